@@ -0,0 +1,124 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include "interval.h"
+#include "vec3.h"
+
+#include <cmath>
+#include <limits>
+
+// Axis-aligned bounding box, stored as one interval per axis.
+class Aabb
+{
+public:
+    Interval _x;
+    Interval _y;
+    Interval _z;
+
+    Aabb() = default; // default box is empty
+
+    Aabb(const Interval &x_value,
+         const Interval &y_value,
+         const Interval &z_value)
+        : _x(x_value), _y(y_value), _z(z_value)
+    {
+    }
+
+    Aabb(const Point3 &a_value, const Point3 &b_value)
+        : _x(std::fmin(a_value[0], b_value[0]),
+             std::fmax(a_value[0], b_value[0])),
+          _y(std::fmin(a_value[1], b_value[1]),
+             std::fmax(a_value[1], b_value[1])),
+          _z(std::fmin(a_value[2], b_value[2]),
+             std::fmax(a_value[2], b_value[2]))
+    {
+    } // treat the two points as extrema of the box
+
+    Aabb(const Aabb &a_value, const Aabb &b_value)
+        : _x(a_value._x, b_value._x), _y(a_value._y, b_value._y),
+          _z(a_value._z, b_value._z)
+    {
+    } // smallest box enclosing both
+
+    [[nodiscard]] const Interval &axis(int n_value) const
+    {
+        if (n_value == 1)
+        {
+            return _y;
+        }
+        if (n_value == 2)
+        {
+            return _z;
+        }
+        return _x;
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return _x._min > _x._max || _y._min > _y._max || _z._min > _z._max;
+    }
+
+    [[nodiscard]] int longest_axis() const
+    {
+        if (_x.size() > _y.size())
+        {
+            return _x.size() > _z.size() ? 0 : 2;
+        }
+        return _y.size() > _z.size() ? 1 : 2;
+    }
+
+    [[nodiscard]] Point3 centroid() const
+    {
+        return {0.5_r * (_x._min + _x._max),
+                0.5_r * (_y._min + _y._max),
+                0.5_r * (_z._min + _z._max)};
+    }
+
+    [[nodiscard]] double surface_area() const
+    {
+        if (empty())
+        {
+            return 0.0;
+        }
+        const double dx{_x.size()};
+        const double dy{_y.size()};
+        const double dz{_z.size()};
+        return 2.0 * (dx * dy + dy * dz + dz * dx);
+    }
+
+    // Slab test.  The caller supplies the reciprocal of the ray direction,
+    // computed once per ray rather than once per box.  Each distance is
+    // three roundings from exact, which can put the far side of a box the
+    // ray grazes before its near side; the far distances are widened by that
+    // bound (Ize, "Robust BVH Ray Traversal", 2013), so a ray through a
+    // shared vertex reaches every box holding it.  A ray parallel to a slab
+    // from an origin on its plane gives a NaN distance, which fmin and fmax
+    // ignore, so it counts as inside that slab.
+    [[nodiscard]] bool hit(const Point3 &origin,
+                           const Vec3 &inverse_direction,
+                           Interval ray_t) const
+    {
+        constexpr Real kRoundoff{std::numeric_limits<Real>::epsilon() / 2};
+        constexpr Real kFarScale{1 + 2 * (3 * kRoundoff / (1 - 3 * kRoundoff))};
+        for (int axis_index{0}; axis_index < 3; ++axis_index)
+        {
+            const Interval &slab{axis(axis_index)};
+            const bool reversed{std::signbit(inverse_direction[axis_index])};
+            const Real near{((reversed ? slab._max : slab._min) -
+                             origin[axis_index]) *
+                            inverse_direction[axis_index]};
+            const Real far{((reversed ? slab._min : slab._max) -
+                            origin[axis_index]) *
+                           inverse_direction[axis_index]};
+            ray_t._min = std::fmax(ray_t._min, near);
+            ray_t._max = std::fmin(ray_t._max, far * kFarScale);
+            if (ray_t._max < ray_t._min)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "camera.h"
+#include "framebuffer.h"
+#include "hittable.h"
+#include "scene.h"
+#include "utility.h"
+#include "vec3.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Motion for frame sequences: over the sequence the camera circles its
+// look-at point once about the view up, and every sphere smaller than
+// kBouncingRadius bounces, each out of step with its neighbours.
+class SceneAnimation
+{
+public:
+    explicit SceneAnimation(const Scene &scene)
+        : _look_from(scene._camera._look_from),
+          _look_at(scene._camera._look_at),
+          _vup(unit_vector(scene._camera._vup))
+    {
+        const SphereSet &spheres{scene._spheres};
+        for (std::size_t index{0}; index < spheres.size(); ++index)
+        {
+            if (spheres.radius(index) < kBouncingRadius)
+            {
+                _bouncing.push_back({index, spheres.centre(index)});
+            }
+        }
+    }
+
+    [[nodiscard]] std::size_t bouncing_spheres() const
+    {
+        return _bouncing.size();
+    }
+
+    // Poses the scene at `time`, which runs from 0 at the start of the
+    // sequence to 1 at its end.  A positive `shutter`, in the same units,
+    // also gives each bouncing sphere the straight motion that takes it to
+    // where it is when the shutter closes, for rays timed from 0 at opening
+    // to 1 at closing.  The camera stays where it is at opening.
+    void pose(double time, Scene &scene, double shutter = 0.0) const
+    {
+        // Rodrigues' rotation of the offset from the look-at point
+        const double angle{2.0 * constants::kPi * time};
+        const Vec3 offset{_look_from - _look_at};
+        const auto cosine{static_cast<Real>(std::cos(angle))};
+        const auto sine{static_cast<Real>(std::sin(angle))};
+        scene._camera._look_from =
+            _look_at + cosine * offset + sine * cross(_vup, offset) +
+            (1 - cosine) * dot(_vup, offset) * _vup;
+
+        for (std::size_t bouncer{0}; bouncer < _bouncing.size(); ++bouncer)
+        {
+            const Point3 start{bounce_centre(bouncer, time)};
+            const std::size_t index{_bouncing[bouncer]._index};
+            scene._spheres.set_centre(index, start);
+            scene._spheres.set_motion(
+                index,
+                shutter > 0.0 ? bounce_centre(bouncer, time + shutter) - start
+                              : Vec3{0, 0, 0});
+        }
+    }
+
+private:
+    // NOLINTBEGIN(readability-magic-numbers)
+    static constexpr Real kBouncingRadius{0.5_r};
+    static constexpr double kBounceHeight{0.5};
+    static constexpr double kBounces{4.0}; // per sequence
+    // NOLINTEND(readability-magic-numbers)
+
+    struct Bouncer
+    {
+        std::size_t _index;
+        Point3 _rest;
+    };
+
+    Point3 _look_from;
+    Point3 _look_at;
+    Vec3 _vup;
+    std::vector<Bouncer> _bouncing;
+
+    [[nodiscard]] Point3 bounce_centre(std::size_t bouncer, double time) const
+    {
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        constexpr double kGoldenRatio{0.6180339887498949};
+
+        const double phase{
+            std::fmod(kGoldenRatio * static_cast<double>(bouncer), 1.0)};
+        const double swing{constants::kPi * (kBounces * time + phase)};
+        const auto height{
+            static_cast<Real>(kBounceHeight * std::fabs(std::sin(swing)))};
+        return _bouncing[bouncer]._rest + height * _vup;
+    }
+};
+
+struct FrameTimes
+{
+    double _setup_seconds{0.0};  // posing the scene and refitting its BVH
+    double _trace_seconds{0.0};  // rendering
+    double _output_seconds{0.0}; // write_frame
+};
+
+// Renders `frame_count` frames of `animation`, calling
+// write_frame(frame, framebuffer) after each, and returns every frame's
+// times.  The scene stays resident: each frame moves the spheres, refits
+// their hierarchy rather than rebuilding it, and renders into the same
+// framebuffer with the camera's thread pool.  `world` must include the
+// scene's spheres.  A positive `shutter`, the fraction of each frame's
+// interval the shutter stays open, blurs the spheres' motion within it;
+// each frame is still one render.
+template <typename WriteFrame>
+std::vector<FrameTimes> render_sequence(Scene &scene,
+                                        const Hittable &world,
+                                        const SceneAnimation &animation,
+                                        int frame_count,
+                                        double shutter,
+                                        WriteFrame &&write_frame)
+{
+    using Clock = std::chrono::steady_clock;
+    const auto seconds_since{[](Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }};
+
+    Camera &camera{scene._camera};
+    camera._shutter_open = 0.0;
+    camera._shutter_close = shutter > 0.0 ? 1.0 : 0.0;
+    Framebuffer framebuffer{camera._image_width, camera.image_height()};
+    std::vector<FrameTimes> times;
+    times.reserve(static_cast<std::size_t>(frame_count));
+    for (int frame{0}; frame < frame_count; ++frame)
+    {
+        FrameTimes frame_times;
+        auto start{Clock::now()};
+        animation.pose(static_cast<double>(frame) / frame_count,
+                       scene,
+                       shutter / frame_count);
+        scene._spheres.refit_hierarchy();
+        framebuffer.clear();
+        frame_times._setup_seconds = seconds_since(start);
+
+        start = Clock::now();
+        camera.render(world, scene._materials, framebuffer);
+        frame_times._trace_seconds = seconds_since(start);
+
+        start = Clock::now();
+        write_frame(frame, framebuffer);
+        frame_times._output_seconds = seconds_since(start);
+        times.push_back(frame_times);
+    }
+    return times;
+}
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator that owns scene objects.  Objects are constructed one after
+// another in large blocks, so objects made together sit together in memory
+// with no per-object allocation header or reference count, and they never
+// move, so pointers to them stay valid.  Everything is destroyed at once,
+// in reverse order of construction, when the arena is.
+class Arena
+{
+public:
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    static constexpr std::size_t kDefaultBlockBytes{std::size_t{1} << 16U};
+
+    explicit Arena(std::size_t block_bytes = kDefaultBlockBytes)
+        : _block_bytes(block_bytes)
+    {
+    }
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    Arena(Arena &&) = delete;
+    Arena &operator=(Arena &&) = delete;
+
+    ~Arena()
+    {
+        for (auto destructor{_destructors.rbegin()};
+             destructor != _destructors.rend();
+             ++destructor)
+        {
+            destructor->_destroy(destructor->_object);
+        }
+    }
+
+    // Constructs a T in the arena and returns it; the arena destroys it.
+    template <typename T, typename... Args>
+    T &make(Args &&...args)
+    {
+        void *storage{allocate(sizeof(T), alignof(T))};
+        T *object{::new (storage) T(std::forward<Args>(args)...)};
+        if constexpr (!std::is_trivially_destructible_v<T>)
+        {
+            _destructors.push_back(
+                {[](void *pointer) { static_cast<T *>(pointer)->~T(); },
+                 object});
+        }
+        return *object;
+    }
+
+    // Bytes handed out so far, excluding the unused tail of each block.
+    [[nodiscard]] std::size_t bytes_used() const
+    {
+        return _bytes_used;
+    }
+
+private:
+    struct Block
+    {
+        std::unique_ptr<std::byte[]> _bytes;
+        std::size_t _size;
+    };
+
+    struct Destructor
+    {
+        void (*_destroy)(void *);
+        void *_object;
+    };
+
+    std::size_t _block_bytes;
+    std::vector<Block> _blocks;
+    std::size_t _block_used{0}; // bytes taken from the last block
+    std::size_t _bytes_used{0};
+    std::vector<Destructor> _destructors;
+
+    void *allocate(std::size_t size, std::size_t alignment)
+    {
+        if (!_blocks.empty())
+        {
+            Block &block{_blocks.back()};
+            void *pointer{block._bytes.get() + _block_used};
+            std::size_t space{block._size - _block_used};
+            if (std::align(alignment, size, pointer, space) != nullptr)
+            {
+                _block_used = block._size - space + size;
+                _bytes_used += size;
+                return pointer;
+            }
+        }
+
+        // an object larger than a block gets a block of its own, with room
+        // to align it; blocks are left uninitialised
+        const std::size_t block_size{std::max(_block_bytes, size + alignment)};
+        _blocks.push_back(
+            {std::unique_ptr<std::byte[]>{new std::byte[block_size]},
+             block_size});
+        _block_used = 0;
+        return allocate(size, alignment);
+    }
+};
+
+#endif
@@ -0,0 +1,2501 @@
+#include "arena.h"
+#include "bvh.h"
+#include "camera.h"
+#include "checkpoint.h"
+#include "denoise.h"
+#include "distributed.h"
+#include "framebuffer.h"
+#include "hittable_list.h"
+#include "image_writer.h"
+#include "instance.h"
+#include "material.h"
+#include "mesh.h"
+#include "mesh_file.h"
+#include "preview.h"
+#include "render_counters.h"
+#include "rng.h"
+#include "sampler.h"
+#include "sampling.h"
+#include "scene.h"
+#include "scene_file.h"
+#include "scenes.h"
+#include "sphere.h"
+#include "sphere_set.h"
+#include "texture.h"
+#include "texture_cache.h"
+#include "texture_file.h"
+#include "utility.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <csignal>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+// checks that failed, so main can report them in its exit status
+int mismatches{0}; // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+
+// Marks the result being printed as failing its check.
+std::ostream &report_mismatch()
+{
+    ++mismatches;
+    return std::cout << "  MISMATCH";
+}
+
+struct TraceResult
+{
+    double _seconds{0.0};
+    std::size_t _hits{0};
+    double _distance_sum{0.0};
+};
+
+HittableList random_sphere_field(std::size_t sphere_count,
+                                 Rng &rng,
+                                 Arena &arena,
+                                 SphereSet *sphere_set = nullptr)
+{
+    // spheres scattered through a cube whose volume grows with the count, so
+    // the density (and hit rate) stays roughly constant across sizes
+    const double half_extent{std::cbrt(static_cast<double>(sphere_count))};
+    constexpr MaterialId kMaterial{0};
+
+    HittableList world;
+    for (std::size_t index{0}; index < sphere_count; ++index)
+    {
+        const Point3 centre{Vec3::random(rng, -half_extent, half_extent)};
+        const auto radius{static_cast<Real>(random_double(rng, 0.1, 0.3))};
+        world.add(arena.make<Sphere>(centre, radius, kMaterial));
+        if (sphere_set != nullptr)
+        {
+            sphere_set->add(centre, radius, kMaterial);
+        }
+    }
+    return world;
+}
+
+std::vector<Ray> random_rays(std::size_t ray_count,
+                             const Aabb &bounds,
+                             Rng &rng)
+{
+    std::vector<Ray> rays;
+    rays.reserve(ray_count);
+    for (std::size_t index{0}; index < ray_count; ++index)
+    {
+        const Point3 origin{
+            static_cast<Real>(
+                random_double(rng, bounds._x._min, bounds._x._max)),
+            static_cast<Real>(
+                random_double(rng, bounds._y._min, bounds._y._max)),
+            static_cast<Real>(
+                random_double(rng, bounds._z._min, bounds._z._max))};
+        rays.emplace_back(origin, random_unit_vector(rng));
+    }
+    return rays;
+}
+
+TraceResult trace(const Hittable &world,
+                  const std::vector<Ray> &rays,
+                  std::vector<HitRecord> *records = nullptr)
+{
+    TraceResult result;
+    const auto start{Clock::now()};
+    for (const Ray &ray : rays)
+    {
+        HitRecord record;
+        if (world.hit(ray, Interval(0.001_r, constants::kInfinity), record))
+        {
+            ++result._hits;
+            result._distance_sum += record._t_interval;
+        }
+        if (records != nullptr)
+        {
+            records->push_back(record);
+        }
+    }
+    result._seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    return result;
+}
+
+bool same_records(const std::vector<HitRecord> &expected,
+                  const std::vector<HitRecord> &actual)
+{
+    for (std::size_t index{0}; index < expected.size(); ++index)
+    {
+        const HitRecord &a_value{expected[index]};
+        const HitRecord &b_value{actual[index]};
+        for (int axis{0}; axis < 3; ++axis)
+        {
+            if (a_value._point[axis] != b_value._point[axis] ||
+                a_value._normal[axis] != b_value._normal[axis])
+            {
+                return false;
+            }
+        }
+        if (a_value._t_interval != b_value._t_interval ||
+            a_value._front_face != b_value._front_face ||
+            a_value._material != b_value._material)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool same_pixels(const Framebuffer &expected, const Framebuffer &actual)
+{
+    for (int j{0}; j < expected.height(); ++j)
+    {
+        for (int i{0}; i < expected.width(); ++i)
+        {
+            for (int axis{0}; axis < 3; ++axis)
+            {
+                if (expected.at(i, j)[axis] != actual.at(i, j)[axis])
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// RMSE between two images' pixel means, clamped to [0, 1] as displayed.
+double image_rmse(const Framebuffer &expected, const Framebuffer &actual)
+{
+    using image_writer_detail::pixel_mean;
+
+    double squared_sum{0.0};
+    for (int j{0}; j < expected.height(); ++j)
+    {
+        for (int i{0}; i < expected.width(); ++i)
+        {
+            const Colour expected_mean{pixel_mean(expected, i, j)};
+            const Colour actual_mean{pixel_mean(actual, i, j)};
+            for (int axis{0}; axis < 3; ++axis)
+            {
+                const double difference{
+                    std::clamp(static_cast<double>(actual_mean[axis]),
+                               0.0,
+                               1.0) -
+                    std::clamp(static_cast<double>(expected_mean[axis]),
+                               0.0,
+                               1.0)};
+                squared_sum += difference * difference;
+            }
+        }
+    }
+    return std::sqrt(squared_sum /
+                     (3.0 * static_cast<double>(expected.width()) *
+                      static_cast<double>(expected.height())));
+}
+
+double mrays_per_second(std::size_t ray_count, double seconds)
+{
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    return static_cast<double>(ray_count) / seconds / 1.0e6;
+}
+
+// Resident memory of this process, from /proc/self/statm.
+std::size_t resident_bytes()
+{
+    std::ifstream statm{"/proc/self/statm"};
+    std::size_t size{0};
+    std::size_t resident{0};
+    statm >> size >> resident;
+    return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+void bench_bvh()
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    constexpr std::size_t kRayCount{20000};
+    const std::vector<std::size_t> sphere_counts{100, 1000, 10000, 100000};
+    // NOLINTEND(readability-magic-numbers)
+
+    std::cout << "BVH against linear list (" << kRayCount << " rays)\n"
+              << std::setw(10) << "spheres" << std::setw(12) << "build ms"
+              << std::setw(14) << "list Mray/s" << std::setw(14)
+              << "bvh Mray/s" << std::setw(10) << "speedup" << '\n';
+
+    Rng rng;
+    for (const std::size_t sphere_count : sphere_counts)
+    {
+        Arena arena;
+        const HittableList world{
+            random_sphere_field(sphere_count, rng, arena)};
+
+        const auto build_start{Clock::now()};
+        const Bvh bvh{world};
+        const double build_ms{std::chrono::duration<double, std::milli>(
+                                  Clock::now() - build_start)
+                                  .count()};
+
+        const std::vector<Ray> rays{
+            random_rays(kRayCount, world.bounding_box(), rng)};
+        const TraceResult list_result{trace(world, rays)};
+        const TraceResult bvh_result{trace(bvh, rays)};
+
+        std::cout << std::setw(10) << sphere_count << std::fixed
+                  << std::setprecision(2) << std::setw(12) << build_ms
+                  << std::setw(14)
+                  << mrays_per_second(kRayCount, list_result._seconds)
+                  << std::setw(14)
+                  << mrays_per_second(kRayCount, bvh_result._seconds)
+                  << std::setw(9)
+                  << list_result._seconds / bvh_result._seconds << 'x';
+        if (list_result._hits != bvh_result._hits ||
+            list_result._distance_sum != bvh_result._distance_sum)
+        {
+            report_mismatch();
+        }
+        std::cout << '\n';
+    }
+}
+
+// Counts the process's hardware cache misses through perf_event_open, where
+// the kernel and processor allow it; virtual machines often do not.
+class CacheMissCounter
+{
+public:
+    CacheMissCounter()
+    {
+        perf_event_attr attributes{};
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.size = sizeof(attributes);
+        attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+        attributes.disabled = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        _descriptor = static_cast<int>(
+            ::syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+    }
+
+    CacheMissCounter(const CacheMissCounter &) = delete;
+    CacheMissCounter &operator=(const CacheMissCounter &) = delete;
+
+    ~CacheMissCounter()
+    {
+        if (_descriptor >= 0)
+        {
+            ::close(_descriptor);
+        }
+    }
+
+    [[nodiscard]] bool available() const
+    {
+        return _descriptor >= 0;
+    }
+
+    void start() const
+    {
+        ::ioctl(_descriptor, PERF_EVENT_IOC_RESET, 0);
+        ::ioctl(_descriptor, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    // Misses since start(), or zero if counting is unavailable.
+    [[nodiscard]] std::uint64_t stop() const
+    {
+        std::uint64_t misses{0};
+        if (available())
+        {
+            ::ioctl(_descriptor, PERF_EVENT_IOC_DISABLE, 0);
+            if (::read(_descriptor, &misses, sizeof(misses)) !=
+                static_cast<ssize_t>(sizeof(misses)))
+            {
+                misses = 0;
+            }
+        }
+        return misses;
+    }
+
+private:
+    int _descriptor{-1};
+};
+
+// Makes spheres one make_shared at a time, each beside a make_shared
+// material as scenes used to be built, and the same spheres in an Arena, then
+// times building a BVH over each, tracing the same rays through both, and
+// freeing the objects.
+void bench_arena()
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    constexpr std::size_t kRayCount{100000};
+    const std::vector<std::size_t> sphere_counts{10000, 100000, 1000000};
+    // NOLINTEND(readability-magic-numbers)
+    const CacheMissCounter cache_misses;
+    const auto milliseconds{[](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+    }};
+    const auto pair{[](auto heap, auto arena) {
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(2) << heap << " / " << arena;
+        return text.str();
+    }};
+
+    std::cout << "\nArena against shared_ptr scene objects (heap / arena, "
+              << kRayCount << " rays through the BVH)\n"
+              << std::setw(9) << "spheres" << std::setw(20) << "make ms"
+              << std::setw(20) << "build BVH ms" << std::setw(16)
+              << "free ms" << std::setw(14) << "Mray/s" << std::setw(24)
+              << "cache misses" << '\n';
+
+    for (const std::size_t sphere_count : sphere_counts)
+    {
+        Rng rng;
+        const double half_extent{std::cbrt(static_cast<double>(sphere_count))};
+        std::vector<Point3> centres;
+        std::vector<Real> radii;
+        for (std::size_t index{0}; index < sphere_count; ++index)
+        {
+            centres.push_back(Vec3::random(rng, -half_extent, half_extent));
+            // NOLINTNEXTLINE(readability-magic-numbers)
+            radii.push_back(static_cast<Real>(random_double(rng, 0.1, 0.3)));
+        }
+
+        auto start{Clock::now()};
+        std::vector<std::shared_ptr<Hittable>> heap_objects;
+        std::vector<std::shared_ptr<Material>> heap_materials;
+        HittableList heap_list;
+        for (std::size_t index{0}; index < sphere_count; ++index)
+        {
+            heap_materials.push_back(std::make_shared<Material>(
+                Lambertian{Colour{0.5, 0.5, 0.5}}));
+            heap_objects.push_back(std::make_shared<Sphere>(
+                centres[index], radii[index], MaterialId{0}));
+            heap_list.add(*heap_objects.back());
+        }
+        const double heap_make_ms{milliseconds(start)};
+        start = Clock::now();
+        std::optional<Bvh> heap_bvh{heap_list};
+        const double heap_build_ms{milliseconds(start)};
+
+        start = Clock::now();
+        std::optional<Arena> arena{std::in_place};
+        HittableList arena_list;
+        for (std::size_t index{0}; index < sphere_count; ++index)
+        {
+            arena_list.add(arena->make<Sphere>(
+                centres[index], radii[index], MaterialId{0}));
+        }
+        const double arena_make_ms{milliseconds(start)};
+        start = Clock::now();
+        std::optional<Bvh> arena_bvh{arena_list};
+        const double arena_build_ms{milliseconds(start)};
+
+        const std::vector<Ray> rays{
+            random_rays(kRayCount, arena_list.bounding_box(), rng)};
+        cache_misses.start();
+        const TraceResult heap_result{trace(*heap_bvh, rays)};
+        const std::uint64_t heap_misses{cache_misses.stop()};
+        cache_misses.start();
+        const TraceResult arena_result{trace(*arena_bvh, rays)};
+        const std::uint64_t arena_misses{cache_misses.stop()};
+
+        heap_bvh.reset();
+        heap_list.clear();
+        start = Clock::now();
+        heap_objects.clear();
+        heap_materials.clear();
+        const double heap_free_ms{milliseconds(start)};
+        arena_bvh.reset();
+        arena_list.clear();
+        start = Clock::now();
+        arena.reset();
+        const double arena_free_ms{milliseconds(start)};
+
+        std::cout << std::setw(9) << sphere_count << std::setw(20)
+                  << pair(heap_make_ms, arena_make_ms) << std::setw(20)
+                  << pair(heap_build_ms, arena_build_ms) << std::setw(16)
+                  << pair(heap_free_ms, arena_free_ms) << std::setw(14)
+                  << pair(mrays_per_second(kRayCount, heap_result._seconds),
+                          mrays_per_second(kRayCount, arena_result._seconds))
+                  << std::setw(24)
+                  << (cache_misses.available() ? pair(heap_misses, arena_misses)
+                                               : std::string{"n/a"});
+        if (heap_result._hits != arena_result._hits ||
+            heap_result._distance_sum != arena_result._distance_sum)
+        {
+            report_mismatch();
+        }
+        std::cout << '\n';
+    }
+}
+
+void bench_sphere_set()
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    constexpr std::size_t kRayCount{20000};
+    const std::vector<std::size_t> sphere_counts{8, 64, 512, 4096};
+    // NOLINTEND(readability-magic-numbers)
+
+    std::cout << "\nSphereSet (" << SphereSet::kKernel << " kernel, "
+              << kRealName << ") against list of Sphere (" << kRayCount
+              << " rays)\n"
+              << std::setw(10) << "spheres" << std::setw(14) << "list Mray/s"
+              << std::setw(14) << "set Mray/s" << std::setw(10) << "speedup"
+              << '\n';
+
+    Rng rng;
+    for (const std::size_t sphere_count : sphere_counts)
+    {
+        SphereSet sphere_set;
+        Arena arena;
+        const HittableList world{
+            random_sphere_field(sphere_count, rng, arena, &sphere_set)};
+        const std::vector<Ray> rays{
+            random_rays(kRayCount, world.bounding_box(), rng)};
+
+        std::vector<HitRecord> list_records;
+        std::vector<HitRecord> set_records;
+        const TraceResult list_result{trace(world, rays, &list_records)};
+        const TraceResult set_result{trace(sphere_set, rays, &set_records)};
+
+        std::cout << std::setw(10) << sphere_count << std::fixed
+                  << std::setprecision(2) << std::setw(14)
+                  << mrays_per_second(kRayCount, list_result._seconds)
+                  << std::setw(14)
+                  << mrays_per_second(kRayCount, set_result._seconds)
+                  << std::setw(9)
+                  << list_result._seconds / set_result._seconds << 'x';
+        if (!same_records(list_records, set_records))
+        {
+            report_mismatch();
+        }
+        std::cout << '\n';
+    }
+}
+
+// Three scalars with the same arithmetic as the scalar code of vec3.h: the
+// baseline that bench_vec3 measures this build's Vec3 layout against.
+struct PackedVec3
+{
+    Real _x;
+    Real _y;
+    Real _z;
+};
+
+PackedVec3 operator+(const PackedVec3 &u_value, const PackedVec3 &v_value)
+{
+    return {u_value._x + v_value._x,
+            u_value._y + v_value._y,
+            u_value._z + v_value._z};
+}
+
+PackedVec3 operator-(const PackedVec3 &u_value, const PackedVec3 &v_value)
+{
+    return {u_value._x - v_value._x,
+            u_value._y - v_value._y,
+            u_value._z - v_value._z};
+}
+
+PackedVec3 operator*(Real t_value, const PackedVec3 &v_value)
+{
+    return {t_value * v_value._x, t_value * v_value._y, t_value * v_value._z};
+}
+
+Real dot(const PackedVec3 &u_value, const PackedVec3 &v_value)
+{
+    return u_value._x * v_value._x + u_value._y * v_value._y +
+           u_value._z * v_value._z;
+}
+
+PackedVec3 cross(const PackedVec3 &u_value, const PackedVec3 &v_value)
+{
+    return {u_value._y * v_value._z - u_value._z * v_value._y,
+            u_value._z * v_value._x - u_value._x * v_value._z,
+            u_value._x * v_value._y - u_value._y * v_value._x};
+}
+
+PackedVec3 unit_vector(const PackedVec3 &v_value)
+{
+    return (1 / std::sqrt(dot(v_value, v_value))) * v_value;
+}
+
+PackedVec3 reflect(const PackedVec3 &vector, const PackedVec3 &normal)
+{
+    return vector - (2 * dot(vector, normal)) * normal;
+}
+
+PackedVec3 refract(const PackedVec3 &incident_ray_uv,
+                   const PackedVec3 &normal,
+                   Real eta_i_over_eta_j)
+{
+    const PackedVec3 reversed{-incident_ray_uv._x,
+                              -incident_ray_uv._y,
+                              -incident_ray_uv._z};
+    const Real cos_theta{std::fmin(dot(reversed, normal), Real{1})};
+    const PackedVec3 ray_out_perpendicular{
+        eta_i_over_eta_j * (incident_ray_uv + cos_theta * normal)};
+    const Real parallel_length{-std::sqrt(
+        std::fabs(1 - dot(ray_out_perpendicular, ray_out_perpendicular)))};
+    return ray_out_perpendicular + parallel_length * normal;
+}
+
+// Applies `operation` to every pair of inputs, `rounds` times over, and
+// returns the seconds taken.
+template <typename Vector, typename Operation>
+double time_vector_operation(const std::vector<Vector> &u_values,
+                             const std::vector<Vector> &v_values,
+                             std::vector<Vector> &results,
+                             int rounds,
+                             const Operation &operation)
+{
+    const auto start{Clock::now()};
+    for (int round{0}; round < rounds; ++round)
+    {
+        for (std::size_t index{0}; index < u_values.size(); ++index)
+        {
+            results[index] = operation(u_values[index], v_values[index]);
+        }
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+template <typename Operation>
+void bench_vector_operation(const char *name,
+                            const std::vector<Vec3> &u_values,
+                            const std::vector<Vec3> &v_values,
+                            const Operation &operation)
+{
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    constexpr int kRounds{2000};
+    const auto packed{[](const Vec3 &vector) {
+        return PackedVec3{vector.x(), vector.y(), vector.z()};
+    }};
+    std::vector<PackedVec3> packed_u;
+    std::vector<PackedVec3> packed_v;
+    for (std::size_t index{0}; index < u_values.size(); ++index)
+    {
+        packed_u.push_back(packed(u_values[index]));
+        packed_v.push_back(packed(v_values[index]));
+    }
+
+    std::vector<PackedVec3> packed_results(u_values.size());
+    std::vector<Vec3> results(u_values.size());
+    const double packed_seconds{time_vector_operation(
+        packed_u, packed_v, packed_results, kRounds, operation)};
+    const double seconds{time_vector_operation(
+        u_values, v_values, results, kRounds, operation)};
+
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    const double operations{1.0e-9 * kRounds *
+                            static_cast<double>(u_values.size())};
+    std::cout << std::setw(12) << name << std::fixed << std::setprecision(2)
+              << std::setw(12) << packed_seconds / operations << std::setw(12)
+              << seconds / operations << std::setw(9)
+              << packed_seconds / seconds << 'x';
+    for (std::size_t index{0}; index < results.size(); ++index)
+    {
+        const PackedVec3 expected{packed_results[index]};
+        if (expected._x != results[index].x() ||
+            expected._y != results[index].y() ||
+            expected._z != results[index].z())
+        {
+            report_mismatch();
+            break;
+        }
+    }
+    std::cout << '\n';
+}
+
+void bench_vec3()
+{
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    constexpr std::size_t kCount{4096};
+
+    std::cout << "\nVec3 (" << sizeof(Vec3) << " bytes, aligned to "
+              << alignof(Vec3) << ", " << kRealName
+              << ") against three packed scalars\n"
+              << std::setw(12) << "operation" << std::setw(12) << "packed ns"
+              << std::setw(12) << "Vec3 ns" << std::setw(10) << "speedup"
+              << '\n';
+
+    Rng rng;
+    std::vector<Vec3> u_values;
+    std::vector<Vec3> v_values;
+    for (std::size_t index{0}; index < kCount; ++index)
+    {
+        u_values.push_back(random_unit_vector(rng));
+        v_values.push_back(random_unit_vector(rng));
+    }
+
+    bench_vector_operation(
+        "add",
+        u_values,
+        v_values,
+        [](const auto &u_value, const auto &v_value) {
+            return u_value + v_value;
+        });
+    bench_vector_operation(
+        "dot",
+        u_values,
+        v_values,
+        [](const auto &u_value, const auto &v_value) {
+            using Vector = std::decay_t<decltype(u_value)>;
+            return Vector{dot(u_value, v_value), 0, 0};
+        });
+    bench_vector_operation(
+        "cross",
+        u_values,
+        v_values,
+        [](const auto &u_value, const auto &v_value) {
+            return cross(u_value, v_value);
+        });
+    bench_vector_operation(
+        "unit_vector",
+        u_values,
+        v_values,
+        [](const auto &u_value, const auto &v_value) {
+            return unit_vector(u_value + v_value);
+        });
+    bench_vector_operation(
+        "reflect",
+        u_values,
+        v_values,
+        [](const auto &u_value, const auto &v_value) {
+            return reflect(u_value, v_value);
+        });
+    bench_vector_operation(
+        "refract",
+        u_values,
+        v_values,
+        [](const auto &u_value, const auto &v_value) {
+            return refract(u_value, v_value, Real{1} / 1.5_r);
+        });
+}
+
+// Draws points from a rejection sampler and from the closed-form mapping
+// meant to replace it, bins both into cells of equal probability and
+// compares the histograms with a two-sample chi-square test.
+template <typename Rejection, typename Mapping, typename Bin>
+void bench_sampling_routine(const char *name,
+                            Rejection rejection,
+                            Mapping mapping,
+                            Bin bin)
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    constexpr std::size_t kCount{1000000};
+    constexpr std::size_t kBins{128};
+    // about six standard deviations above the statistic's mean
+    const double limit{(kBins - 1) + 6.0 * std::sqrt(2.0 * (kBins - 1))};
+    // NOLINTEND(readability-magic-numbers)
+
+    std::vector<Vec3> points(kCount);
+    const auto draw{[&](auto &&sample, Rng &rng, std::vector<double> &counts) {
+        const auto start{Clock::now()};
+        for (Vec3 &point : points)
+        {
+            point = sample(rng);
+        }
+        const double seconds{
+            std::chrono::duration<double>(Clock::now() - start).count()};
+        counts.assign(kBins, 0.0);
+        for (const Vec3 &point : points)
+        {
+            counts[bin(point)] += 1.0;
+        }
+        return seconds;
+    }};
+
+    Rng rejection_rng{1};
+    Rng mapping_rng{2};
+    std::vector<double> rejection_counts;
+    std::vector<double> mapping_counts;
+    const double rejection_seconds{
+        draw(rejection, rejection_rng, rejection_counts)};
+    const double mapping_seconds{draw(
+        [&](Rng &rng) {
+            const double u{random_double(rng)};
+            return mapping(Sample2{u, random_double(rng)});
+        },
+        mapping_rng,
+        mapping_counts)};
+
+    double chi_square{0.0};
+    for (std::size_t index{0}; index < kBins; ++index)
+    {
+        const double difference{rejection_counts[index] -
+                                mapping_counts[index]};
+        const double total{rejection_counts[index] + mapping_counts[index]};
+        chi_square += total > 0.0 ? difference * difference / total : 0.0;
+    }
+
+    const double scale{1e9 / static_cast<double>(kCount)};
+    std::cout << std::setw(18) << name << std::fixed << std::setprecision(2)
+              << std::setw(14) << rejection_seconds * scale << std::setw(16)
+              << mapping_seconds * scale << std::setprecision(1)
+              << std::setw(12) << chi_square;
+    if (chi_square > limit)
+    {
+        report_mismatch();
+    }
+    std::cout << '\n';
+}
+
+void bench_sampling()
+{
+    // Cells are rings or bands of equal probability split into sectors
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    constexpr std::size_t kBands{8};
+    constexpr std::size_t kSectors{16};
+    const auto cell{[](double band_fraction, double x, double y) {
+        const double turn{std::atan2(y, x) / (2.0 * constants::kPi) + 0.5};
+        const auto band{std::min(
+            static_cast<std::size_t>(band_fraction * kBands), kBands - 1)};
+        const auto sector{std::min(static_cast<std::size_t>(turn * kSectors),
+                                   kSectors - 1)};
+        return band * kSectors + sector;
+    }};
+
+    std::cout << "\nClosed-form sampling against rejection sampling "
+                 "(ns per sample, chi-square on 127 degrees of freedom)\n"
+              << std::setw(18) << "routine" << std::setw(14) << "rejection"
+              << std::setw(16) << "closed form" << std::setw(12)
+              << "chi-square" << '\n';
+
+    // the radius squared of a uniform disc point is uniform
+    bench_sampling_routine(
+        "concentric_disc",
+        [](Rng &rng) { return random_in_unit_disc(rng); },
+        [](const Sample2 &sample) { return concentric_disc(sample); },
+        [&](const Vec3 &point) {
+            return cell(point.x() * point.x() + point.y() * point.y(),
+                        point.x(),
+                        point.y());
+        });
+
+    // so is the height of a uniform sphere point (Archimedes)
+    bench_sampling_routine(
+        "uniform_sphere",
+        [](Rng &rng) { return random_unit_vector(rng); },
+        [](const Sample2 &sample) { return uniform_sphere(sample); },
+        [&](const Vec3 &point) {
+            return cell((point.z() + 1) / 2, point.x(), point.y());
+        });
+
+    // and the squared cosine to the normal of a cosine-weighted direction;
+    // the rejection version is the book's normal plus a unit vector
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    const Vec3 normal{unit_vector(Vec3{1, 2, 3})};
+    Vec3 tangent;
+    Vec3 bitangent;
+    orthonormal_basis(normal, tangent, bitangent);
+    bench_sampling_routine(
+        "cosine_hemisphere",
+        [&](Rng &rng) { return unit_vector(normal + random_unit_vector(rng)); },
+        [&](const Sample2 &sample) {
+            return cosine_hemisphere(normal, sample);
+        },
+        [&](const Vec3 &direction) {
+            const double cosine{dot(direction, normal)};
+            return cell(cosine * cosine,
+                        dot(direction, tangent),
+                        dot(direction, bitangent));
+        });
+}
+
+struct ImageEstimate
+{
+    double _mean{0.0};     // mean luminance over all pixels
+    double _variance{0.0}; // variance of that mean
+    std::uint64_t _samples{0};
+    double _seconds{0.0};
+};
+
+ImageEstimate estimate_image(Camera &camera,
+                             const Hittable &world,
+                             const MaterialTable &materials)
+{
+    const auto start{Clock::now()};
+    const Framebuffer framebuffer{camera.render(world, materials)};
+
+    ImageEstimate estimate;
+    estimate._seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    const auto pixel_count{static_cast<double>(framebuffer.width()) *
+                           static_cast<double>(framebuffer.height())};
+    for (int j{0}; j < framebuffer.height(); ++j)
+    {
+        for (int i{0}; i < framebuffer.width(); ++i)
+        {
+            const auto samples{
+                static_cast<double>(framebuffer.samples(i, j))};
+            estimate._mean += luminance(framebuffer.at(i, j)) / samples;
+            estimate._variance +=
+                framebuffer.luminance_variance(i, j) / samples;
+            estimate._samples += framebuffer.samples(i, j);
+        }
+    }
+    estimate._mean /= pixel_count;
+    estimate._variance /= pixel_count * pixel_count;
+    return estimate;
+}
+
+// The three large spheres of the main scene on its ground plane.
+HittableList showcase_scene(MaterialTable &materials, Arena &arena)
+{
+    HittableList world;
+    // NOLINTBEGIN(readability-magic-numbers)
+    world.add(arena.make<Sphere>(
+        Point3{0, -1000, 0},
+        1000_r,
+        materials.add(Lambertian{Colour{0.5, 0.5, 0.5}})));
+    world.add(arena.make<Sphere>(
+        Point3{0, 1, 0}, 1.0_r, materials.add(Dielectric{1.5})));
+    world.add(arena.make<Sphere>(
+        Point3{-4, 1, 0},
+        1.0_r,
+        materials.add(Lambertian{Colour{0.4_r, 0.2_r, 0.1_r}})));
+    world.add(arena.make<Sphere>(
+        Point3{4, 1, 0},
+        1.0_r,
+        materials.add(Metal{Colour{0.7_r, 0.6_r, 0.5_r}, 0.1})));
+    // NOLINTEND(readability-magic-numbers)
+    return world;
+}
+
+Camera showcase_camera()
+{
+    Camera camera;
+    // NOLINTBEGIN(readability-magic-numbers)
+    camera._aspect_ratio = 16.0 / 9.0;
+    camera._image_width = 96;
+    camera._samples_per_pixel = 256;
+    camera._max_depth = 50;
+    camera._vertical_fov = 20;
+    camera._look_from = Point3{13, 2, 3};
+    camera._look_at = Point3{0, 0, 0};
+    camera._defocus_angle = 0.0;
+    // NOLINTEND(readability-magic-numbers)
+    return camera;
+}
+
+void bench_russian_roulette()
+{
+    // Renders one scene with and without Russian roulette and checks the two
+    // image means agree to within sampling error: roulette must change only
+    // the cost and variance of the estimator, never its expectation.
+    MaterialTable materials;
+    Arena arena;
+    const HittableList world{showcase_scene(materials, arena)};
+    Camera camera{showcase_camera()};
+
+    camera._russian_roulette_depth = 0;
+    const ImageEstimate reference{estimate_image(camera, world, materials)};
+    camera._russian_roulette_depth = 3;
+    camera._seed = 1; // independent samples, so the two errors add
+    const ImageEstimate roulette{estimate_image(camera, world, materials)};
+
+    const double z_score{(roulette._mean - reference._mean) /
+                         std::sqrt(reference._variance + roulette._variance)};
+    std::cout << "\nRussian roulette against full-depth paths ("
+              << reference._samples << " samples each)\n"
+              << std::setw(14) << "full mean" << std::setw(14)
+              << "roulette mean" << std::setw(10) << "z-score"
+              << std::setw(12) << "full s" << std::setw(12) << "roulette s"
+              << '\n'
+              << std::fixed << std::setprecision(5) << std::setw(14)
+              << reference._mean << std::setw(14) << roulette._mean
+              << std::setprecision(2) << std::setw(10) << z_score
+              << std::setw(12) << reference._seconds << std::setw(12)
+              << roulette._seconds;
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    if (std::fabs(z_score) > 4.0)
+    {
+        report_mismatch();
+    }
+    std::cout << '\n';
+}
+
+void bench_samplers()
+{
+    // Every sampler must converge to the same image: their means are checked
+    // against the independent sampler's, as in bench_russian_roulette.  The
+    // per-pixel variances overstate the error of the stratified and
+    // low-discrepancy samplers, so the check is conservative for them.
+    MaterialTable materials;
+    Arena arena;
+    const HittableList world{showcase_scene(materials, arena)};
+    Camera camera{showcase_camera()};
+
+    camera._sampler = SamplerKind::kIndependent;
+    const ImageEstimate reference{estimate_image(camera, world, materials)};
+    std::cout << "\nSamplers against independent sampling ("
+              << reference._samples << " samples each)\n"
+              << std::setw(14) << "sampler" << std::setw(12) << "mean"
+              << std::setw(10) << "z-score" << std::setw(10) << "s" << '\n'
+              << std::setw(14) << sampler_name(SamplerKind::kIndependent)
+              << std::fixed << std::setprecision(5) << std::setw(12)
+              << reference._mean
+              << std::setw(10) << "" << std::setprecision(2) << std::setw(10)
+              << reference._seconds << '\n';
+
+    camera._seed = 1; // independent of the reference
+    for (const SamplerKind sampler : {SamplerKind::kStratified,
+                                      SamplerKind::kSobol,
+                                      SamplerKind::kBlueNoise})
+    {
+        camera._sampler = sampler;
+        const ImageEstimate estimate{
+            estimate_image(camera, world, materials)};
+        const double z_score{
+            (estimate._mean - reference._mean) /
+            std::sqrt(reference._variance + estimate._variance)};
+        std::cout << std::setw(14) << sampler_name(sampler)
+                  << std::setprecision(5) << std::setw(12) << estimate._mean
+                  << std::setprecision(2) << std::setw(10) << z_score
+                  << std::setw(10) << estimate._seconds;
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        if (std::fabs(z_score) > 4.0)
+        {
+            report_mismatch();
+        }
+        std::cout << '\n';
+    }
+}
+
+void bench_denoise()
+{
+    // Denoises a 32 spp render and finds how many samples per pixel a plain
+    // render needs to match its error against a 4096 spp reference.  The
+    // denoised image must at least beat the render it came from.
+    // NOLINTBEGIN(readability-magic-numbers)
+    constexpr int kSamples{32};
+    constexpr int kReferenceSamples{4096};
+    constexpr int kMaxSamples{1024};
+    // NOLINTEND(readability-magic-numbers)
+    MaterialTable materials;
+    Arena arena;
+    const HittableList world{showcase_scene(materials, arena)};
+    const Bvh bvh{world};
+    Camera camera{showcase_camera()};
+    camera._sampler = SamplerKind::kSobol;
+    camera._threads = std::max(std::thread::hardware_concurrency(), 1U);
+
+    camera._samples_per_pixel = kReferenceSamples;
+    camera._seed = 1;
+    const Framebuffer reference{camera.render(bvh, materials)};
+    camera._seed = 0;
+    camera._samples_per_pixel = kSamples;
+    const Framebuffer noisy{camera.render(bvh, materials)};
+    const double render_seconds{camera.stats()._seconds};
+
+    auto start{Clock::now()};
+    const FeatureBuffer features{camera.render_features(bvh, materials)};
+    const double feature_seconds{
+        std::chrono::duration<double>(Clock::now() - start).count()};
+    start = Clock::now();
+    const Framebuffer denoised{denoise(noisy, features, camera._threads)};
+    const double denoise_seconds{
+        std::chrono::duration<double>(Clock::now() - start).count()};
+
+    const double noisy_error{image_rmse(reference, noisy)};
+    const double denoised_error{image_rmse(reference, denoised)};
+    int matching_samples{kSamples};
+    double matching_error{noisy_error};
+    while (matching_error > denoised_error && matching_samples < kMaxSamples)
+    {
+        matching_samples *= 2;
+        camera._samples_per_pixel = matching_samples;
+        matching_error = image_rmse(reference, camera.render(bvh, materials));
+    }
+
+    std::cout << "\nDenoising " << kSamples << " spp (" << camera._threads
+              << " threads)\n"
+              << std::setw(11) << "raw RMSE" << std::setw(15)
+              << "denoised RMSE" << std::setw(12) << "matches spp"
+              << std::setw(10) << "render s" << std::setw(12) << "features s"
+              << std::setw(11) << "denoise s" << '\n'
+              << std::fixed << std::setprecision(5) << std::setw(11)
+              << noisy_error << std::setw(15) << denoised_error
+              << std::setw(12)
+              << (matching_error > denoised_error
+                      ? "> " + std::to_string(kMaxSamples)
+                      : std::to_string(matching_samples))
+              << std::setprecision(3) << std::setw(10) << render_seconds
+              << std::setw(12) << feature_seconds << std::setw(11)
+              << denoise_seconds;
+    if (denoised_error >= noisy_error)
+    {
+        report_mismatch();
+    }
+    std::cout << '\n';
+}
+
+// Renders in both modes and reports the times, flagging images that
+// differ.  `world` is rendered as it is, so a SphereSet should already have
+// its hierarchy.
+void compare_wavefront(const std::string &name,
+                       const Hittable &world,
+                       const MaterialTable &materials,
+                       Camera &camera)
+{
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    for (const unsigned int threads : {1U, 2U, 4U})
+    {
+        camera._threads = threads;
+
+        camera._wavefront = false;
+        auto start{Clock::now()};
+        const Framebuffer depth_first{camera.render(world, materials)};
+        const double depth_first_seconds{
+            std::chrono::duration<double>(Clock::now() - start).count()};
+
+        camera._wavefront = true;
+        start = Clock::now();
+        const Framebuffer wavefront{camera.render(world, materials)};
+        const double wavefront_seconds{
+            std::chrono::duration<double>(Clock::now() - start).count()};
+
+        std::cout << std::setw(10) << name << std::setw(9) << threads
+                  << std::fixed << std::setprecision(2) << std::setw(14)
+                  << depth_first_seconds << std::setw(14) << wavefront_seconds
+                  << std::setw(9) << depth_first_seconds / wavefront_seconds
+                  << 'x';
+        if (!same_pixels(depth_first, wavefront))
+        {
+            report_mismatch();
+        }
+        std::cout << '\n';
+    }
+}
+
+void bench_wavefront()
+{
+    std::cout << "\nWavefront against depth-first rendering\n"
+              << std::setw(10) << "scene" << std::setw(9) << "threads"
+              << std::setw(14) << "depth-first s" << std::setw(14)
+              << "wavefront s" << std::setw(10) << "speedup" << '\n';
+
+    // a Bvh over four Sphere objects
+    MaterialTable materials;
+    Arena arena;
+    const HittableList objects{showcase_scene(materials, arena)};
+    const Bvh bvh{objects};
+    Camera camera{showcase_camera()};
+    compare_wavefront("showcase", bvh, materials, camera);
+
+    // the default scene, held as main holds it
+    Scene scene{random_spheres_scene()};
+    scene._spheres.build_hierarchy();
+    const HittableList world{scene._spheres};
+    // NOLINTBEGIN(readability-magic-numbers)
+    scene._camera._image_width = 160;
+    scene._camera._samples_per_pixel = 32;
+    // NOLINTEND(readability-magic-numbers)
+    compare_wavefront("spheres", world, scene._materials, scene._camera);
+}
+
+void bench_scene_file()
+{
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    constexpr std::size_t kSphereCount{1000000};
+
+    Scene scene;
+    Rng rng;
+    const double half_extent{std::cbrt(static_cast<double>(kSphereCount))};
+    scene._materials.add(Lambertian{Colour{0.5, 0.5, 0.5}});
+    for (std::size_t index{0}; index < kSphereCount; ++index)
+    {
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        scene._spheres.add(Vec3::random(rng, -half_extent, half_extent),
+                           static_cast<Real>(random_double(rng, 0.1, 0.3)),
+                           0);
+    }
+
+    auto start{Clock::now()};
+    scene._spheres.build_hierarchy();
+    const double build_seconds{
+        std::chrono::duration<double>(Clock::now() - start).count()};
+
+    const std::filesystem::path directory{
+        std::filesystem::temp_directory_path()};
+    const std::string binary_path{(directory / "bench_scene.bin").string()};
+    const std::string text_path{(directory / "bench_scene.txt").string()};
+    {
+        std::ofstream binary{binary_path, std::ios::binary};
+        write_scene_binary(binary, scene);
+        std::ofstream text{text_path};
+        write_scene_text(text, scene);
+    }
+
+    std::string error;
+    start = Clock::now();
+    const std::optional<Scene> binary_scene{load_scene(binary_path, error)};
+    const double binary_seconds{
+        std::chrono::duration<double>(Clock::now() - start).count()};
+    start = Clock::now();
+    const std::optional<Scene> text_scene{load_scene(text_path, error)};
+    const double text_seconds{
+        std::chrono::duration<double>(Clock::now() - start).count()};
+
+    std::cout << "\nScene files (" << kSphereCount << " spheres)\n"
+              << std::setw(14) << "build BVH s" << std::setw(14)
+              << "load binary s" << std::setw(14) << "load text s" << '\n'
+              << std::fixed << std::setprecision(3) << std::setw(14)
+              << build_seconds << std::setw(14) << binary_seconds
+              << std::setw(14) << text_seconds;
+    if (!binary_scene || !text_scene ||
+        binary_scene->_spheres.size() != kSphereCount ||
+        text_scene->_spheres.size() != kSphereCount ||
+        binary_scene->_spheres.hierarchy().nodes().size() !=
+            scene._spheres.hierarchy().nodes().size() ||
+        binary_scene->_spheres.radii() != scene._spheres.radii() ||
+        text_scene->_spheres.centre_x() != scene._spheres.centre_x())
+    {
+        report_mismatch() << ' ' << error;
+    }
+    std::cout << '\n';
+
+    std::filesystem::remove(binary_path);
+    std::filesystem::remove(text_path);
+
+    // camera settings no render can start from are refused, in both forms
+    std::size_t accepted{0};
+    for (const std::string_view bad : {"image_width -100",
+                                       "image_width 1e20",
+                                       "samples_per_pixel 0",
+                                       "max_depth -1",
+                                       "aspect_ratio nan",
+                                       "aspect_ratio -1"})
+    {
+        if (scene_file_detail::load_text(std::as_bytes(std::span{bad}),
+                                         error))
+        {
+            ++accepted;
+        }
+    }
+    Scene small;
+    std::ostringstream binary;
+    write_scene_binary(binary, small);
+    const std::string header{binary.str()};
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    for (const std::int64_t width : {std::int64_t{-5}, std::int64_t{1} << 40U})
+    {
+        std::vector<std::byte> bytes(header.size());
+        std::memcpy(bytes.data(), header.data(), header.size());
+        std::memcpy(bytes.data() +
+                        offsetof(scene_file_detail::Header, _image_width),
+                    &width,
+                    sizeof(width));
+        if (load_scene_binary(bytes, error))
+        {
+            ++accepted;
+        }
+    }
+    std::cout << "Invalid camera settings accepted: " << accepted;
+    if (accepted != 0)
+    {
+        report_mismatch();
+    }
+    std::cout << '\n';
+}
+
+// A closed, bumpy sphere of radius about one around the origin with
+// 2 * segments * (rings - 1) triangles and per-vertex normals.
+TriangleMesh bumpy_sphere_mesh(std::uint32_t rings, std::uint32_t segments)
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    const auto point{[](double theta, double phi) {
+        const double radius{1.0 + 0.05 * std::sin(9.0 * theta) *
+                                      std::sin(11.0 * phi)};
+        return Point3{
+            static_cast<Real>(radius * std::sin(theta) * std::cos(phi)),
+            static_cast<Real>(radius * std::cos(theta)),
+            static_cast<Real>(radius * std::sin(theta) * std::sin(phi))};
+    }};
+    // NOLINTEND(readability-magic-numbers)
+
+    // the poles, then rings of vertices from north to south
+    std::vector<Point3> positions{point(0.0, 0.0), point(constants::kPi, 0.0)};
+    for (std::uint32_t ring{1}; ring < rings; ++ring)
+    {
+        for (std::uint32_t segment{0}; segment < segments; ++segment)
+        {
+            positions.push_back(point(constants::kPi * ring / rings,
+                                      2.0 * constants::kPi * segment /
+                                          segments));
+        }
+    }
+    const auto vertex{[segments](std::uint32_t ring, std::uint32_t segment) {
+        return 2 + (ring - 1) * segments + segment % segments;
+    }};
+
+    std::vector<Triangle> triangles;
+    for (std::uint32_t segment{0}; segment < segments; ++segment)
+    {
+        triangles.push_back({0, vertex(1, segment + 1), vertex(1, segment)});
+        triangles.push_back({1,
+                             vertex(rings - 1, segment),
+                             vertex(rings - 1, segment + 1)});
+        for (std::uint32_t ring{1}; ring + 1 < rings; ++ring)
+        {
+            const std::uint32_t a{vertex(ring, segment)};
+            const std::uint32_t b{vertex(ring, segment + 1)};
+            const std::uint32_t c{vertex(ring + 1, segment)};
+            const std::uint32_t d{vertex(ring + 1, segment + 1)};
+            triangles.push_back({a, b, d});
+            triangles.push_back({a, d, c});
+        }
+    }
+
+    // area-weighted face normals summed at each vertex
+    std::vector<Vec3> normals(positions.size(), Vec3{0, 0, 0});
+    for (const Triangle &triangle : triangles)
+    {
+        const Point3 &p0{positions[triangle[0]]};
+        const Vec3 normal{cross(positions[triangle[1]] - p0,
+                                positions[triangle[2]] - p0)};
+        for (const std::uint32_t index : triangle)
+        {
+            normals[index] += normal;
+        }
+    }
+    for (Vec3 &normal : normals)
+    {
+        normal = unit_vector(normal);
+    }
+    return {std::move(positions),
+            std::move(normals),
+            std::move(triangles),
+            MaterialId{0}};
+}
+
+// Builds a closed mesh of a few million triangles, writes it as OBJ and PLY
+// and times loading each, and traces random rays through all three copies.
+// MB is the size of the file, or of the mesh in memory, whose load time is
+// the time to generate it.  Rays from inside towards every vertex and edge
+// midpoint must all hit, as the intersection is watertight.
+void bench_mesh()
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    constexpr std::uint32_t kRings{1000};
+    constexpr std::uint32_t kSegments{1000};
+    constexpr std::size_t kRayCount{200000};
+    // NOLINTEND(readability-magic-numbers)
+    const auto seconds{[](Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }};
+
+    auto start{Clock::now()};
+    const TriangleMesh mesh{bumpy_sphere_mesh(kRings, kSegments)};
+    const double generate_seconds{seconds(start)};
+
+    // the hierarchy alone, over copies of the same arrays
+    std::vector<Point3> positions{mesh.positions()};
+    std::vector<Vec3> normals{mesh.normals()};
+    std::vector<Triangle> triangles{mesh.triangles()};
+    start = Clock::now();
+    const TriangleMesh rebuilt{std::move(positions),
+                               std::move(normals),
+                               std::move(triangles),
+                               MaterialId{0}};
+    const double build_seconds{seconds(start)};
+
+    const std::filesystem::path directory{
+        std::filesystem::temp_directory_path()};
+    const std::string obj_path{(directory / "bench_mesh.obj").string()};
+    const std::string ply_path{(directory / "bench_mesh.ply").string()};
+    {
+        std::ofstream obj{obj_path};
+        write_obj(obj, mesh);
+        std::ofstream ply{ply_path, std::ios::binary};
+        write_ply(ply, mesh);
+    }
+    std::string error;
+    start = Clock::now();
+    const std::optional<TriangleMesh> obj_mesh{
+        load_mesh(obj_path, MaterialId{0}, error)};
+    const double obj_seconds{seconds(start)};
+    start = Clock::now();
+    const std::optional<TriangleMesh> ply_mesh{
+        load_mesh(ply_path, MaterialId{0}, error)};
+    const double ply_seconds{seconds(start)};
+    const std::uintmax_t obj_bytes{std::filesystem::file_size(obj_path)};
+    const std::uintmax_t ply_bytes{std::filesystem::file_size(ply_path)};
+    std::filesystem::remove(obj_path);
+    std::filesystem::remove(ply_path);
+
+    Rng rng;
+    const std::vector<Ray> rays{
+        random_rays(kRayCount, mesh.bounding_box(), rng)};
+    const TraceResult result{trace(mesh, rays)};
+
+    std::cout << "\nTriangle mesh (" << mesh.size() << " triangles, "
+              << kRayCount << " rays)\nBVH build " << std::fixed
+              << std::setprecision(3) << build_seconds << " s\n"
+              << std::setw(10) << "source" << std::setw(10) << "MB"
+              << std::setw(10) << "load s" << std::setw(12) << "bytes/tri"
+              << std::setw(10) << "Mray/s" << '\n';
+    const auto row{[&](const char *source,
+                       double megabytes,
+                       double load_seconds,
+                       const TriangleMesh &loaded) {
+        const TraceResult loaded_result{trace(loaded, rays)};
+        std::cout << std::setw(10) << source << std::setprecision(1)
+                  << std::setw(10) << megabytes << std::setprecision(3)
+                  << std::setw(10) << load_seconds << std::setprecision(1)
+                  << std::setw(12)
+                  << static_cast<double>(loaded.memory_bytes()) /
+                         static_cast<double>(loaded.size())
+                  << std::setprecision(2) << std::setw(10)
+                  << mrays_per_second(kRayCount, loaded_result._seconds);
+        // the files hold float precision, so hits may move by a rounding
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        const double tolerance{&loaded == &rebuilt
+                                   ? 0.0
+                                   : 1e-6 * result._distance_sum};
+        if (loaded.size() != mesh.size() ||
+            loaded_result._hits != result._hits ||
+            std::fabs(loaded_result._distance_sum - result._distance_sum) >
+                tolerance)
+        {
+            report_mismatch();
+        }
+        std::cout << '\n';
+    }};
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    constexpr double kMegabyte{1024.0 * 1024.0};
+    row("memory",
+        static_cast<double>(rebuilt.memory_bytes()) / kMegabyte,
+        generate_seconds,
+        rebuilt);
+    if (!obj_mesh || !ply_mesh)
+    {
+        report_mismatch() << ' ' << error << '\n';
+        return;
+    }
+    row("obj",
+        static_cast<double>(obj_bytes) / kMegabyte,
+        obj_seconds,
+        *obj_mesh);
+    row("ply",
+        static_cast<double>(ply_bytes) / kMegabyte,
+        ply_seconds,
+        *ply_mesh);
+
+    // every target lies on the surface, and the centre is inside it
+    std::size_t targets{0};
+    std::size_t leaks{0};
+    const auto aim{[&](const Point3 &target) {
+        HitRecord record;
+        ++targets;
+        if (!mesh.hit(Ray{Point3{0, 0, 0}, target},
+                      Interval(0, constants::kInfinity),
+                      record))
+        {
+            ++leaks;
+        }
+    }};
+    start = Clock::now();
+    for (const Triangle &triangle : mesh.triangles())
+    {
+        const Point3 &p0{mesh.positions()[triangle[0]]};
+        const Point3 &p1{mesh.positions()[triangle[1]]};
+        aim(p0);
+        aim(0.5_r * (p0 + p1));
+    }
+    std::cout << "Watertight: " << leaks << " of " << targets
+              << " rays at vertices and edges escaped ("
+              << std::setprecision(2) << seconds(start) << " s)";
+    if (leaks != 0)
+    {
+        report_mismatch();
+    }
+    std::cout << '\n';
+
+    // vertices after a face that splits some by normal keep their file
+    // indices
+    constexpr std::string_view kInterleaved{"v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+                                            "vn 0 0 1\nvn 0 0 -1\n"
+                                            "f 1//1 2//1 3//1\n"
+                                            "f 1//2 3//2 2//2\n"
+                                            "v 5 0 0\nv 6 0 0\nv 5 1 0\n"
+                                            "f 4 5 6\n"};
+    mesh_file_detail::MeshData interleaved;
+    const bool parsed{mesh_file_detail::parse_obj(
+        std::as_bytes(std::span{kInterleaved}), interleaved, error)};
+    const std::array<Point3, 3> expected{
+        Point3{5, 0, 0}, Point3{6, 0, 0}, Point3{5, 1, 0}};
+    bool interleaved_match{parsed && interleaved._triangles.size() == 3};
+    for (std::size_t corner{0}; interleaved_match && corner < 3; ++corner)
+    {
+        const Point3 &position{
+            interleaved._positions[interleaved._triangles[2][corner]]};
+        for (int axis{0}; axis < 3; ++axis)
+        {
+            interleaved_match = interleaved_match &&
+                                position[axis] == expected[corner][axis];
+        }
+    }
+    std::cout << "OBJ vertices interleaved with split faces: "
+              << (interleaved_match ? "resolved" : "wrong");
+    if (!interleaved_match)
+    {
+        report_mismatch();
+    }
+    std::cout << '\n';
+}
+
+// Random rigid placement with uniform scale inside a cube of the given half
+// extent.
+Transform random_placement(Rng &rng, double half_extent)
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    const Vec3 axis{random_unit_vector(rng)};
+    const auto scale{static_cast<Real>(random_double(rng, 0.3, 0.6))};
+    return Transform::translation(
+               Vec3::random(rng, -half_extent, half_extent)) *
+           Transform::rotation(axis, random_double(rng, 0.0, 360.0)) *
+           Transform::scaling(Vec3{scale, scale, scale});
+    // NOLINTEND(readability-magic-numbers)
+}
+
+// The mesh's triangles copied under each transform into one mesh, as a
+// scene without instancing would hold them.  The transforms must scale
+// uniformly, so that normalised vertex normals map to normalised ones.
+TriangleMesh flattened_mesh(const TriangleMesh &mesh,
+                            const std::vector<Transform> &transforms)
+{
+    std::vector<Point3> positions;
+    std::vector<Vec3> normals;
+    std::vector<Triangle> triangles;
+    for (const Transform &transform : transforms)
+    {
+        const auto base{static_cast<std::uint32_t>(positions.size())};
+        for (const Point3 &position : mesh.positions())
+        {
+            positions.push_back(transform.point(position));
+        }
+        for (const Vec3 &normal : mesh.normals())
+        {
+            normals.push_back(unit_vector(transform.normal(normal)));
+        }
+        for (const Triangle &triangle : mesh.triangles())
+        {
+            triangles.push_back(
+                {base + triangle[0], base + triangle[1], base + triangle[2]});
+        }
+    }
+    return {std::move(positions),
+            std::move(normals),
+            std::move(triangles),
+            mesh.material()};
+}
+
+// Places one shared mesh many times under random transforms.  Reports the
+// memory of the instances beside that of copying the mesh into each place,
+// the time to build the top-level hierarchy and to rebuild it after moving
+// every instance, and the tracing rate.  A few instances must trace the
+// same as the flattened copy of their triangles.
+void bench_instances()
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    constexpr std::uint32_t kRings{224};
+    constexpr std::size_t kRayCount{100000};
+    const std::vector<std::size_t> instance_counts{1000, 10000, 100000};
+    // NOLINTEND(readability-magic-numbers)
+    const auto milliseconds{[](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+    }};
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    constexpr double kMegabyte{1024.0 * 1024.0};
+
+    const TriangleMesh mesh{bumpy_sphere_mesh(kRings, kRings)};
+    std::cout << "\nInstances of one " << mesh.size() << "-triangle mesh ("
+              << std::fixed << std::setprecision(1)
+              << static_cast<double>(mesh.memory_bytes()) / kMegabyte
+              << " MB, " << kRayCount << " rays)\n"
+              << std::setw(10) << "instances" << std::setw(12) << "MB"
+              << std::setw(14) << "flattened MB" << std::setw(10)
+              << "build ms" << std::setw(12) << "rebuild ms" << std::setw(10)
+              << "Mray/s" << '\n';
+
+    Rng rng;
+    for (const std::size_t instance_count : instance_counts)
+    {
+        // the same density of instances at every count
+        const double half_extent{
+            std::cbrt(static_cast<double>(instance_count))};
+        InstanceSet instances;
+        for (std::size_t index{0}; index < instance_count; ++index)
+        {
+            instances.add(mesh, random_placement(rng, half_extent));
+        }
+        auto start{Clock::now()};
+        instances.build_hierarchy();
+        const double build_ms{milliseconds(start)};
+
+        for (std::size_t index{0}; index < instance_count; ++index)
+        {
+            instances.set_to_world(index, random_placement(rng, half_extent));
+        }
+        start = Clock::now();
+        instances.build_hierarchy();
+        const double rebuild_ms{milliseconds(start)};
+
+        const std::vector<Ray> rays{
+            random_rays(kRayCount, instances.bounding_box(), rng)};
+        const TraceResult result{trace(instances, rays)};
+        std::cout << std::setw(10) << instance_count << std::setprecision(1)
+                  << std::setw(12)
+                  << static_cast<double>(mesh.memory_bytes() +
+                                         instances.memory_bytes()) /
+                         kMegabyte
+                  << std::setw(14)
+                  << static_cast<double>(instance_count) *
+                         static_cast<double>(mesh.memory_bytes()) / kMegabyte
+                  << std::setw(10) << build_ms << std::setw(12) << rebuild_ms
+                  << std::setprecision(2) << std::setw(10)
+                  << mrays_per_second(kRayCount, result._seconds) << '\n';
+    }
+
+    // a small mesh placed a few times, against its triangles copied out
+    // NOLINTBEGIN(readability-magic-numbers)
+    const TriangleMesh small{bumpy_sphere_mesh(20, 20)};
+    constexpr std::size_t kCopies{64};
+    constexpr double kHalfExtent{2.0};
+    // NOLINTEND(readability-magic-numbers)
+    std::vector<Transform> transforms;
+    InstanceSet instances;
+    for (std::size_t index{0}; index < kCopies; ++index)
+    {
+        transforms.push_back(random_placement(rng, kHalfExtent));
+        instances.add(small, transforms.back());
+    }
+    instances.build_hierarchy();
+    const TriangleMesh flattened{flattened_mesh(small, transforms)};
+    const std::vector<Ray> rays{
+        random_rays(kRayCount, flattened.bounding_box(), rng)};
+    std::vector<HitRecord> instance_records;
+    std::vector<HitRecord> flattened_records;
+    const TraceResult instance_result{
+        trace(instances, rays, &instance_records)};
+    const TraceResult flattened_result{
+        trace(flattened, rays, &flattened_records)};
+    // rounding differs between the two, so compare within a tolerance
+    constexpr double kTolerance{
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        1.0e4 * std::numeric_limits<Real>::epsilon()};
+    double worst_normal{0.0};
+    for (std::size_t index{0}; index < rays.size(); ++index)
+    {
+        worst_normal = std::max(
+            worst_normal,
+            static_cast<double>((instance_records[index]._normal -
+                                 flattened_records[index]._normal)
+                                    .length()));
+    }
+    std::cout << "Instances against flattened copies: " << instance_result._hits
+              << " and " << flattened_result._hits << " hits";
+    if (instance_result._hits != flattened_result._hits ||
+        std::fabs(instance_result._distance_sum -
+                  flattened_result._distance_sum) >
+            kTolerance * flattened_result._distance_sum ||
+        worst_normal > kTolerance)
+    {
+        report_mismatch();
+    }
+    std::cout << '\n';
+}
+
+// Moves a million spheres a little each frame, as an animation would, and
+// compares refitting their hierarchy with rebuilding it: the time taken,
+// and the tracing rate through each tree as the refitted one loosens.  Both
+// must give the same hits.
+void bench_refit()
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    constexpr std::size_t kSphereCount{1000000};
+    constexpr std::size_t kRayCount{20000};
+    constexpr int kFrames{4};
+    constexpr double kStep{0.1}; // largest move per frame along each axis
+    // NOLINTEND(readability-magic-numbers)
+    const auto milliseconds{[](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+    }};
+
+    Rng rng;
+    const double half_extent{std::cbrt(static_cast<double>(kSphereCount))};
+    SphereSet spheres;
+    for (std::size_t index{0}; index < kSphereCount; ++index)
+    {
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        spheres.add(Vec3::random(rng, -half_extent, half_extent),
+                    static_cast<Real>(random_double(rng, 0.1, 0.3)),
+                    0);
+    }
+    spheres.build_hierarchy();
+    const std::vector<Ray> rays{
+        random_rays(kRayCount, spheres.bounding_box(), rng)};
+
+    std::cout << "\nRefit against rebuild (" << kSphereCount << " spheres, "
+              << kRayCount << " rays)\n"
+              << std::setw(8) << "frame" << std::setw(12) << "refit ms"
+              << std::setw(14) << "rebuild ms" << std::setw(14)
+              << "refit Mray/s" << std::setw(16) << "rebuild Mray/s" << '\n';
+    for (int frame{1}; frame <= kFrames; ++frame)
+    {
+        for (std::size_t index{0}; index < spheres.size(); ++index)
+        {
+            spheres.set_centre(index,
+                               spheres.centre(index) +
+                                   Vec3::random(rng, -kStep, kStep));
+        }
+        auto start{Clock::now()};
+        spheres.refit_hierarchy();
+        const double refit_ms{milliseconds(start)};
+
+        SphereSet rebuilt{spheres};
+        start = Clock::now();
+        rebuilt.build_hierarchy();
+        const double rebuild_ms{milliseconds(start)};
+
+        const TraceResult refit_result{trace(spheres, rays)};
+        const TraceResult rebuild_result{trace(rebuilt, rays)};
+        std::cout << std::setw(8) << frame << std::fixed
+                  << std::setprecision(1) << std::setw(12) << refit_ms
+                  << std::setw(14) << rebuild_ms << std::setprecision(3)
+                  << std::setw(14)
+                  << mrays_per_second(kRayCount, refit_result._seconds)
+                  << std::setw(16)
+                  << mrays_per_second(kRayCount, rebuild_result._seconds);
+        if (refit_result._hits != rebuild_result._hits ||
+            refit_result._distance_sum != rebuild_result._distance_sum)
+        {
+            report_mismatch();
+        }
+        std::cout << '\n';
+    }
+}
+
+// Motion blur on the book's scene with its small spheres rising by up to
+// half a unit while the shutter is open: one render sampling the shutter
+// against the static render and against averaging renders at kInstants
+// fixed times.  Rays at random times through the moving spheres' and
+// instances' hierarchies must hit exactly what they hit without one, which
+// holds only if the bounds enclose the motion, and a moving instance must
+// hit what a static one blended to the ray's time does.
+void bench_motion_blur()
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    constexpr std::size_t kRayCount{100000};
+    constexpr int kInstants{8};
+    constexpr double kRise{0.5};
+    constexpr std::size_t kInstanceCount{64};
+    const Aabb ray_bounds{Point3{-11, 0, -11}, Point3{11, 2, 11}};
+    // NOLINTEND(readability-magic-numbers)
+
+    Scene scene{random_spheres_scene()};
+    SphereSet &spheres{scene._spheres};
+    Rng rng;
+    for (std::size_t index{0}; index < spheres.size(); ++index)
+    {
+        if (spheres.radius(index) < 1)
+        {
+            spheres.set_motion(
+                index,
+                Vec3{0, static_cast<Real>(random_double(rng, 0.0, kRise)), 0});
+        }
+    }
+    const SphereSet linear{spheres};
+    Scene still{random_spheres_scene()};
+    still._spheres.build_hierarchy();
+    spheres.build_hierarchy();
+
+    std::vector<Ray> rays{random_rays(kRayCount, ray_bounds, rng)};
+    for (Ray &ray : rays)
+    {
+        ray = Ray{ray.origin(),
+                  ray.direction(),
+                  static_cast<Real>(random_double(rng))};
+    }
+    const TraceResult still_result{trace(still._spheres, rays)};
+    const TraceResult tree_result{trace(spheres, rays)};
+    const TraceResult linear_result{trace(linear, rays)};
+
+    const TriangleMesh mesh{bumpy_sphere_mesh(32, 32)};
+    InstanceSet instances;
+    std::vector<std::pair<Transform, Transform>> motions;
+    for (std::size_t index{0}; index < kInstanceCount; ++index)
+    {
+        const Transform start{random_placement(rng, 2.0)};
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        const Transform end{Transform::translation(Vec3::random(rng, -1, 1)) *
+                            start *
+                            Transform::rotation(random_unit_vector(rng), 20)};
+        instances.add(mesh, start, end);
+        motions.emplace_back(start, end);
+    }
+    const InstanceSet linear_instances{instances};
+    instances.build_hierarchy();
+    std::vector<Ray> instance_rays{
+        random_rays(kRayCount, instances.bounding_box(), rng)};
+    bool instances_match{true};
+    for (Ray &ray : instance_rays)
+    {
+        ray = Ray{ray.origin(),
+                  ray.direction(),
+                  static_cast<Real>(random_double(rng))};
+        const Interval ray_t{0.001_r, constants::kInfinity};
+        const auto &[start, end]{
+            motions[static_cast<std::size_t>(rng.next()) % kInstanceCount]};
+        const Instance moving{mesh, start, end};
+        const Instance blended{
+            mesh, Transform::interpolate(start, end, ray.time())};
+        HitRecord moving_record;
+        HitRecord blended_record;
+        const bool moving_hit{moving.hit(ray, ray_t, moving_record)};
+        if (moving_hit != blended.hit(ray, ray_t, blended_record) ||
+            (moving_hit &&
+             moving_record._t_interval != blended_record._t_interval))
+        {
+            instances_match = false;
+        }
+    }
+    const TraceResult instance_tree{trace(instances, instance_rays)};
+    const TraceResult instance_linear{trace(linear_instances, instance_rays)};
+
+    std::cout << "\nMotion blur (" << kRayCount << " rays at random times)\n"
+              << std::fixed << std::setprecision(3)
+              << "Spheres: static " << mrays_per_second(kRayCount,
+                                                        still_result._seconds)
+              << " Mray/s, moving "
+              << mrays_per_second(kRayCount, tree_result._seconds)
+              << " Mray/s, moving without BVH "
+              << mrays_per_second(kRayCount, linear_result._seconds)
+              << " Mray/s";
+    if (tree_result._hits != linear_result._hits ||
+        tree_result._distance_sum != linear_result._distance_sum)
+    {
+        report_mismatch();
+    }
+    std::cout << "\nInstances (" << kInstanceCount << " moving): BVH "
+              << mrays_per_second(kRayCount, instance_tree._seconds)
+              << " Mray/s, linear "
+              << mrays_per_second(kRayCount, instance_linear._seconds)
+              << " Mray/s";
+    if (!instances_match || instance_tree._hits != instance_linear._hits ||
+        instance_tree._distance_sum != instance_linear._distance_sum)
+    {
+        report_mismatch();
+    }
+    std::cout << '\n';
+
+    // NOLINTBEGIN(readability-magic-numbers)
+    for (Camera *camera : {&scene._camera, &still._camera})
+    {
+        camera->_image_width = 160;
+        camera->_samples_per_pixel = 16;
+    }
+    // NOLINTEND(readability-magic-numbers)
+    const auto seconds{[](Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }};
+    auto start{Clock::now()};
+    static_cast<void>(still._camera.render(still._spheres, still._materials));
+    const double still_seconds{seconds(start)};
+
+    Camera &camera{scene._camera};
+    camera._shutter_close = 1.0;
+    start = Clock::now();
+    static_cast<void>(camera.render(spheres, scene._materials));
+    const double blurred_seconds{seconds(start)};
+
+    start = Clock::now();
+    for (int instant{0}; instant < kInstants; ++instant)
+    {
+        camera._shutter_open = (instant + 0.5) / kInstants;
+        camera._shutter_close = camera._shutter_open;
+        static_cast<void>(camera.render(spheres, scene._materials));
+    }
+    const double averaged_seconds{seconds(start)};
+    std::cout << "Render (" << camera._image_width << " wide, "
+              << camera._samples_per_pixel << " spp): static "
+              << still_seconds << " s, blurred " << blurred_seconds << " s, "
+              << kInstants << " instants averaged " << averaged_seconds
+              << " s\n";
+}
+
+// Renders the book scene with every diffuse and metal sphere image textured
+// from far more texture data than its tile cache holds, and checks that the
+// smallest cache, too small for the working set and shared by several
+// threads, gives the same image as one large enough to keep every tile read.
+void bench_textures()
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    constexpr std::size_t kTextureCount{8};
+    constexpr std::uint32_t kTextureSize{4096};
+    constexpr std::size_t kCacheBytes{std::size_t{16} << 20U};
+    constexpr std::size_t kLargeCacheBytes{std::size_t{256} << 20U};
+    constexpr unsigned int kSharingThreads{4};
+    constexpr double kMegabyte{1048576.0};
+    // NOLINTEND(readability-magic-numbers)
+    const auto seconds{[](Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }};
+
+    const std::filesystem::path directory{
+        std::filesystem::temp_directory_path()};
+    std::vector<std::string> paths;
+    std::vector<std::unique_ptr<TextureFile>> files;
+    std::size_t file_bytes{0};
+    std::string error;
+    auto start{Clock::now()};
+    for (std::size_t index{0}; index < kTextureCount; ++index)
+    {
+        paths.push_back(
+            (directory / ("bench_texture_" + std::to_string(index) + ".rtt"))
+                .string());
+        std::unique_ptr<TextureFile> file;
+        if (write_grid_texture(paths.back(), kTextureSize, index, error))
+        {
+            file = load_texture(paths.back(), error);
+        }
+        if (!file)
+        {
+            std::cout << "\nTextures: " << error << '\n';
+            return;
+        }
+        file_bytes += file->file_bytes();
+        files.push_back(std::move(file));
+    }
+    const double write_seconds{seconds(start)};
+
+    // every diffuse and metal sphere, the ground included, takes the
+    // textures in turn
+    const auto textured_scene{[&files](TileCache &cache) {
+        Scene scene{random_spheres_scene()};
+        std::vector<Texture> textures;
+        for (const std::unique_ptr<TextureFile> &file : files)
+        {
+            textures.emplace_back(ImageTexture{*file, cache});
+        }
+        std::size_t next{0};
+        for (std::size_t index{0}; index < scene._spheres.size(); ++index)
+        {
+            const MaterialId id{scene._spheres.material(index)};
+            const Material &material{scene._materials[id]};
+            const Texture &texture{textures[next % textures.size()]};
+            if (const auto *metal{material.get_if<Metal>()})
+            {
+                scene._materials.set(id, Metal{texture, metal->fuzz()});
+                ++next;
+            }
+            else if (material.get_if<Lambertian>() != nullptr)
+            {
+                scene._materials.set(id, Lambertian{texture});
+                ++next;
+            }
+        }
+        scene._spheres.build_hierarchy();
+        // NOLINTBEGIN(readability-magic-numbers)
+        scene._camera._image_width = 320;
+        scene._camera._samples_per_pixel = 16;
+        // NOLINTEND(readability-magic-numbers)
+        return scene;
+    }};
+    const auto render{[&](Scene &scene, unsigned int threads) {
+        scene._camera._threads = threads;
+        start = Clock::now();
+        Framebuffer image{scene._camera.render(scene._spheres,
+                                               scene._materials)};
+        return std::pair{std::move(image), seconds(start)};
+    }};
+
+    Scene plain{random_spheres_scene()};
+    plain._spheres.build_hierarchy();
+    // NOLINTBEGIN(readability-magic-numbers)
+    plain._camera._image_width = 320;
+    plain._camera._samples_per_pixel = 16;
+    // NOLINTEND(readability-magic-numbers)
+    const double plain_seconds{render(plain, 1).second};
+
+    const std::size_t resident_before{resident_bytes()};
+    TileCache cache{kCacheBytes};
+    Scene scene{textured_scene(cache)};
+    const auto [image, textured_seconds]{render(scene, 1)};
+    const std::size_t resident_after{resident_bytes()};
+    const TileCache::Stats stats{cache.stats()};
+
+    TileCache shared_cache{0};
+    Scene shared_scene{textured_scene(shared_cache)};
+    const Framebuffer shared_image{
+        render(shared_scene, kSharingThreads).first};
+    const TileCache::Stats shared_stats{shared_cache.stats()};
+
+    TileCache large_cache{kLargeCacheBytes};
+    Scene large_scene{textured_scene(large_cache)};
+    const Framebuffer large_image{render(large_scene, 1).first};
+    const TileCache::Stats large_stats{large_cache.stats()};
+
+    std::cout << std::fixed << std::setprecision(3) << "\nTextures ("
+              << kTextureCount << " of " << kTextureSize << " x "
+              << kTextureSize << ", "
+              << static_cast<double>(file_bytes) / kMegabyte
+              << " MB of files written in " << write_seconds << " s)\n"
+              << "Render (" << scene._camera._image_width << " wide, "
+              << scene._camera._samples_per_pixel << " spp): untextured "
+              << plain_seconds << " s, textured " << textured_seconds
+              << " s\n";
+    const auto print_cache{[&](const char *name,
+                               const TileCache &tiles,
+                               const TileCache::Stats &counts) {
+        std::cout << name << " cache (" << tiles.slot_count() << " tiles, "
+                  << static_cast<double>(tiles.memory_bytes()) / kMegabyte
+                  << " MB): " << counts._lookups << " lookups, hit rate "
+                  << 100.0 * counts.hit_rate() << "%, " << counts._misses
+                  << " tiles decoded, " << counts._evictions << " evicted";
+    }};
+    print_cache("Small", cache, stats);
+    std::cout << "\nResident memory grew "
+              << (static_cast<double>(resident_after) -
+                  static_cast<double>(resident_before)) /
+                     kMegabyte
+              << " MB over the small cache's render\n";
+    print_cache("Shared", shared_cache, shared_stats);
+    std::cout << ", " << kSharingThreads << " threads";
+    if (!same_pixels(large_image, shared_image) ||
+        !same_pixels(large_image, image))
+    {
+        report_mismatch();
+    }
+    std::cout << '\n';
+    print_cache("Large", large_cache, large_stats);
+    std::cout << '\n';
+
+    files.clear();
+    for (const std::string &path : paths)
+    {
+        std::filesystem::remove(path);
+    }
+}
+
+// Renders half the samples, checkpoints and reloads the framebuffer, and
+// finishes the render from the reloaded copy, which must match an
+// uninterrupted render.  The stratified sampler's pattern must stay laid
+// out for the count the render began with, read back from the checkpoint
+// even though the resumed settings ask for more samples.
+void bench_checkpoint()
+{
+    Scene scene{random_spheres_scene()};
+    Camera &camera{scene._camera};
+    // NOLINTBEGIN(readability-magic-numbers)
+    camera._image_width = 160;
+    constexpr int kSamples{32};
+    // NOLINTEND(readability-magic-numbers)
+    scene._spheres.build_hierarchy();
+    const std::string path{
+        (std::filesystem::temp_directory_path() / "bench_checkpoint.bin")
+            .string()};
+
+    double save_seconds{0.0};
+    double load_seconds{0.0};
+    std::string failures;
+    for (const SamplerKind sampler :
+         {SamplerKind::kIndependent, SamplerKind::kStratified})
+    {
+        camera._sampler = sampler;
+        camera._samples_per_pixel = kSamples;
+        camera._stratified_samples = kSamples / 2;
+        const Framebuffer expected{
+            camera.render(scene._spheres, scene._materials)};
+
+        camera._samples_per_pixel = kSamples / 2;
+        camera._stratified_samples = 0;
+        const Framebuffer half{camera.render(scene._spheres, scene._materials)};
+
+        std::string error;
+        auto start{Clock::now()};
+        const bool saved{
+            save_checkpoint(path, half, checkpoint_info(scene), error)};
+        save_seconds =
+            std::chrono::duration<double>(Clock::now() - start).count();
+
+        // as main resumes: the settings come from the longer render
+        camera._samples_per_pixel = kSamples;
+        CheckpointInfo info{checkpoint_info(scene)};
+        start = Clock::now();
+        std::optional<Framebuffer> resumed{load_checkpoint(path, info, error)};
+        load_seconds =
+            std::chrono::duration<double>(Clock::now() - start).count();
+        if (resumed)
+        {
+            camera._stratified_samples = info._stratified_samples;
+            camera.render(scene._spheres, scene._materials, *resumed);
+        }
+        if (!saved || !resumed || info._stratified_samples != kSamples / 2 ||
+            !same_pixels(expected, *resumed))
+        {
+            failures += (sampler == SamplerKind::kIndependent ? " independent"
+                                                              : " stratified");
+            failures += error.empty() ? "" : ": " + error;
+        }
+    }
+    camera._stratified_samples = 0;
+
+    std::cout << "\nCheckpoint (" << camera._image_width << " pixels wide)\n"
+              << std::setw(10) << "save ms" << std::setw(10) << "load ms"
+              << '\n'
+              << std::fixed << std::setprecision(2) << std::setw(10)
+              << save_seconds * 1000.0 << std::setw(10)
+              << load_seconds * 1000.0;
+    if (!failures.empty())
+    {
+        report_mismatch() << failures;
+    }
+    std::cout << '\n';
+    std::filesystem::remove(path);
+}
+
+// Moves the preview camera through a series of commands on its control
+// FIFO, reports how quickly each interrupted render stopped, and checks the
+// image the preview settles on against a plain render of the final view.
+void bench_preview()
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    constexpr int kCommands{10};
+    constexpr double kFinalFov{30.0};
+    const auto set_up{[](Scene &scene) {
+        scene._camera._image_width = 160;
+        scene._camera._samples_per_pixel = 8;
+        scene._spheres.build_hierarchy();
+    }};
+    // NOLINTEND(readability-magic-numbers)
+
+    Scene expected_scene{random_spheres_scene()};
+    set_up(expected_scene);
+    expected_scene._camera._vertical_fov = kFinalFov;
+    const Framebuffer expected{expected_scene._camera.render(
+        expected_scene._spheres, expected_scene._materials)};
+
+    Scene scene{random_spheres_scene()};
+    set_up(scene);
+    const std::filesystem::path directory{
+        std::filesystem::temp_directory_path()};
+    const std::string image_path{(directory / "bench_preview.ppm").string()};
+    const std::string control_path{(directory / "bench_preview.fifo").string()};
+    std::filesystem::remove(control_path);
+    if (::mkfifo(control_path.c_str(), 0600) != 0)
+    {
+        std::cout << "\nPreview: cannot create " << control_path << '\n';
+        return;
+    }
+
+    // the frame counter stops once the preview has finished the final view
+    const auto frame_number{[&] {
+        std::ifstream input{image_path, std::ios::binary};
+        std::string magic;
+        std::string comment;
+        std::string frame;
+        input >> magic >> comment >> comment >> frame;
+        return frame;
+    }};
+    std::thread commands{[&] {
+        std::ofstream control{control_path};
+        for (int command{0}; command < kCommands; ++command)
+        {
+            control << "vertical_fov " << 20 + command << std::endl;
+            std::this_thread::sleep_for(std::chrono::milliseconds{50});
+        }
+        control << "vertical_fov " << kFinalFov << std::endl;
+        std::string last;
+        for (std::string frame{frame_number()}; frame != last;
+             frame = frame_number())
+        {
+            last = frame;
+            std::this_thread::sleep_for(std::chrono::milliseconds{500});
+        }
+        control << "quit" << std::endl;
+    }};
+
+    PreviewStats stats;
+    std::string error;
+    const std::optional<Framebuffer> result{
+        run_preview(scene, image_path, control_path, stats, error)};
+    commands.join();
+
+    std::cout << "\nPreview restarts (" << scene._camera._image_width
+              << " pixels wide, one sample per pass)\n"
+              << std::setw(10) << "restarts" << std::setw(10) << "frames"
+              << std::setw(14) << "mean stop ms" << std::setw(13)
+              << "max stop ms" << '\n'
+              << std::setw(10) << stats._restarts << std::setw(10)
+              << stats._frames << std::fixed << std::setprecision(2)
+              << std::setw(14)
+              << 1000.0 * stats._total_stop_seconds /
+                     std::max(stats._stops, 1)
+              << std::setw(13) << 1000.0 * stats._max_stop_seconds;
+    if (!result || !same_pixels(expected, *result))
+    {
+        report_mismatch() << ' ' << error;
+    }
+    std::cout << '\n';
+    std::filesystem::remove(image_path);
+    std::filesystem::remove(control_path);
+}
+
+// Plays a worker that hangs: takes the scene and a job, lets the `workers`
+// real workers start by writing to `release`, then sends half a message
+// header and goes quiet.  The coordinator must neither block on the partial
+// message nor wait past the job's deadline.
+[[noreturn]] void run_hung_worker(std::uint16_t port, int workers, int release)
+{
+    using namespace distributed_detail;
+    const Socket socket{connect_to("127.0.0.1", port)};
+    const HelloRecord hello{kMagic, sizeof(Real), 1};
+    MessageType type{};
+    std::vector<std::byte> payload;
+    if (socket.send_message(MessageType::kHello,
+                            std::as_bytes(std::span{&hello, 1})) &&
+        socket.receive_message(type, payload, kMaxPayload) &&
+        socket.receive_message(type, payload, kMaxPayload))
+    {
+        const MessageHeader header{MessageType::kResult, 0, 0};
+        static_cast<void>(socket.send_all(
+            std::as_bytes(std::span{&header, 1}).first(sizeof(header) / 2)));
+    }
+    const std::vector<char> tokens(static_cast<std::size_t>(workers));
+    static_cast<void>(::write(release, tokens.data(), tokens.size()));
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    std::this_thread::sleep_for(std::chrono::seconds{60});
+    std::_Exit(EXIT_SUCCESS);
+}
+
+// Renders the cover scene across worker processes on loopback, killing one
+// of them partway through and with another hung on its first job, and
+// checks the merged image against a single-process render.
+void bench_distributed()
+{
+    constexpr int kWorkers{3};
+    constexpr std::chrono::milliseconds kKillAfter{500};
+    constexpr std::chrono::seconds kJobTimeout{2};
+
+    Scene scene{random_spheres_scene()};
+    // NOLINTBEGIN(readability-magic-numbers)
+    scene._camera._image_width = 160;
+    scene._camera._samples_per_pixel = 32;
+    // NOLINTEND(readability-magic-numbers)
+    scene._spheres.build_hierarchy();
+
+    auto start{Clock::now()};
+    const Framebuffer expected{
+        scene._camera.render(scene._spheres, scene._materials)};
+    const double single_seconds{
+        std::chrono::duration<double>(Clock::now() - start).count()};
+
+    Listener listener{0};
+    std::array<int, 2> release{-1, -1};
+    if (!listener.is_open() || ::pipe(release.data()) != 0)
+    {
+        std::cout << "\nDistributed render:";
+        report_mismatch() << " unable to listen\n";
+        return;
+    }
+    std::cout << std::flush;
+    // the hung worker connects first, so it is sure to be given a job
+    const pid_t hung{::fork()};
+    if (hung == 0)
+    {
+        run_hung_worker(listener.port(), kWorkers, release[1]);
+    }
+    std::vector<pid_t> workers;
+    for (int worker{0}; worker < kWorkers; ++worker)
+    {
+        const pid_t pid{::fork()};
+        if (pid == 0)
+        {
+            char token{};
+            std::string error;
+            std::_Exit(::read(release[0], &token, 1) == 1 &&
+                               run_worker(
+                                   "127.0.0.1", listener.port(), 1, error)
+                           ? EXIT_SUCCESS
+                           : EXIT_FAILURE);
+        }
+        workers.push_back(pid);
+    }
+
+    std::thread killer{[&workers, kKillAfter] {
+        std::this_thread::sleep_for(kKillAfter);
+        ::kill(workers.back(), SIGKILL);
+    }};
+    CoordinatorStats stats;
+    std::string error;
+    const std::optional<Framebuffer> merged{
+        coordinate_render(scene, listener, kJobTimeout, stats, error)};
+    killer.join();
+    ::kill(hung, SIGKILL);
+    ::waitpid(hung, nullptr, 0);
+    for (const pid_t pid : workers)
+    {
+        ::waitpid(pid, nullptr, 0);
+    }
+    ::close(release[0]);
+    ::close(release[1]);
+
+    std::cout << "\nDistributed render (" << kWorkers
+              << " loopback workers, one killed, and one hung)\n"
+              << std::setw(12) << "single s" << std::setw(14) << "distributed s"
+              << std::setw(9) << "workers" << std::setw(8) << "jobs"
+              << std::setw(10) << "reissued" << std::setw(9) << "expired"
+              << '\n'
+              << std::fixed << std::setprecision(2) << std::setw(12)
+              << single_seconds << std::setw(14) << stats._seconds
+              << std::setw(9) << stats._workers << std::setw(8) << stats._jobs
+              << std::setw(10) << stats._reissued_jobs << std::setw(9)
+              << stats._expired_jobs;
+    // the hung worker and the two that live are sure to have been sent the
+    // scene; the killed one may not have been
+    if (!merged || !same_pixels(expected, *merged) ||
+        stats._workers < static_cast<std::size_t>(kWorkers) ||
+        stats._expired_jobs != 1)
+    {
+        report_mismatch() << ' ' << error;
+    }
+    std::cout << '\n';
+}
+
+struct SceneResult
+{
+    std::string _name;
+    std::size_t _primitives{0};
+    double _build_seconds{0.0};
+    double _render_seconds{0.0};
+    double _output_seconds{0.0};
+    RenderCounters _counters;
+};
+
+// Renders the scene from its own viewpoint with the image size, sampling and
+// threading of `settings`.
+SceneResult bench_scene(std::string name, Scene scene, const Camera &settings)
+{
+    SceneResult result;
+    result._name = std::move(name);
+    result._primitives = scene._spheres.size();
+
+    auto start{Clock::now()};
+    scene._spheres.build_hierarchy();
+    result._build_seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+
+    Camera &camera{scene._camera};
+    camera._image_width = settings._image_width;
+    camera._samples_per_pixel = settings._samples_per_pixel;
+    camera._threads = settings._threads;
+    camera._wavefront = settings._wavefront;
+    const Framebuffer framebuffer{
+        camera.render(scene._spheres, scene._materials)};
+    result._render_seconds = camera.stats()._seconds;
+    result._counters = camera.stats()._counters;
+
+    std::ostringstream image;
+    start = Clock::now();
+    write_image(image, framebuffer, ImageFormat::kPng);
+    result._output_seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    return result;
+}
+
+double rays_per_second(const SceneResult &result)
+{
+    const RenderCounters &counters{result._counters};
+    return static_cast<double>(counters._primary_rays +
+                               counters._secondary_rays) /
+           result._render_seconds;
+}
+
+double average_path_depth(const RenderCounters &counters)
+{
+    return static_cast<double>(counters._primary_rays +
+                               counters._secondary_rays) /
+           static_cast<double>(counters._primary_rays);
+}
+
+void write_json(std::ostream &output,
+                const Camera &camera,
+                const std::vector<SceneResult> &results)
+{
+    output << std::setprecision(9) << "{\n  \"threads\": " << camera._threads
+           << ",\n  \"image_width\": " << camera._image_width
+           << ",\n  \"samples_per_pixel\": " << camera._samples_per_pixel
+           << ",\n  \"real\": \"" << kRealName
+           << "\",\n  \"sphere_set_kernel\": \"" << SphereSet::kKernel
+           << "\",\n  \"scenes\": [";
+    for (std::size_t index{0}; index < results.size(); ++index)
+    {
+        const SceneResult &result{results[index]};
+        const RenderCounters &counters{result._counters};
+        output << (index == 0 ? "" : ",") << "\n    {\"name\": \""
+               << result._name << "\", \"primitives\": " << result._primitives
+               << ", \"rays_per_second\": " << rays_per_second(result)
+               << ", \"primary_rays\": " << counters._primary_rays
+               << ", \"secondary_rays\": " << counters._secondary_rays
+               << ", \"average_path_depth\": "
+               << average_path_depth(counters)
+               << ", \"nodes_visited\": " << counters._nodes_visited
+               << ", \"primitives_tested\": " << counters._primitives_tested
+               << ", \"build_seconds\": " << result._build_seconds
+               << ", \"render_seconds\": " << result._render_seconds
+               << ", \"intersect_seconds\": " << counters._intersect_seconds
+               << ", \"scatter_seconds\": " << counters._scatter_seconds
+               << ", \"output_seconds\": " << result._output_seconds << '}';
+    }
+    output << "\n  ]\n}\n";
+}
+
+// Renders the reproducible scenes in wavefront mode, whose stages give the
+// intersection and scatter time split, and reports the counters of an
+// RT_STATS build.  Returns false if the JSON file could not be written.
+bool bench_scenes(const std::string &json_path)
+{
+    Camera camera{showcase_camera()};
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    camera._samples_per_pixel = 16;
+    camera._threads = std::max(std::thread::hardware_concurrency(), 1U);
+    camera._wavefront = true;
+
+    std::vector<SceneResult> results;
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    for (const int half_width : {11, 22, 44})
+    {
+        results.push_back(bench_scene("spheres-" + std::to_string(half_width),
+                                      random_spheres_scene(half_width),
+                                      camera));
+    }
+    results.push_back(bench_scene(
+        "glass", random_spheres_scene(11, SphereMix::kGlass), camera));
+    results.push_back(bench_scene(
+        "metal", random_spheres_scene(11, SphereMix::kMetal), camera));
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    results.push_back(bench_scene("dense-grid", dense_grid_scene(20), camera));
+
+    std::cout << "\nScenes (" << camera._threads << " threads, "
+              << camera._samples_per_pixel << " spp, wavefront)\n"
+              << std::setw(12) << "scene" << std::setw(8) << "prims"
+              << std::setw(10) << "Mray/s" << std::setw(10) << "primary"
+              << std::setw(11) << "secondary" << std::setw(7) << "depth"
+              << std::setw(10) << "nodes/ray" << std::setw(11) << "isect s"
+              << std::setw(11) << "scatter s" << std::setw(10) << "output s"
+              << '\n';
+    for (const SceneResult &result : results)
+    {
+        const RenderCounters &counters{result._counters};
+        const auto rays{static_cast<double>(counters._primary_rays +
+                                            counters._secondary_rays)};
+        std::cout << std::setw(12) << result._name << std::setw(8)
+                  << result._primitives << std::fixed << std::setprecision(2)
+                  << std::setw(10)
+                  << mrays_per_second(static_cast<std::size_t>(rays),
+                                      result._render_seconds)
+                  << std::setw(10) << counters._primary_rays << std::setw(11)
+                  << counters._secondary_rays << std::setw(7)
+                  << average_path_depth(counters) << std::setw(10)
+                  << static_cast<double>(counters._nodes_visited) / rays
+                  << std::setprecision(3) << std::setw(11)
+                  << counters._intersect_seconds << std::setw(11)
+                  << counters._scatter_seconds << std::setw(10)
+                  << result._output_seconds << '\n';
+    }
+
+    if (json_path.empty())
+    {
+        return true;
+    }
+    std::ofstream json{json_path};
+    write_json(json, camera, results);
+    return static_cast<bool>(json);
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const std::span<char *> arguments{argv, static_cast<std::size_t>(argc)};
+    std::string json_path;
+    bool scenes_only{false};
+    for (std::size_t index{1}; index < arguments.size(); ++index)
+    {
+        const std::string_view argument{arguments[index]};
+        if (argument == "--json" && index + 1 < arguments.size())
+        {
+            json_path = arguments[++index];
+        }
+        else if (argument == "--scenes")
+        {
+            scenes_only = true;
+        }
+        else
+        {
+            std::cerr << "Usage: " << arguments[0]
+                      << " [--scenes] [--json FILE]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!scenes_only)
+    {
+        bench_bvh();
+        bench_arena();
+        bench_sphere_set();
+        bench_vec3();
+        bench_sampling();
+        bench_russian_roulette();
+        bench_samplers();
+        bench_denoise();
+        bench_wavefront();
+        bench_scene_file();
+        bench_mesh();
+        bench_instances();
+        bench_refit();
+        bench_motion_blur();
+        bench_textures();
+        bench_checkpoint();
+        bench_preview();
+        bench_distributed();
+    }
+    if (!bench_scenes(json_path))
+    {
+        std::cerr << "Unable to write " << json_path << '\n';
+        return EXIT_FAILURE;
+    }
+    if (mismatches > 0)
+    {
+        std::cerr << mismatches << " check(s) failed\n";
+        return EXIT_FAILURE;
+    }
+}
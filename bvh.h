@@ -0,0 +1,664 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "aabb.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "render_counters.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+// One node of a flattened bounding volume hierarchy.  Nodes are laid out
+// depth first, so an interior node's first child immediately follows it and
+// only the index of the second child needs storing.
+struct BvhNode
+{
+    Aabb _bounds;
+    std::uint32_t _offset{0}; // leaf: first primitive, interior: second child
+    std::uint16_t _count{0};  // primitives in a leaf, zero for interior nodes
+    std::uint16_t _axis{0};   // split axis of an interior node
+};
+
+// Rays traced through a hierarchy together, each with the distance of its
+// nearest hit so far.  Lanes from _count on are unused.
+struct RayPacket
+{
+    static constexpr std::size_t kSize{8};
+
+    std::array<const Ray *, kSize> _rays{};
+    std::array<Real, kSize> _closest{};
+    std::size_t _count{0};
+    Real _t_min{0};
+};
+
+// Splits a batch into packets of consecutive slots and calls
+// trace(packet, slot), where slot(lane) is the slot a lane's ray came from,
+// copying each lane's narrowed distance back to `closest` afterwards.
+template <typename Trace>
+void for_each_packet(std::span<const Ray> rays,
+                     std::span<const std::uint32_t> slots,
+                     Real t_min,
+                     std::span<Real> closest,
+                     Trace &&trace)
+{
+    RayPacket packet;
+    packet._t_min = t_min;
+    for (std::size_t first{0}; first < slots.size(); first += RayPacket::kSize)
+    {
+        packet._count = std::min(RayPacket::kSize, slots.size() - first);
+        for (std::size_t lane{0}; lane < packet._count; ++lane)
+        {
+            packet._rays[lane] = &rays[slots[first + lane]];
+            packet._closest[lane] = closest[slots[first + lane]];
+        }
+        trace(packet, [&slots, first](std::size_t lane) {
+            return slots[first + lane];
+        });
+        for (std::size_t lane{0}; lane < packet._count; ++lane)
+        {
+            closest[slots[first + lane]] = packet._closest[lane];
+        }
+    }
+}
+
+// Hierarchy over an arbitrary set of primitives, described only by their
+// bounding boxes.  Building produces the node array plus the order in which
+// leaves reference the primitives; callers supply the per-primitive hit test
+// during traversal.
+class BvhTree
+{
+public:
+    BvhTree() = default;
+
+    explicit BvhTree(const std::vector<Aabb> &primitive_bounds)
+    {
+        std::vector<BuildPrimitive> primitives;
+        primitives.reserve(primitive_bounds.size());
+        for (std::size_t index{0}; index < primitive_bounds.size(); ++index)
+        {
+            primitives.push_back({primitive_bounds[index],
+                                  primitive_bounds[index].centroid(),
+                                  static_cast<std::uint32_t>(index)});
+        }
+
+        if (!primitives.empty())
+        {
+            _nodes.reserve(2 * primitives.size());
+            build(primitives, 0, primitives.size(), 0);
+        }
+
+        _order.reserve(primitives.size());
+        for (const BuildPrimitive &primitive : primitives)
+        {
+            _order.push_back(primitive._index);
+        }
+    }
+
+    // Adopts nodes built earlier, typically loaded from a file, whose leaves
+    // reference primitives already stored in leaf order; order() is empty.
+    explicit BvhTree(std::vector<BvhNode> nodes) : _nodes(std::move(nodes))
+    {
+    }
+
+    // Checks that every leaf lies within primitive_count primitives, every
+    // interior node's children follow it, and no path is deeper than
+    // traversal's stack allows.  Run before trusting adopted nodes.
+    [[nodiscard]] bool well_formed(std::size_t primitive_count) const
+    {
+        if (_nodes.empty())
+        {
+            return primitive_count == 0;
+        }
+
+        std::array<std::uint32_t, kMaxDepth> stack{};
+        std::array<std::size_t, kMaxDepth> depths{};
+        std::size_t stack_size{0};
+        std::uint32_t current{0};
+        std::size_t depth{0};
+        std::size_t visited{0};
+        while (true)
+        {
+            if (++visited > _nodes.size())
+            {
+                return false;
+            }
+            const BvhNode &node{_nodes[current]};
+            if (node._count > 0)
+            {
+                if (std::size_t{node._offset} + node._count > primitive_count)
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                if (node._offset <= current + 1 ||
+                    node._offset >= _nodes.size() || node._axis > 2 ||
+                    depth + 1 >= kMaxDepth)
+                {
+                    return false;
+                }
+                depths[stack_size] = depth + 1;
+                stack[stack_size++] = node._offset;
+                current = current + 1;
+                ++depth;
+                continue;
+            }
+
+            if (stack_size == 0)
+            {
+                return true;
+            }
+            current = stack[--stack_size];
+            depth = depths[stack_size];
+        }
+    }
+
+    [[nodiscard]] const std::vector<BvhNode> &nodes() const
+    {
+        return _nodes;
+    }
+
+    [[nodiscard]] const std::vector<std::uint32_t> &order() const
+    {
+        return _order;
+    }
+
+    [[nodiscard]] Aabb bounding_box() const
+    {
+        return _nodes.empty() ? Aabb{} : _nodes.front()._bounds;
+    }
+
+    // Recomputes every node's bounds from primitive_bounds(position), the
+    // current bounds of the primitive at that leaf position, keeping the
+    // tree's shape.  Children follow their parents, so one backward sweep
+    // sees both children of a node before the node.  Far cheaper than a
+    // rebuild, but the tree loosens as primitives move from where it was
+    // built.
+    template <typename PrimitiveBounds>
+    void refit(PrimitiveBounds &&primitive_bounds)
+    {
+        for (std::size_t index{_nodes.size()}; index-- > 0;)
+        {
+            BvhNode &node{_nodes[index]};
+            Aabb bounds;
+            if (node._count > 0)
+            {
+                for (std::uint32_t position{node._offset};
+                     position < node._offset + node._count;
+                     ++position)
+                {
+                    bounds = Aabb{bounds, primitive_bounds(position)};
+                }
+            }
+            else
+            {
+                bounds = Aabb{_nodes[index + 1]._bounds,
+                              _nodes[node._offset]._bounds};
+            }
+            node._bounds = bounds;
+        }
+    }
+
+    // Walks the hierarchy front to back with an explicit stack, calling
+    // hit_primitive(position, ray_t) for each primitive in every leaf the ray
+    // reaches, where order()[position] is the primitive's original index.
+    // hit_primitive returns true on a hit and shrinks ray_t._max to the new
+    // closest distance, which culls the remaining nodes.
+    template <typename HitPrimitive>
+    bool hit(const Ray &ray,
+             Interval ray_t,
+             HitPrimitive &&hit_primitive) const
+    {
+        if (_nodes.empty())
+        {
+            return false;
+        }
+
+        const Point3 origin{ray.origin()};
+        const Vec3 direction{ray.direction()};
+        const Vec3 inverse_direction{
+            1 / direction[0], 1 / direction[1], 1 / direction[2]};
+
+        std::array<std::uint32_t, kMaxDepth> stack{};
+        std::size_t stack_size{0};
+        std::uint32_t current{0};
+        bool hit_anything{false};
+
+        while (true)
+        {
+            const BvhNode &node{_nodes[current]};
+            RT_COUNT(_nodes_visited, 1U);
+            if (node._bounds.hit(origin, inverse_direction, ray_t))
+            {
+                if (node._count > 0)
+                {
+                    for (std::uint32_t index{node._offset};
+                         index < node._offset + node._count;
+                         ++index)
+                    {
+                        if (hit_primitive(index, ray_t))
+                        {
+                            hit_anything = true;
+                        }
+                    }
+                }
+                else
+                {
+                    // visit the child nearer the ray origin first
+                    if (direction[node._axis] < 0.0)
+                    {
+                        stack[stack_size++] = current + 1;
+                        current = node._offset;
+                    }
+                    else
+                    {
+                        stack[stack_size++] = node._offset;
+                        current = current + 1;
+                    }
+                    continue;
+                }
+            }
+
+            if (stack_size == 0)
+            {
+                break;
+            }
+            current = stack[--stack_size];
+        }
+
+        return hit_anything;
+    }
+
+    // Walks the hierarchy once for a packet of rays, visiting every node
+    // that any of them reaches, instead of once per ray.  Each node's box is
+    // tested against all lanes in one loop with the arithmetic of
+    // Aabb::hit, and only lanes whose rays reach a leaf see its
+    // primitives, through hit_primitive(lane, position, lane_t) as in hit().
+    // A lane's closest hit is the one hit() finds, though lanes whose rays
+    // point away from the packet's first may test primitives in another
+    // order.  Pays off for rays that take similar paths through the tree.
+    template <typename HitPrimitive>
+    void hit_packet(RayPacket &packet, HitPrimitive &&hit_primitive) const
+    {
+        if (_nodes.empty() || packet._count == 0)
+        {
+            return;
+        }
+
+        // empty lanes keep an interval that no box can hit
+        std::array<Real, RayPacket::kSize> t_max{};
+        t_max.fill(-constants::kInfinity);
+        std::array<std::array<Real, RayPacket::kSize>, 3> origin{};
+        std::array<std::array<Real, RayPacket::kSize>, 3> inverse_direction{};
+        for (std::size_t lane{0}; lane < packet._count; ++lane)
+        {
+            t_max[lane] = packet._closest[lane];
+            for (int axis{0}; axis < 3; ++axis)
+            {
+                const auto component{static_cast<std::size_t>(axis)};
+                origin[component][lane] = packet._rays[lane]->origin()[axis];
+                inverse_direction[component][lane] =
+                    1 / packet._rays[lane]->direction()[axis];
+            }
+        }
+
+        constexpr Real kRoundoff{std::numeric_limits<Real>::epsilon() / 2};
+        constexpr Real kFarScale{1 + 2 * (3 * kRoundoff / (1 - 3 * kRoundoff))};
+        // each node is tested for the lanes whose rays reached its parent,
+        // as each ray's own walk in hit() would test it, and counted for
+        // those alone
+        std::array<std::uint32_t, kMaxDepth> stack{};
+        std::array<std::uint32_t, kMaxDepth> stack_lanes{};
+        std::size_t stack_size{0};
+        std::uint32_t current{0};
+        static_assert(RayPacket::kSize < 32);
+        std::uint32_t lanes{(1U << packet._count) - 1};
+
+        while (true)
+        {
+            const BvhNode &node{_nodes[current]};
+            RT_COUNT(_nodes_visited,
+                     static_cast<unsigned int>(std::popcount(lanes)));
+            std::uint32_t reached{0};
+            for (std::size_t lane{0}; lane < RayPacket::kSize; ++lane)
+            {
+                // selects rather than fmax and fmin, which compile to
+                // calls; a NaN distance still leaves the interval as it was
+                Real near_t{packet._t_min};
+                Real far_t{t_max[lane]};
+                for (std::size_t axis{0}; axis < 3; ++axis)
+                {
+                    const Interval &slab{
+                        node._bounds.axis(static_cast<int>(axis))};
+                    const Real inverse{inverse_direction[axis][lane]};
+                    const Real to_min{(slab._min - origin[axis][lane]) *
+                                      inverse};
+                    const Real to_max{(slab._max - origin[axis][lane]) *
+                                      inverse};
+                    const Real near{inverse < 0 ? to_max : to_min};
+                    const Real far{(inverse < 0 ? to_min : to_max) *
+                                   kFarScale};
+                    near_t = near > near_t ? near : near_t;
+                    far_t = far < far_t ? far : far_t;
+                }
+                if (near_t <= far_t)
+                {
+                    reached |= 1U << lane;
+                }
+            }
+            reached &= lanes;
+
+            if (reached != 0)
+            {
+                if (node._count > 0)
+                {
+                    for (std::uint32_t index{node._offset};
+                         index < node._offset + node._count;
+                         ++index)
+                    {
+                        for (std::size_t lane{0}; lane < packet._count; ++lane)
+                        {
+                            Interval lane_t{packet._t_min, t_max[lane]};
+                            if (((reached >> lane) & 1U) != 0 &&
+                                hit_primitive(lane, index, lane_t))
+                            {
+                                t_max[lane] = lane_t._max;
+                            }
+                        }
+                    }
+                }
+                else
+                {
+                    // visit first the child nearer the first reaching ray
+                    const auto leader{
+                        static_cast<std::size_t>(std::countr_zero(reached))};
+                    stack_lanes[stack_size] = reached;
+                    lanes = reached;
+                    if (inverse_direction[node._axis][leader] < 0)
+                    {
+                        stack[stack_size++] = current + 1;
+                        current = node._offset;
+                    }
+                    else
+                    {
+                        stack[stack_size++] = node._offset;
+                        current = current + 1;
+                    }
+                    continue;
+                }
+            }
+
+            if (stack_size == 0)
+            {
+                break;
+            }
+            current = stack[--stack_size];
+            lanes = stack_lanes[stack_size];
+        }
+
+        for (std::size_t lane{0}; lane < packet._count; ++lane)
+        {
+            packet._closest[lane] = t_max[lane];
+        }
+    }
+
+private:
+    static constexpr std::size_t kMaxDepth{64};
+    static constexpr std::size_t kBinCount{16};
+    static constexpr std::size_t kMaxLeafSize{4};
+    static constexpr double kTraversalCost{1.0}; // relative to one primitive
+
+    struct BuildPrimitive
+    {
+        Aabb _bounds;
+        Point3 _centroid;
+        std::uint32_t _index;
+    };
+
+    struct Bin
+    {
+        Aabb _bounds;
+        std::size_t _count{0};
+    };
+
+    std::vector<BvhNode> _nodes;
+    std::vector<std::uint32_t> _order;
+
+    // Builds the subtree over primitives [begin, end) and returns its index.
+    std::uint32_t build(std::vector<BuildPrimitive> &primitives,
+                        std::size_t begin,
+                        std::size_t end,
+                        std::size_t depth)
+    {
+        const auto node_index{static_cast<std::uint32_t>(_nodes.size())};
+        _nodes.emplace_back();
+
+        Aabb bounds;
+        Aabb centroid_bounds;
+        for (std::size_t index{begin}; index < end; ++index)
+        {
+            bounds = Aabb{bounds, primitives[index]._bounds};
+            centroid_bounds = Aabb{centroid_bounds,
+                                   Aabb{primitives[index]._centroid,
+                                        primitives[index]._centroid}};
+        }
+        _nodes[node_index]._bounds = bounds;
+
+        const std::size_t count{end - begin};
+        const int axis{centroid_bounds.longest_axis()};
+        const Interval &extent{centroid_bounds.axis(axis)};
+
+        if (count <= 1 || (count <= kMaxLeafSize && extent.size() <= 0.0))
+        {
+            make_leaf(node_index, begin, count);
+            return node_index;
+        }
+
+        std::size_t middle{begin};
+        if (extent.size() > 0.0 && depth + 1 < kMaxDepth / 2)
+        {
+            middle =
+                sah_partition(primitives, begin, end, bounds, axis, extent);
+            if (middle == end)
+            {
+                make_leaf(node_index, begin, count);
+                return node_index;
+            }
+        }
+
+        if (middle == begin)
+        {
+            // degenerate or too deep: split at the median centroid instead
+            middle = begin + count / 2;
+            std::nth_element(
+                primitives.begin() + static_cast<std::ptrdiff_t>(begin),
+                primitives.begin() + static_cast<std::ptrdiff_t>(middle),
+                primitives.begin() + static_cast<std::ptrdiff_t>(end),
+                [axis](const BuildPrimitive &a_value,
+                       const BuildPrimitive &b_value) {
+                    return a_value._centroid[axis] < b_value._centroid[axis];
+                });
+        }
+
+        build(primitives, begin, middle, depth + 1);
+        const std::uint32_t second_child{
+            build(primitives, middle, end, depth + 1)};
+        _nodes[node_index]._offset = second_child;
+        _nodes[node_index]._axis = static_cast<std::uint16_t>(axis);
+        return node_index;
+    }
+
+    void make_leaf(std::uint32_t node_index,
+                   std::size_t begin,
+                   std::size_t count)
+    {
+        _nodes[node_index]._offset = static_cast<std::uint32_t>(begin);
+        _nodes[node_index]._count = static_cast<std::uint16_t>(count);
+    }
+
+    // Bins centroids along the axis and partitions at the split with the
+    // lowest surface area heuristic cost.  Returns the partition point,
+    // `begin` if no split separates the primitives, or `end` if a leaf is
+    // cheaper than any split.
+    static std::size_t sah_partition(std::vector<BuildPrimitive> &primitives,
+                                     std::size_t begin,
+                                     std::size_t end,
+                                     const Aabb &bounds,
+                                     int axis,
+                                     const Interval &extent)
+    {
+        const auto bin_of{[axis, &extent](const BuildPrimitive &primitive) {
+            const auto bin{static_cast<std::size_t>(
+                static_cast<double>(kBinCount) *
+                (primitive._centroid[axis] - extent._min) / extent.size())};
+            return std::min(bin, kBinCount - 1);
+        }};
+
+        std::array<Bin, kBinCount> bins{};
+        for (std::size_t index{begin}; index < end; ++index)
+        {
+            Bin &bin{bins[bin_of(primitives[index])]};
+            bin._bounds = Aabb{bin._bounds, primitives[index]._bounds};
+            ++bin._count;
+        }
+
+        // sweep from the right to find the cost of every right-hand side
+        std::array<double, kBinCount> right_cost{};
+        Aabb right_bounds;
+        std::size_t right_count{0};
+        for (std::size_t split{kBinCount - 1}; split > 0; --split)
+        {
+            right_bounds = Aabb{right_bounds, bins[split]._bounds};
+            right_count += bins[split]._count;
+            right_cost[split] = right_bounds.surface_area() *
+                                static_cast<double>(right_count);
+        }
+
+        double best_cost{constants::kInfinity};
+        std::size_t best_split{0};
+        Aabb left_bounds;
+        std::size_t left_count{0};
+        for (std::size_t split{1}; split < kBinCount; ++split)
+        {
+            left_bounds = Aabb{left_bounds, bins[split - 1]._bounds};
+            left_count += bins[split - 1]._count;
+            const double cost{left_bounds.surface_area() *
+                                  static_cast<double>(left_count) +
+                              right_cost[split]};
+            if (left_count > 0 && left_count < end - begin && cost < best_cost)
+            {
+                best_cost = cost;
+                best_split = split;
+            }
+        }
+
+        if (best_split == 0)
+        {
+            return begin;
+        }
+
+        const std::size_t count{end - begin};
+        const double split_cost{kTraversalCost +
+                                best_cost / bounds.surface_area()};
+        if (count <= kMaxLeafSize && split_cost >= static_cast<double>(count))
+        {
+            return end;
+        }
+
+        const auto middle{std::partition(
+            primitives.begin() + static_cast<std::ptrdiff_t>(begin),
+            primitives.begin() + static_cast<std::ptrdiff_t>(end),
+            [&bin_of, best_split](const BuildPrimitive &primitive) {
+                return bin_of(primitive) < best_split;
+            })};
+        return static_cast<std::size_t>(middle - primitives.begin());
+    }
+};
+
+// Bounding volume hierarchy over the objects of a HittableList.  Replaces the
+// list's linear scan with a logarithmic traversal of the object bounds.
+class Bvh : public Hittable
+{
+public:
+    explicit Bvh(const HittableList &list)
+    {
+        std::vector<Aabb> bounds;
+        bounds.reserve(list._objects.size());
+        for (const auto &object : list._objects)
+        {
+            bounds.push_back(object->bounding_box());
+        }
+        _tree = BvhTree{bounds};
+
+        // store objects in leaf order so each leaf reads a contiguous run
+        _objects.reserve(list._objects.size());
+        for (const std::uint32_t index : _tree.order())
+        {
+            _objects.push_back(list._objects[index]);
+        }
+    }
+
+    bool hit(const Ray &ray, Interval ray_t, HitRecord &rec) const override
+    {
+        return _tree.hit(ray,
+                         ray_t,
+                         [this, &ray, &rec](std::uint32_t position,
+                                            Interval &closest) {
+                             RT_COUNT(_primitives_tested, 1U);
+                             if (!_objects[position]->hit(ray, closest, rec))
+                             {
+                                 return false;
+                             }
+                             closest._max = rec._t_interval;
+                             return true;
+                         });
+    }
+
+    // Traces the rays in packets of consecutive slots, so rays generated
+    // together share one walk of the tree.
+    void hit_batch(std::span<const Ray> rays,
+                   std::span<const std::uint32_t> slots,
+                   Real t_min,
+                   std::span<Real> closest,
+                   std::span<HitRecord> records) const override
+    {
+        for_each_packet(
+            rays, slots, t_min, closest, [&](RayPacket &packet, auto slot) {
+                _tree.hit_packet(
+                    packet,
+                    [&](std::size_t lane,
+                        std::uint32_t position,
+                        Interval &lane_t) {
+                        RT_COUNT(_primitives_tested, 1U);
+                        HitRecord &record{records[slot(lane)]};
+                        if (!_objects[position]->hit(
+                                *packet._rays[lane], lane_t, record))
+                        {
+                            return false;
+                        }
+                        lane_t._max = record._t_interval;
+                        return true;
+                    });
+            });
+    }
+
+    [[nodiscard]] Aabb bounding_box() const override
+    {
+        return _tree.bounding_box();
+    }
+
+private:
+    BvhTree _tree;
+    std::vector<const Hittable *> _objects; // owned with the list's objects
+};
+
+#endif
@@ -2,11 +2,28 @@
 #define CAMERA_H
 
 #include "colour.h"
+#include "feature_buffer.h"
+#include "framebuffer.h"
 #include "hittable.h"
 #include "material.h"
+#include "render_counters.h"
+#include "sampler.h"
+#include "sampling.h"
+#include "thread_pool.h"
 #include "utility.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <format>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
 
 class Camera
 {
@@ -15,6 +32,8 @@ public:
     int _image_width = 100;
     int _samples_per_pixel = 10;
     int _max_depth = 10; // maximum nuber of ray bounces into scene
+    int _russian_roulette_depth = 3; // bounces before paths may be culled,
+                                     // 0 to disable
 
     double _vertical_fov = 90.0; // vertical field of view
     Point3 _look_from = Point3{0.0, 0.0, -1.0};
@@ -24,36 +43,208 @@ public:
     double _defocus_angle = 0.0;
     double _focus_dist = 10.0;
 
-    void render(const Hittable &world)
+    // Each camera ray samples a time in [_shutter_open, _shutter_close), in
+    // the units of the scene's motion, which primitives bound over times 0
+    // to 1.  Equal times, the default, show the scene at that instant.
+    double _shutter_open = 0.0;
+    double _shutter_close = 0.0;
+
+    unsigned int _threads = 1; // worker threads used by render
+    int _tile_size = 16;       // edge length of the square tiles, in pixels
+    std::uint64_t _seed = 0;   // base seed for every pixel sample
+    SamplerKind _sampler = SamplerKind::kIndependent; // see sampler.h
+    // The sample count the stratified sampler lays its pattern out for, if
+    // not _samples_per_pixel.  A resumed render keeps the count its
+    // checkpoint was started with, so the samples added beyond it are
+    // drawn independently instead of from a pattern for another count.
+    int _stratified_samples = 0;
+
+    // Wavefront mode traces each tile's samples as a batch of paths advanced
+    // one bounce at a time through separate intersection and scatter stages,
+    // rather than following each path to completion before starting the
+    // next.  The image is identical either way; renders in passes
+    // (progressive, checkpointed or resumed) always trace depth first.
+    bool _wavefront = false;
+
+    // Progressive mode renders in passes of _pass_samples per pixel and stops
+    // sampling a pixel once the relative standard error of its luminance
+    // falls below _error_threshold.  _samples_per_pixel then caps the samples
+    // any pixel receives.  A positive _time_budget (seconds) ends any render
+    // in passes after the pass that exceeds it.
+    bool _progressive = false;
+    int _pass_samples = 8;
+    int _min_samples = 16; // samples before a pixel may be judged converged
+    double _error_threshold = 0.02;
+    double _time_budget = 0.0;
+
+    struct RenderStats
+    {
+        int _passes{0};
+        std::uint64_t _samples_taken{0};
+        std::uint64_t _samples_budgeted{0}; // at _samples_per_pixel each
+        std::uint64_t _converged_pixels{0};
+        double _seconds{0.0};
+        RenderCounters _counters; // filled only in RT_STATS builds
+    };
+
+    // A positive _checkpoint_interval (seconds) renders in passes of
+    // _pass_samples, as progressive mode does, and calls _checkpoint with the
+    // framebuffer after the first pass to end that long after the last call,
+    // and again once the render stops.
+    double _checkpoint_interval = 0.0;
+    std::function<void(const Framebuffer &)> _checkpoint;
+
+    // If set, _on_pass is called with the framebuffer after every pass of a
+    // render in passes, as the preview does to show the image refining, and
+    // selects rendering in passes.  If set, _stop is polled before each
+    // tile; once it returns true the render skips the remaining tiles and
+    // returns.
+    std::function<void(const Framebuffer &)> _on_pass;
+    std::function<bool()> _stop;
+
+    // Renders the world into a framebuffer of accumulated samples; see
+    // write_image for turning it into an image file.
+    Framebuffer render(const Hittable &world, const MaterialTable &materials)
+    {
+        Framebuffer framebuffer{_image_width, image_height()};
+        render(world, materials, framebuffer);
+        return framebuffer;
+    }
+
+    // Continues a render in `framebuffer`, which may hold the samples of an
+    // earlier one with the same scene and seed, such as a loaded checkpoint.
+    // Each pixel's samples continue its own sequence, so the result is the
+    // image an uninterrupted render would have made.
+    void render(const Hittable &world,
+                const MaterialTable &materials,
+                Framebuffer &framebuffer)
     {
         initialise();
+        const auto start{std::chrono::steady_clock::now()};
 
-        //        std::cout << std::format("P3\n {} {} \n255\n",
-        //                                 _image_width,
-        //                                 _image_height);
+        _stats = RenderStats{};
+        _stats._samples_budgeted =
+            static_cast<std::uint64_t>(_image_width) *
+            static_cast<std::uint64_t>(_image_height) *
+            static_cast<std::uint64_t>(_samples_per_pixel);
 
-        std::cout << "P3\n " << _image_width << ' ' << _image_height
-                  << "\n255\n";
+        if (_progressive || _checkpoint_interval > 0.0 || _on_pass ||
+            framebuffer.total_samples() > 0)
+        {
+            render_passes(world, materials, framebuffer, start);
+        }
+        else
+        {
+            render_frame_tiles(world, materials, framebuffer, {});
+            _stats._passes = 1;
+            _stats._samples_taken = _stats._samples_budgeted;
+        }
+        if (_checkpoint)
+        {
+            _checkpoint(framebuffer);
+        }
+        _stats._seconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
 
-        for (int j{0}; j < _image_height; ++j)
+        std::clog << "\rDone.                  \n";
+    }
+
+    // Renders only the listed tiles into `framebuffer`, which must cover the
+    // whole image.  Each pixel ends up exactly as render() would leave it, so
+    // processes can share out the tiles of one frame and merge the results.
+    void render_tiles(const Hittable &world,
+                      const MaterialTable &materials,
+                      std::span<const std::size_t> tiles,
+                      Framebuffer &framebuffer)
+    {
+        if (tiles.empty())
         {
-            //            std::clog << std::format("\rScanlines remaining: {} ",
-            //                                     _image_height - j)
-            //                      << std::flush;
-            std::clog << "\rScanlines remaining: " << _image_height - j << ' '
-                      << std::flush;
-            for (int i{0}; i < _image_width; ++i)
+            return;
+        }
+        initialise();
+        render_frame_tiles(world, materials, framebuffer, tiles);
+    }
+
+    // Traces up to kFeatureSamples of each pixel's camera rays, through
+    // glass and polished metal, to the first surface that scatters diffusely
+    // and averages the features the denoiser is guided by: that surface's
+    // albedo tinted by the specular bounces before it, its normal and the
+    // distance along the path.  The rays are the pixel's first samples', so
+    // the features are antialiased like the image.
+    FeatureBuffer render_features(const Hittable &world,
+                                  const MaterialTable &materials)
+    {
+        initialise();
+        FeatureBuffer features{_image_width, _image_height};
+        const int samples{std::min(_samples_per_pixel, kFeatureSamples)};
+        for_each_tile([&](int i_begin, int j_begin, int i_end, int j_end) {
+            for (int j{j_begin}; j < j_end; ++j)
             {
-                Colour pixel_colour{0.0, 0.0, 0.0};
-                for (int sample{0}; sample < _samples_per_pixel; ++sample)
+                for (int i{i_begin}; i < i_end; ++i)
                 {
-                    const Ray ray{get_ray(i, j)};
-                    pixel_colour += ray_colour(ray, _max_depth, world);
+                    Colour albedo{0.0, 0.0, 0.0};
+                    Vec3 normal{0.0, 0.0, 0.0};
+                    double depth{0.0};
+                    for (int sample{0}; sample < samples; ++sample)
+                    {
+                        Sampler sampler{pixel_sampler(i, j, sample)};
+                        const Ray ray{get_ray(i, j, sampler)};
+                        const FirstSurface surface{
+                            first_surface(ray, world, materials, sampler)};
+                        albedo += surface._albedo;
+                        normal += surface._normal;
+                        depth += surface._depth;
+                    }
+                    const auto count{static_cast<Real>(samples)};
+                    features.set(i,
+                                 j,
+                                 albedo / count,
+                                 normal.near_zero() ? normal
+                                                    : unit_vector(normal),
+                                 depth / samples);
                 }
-                write_colour(std::cout, pixel_colour, _samples_per_pixel);
             }
-        }
-        std::clog << "\rDone.                  \n";
+        });
+        return features;
+    }
+
+    [[nodiscard]] const RenderStats &stats() const
+    {
+        return _stats;
+    }
+
+    [[nodiscard]] int image_height() const
+    {
+        const auto height{static_cast<int>(_image_width / _aspect_ratio)};
+        return (height < 1) ? 1 : height;
+    }
+
+    struct TileBounds
+    {
+        int _i_begin;
+        int _j_begin;
+        int _i_end; // one past the last column
+        int _j_end; // one past the last row
+    };
+
+    // Tiles are numbered row by row from the top left.
+    [[nodiscard]] std::size_t tile_count() const
+    {
+        return static_cast<std::size_t>(tiles_across()) *
+               static_cast<std::size_t>(
+                   (image_height() + _tile_size - 1) / _tile_size);
+    }
+
+    [[nodiscard]] TileBounds tile_bounds(std::size_t tile) const
+    {
+        const auto across{static_cast<std::size_t>(tiles_across())};
+        const int i_begin{static_cast<int>(tile % across) * _tile_size};
+        const int j_begin{static_cast<int>(tile / across) * _tile_size};
+        return {i_begin,
+                j_begin,
+                std::min(i_begin + _tile_size, _image_width),
+                std::min(j_begin + _tile_size, image_height())};
     }
 
 private:
@@ -67,12 +258,91 @@ private:
     Vec3 _w;
     Vec3 _defocus_disc_u; // defocus disc horizontal radius
     Vec3 _defocus_disc_v; // defocus disc vertical radius
+    Real _pixel_spread;   // angle a pixel subtends, in radians
+
+    RenderStats _stats;
+    std::unique_ptr<ThreadPool> _pool; // kept between renders
+
+    // NOLINTBEGIN(readability-magic-numbers)
+    static constexpr int kWavefrontPaths{4096}; // paths in flight per tile
+    static constexpr int kFeatureSamples{16};
+    static constexpr int kFeatureBounces{8}; // specular bounces followed
+    static constexpr double kBackgroundDepth{1.0e4};
+    static constexpr Real kRoughSpread{0.1_r}; // radians, after rough bounces
+    // NOLINTEND(readability-magic-numbers)
+
+    // The cone of rays a path stands for, whose width where it meets a
+    // surface is the footprint textures filter over (Akenine-Moller et al.,
+    // "Texture Level of Detail Strategies for Real-Time Ray Tracing", 2019).
+    // It leaves the camera a pixel wide in angle, and its spread widens to
+    // kRoughSpread at the first bounce off a rough surface; specular
+    // bounces keep it, ignoring curvature.
+    struct RayCone
+    {
+        Real _width{0};
+        Real _spread{0};
+
+        // Grows the cone along the ray to the hit and records its width.
+        void reach(const Ray &ray, HitRecord &record)
+        {
+            _width += _spread * record._t_interval * ray.direction().length();
+            record._footprint = _width;
+        }
+
+        void bounce(const Material &material)
+        {
+            if (!material.is_specular())
+            {
+                _spread = std::fmax(_spread, kRoughSpread);
+            }
+        }
+    };
+
+    struct FirstSurface
+    {
+        Colour _albedo;
+        Vec3 _normal;
+        double _depth;
+    };
+
+    // State of a wavefront of paths, one slot per path, kept as parallel
+    // arrays so each stage streams through only the data it touches.  The
+    // queues hold the slots still in flight, compacted after every stage.
+    struct PathBatch
+    {
+        std::vector<Ray> _rays;
+        std::vector<Colour> _throughput;
+        std::vector<Colour> _radiance;
+        std::vector<Sampler> _samplers;
+        std::vector<HitRecord> _records;
+        std::vector<RayCone> _cones;
+        std::vector<Real> _closest; // nearest hit distance while intersecting
+        std::vector<std::uint32_t> _active; // slots awaiting intersection
+        std::vector<std::uint32_t> _hits;   // slots awaiting scatter
+
+        // Makes room for `size` paths, keeping any larger allocation.
+        void resize(std::size_t size)
+        {
+            if (size <= _rays.size())
+            {
+                return;
+            }
+            _rays.resize(size);
+            _throughput.resize(size);
+            _radiance.resize(size);
+            _samplers.resize(size);
+            _records.resize(size);
+            _cones.resize(size);
+            _closest.resize(size);
+            _active.reserve(size);
+            _hits.reserve(size);
+        }
+    };
 
 
     void initialise()
     {
-        _image_height = {static_cast<int>(_image_width / _aspect_ratio)};
-        _image_height = {(_image_height < 1) ? 1 : _image_height};
+        _image_height = image_height();
 
         _centre = _look_from;
 
@@ -90,92 +360,590 @@ private:
         _v = cross(_w, _u);
 
         // Calculate the vectors across the horizontal and down the vertical viewport edges
-        const Vec3 viewport_u{viewport_width * _u};
-        const Vec3 viewport_v{viewport_height * -_v};
+        const Vec3 viewport_u{static_cast<Real>(viewport_width) * _u};
+        const Vec3 viewport_v{static_cast<Real>(viewport_height) * -_v};
 
         // Calculate the horizontal and vertical delta vectors from pixel to pixel
-        _pixel_delta_u = {viewport_u / _image_width};
-        _pixel_delta_v = {viewport_v / _image_height};
+        _pixel_delta_u = {viewport_u / static_cast<Real>(_image_width)};
+        _pixel_delta_v = {viewport_v / static_cast<Real>(_image_height)};
 
         // Calculate the location of the upper left pixel
-        const Point3 viewport_upper_left{_centre - (_focus_dist * _w) -
-                                         viewport_u / 2.0 - viewport_v / 2.0};
+        const Point3 viewport_upper_left{
+            _centre - (static_cast<Real>(_focus_dist) * _w) - viewport_u / 2 -
+            viewport_v / 2};
         _pixel00_loc = {viewport_upper_left +
-                        0.5 * (_pixel_delta_u + _pixel_delta_v)};
+                        0.5_r * (_pixel_delta_u + _pixel_delta_v)};
 
         // Calculate the camera defocus disc basis vectors.
         const double defocus_radius{
             _focus_dist * tan(degrees_to_radians(_defocus_angle / 2.0))};
-        _defocus_disc_u = _u * defocus_radius;
-        _defocus_disc_v = _v * defocus_radius;
+        _defocus_disc_u = _u * static_cast<Real>(defocus_radius);
+        _defocus_disc_v = _v * static_cast<Real>(defocus_radius);
+
+        _pixel_spread =
+            _pixel_delta_u.length() / static_cast<Real>(_focus_dist);
     }
 
 
-    [[nodiscard]] Ray get_ray(int i, int j) const
+    // Calls render_tile(i_begin, j_begin, i_end, j_end) for each listed tile,
+    // or every tile of the image if the list is empty, spread across the
+    // worker threads.
+    template <typename RenderTile>
+    void for_each_tile(const RenderTile &render_tile,
+                       std::span<const std::size_t> tiles = {})
     {
-        // get a randomly sampled camera ray for the pixel at location i,j, originating from the camera defocus disc
-        const Point3 pixel_centre{_pixel00_loc + (i * _pixel_delta_u) +
-                                  (j * _pixel_delta_v)};
-        const Point3 pixel_sample{pixel_centre + pixel_sample_square()};
+        const std::size_t tile_count{tiles.empty() ? this->tile_count()
+                                                   : tiles.size()};
+
+        std::mutex progress_mutex;
+        std::size_t tiles_remaining{tile_count};
+
+        const auto run_tile{[&](std::size_t task) {
+            if (_stop && _stop())
+            {
+                return;
+            }
+            const TileBounds bounds{
+                tile_bounds(tiles.empty() ? task : tiles[task])};
+            render_tile(bounds._i_begin,
+                        bounds._j_begin,
+                        bounds._i_end,
+                        bounds._j_end);
+
+            //            std::clog << std::format("\rTiles remaining: {} ",
+            //                                     tiles_remaining)
+            //                      << std::flush;
+            const std::lock_guard<std::mutex> lock{progress_mutex};
+            _stats._counters += take_render_counters();
+            --tiles_remaining;
+            std::clog << "\rTiles remaining: " << tiles_remaining << ' '
+                      << std::flush;
+        }};
+
+        if (_threads <= 1)
+        {
+            for (std::size_t task{0}; task < tile_count; ++task)
+            {
+                run_tile(task);
+            }
+            return;
+        }
+
+        if (!_pool || _pool->size() != _threads)
+        {
+            _pool = std::make_unique<ThreadPool>(_threads);
+        }
+        _pool->parallel_for(tile_count, run_tile);
+    }
+
+    [[nodiscard]] int tiles_across() const
+    {
+        return (_image_width + _tile_size - 1) / _tile_size;
+    }
 
-        const Point3 ray_origin{(_defocus_angle <= 0) ? _centre
-                                                      : defocus_disc_sample()};
+    // Takes every sample of the listed tiles (all tiles if the list is
+    // empty), depth first or as wavefronts.
+    void render_frame_tiles(const Hittable &world,
+                            const MaterialTable &materials,
+                            Framebuffer &framebuffer,
+                            std::span<const std::size_t> tiles)
+    {
+        if (_wavefront)
+        {
+            render_wavefront(world, materials, framebuffer, tiles);
+            return;
+        }
+        for_each_tile(
+            [&](int i_begin, int j_begin, int i_end, int j_end) {
+                for (int j{j_begin}; j < j_end; ++j)
+                {
+                    for (int i{i_begin}; i < i_end; ++i)
+                    {
+                        sample_pixel(i,
+                                     j,
+                                     _samples_per_pixel,
+                                     world,
+                                     materials,
+                                     framebuffer);
+                    }
+                }
+            },
+            tiles);
+    }
+
+    // Renders in passes of _pass_samples until every pixel has
+    // _samples_per_pixel samples or, in progressive mode, has converged.
+    // Pixels are judged only on their own samples, so a framebuffer resumed
+    // after any pass carries on exactly as if never stopped.
+    void render_passes(const Hittable &world,
+                       const MaterialTable &materials,
+                       Framebuffer &framebuffer,
+                       std::chrono::steady_clock::time_point start)
+    {
+        const auto max_samples{
+            static_cast<std::uint32_t>(std::max(_samples_per_pixel, 0))};
+        std::vector<std::uint8_t> converged(
+            static_cast<std::size_t>(_image_width) *
+            static_cast<std::size_t>(_image_height));
+        const auto is_done{[&](int i, int j) {
+            const std::uint32_t taken{framebuffer.samples(i, j)};
+            return taken >= max_samples ||
+                   (_progressive &&
+                    taken >= static_cast<std::uint32_t>(_min_samples) &&
+                    framebuffer.relative_error(i, j) < _error_threshold);
+        }};
+        for (int j{0}; j < _image_height; ++j)
+        {
+            for (int i{0}; i < _image_width; ++i)
+            {
+                converged[pixel_index(i, j)] =
+                    framebuffer.samples(i, j) > 0 && is_done(i, j) ? 1 : 0;
+            }
+        }
+        std::atomic<std::uint64_t> active_pixels{1};
+        auto last_checkpoint{start};
+
+        while (active_pixels > 0)
+        {
+            active_pixels = 0;
+            for_each_tile([&](int i_begin, int j_begin, int i_end, int j_end) {
+                std::uint64_t tile_active{0};
+                for (int j{j_begin}; j < j_end; ++j)
+                {
+                    for (int i{i_begin}; i < i_end; ++i)
+                    {
+                        std::uint8_t &done{converged[pixel_index(i, j)]};
+                        if (done != 0)
+                        {
+                            continue;
+                        }
+                        const std::uint32_t taken{framebuffer.samples(i, j)};
+                        const auto count{static_cast<int>(std::min(
+                            static_cast<std::uint32_t>(_pass_samples),
+                            max_samples - taken))};
+                        sample_pixel(
+                            i, j, count, world, materials, framebuffer);
+
+                        if (is_done(i, j))
+                        {
+                            done = 1;
+                        }
+                        else
+                        {
+                            ++tile_active;
+                        }
+                    }
+                }
+                active_pixels += tile_active;
+            });
+            ++_stats._passes;
+            if (_on_pass)
+            {
+                _on_pass(framebuffer);
+            }
+            if (_stop && _stop())
+            {
+                break;
+            }
+
+            const auto now{std::chrono::steady_clock::now()};
+            if (_time_budget > 0.0 &&
+                std::chrono::duration<double>(now - start).count() >=
+                    _time_budget)
+            {
+                break;
+            }
+            if (_checkpoint && _checkpoint_interval > 0.0 &&
+                active_pixels > 0 &&
+                std::chrono::duration<double>(now - last_checkpoint).count() >=
+                    _checkpoint_interval)
+            {
+                _checkpoint(framebuffer);
+                last_checkpoint = std::chrono::steady_clock::now();
+            }
+        }
+
+        for (int j{0}; j < _image_height; ++j)
+        {
+            for (int i{0}; i < _image_width; ++i)
+            {
+                const std::uint32_t taken{framebuffer.samples(i, j)};
+                _stats._samples_taken += taken;
+                if (converged[pixel_index(i, j)] != 0 && taken < max_samples)
+                {
+                    ++_stats._converged_pixels;
+                }
+            }
+        }
+    }
+
+    void render_wavefront(const Hittable &world,
+                          const MaterialTable &materials,
+                          Framebuffer &framebuffer,
+                          std::span<const std::size_t> tiles)
+    {
+        const auto render_tile{[&](int i_begin,
+                                   int j_begin,
+                                   int i_end,
+                                   int j_end) {
+            const int tile_width{i_end - i_begin};
+            const int tile_pixels{tile_width * (j_end - j_begin)};
+            // not std::clamp, whose bounds would be inverted by a sample
+            // count below one
+            const int batch_samples{std::max(
+                std::min(kWavefrontPaths / tile_pixels, _samples_per_pixel),
+                1)};
+            // each thread keeps its batch from tile to tile rather than
+            // allocating and clearing megabytes per tile
+            thread_local PathBatch batch;
+            batch.resize(static_cast<std::size_t>(tile_pixels) *
+                         static_cast<std::size_t>(batch_samples));
+
+            for (int first{0}; first < _samples_per_pixel;
+                 first += batch_samples)
+            {
+                const int count{
+                    std::min(batch_samples, _samples_per_pixel - first)};
+
+                // generate: slot = sample offset * tile_pixels + pixel
+                batch._active.clear();
+                std::uint32_t slot{0};
+                for (int sample{first}; sample < first + count; ++sample)
+                {
+                    for (int j{j_begin}; j < j_end; ++j)
+                    {
+                        for (int i{i_begin}; i < i_end; ++i)
+                        {
+                            Sampler &sampler{batch._samplers[slot]};
+                            sampler = pixel_sampler(i, j, sample);
+                            batch._rays[slot] = get_ray(i, j, sampler);
+                            batch._throughput[slot] = Colour{1.0, 1.0, 1.0};
+                            batch._radiance[slot] = Colour{0.0, 0.0, 0.0};
+                            batch._cones[slot] = RayCone{0, _pixel_spread};
+                            batch._active.push_back(slot++);
+                        }
+                    }
+                }
+
+                trace_wavefront(batch, world, materials);
+
+                // accumulate each pixel's samples in sample order, exactly
+                // as sample_pixel does
+                for (int pixel{0}; pixel < tile_pixels; ++pixel)
+                {
+                    for (int offset{0}; offset < count; ++offset)
+                    {
+                        framebuffer.add_sample(
+                            i_begin + pixel % tile_width,
+                            j_begin + pixel / tile_width,
+                            batch._radiance[static_cast<std::size_t>(
+                                offset * tile_pixels + pixel)]);
+                    }
+                }
+            }
+        }};
+        for_each_tile(render_tile, tiles);
+    }
+
+    // Advances every path in the batch one bounce per iteration.  Paths that
+    // miss, are absorbed or lose at Russian roulette drop out of the queues,
+    // so later bounces only visit live paths.  Each path owns its sampler
+    // and sees the same arithmetic as ray_colour, so its radiance is
+    // identical to the depth-first result.
+    void trace_wavefront(PathBatch &batch,
+                         const Hittable &world,
+                         const MaterialTable &materials) const
+    {
+        RT_COUNT(_primary_rays, batch._active.size());
+        for (int depth{0}; depth < _max_depth && !batch._active.empty();
+             ++depth)
+        {
+            if (depth > 0)
+            {
+                RT_COUNT(_secondary_rays, batch._active.size());
+            }
+            intersect_stage(batch, world);
+            scatter_stage(batch, materials, depth);
+        }
+    }
+
+    // The whole queue goes to the world at once, so hierarchies can trace
+    // neighbouring paths together.  Misses take the background and leave the
+    // wavefront; hits queue for scattering.
+    static void intersect_stage(PathBatch &batch, const Hittable &world)
+    {
+        RT_TIME_STAGE(_intersect_seconds);
+        for (const std::uint32_t slot : batch._active)
+        {
+            batch._closest[slot] = constants::kInfinity;
+        }
+        world.hit_batch(batch._rays,
+                        batch._active,
+                        0.001_r,
+                        batch._closest,
+                        batch._records);
+
+        batch._hits.clear();
+        for (const std::uint32_t slot : batch._active)
+        {
+            if (batch._closest[slot] < constants::kInfinity)
+            {
+                batch._cones[slot].reach(batch._rays[slot],
+                                         batch._records[slot]);
+                batch._hits.push_back(slot);
+            }
+            else
+            {
+                batch._radiance[slot] =
+                    batch._throughput[slot] * background(batch._rays[slot]);
+            }
+        }
+    }
+
+    // Absorbed and culled paths keep zero radiance; survivors queue for the
+    // next bounce.
+    void scatter_stage(PathBatch &batch,
+                       const MaterialTable &materials,
+                       int depth) const
+    {
+        RT_TIME_STAGE(_scatter_seconds);
+        batch._active.clear();
+        for (const std::uint32_t slot : batch._hits)
+        {
+            const HitRecord &record{batch._records[slot]};
+            Ray scattered;
+            Colour attenuation;
+            Sampler &sampler{batch._samplers[slot]};
+            const Material &material{materials[record._material]};
+            if (!material.scatter(batch._rays[slot],
+                                  record,
+                                  attenuation,
+                                  scattered,
+                                  sampler.next_2d()))
+            {
+                continue;
+            }
+            batch._cones[slot].bounce(material);
+            batch._throughput[slot] = batch._throughput[slot] * attenuation;
+            batch._rays[slot] = scattered;
+
+            if (survives_roulette(depth, batch._throughput[slot], sampler))
+            {
+                batch._active.push_back(slot);
+            }
+        }
+    }
+
+    // Adds `count` samples to pixel i,j, continuing its sample sequence from
+    // however many it already holds.
+    void sample_pixel(int i,
+                      int j,
+                      int count,
+                      const Hittable &world,
+                      const MaterialTable &materials,
+                      Framebuffer &framebuffer) const
+    {
+        const auto first{static_cast<int>(framebuffer.samples(i, j))};
+        for (int sample{first}; sample < first + count; ++sample)
+        {
+            Sampler sampler{pixel_sampler(i, j, sample)};
+            const Ray ray{get_ray(i, j, sampler)};
+            framebuffer.add_sample(
+                i, j, ray_colour(ray, world, materials, sampler));
+        }
+    }
+
+    [[nodiscard]] std::size_t pixel_index(int i, int j) const
+    {
+        return static_cast<std::size_t>(j) *
+                   static_cast<std::size_t>(_image_width) +
+               static_cast<std::size_t>(i);
+    }
+
+    [[nodiscard]] Sampler pixel_sampler(int i, int j, int sample) const
+    {
+        // Every pixel sample draws its own points, so the image depends only
+        // on the seed, never on thread count or tile order.
+        return Sampler{_sampler,
+                       _seed,
+                       i,
+                       j,
+                       pixel_index(i, j),
+                       sample,
+                       _stratified_samples > 0 ? _stratified_samples
+                                               : _samples_per_pixel};
+    }
+
+    [[nodiscard]] Ray get_ray(int i, int j, Sampler &sampler) const
+    {
+        // get a randomly sampled camera ray for the pixel at location i,j, originating from the camera defocus disc
+        const Point3 pixel_centre{_pixel00_loc +
+                                  (static_cast<Real>(i) * _pixel_delta_u) +
+                                  (static_cast<Real>(j) * _pixel_delta_v)};
+        const Point3 pixel_sample{pixel_centre +
+                                  pixel_sample_square(sampler.next_2d())};
+
+        // the lens dimension is taken even without defocus, so later
+        // dimensions line up across cameras
+        const Sample2 lens{sampler.next_2d()};
+        const Point3 ray_origin{
+            (_defocus_angle <= 0) ? _centre : defocus_disc_sample(lens)};
         const Vec3 ray_direction{pixel_sample - ray_origin};
 
-        return Ray{ray_origin, ray_direction};
+        // the time is drawn only while the shutter stays open, so renders
+        // without motion blur keep their sample sequences
+        auto time{static_cast<Real>(_shutter_open)};
+        if (_shutter_close > _shutter_open)
+        {
+            time = static_cast<Real>(std::lerp(
+                _shutter_open, _shutter_close, sampler.next_1d()));
+        }
+        return Ray{ray_origin, ray_direction, time};
     }
 
-    [[nodiscard]] Vec3 pixel_sample_square() const
+    [[nodiscard]] Vec3 pixel_sample_square(const Sample2 &sample) const
     {
-        // returns a random point in the square surrounding a pixel at the origin
-        const double px{-0.5 + random_double()};
-        const double py{-0.5 + random_double()};
+        // returns a point in the square surrounding a pixel at the origin
+        const auto px{static_cast<Real>(-0.5 + sample[0])};
+        const auto py{static_cast<Real>(-0.5 + sample[1])};
         return {(px * _pixel_delta_u) + (py * _pixel_delta_v)};
     }
 
-    Point3 defocus_disc_sample() const
+    [[nodiscard]] Point3 defocus_disc_sample(const Sample2 &sample) const
     {
-        // Returns a random point in the camera defocus disc.
-        Point3 point{random_in_unit_disc()};
+        // Returns a point in the camera defocus disc.
+        const Point3 point{concentric_disc(sample)};
 
-        return _centre +
-               (point[0] * _defocus_disc_u) * (point[1] * _defocus_disc_v);
+        return _centre + (point[0] * _defocus_disc_u) +
+               (point[1] * _defocus_disc_v);
     }
 
-    [[nodiscard]] Colour ray_colour(const Ray &ray,
-                                    int depth,
-                                    const Hittable &world) const
+    // Traces one path iteratively, carrying the product of attenuations
+    // (throughput) forward instead of multiplying on the way back out of a
+    // recursion.
+    [[nodiscard]] Colour ray_colour(const Ray &camera_ray,
+                                    const Hittable &world,
+                                    const MaterialTable &materials,
+                                    Sampler &sampler) const
     {
-        // If we have exceeded the ray bounce limit, we stop gathering light
-        if (depth <= 0)
+        Ray ray{camera_ray};
+        Colour throughput{1.0, 1.0, 1.0};
+        RayCone cone{0, _pixel_spread};
+
+        // If we exceed the ray bounce limit, we stop gathering light
+        RT_COUNT(_primary_rays, 1U);
+        for (int depth{0}; depth < _max_depth; ++depth)
         {
-            return Colour{0.0, 0.0, 0.0};
+            if (depth > 0)
+            {
+                RT_COUNT(_secondary_rays, 1U);
+            }
+            HitRecord record;
+            if (!world.hit(
+                    ray, Interval(0.001_r, constants::kInfinity), record))
+            {
+                return throughput * background(ray);
+            }
+            cone.reach(ray, record);
+
+            Ray scattered;
+            Colour attenuation;
+            const Material &material{materials[record._material]};
+            if (!material.scatter(
+                    ray, record, attenuation, scattered, sampler.next_2d()))
+            {
+                return Colour{0.0, 0.0, 0.0};
+            }
+            cone.bounce(material);
+            throughput = throughput * attenuation;
+            ray = scattered;
+
+            if (!survives_roulette(depth, throughput, sampler))
+            {
+                return Colour{0.0, 0.0, 0.0};
+            }
         }
 
-        HitRecord record;
+        return Colour{0.0, 0.0, 0.0};
+    }
 
-        if (world.hit(ray, Interval(0.001, constants::kInfinity), record))
+    // The features of the surface seen along `camera_ray`; see
+    // render_features.  Rays that escape take the background as albedo, a
+    // normal facing back along the ray and a depth far beyond the scene.
+    [[nodiscard]] FirstSurface first_surface(const Ray &camera_ray,
+                                             const Hittable &world,
+                                             const MaterialTable &materials,
+                                             Sampler &sampler) const
+    {
+        Ray ray{camera_ray};
+        Colour tint{1.0, 1.0, 1.0};
+        double distance{0.0};
+        RayCone cone{0, _pixel_spread};
+        for (int bounce{0}; bounce < kFeatureBounces; ++bounce)
         {
+            HitRecord record;
+            if (!world.hit(
+                    ray, Interval(0.001_r, constants::kInfinity), record))
+            {
+                break;
+            }
+            distance += static_cast<double>(record._t_interval) *
+                        static_cast<double>(ray.direction().length());
+            cone.reach(ray, record);
+            const Material &material{materials[record._material]};
             Ray scattered;
             Colour attenuation;
-            if (record._material->scatter(ray, record, attenuation, scattered))
+            if (!material.is_specular() || bounce + 1 == kFeatureBounces ||
+                !material.scatter(
+                    ray, record, attenuation, scattered, sampler.next_2d()))
             {
-                return attenuation * ray_colour(scattered, depth - 1, world);
+                return {tint * material.albedo(record),
+                        record._normal,
+                        distance};
             }
-            return Colour{
-                0.0,
-                0.0,
-                0.0,
-            };
+            tint = tint * attenuation;
+            ray = scattered;
+        }
+        return {tint * background(ray),
+                -unit_vector(ray.direction()),
+                distance + kBackgroundDepth};
+    }
+
+    // After _russian_roulette_depth bounces a path survives each further
+    // bounce with probability tied to its throughput, and survivors are
+    // reweighted by the inverse of that probability, which keeps the estimate
+    // unbiased while ending dim paths early.
+    bool survives_roulette(int depth,
+                           Colour &throughput,
+                           Sampler &sampler) const
+    {
+        if (_russian_roulette_depth <= 0 || depth + 1 < _russian_roulette_depth)
+        {
+            return true;
         }
 
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        constexpr double kMaxSurvival{0.95};
+        const Real brightest{std::fmax(
+            throughput.x(), std::fmax(throughput.y(), throughput.z()))};
+        const double survival{fmin(brightest, kMaxSurvival)};
+        if (sampler.next_1d() >= survival)
+        {
+            return false;
+        }
+        throughput /= static_cast<Real>(survival);
+        return true;
+    }
+
+    [[nodiscard]] static Colour background(const Ray &ray)
+    {
         const Vec3 unit_direction{unit_vector(ray.direction())};
         // NOLINTNEXTLINE(readability-magic-numbers)
-        auto a_value(0.5 * (unit_direction.y() + 1.0));
+        auto a_value(0.5_r * (unit_direction.y() + 1));
 
-        return (1.0 - a_value) * Colour{1.0, 1.0, 1.0} +
+        return (1 - a_value) * Colour{1, 1, 1} +
                // NOLINTNEXTLINE(readability-magic-numbers)
-               a_value * Colour{0.5, 0.7, 1.0};
+               a_value * Colour{0.5_r, 0.7_r, 1};
     }
 };
 
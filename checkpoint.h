@@ -0,0 +1,268 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "framebuffer.h"
+#include "mapped_file.h"
+#include "sampler.h"
+#include "scene.h"
+#include "scene_file.h"
+#include "utility.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+// A checkpoint holds a render in progress: every pixel's accumulated sum,
+// squared luminance and sample count.  Pixel samples draw points that depend
+// only on the seed, pixel and sample index, so the sample counts are all the
+// random number state a resumed render needs to carry on exactly where it
+// stopped.
+//
+// The file is a fixed header, then the sums as three doubles per pixel, the
+// squared luminances, and the sample counts, each row-major.  The header
+// records what the samples depend on, the seed, the sampler, the Russian
+// roulette depth and a fingerprint of the scene, so a checkpoint is only
+// resumed by the render that wrote it; the samples per pixel may differ, so
+// a finished render can be resumed with more.  It also records the sample
+// count the stratified sampler's pattern was laid out for when the render
+// began, which a resumed render keeps, so its extra samples do not come
+// from a pattern for another count.  Like binary scene files, checkpoints
+// use the writing machine's byte order.
+namespace checkpoint_detail
+{
+constexpr std::array<char, 8> kMagic{'R', 'T', 'C', 'H', 'E', 'C', 'K', '3'};
+
+struct Header
+{
+    std::array<char, 8> _magic;
+    std::int64_t _width;
+    std::int64_t _height;
+    std::uint64_t _real_bytes; // sizeof(Real) in the writing build
+    std::uint64_t _seed;
+    std::int64_t _russian_roulette_depth;
+    std::uint64_t _scene_fingerprint;
+    std::uint64_t _sampler;            // SamplerKind
+    std::int64_t _stratified_samples; // Camera::_stratified_samples
+};
+
+static_assert(std::is_trivially_copyable_v<Header> &&
+              sizeof(Header) % 8 == 0);
+
+inline std::size_t file_size(std::size_t pixels)
+{
+    const std::size_t count_bytes{pixels * sizeof(std::uint32_t)};
+    return sizeof(Header) + pixels * 4 * sizeof(double) + count_bytes;
+}
+} // namespace checkpoint_detail
+
+// What a checkpoint's samples depend on, other than the sample counts.
+struct CheckpointInfo
+{
+    int _width{0};
+    int _height{0};
+    std::uint64_t _seed{0};
+    int _russian_roulette_depth{0};
+    std::uint64_t _scene_fingerprint{0};
+    SamplerKind _sampler{SamplerKind::kIndependent};
+    int _stratified_samples{1}; // taken from the checkpoint when resuming
+};
+
+// FNV-1a hash of the scene's binary form with its samples per pixel left
+// out.
+inline std::uint64_t scene_fingerprint(const Scene &scene)
+{
+    std::ostringstream output;
+    write_scene_binary(output, scene);
+    std::string bytes{output.str()};
+    std::memset(
+        bytes.data() + offsetof(scene_file_detail::Header, _samples_per_pixel),
+        0,
+        sizeof(scene_file_detail::Header::_samples_per_pixel));
+
+    // NOLINTBEGIN(readability-magic-numbers)
+    std::uint64_t hash{0xcbf29ce484222325ULL};
+    for (const char byte : bytes)
+    {
+        hash ^= static_cast<unsigned char>(byte);
+        hash *= 0x100000001b3ULL;
+    }
+    // NOLINTEND(readability-magic-numbers)
+    return hash;
+}
+
+inline CheckpointInfo checkpoint_info(const Scene &scene)
+{
+    const Camera &camera{scene._camera};
+    return {camera._image_width,
+            camera.image_height(),
+            camera._seed,
+            camera._russian_roulette_depth,
+            scene_fingerprint(scene),
+            camera._sampler,
+            camera._stratified_samples > 0 ? camera._stratified_samples
+                                           : camera._samples_per_pixel};
+}
+
+// Writes the framebuffer through a mapping of `path`.tmp, then renames it
+// over `path`, so an interruption leaves the previous checkpoint intact.
+inline bool save_checkpoint(const std::string &path,
+                            const Framebuffer &framebuffer,
+                            const CheckpointInfo &info,
+                            std::string &error)
+{
+    using namespace checkpoint_detail;
+
+    const std::size_t pixels{static_cast<std::size_t>(framebuffer.width()) *
+                             static_cast<std::size_t>(framebuffer.height())};
+    const std::string temporary_path{path + ".tmp"};
+    {
+        const MappedOutputFile file{temporary_path, file_size(pixels)};
+        if (!file.is_open())
+        {
+            error = "cannot create " + temporary_path;
+            return false;
+        }
+
+        const Header header{kMagic,
+                            framebuffer.width(),
+                            framebuffer.height(),
+                            sizeof(Real),
+                            info._seed,
+                            info._russian_roulette_depth,
+                            info._scene_fingerprint,
+                            static_cast<std::uint64_t>(info._sampler),
+                            info._stratified_samples};
+        std::byte *output{file.bytes().data()};
+        std::memcpy(output, &header, sizeof(header));
+        std::byte *sums{output + sizeof(Header)};
+        std::byte *luminance_squares{sums + pixels * 3 * sizeof(double)};
+        std::byte *counts{luminance_squares + pixels * sizeof(double)};
+
+        std::size_t pixel{0};
+        for (int j{0}; j < framebuffer.height(); ++j)
+        {
+            for (int i{0}; i < framebuffer.width(); ++i, ++pixel)
+            {
+                const Colour &sum{framebuffer.at(i, j)};
+                const std::array<double, 3> values{sum.x(), sum.y(), sum.z()};
+                const double luminance_square{
+                    framebuffer.luminance_square(i, j)};
+                const std::uint32_t count{framebuffer.samples(i, j)};
+                std::memcpy(sums + pixel * sizeof(values),
+                            values.data(),
+                            sizeof(values));
+                std::memcpy(luminance_squares + pixel * sizeof(double),
+                            &luminance_square,
+                            sizeof(double));
+                std::memcpy(counts + pixel * sizeof(count),
+                            &count,
+                            sizeof(count));
+            }
+        }
+        if (!file.sync())
+        {
+            error = "cannot write " + temporary_path;
+            return false;
+        }
+    }
+
+    if (std::rename(temporary_path.c_str(), path.c_str()) != 0)
+    {
+        error = "cannot replace " + path;
+        return false;
+    }
+    return true;
+}
+
+// Loads a checkpoint written for a render matching `expected`, whose
+// _stratified_samples becomes the checkpoint's, for the resumed render to
+// use.  On failure returns nothing and describes the problem in `error`.
+inline std::optional<Framebuffer>
+load_checkpoint(const std::string &path,
+                CheckpointInfo &expected,
+                std::string &error)
+{
+    using namespace checkpoint_detail;
+
+    const MappedFile file{path};
+    if (!file.is_open())
+    {
+        error = "cannot open " + path;
+        return std::nullopt;
+    }
+    const std::span<const std::byte> bytes{file.bytes()};
+    Header header{};
+    if (bytes.size() >= sizeof(Header))
+    {
+        std::memcpy(&header, bytes.data(), sizeof(Header));
+    }
+    if (header._magic != kMagic)
+    {
+        error = path + ": not a checkpoint";
+        return std::nullopt;
+    }
+    if (header._width != expected._width ||
+        header._height != expected._height ||
+        header._real_bytes != sizeof(Real) || header._seed != expected._seed ||
+        header._russian_roulette_depth != expected._russian_roulette_depth ||
+        header._scene_fingerprint != expected._scene_fingerprint ||
+        header._sampler != static_cast<std::uint64_t>(expected._sampler))
+    {
+        error = path + ": written for a different scene, image size, seed, "
+                       "sampler, roulette depth or build";
+        return std::nullopt;
+    }
+    const std::size_t pixels{static_cast<std::size_t>(expected._width) *
+                             static_cast<std::size_t>(expected._height)};
+    if (bytes.size() != file_size(pixels))
+    {
+        error = path + ": truncated";
+        return std::nullopt;
+    }
+    if (header._stratified_samples <= 0 ||
+        header._stratified_samples > std::numeric_limits<int>::max())
+    {
+        error = path + ": bad stratified sample count";
+        return std::nullopt;
+    }
+    expected._stratified_samples = static_cast<int>(header._stratified_samples);
+
+    const std::byte *sums{bytes.data() + sizeof(Header)};
+    const std::byte *luminance_squares{sums + pixels * 3 * sizeof(double)};
+    const std::byte *counts{luminance_squares + pixels * sizeof(double)};
+    Framebuffer framebuffer{expected._width, expected._height};
+    std::size_t pixel{0};
+    for (int j{0}; j < expected._height; ++j)
+    {
+        for (int i{0}; i < expected._width; ++i, ++pixel)
+        {
+            std::array<double, 3> values{};
+            double luminance_square{0.0};
+            std::uint32_t count{0};
+            std::memcpy(
+                values.data(), sums + pixel * sizeof(values), sizeof(values));
+            std::memcpy(&luminance_square,
+                        luminance_squares + pixel * sizeof(double),
+                        sizeof(double));
+            std::memcpy(&count, counts + pixel * sizeof(count), sizeof(count));
+            framebuffer.set_pixel(i,
+                                  j,
+                                  Colour{static_cast<Real>(values[0]),
+                                         static_cast<Real>(values[1]),
+                                         static_cast<Real>(values[2])},
+                                  luminance_square,
+                                  count);
+        }
+    }
+    return framebuffer;
+}
+
+#endif
@@ -9,6 +9,13 @@
 
 using Colour = Vec3;
 
+inline double luminance(const Colour &colour)
+{
+    // relative luminance of a linear Rec. 709 colour
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    return 0.2126 * colour.x() + 0.7152 * colour.y() + 0.0722 * colour.z();
+}
+
 inline double linear_to_gamma(double linear_component)
 {
     return sqrt(linear_component);
@@ -29,7 +36,7 @@ void write_colour(std::ostream &out, Colour pixel_colour, int samples_per_pixel)
     g = linear_to_gamma(g);
     b = linear_to_gamma(b);
 
-    static const Interval intensity{0.000, 0.999};
+    static const BasicInterval<double> intensity{0.000, 0.999};
     constexpr int kMaxIntensity{256};
     out << static_cast<int>(kMaxIntensity * intensity.clamp(r)) << ' '
         << static_cast<int>(kMaxIntensity * intensity.clamp(g)) << ' '
@@ -0,0 +1,206 @@
+// Measures how quickly each sampler converges: renders a scene with every
+// sampler at doubling samples per pixel and reports the RMSE of each image
+// against a reference rendered with many more samples.  With --denoise the
+// images are denoised before they are measured.
+
+#include "camera.h"
+#include "denoise.h"
+#include "framebuffer.h"
+#include "image_writer.h"
+#include "sampler.h"
+#include "scene.h"
+#include "scene_file.h"
+#include "scenes.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr std::array<SamplerKind, 4> kSamplers{SamplerKind::kIndependent,
+                                               SamplerKind::kStratified,
+                                               SamplerKind::kSobol,
+                                               SamplerKind::kBlueNoise};
+
+bool parse_number(std::string_view text, int &value)
+{
+    const char *end{text.data() + text.size()};
+    const auto [pointer, error]{std::from_chars(text.data(), end, value)};
+    return error == std::errc{} && pointer == end && value > 0;
+}
+
+// Errors are measured on pixel means clamped to [0, 1], as image_diff does,
+// so a few bright outliers do not dominate.
+double rmse(const Framebuffer &reference, const Framebuffer &test)
+{
+    using image_writer_detail::pixel_mean;
+
+    double squared_sum{0.0};
+    for (int j{0}; j < reference.height(); ++j)
+    {
+        for (int i{0}; i < reference.width(); ++i)
+        {
+            const Colour expected{pixel_mean(reference, i, j)};
+            const Colour actual{pixel_mean(test, i, j)};
+            for (int axis{0}; axis < 3; ++axis)
+            {
+                const auto clamped{[axis](const Colour &colour) {
+                    return std::clamp(
+                        static_cast<double>(colour[axis]), 0.0, 1.0);
+                }};
+                const double difference{clamped(actual) - clamped(expected)};
+                squared_sum += difference * difference;
+            }
+        }
+    }
+    const double count{static_cast<double>(reference.width()) *
+                       static_cast<double>(reference.height()) * 3.0};
+    return std::sqrt(squared_sum / count);
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const std::span<char *> arguments{argv, static_cast<std::size_t>(argc)};
+    // NOLINTBEGIN(readability-magic-numbers)
+    int width{96};
+    int max_samples{64};
+    int reference_samples{4096};
+    // NOLINTEND(readability-magic-numbers)
+    unsigned int threads{std::max(std::thread::hardware_concurrency(), 1U)};
+    std::string scene_path;
+    bool denoise_images{false};
+    for (std::size_t index{1}; index < arguments.size(); ++index)
+    {
+        const std::string_view argument{arguments[index]};
+        const bool has_value{index + 1 < arguments.size()};
+        int threads_value{0};
+        if (argument == "--width" && has_value &&
+            parse_number(arguments[index + 1], width))
+        {
+            ++index;
+        }
+        else if (argument == "--max-spp" && has_value &&
+                 parse_number(arguments[index + 1], max_samples))
+        {
+            ++index;
+        }
+        else if (argument == "--reference-spp" && has_value &&
+                 parse_number(arguments[index + 1], reference_samples))
+        {
+            ++index;
+        }
+        else if (argument == "--threads" && has_value &&
+                 parse_number(arguments[index + 1], threads_value))
+        {
+            threads = static_cast<unsigned int>(threads_value);
+            ++index;
+        }
+        else if (argument == "--denoise")
+        {
+            denoise_images = true;
+        }
+        else if (argument == "--scene" && has_value)
+        {
+            scene_path = arguments[++index];
+        }
+        else
+        {
+            std::cerr << "Usage: " << arguments[0]
+                      << " [--width N] [--max-spp N] [--reference-spp N]"
+                         " [--threads N] [--scene FILE] [--denoise]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::optional<Scene> scene;
+    if (scene_path.empty())
+    {
+        scene = random_spheres_scene();
+    }
+    else
+    {
+        std::string error;
+        scene = load_scene(scene_path, error);
+        if (!scene)
+        {
+            std::cerr << error << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+    if (scene->_spheres.hierarchy().nodes().empty())
+    {
+        scene->_spheres.build_hierarchy();
+    }
+
+    Camera &camera{scene->_camera};
+    camera._image_width = width;
+    camera._threads = threads;
+
+    // the reference uses its own seed, so its remaining error is independent
+    // of every test image's
+    const auto start{std::chrono::steady_clock::now()};
+    camera._sampler = SamplerKind::kSobol;
+    camera._samples_per_pixel = reference_samples;
+    camera._seed = 1;
+    const Framebuffer reference{
+        camera.render(scene->_spheres, scene->_materials)};
+    std::cout << "Reference: " << reference_samples << " spp in "
+              << std::fixed << std::setprecision(1)
+              << std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count()
+              << " s\n";
+
+    camera._seed = 0;
+    double denoise_seconds{0.0};
+    std::cout << std::setw(6) << "spp";
+    for (const SamplerKind sampler : kSamplers)
+    {
+        std::cout << std::setw(13) << sampler_name(sampler);
+    }
+    std::cout << '\n' << std::fixed << std::setprecision(5);
+    for (int samples{1}; samples <= max_samples; samples *= 2)
+    {
+        camera._samples_per_pixel = samples;
+        std::cout << std::setw(6) << samples;
+        for (const SamplerKind sampler : kSamplers)
+        {
+            camera._sampler = sampler;
+            Framebuffer image{
+                camera.render(scene->_spheres, scene->_materials)};
+            if (denoise_images)
+            {
+                const FeatureBuffer features{camera.render_features(
+                    scene->_spheres, scene->_materials)};
+                const auto filter_start{std::chrono::steady_clock::now()};
+                image = denoise(image, features, threads);
+                denoise_seconds += std::chrono::duration<double>(
+                                       std::chrono::steady_clock::now() -
+                                       filter_start)
+                                       .count();
+            }
+            std::cout << std::setw(13) << rmse(reference, image);
+        }
+        std::cout << std::endl;
+    }
+    if (denoise_images)
+    {
+        std::cout << "Denoise time: " << std::setprecision(3)
+                  << denoise_seconds << " s in total\n";
+    }
+}
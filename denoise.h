@@ -0,0 +1,254 @@
+#ifndef DENOISE_H
+#define DENOISE_H
+
+#include "colour.h"
+#include "feature_buffer.h"
+#include "framebuffer.h"
+#include "thread_pool.h"
+#include "utility.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Edge-avoiding a-trous wavelet denoiser (Dammertz et al., "Edge-Avoiding
+// A-Trous Wavelet Transform for fast Global Illumination Filtering", 2010).
+// Each pass blurs with a 5x5 B3 spline kernel whose taps lie 2^pass pixels
+// apart, so four passes cover 61x61 pixels at 25 taps a pixel each, and
+// every tap is weighted down where the features show an edge between it and
+// the pixel: a different normal, depth or albedo, or a luminance further
+// from the pixel's than its estimated noise explains (Schied et al.,
+// "Spatiotemporal Variance-Guided Filtering", 2017).  The filter works on
+// the image divided by the albedo, so textures the features capture are not
+// blurred, and multiplies the albedo back in afterwards.
+//
+// The weights are looser than SVGF's, which filters far more pixels per
+// feature: at the widths rendered here a small sphere spans a few pixels,
+// and cos^128 normal weights would leave its noise untouched.
+namespace denoise_detail
+{
+// NOLINTBEGIN(readability-magic-numbers)
+constexpr int kPasses{4};
+constexpr int kRadius{2}; // taps either side of the pixel
+// B3 spline weights by distance from the pixel, in taps
+constexpr std::array<double, 3> kKernel{3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0};
+constexpr double kLuminanceSigma{2.0}; // in standard deviations
+constexpr int kNormalSquarings{3};     // normal weight is cos^8
+constexpr double kDepthSigma{0.05};    // relative change per pixel
+constexpr double kAlbedoSigma{0.3};
+constexpr Real kMinAlbedo{0.01_r}; // keep dark albedos from amplifying noise
+constexpr double kTiny{1e-10};
+// NOLINTEND(readability-magic-numbers)
+
+inline Colour floored(const Colour &albedo)
+{
+    return {std::max(albedo.x(), kMinAlbedo),
+            std::max(albedo.y(), kMinAlbedo),
+            std::max(albedo.z(), kMinAlbedo)};
+}
+
+inline double normal_weight(const Vec3 &normal, const Vec3 &other)
+{
+    double weight{std::max(0.0, static_cast<double>(dot(normal, other)))};
+    for (int squaring{0}; squaring < kNormalSquarings; ++squaring)
+    {
+        weight *= weight;
+    }
+    return weight;
+}
+
+// The filtered image and the variance of each pixel's luminance in it,
+// both divided by the albedo.
+struct Layer
+{
+    std::vector<Colour> _colour;
+    std::vector<double> _variance;
+};
+} // namespace denoise_detail
+
+// Returns the denoised image of `framebuffer`, whose pixels `features`
+// describes, as a framebuffer of one sample per pixel, spreading rows across
+// `threads` threads.
+inline Framebuffer denoise(const Framebuffer &framebuffer,
+                           const FeatureBuffer &features,
+                           unsigned int threads)
+{
+    using namespace denoise_detail;
+
+    const int width{framebuffer.width()};
+    const int height{framebuffer.height()};
+    const auto index{[width](int i, int j) {
+        return static_cast<std::size_t>(j) * static_cast<std::size_t>(width) +
+               static_cast<std::size_t>(i);
+    }};
+    const std::size_t pixels{static_cast<std::size_t>(width) *
+                             static_cast<std::size_t>(height)};
+
+    std::optional<ThreadPool> pool;
+    if (threads > 1)
+    {
+        pool.emplace(threads);
+    }
+    const auto for_each_row{[&](const std::function<void(int)> &row) {
+        if (pool)
+        {
+            pool->parallel_for(static_cast<std::size_t>(height),
+                               [&row](std::size_t j) {
+                                   row(static_cast<int>(j));
+                               });
+            return;
+        }
+        for (int j{0}; j < height; ++j)
+        {
+            row(j);
+        }
+    }};
+
+    Layer layer{std::vector<Colour>(pixels), std::vector<double>(pixels)};
+    for_each_row([&](int j) {
+        for (int i{0}; i < width; ++i)
+        {
+            const std::size_t pixel{index(i, j)};
+            const std::uint32_t samples{framebuffer.samples(i, j)};
+            const Colour mean{samples > 0 ? framebuffer.at(i, j) /
+                                                static_cast<Real>(samples)
+                                          : Colour{0.0, 0.0, 0.0}};
+            const Colour albedo{floored(features.albedo(i, j))};
+            layer._colour[pixel] = {mean.x() / albedo.x(),
+                                    mean.y() / albedo.y(),
+                                    mean.z() / albedo.z()};
+            // the variance of the mean; with one sample, assume an error as
+            // large as the pixel
+            double variance{framebuffer.luminance_variance(i, j) / samples};
+            if (!std::isfinite(variance))
+            {
+                variance = luminance(mean) * luminance(mean);
+            }
+            const double albedo_luminance{luminance(albedo)};
+            layer._variance[pixel] =
+                variance / (albedo_luminance * albedo_luminance);
+        }
+    });
+
+    Layer next{std::vector<Colour>(pixels), std::vector<double>(pixels)};
+    std::vector<double> blurred_variance(pixels);
+    for (int pass{0}; pass < kPasses; ++pass)
+    {
+        const int step{1 << pass};
+
+        // the luminance weight uses a 3x3 blur of the variance, as a single
+        // pixel's estimate is itself noisy
+        for_each_row([&](int j) {
+            for (int i{0}; i < width; ++i)
+            {
+                double sum{0.0};
+                double weight_sum{0.0};
+                for (int dy{-1}; dy <= 1; ++dy)
+                {
+                    for (int dx{-1}; dx <= 1; ++dx)
+                    {
+                        const int x{i + dx};
+                        const int y{j + dy};
+                        if (x < 0 || x >= width || y < 0 || y >= height)
+                        {
+                            continue;
+                        }
+                        const double weight{
+                            kKernel[static_cast<std::size_t>(std::abs(dx))] *
+                            kKernel[static_cast<std::size_t>(std::abs(dy))]};
+                        sum += weight * layer._variance[index(x, y)];
+                        weight_sum += weight;
+                    }
+                }
+                blurred_variance[index(i, j)] = sum / weight_sum;
+            }
+        });
+
+        for_each_row([&](int j) {
+            for (int i{0}; i < width; ++i)
+            {
+                const std::size_t pixel{index(i, j)};
+                const double pixel_luminance{luminance(layer._colour[pixel])};
+                const double luminance_scale{
+                    kLuminanceSigma * std::sqrt(blurred_variance[pixel]) +
+                    kTiny};
+                const Vec3 &normal{features.normal(i, j)};
+                const double depth{features.depth(i, j)};
+                const double depth_scale{kDepthSigma * step * depth + kTiny};
+                const Colour &albedo{features.albedo(i, j)};
+
+                Colour sum{0.0, 0.0, 0.0};
+                double weight_sum{0.0};
+                double variance_sum{0.0};
+                for (int dy{-kRadius}; dy <= kRadius; ++dy)
+                {
+                    const int y{j + dy * step};
+                    if (y < 0 || y >= height)
+                    {
+                        continue;
+                    }
+                    for (int dx{-kRadius}; dx <= kRadius; ++dx)
+                    {
+                        const int x{i + dx * step};
+                        if (x < 0 || x >= width)
+                        {
+                            continue;
+                        }
+                        const std::size_t tap{index(x, y)};
+                        double weight{
+                            kKernel[static_cast<std::size_t>(std::abs(dx))] *
+                            kKernel[static_cast<std::size_t>(std::abs(dy))]};
+                        if (tap != pixel)
+                        {
+                            const Colour albedo_change{features.albedo(x, y) -
+                                                       albedo};
+                            const double exponent{
+                                std::fabs(pixel_luminance -
+                                          luminance(layer._colour[tap])) /
+                                    luminance_scale +
+                                std::fabs(depth - features.depth(x, y)) /
+                                    (depth_scale *
+                                     (std::abs(dx) + std::abs(dy))) +
+                                albedo_change.length_squared() /
+                                    (kAlbedoSigma * kAlbedoSigma)};
+                            weight *= std::exp(-exponent) *
+                                      normal_weight(normal,
+                                                    features.normal(x, y));
+                        }
+                        sum += static_cast<Real>(weight) * layer._colour[tap];
+                        weight_sum += weight;
+                        variance_sum += weight * weight * layer._variance[tap];
+                    }
+                }
+                next._colour[pixel] = sum / static_cast<Real>(weight_sum);
+                next._variance[pixel] =
+                    variance_sum / (weight_sum * weight_sum);
+            }
+        });
+        std::swap(layer, next);
+    }
+
+    Framebuffer result{width, height};
+    for (int j{0}; j < height; ++j)
+    {
+        for (int i{0}; i < width; ++i)
+        {
+            const Colour colour{layer._colour[index(i, j)] *
+                                floored(features.albedo(i, j))};
+            const double colour_luminance{luminance(colour)};
+            result.set_pixel(
+                i, j, colour, colour_luminance * colour_luminance, 1);
+        }
+    }
+    return result;
+}
+
+#endif
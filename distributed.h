@@ -0,0 +1,856 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include "camera.h"
+#include "framebuffer.h"
+#include "scene.h"
+#include "scene_file.h"
+#include "utility.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// Renders one frame across several processes, possibly on other machines.
+//
+// The coordinator listens on a TCP port.  Each worker connects and says how
+// many threads it has; the coordinator replies with the scene in binary form
+// and the camera settings the scene file does not hold, then hands out jobs,
+// each a list of tile numbers.  The worker renders those tiles with
+// Camera::render_tiles and sends back every pixel's accumulated sum, sample
+// count and squared luminance, which the coordinator copies into its
+// framebuffer.  A pixel is always rendered whole by one process, in the same
+// sample order as a single-process render, so the merged image is
+// bit-identical to one.  If a worker disconnects or dies, the tiles of its
+// job go back on the queue for the others.
+//
+// Messages are a fixed header followed by a payload, in the machine's own
+// byte order; like binary scene files, the protocol is meant for machines of
+// one kind, and workers must be built with the coordinator's Real.
+namespace distributed_detail
+{
+// NOLINTNEXTLINE(readability-magic-numbers)
+constexpr std::array<char, 8> kMagic{'R', 'T', 'W', 'O', 'R', 'K', 'R', '1'};
+
+enum class MessageType : std::uint32_t
+{
+    kHello,  // worker to coordinator: HelloRecord
+    kScene,  // coordinator to worker: SettingsRecord, then a binary scene
+    kJob,    // coordinator to worker: tile numbers as std::uint64_t
+    kResult, // worker to coordinator: PixelRecords of the job's tiles
+    kDone    // coordinator to worker: no payload
+};
+
+struct MessageHeader
+{
+    MessageType _type;
+    std::uint32_t _reserved;
+    std::uint64_t _size; // payload bytes
+};
+
+struct HelloRecord
+{
+    std::array<char, 8> _magic;
+    std::uint32_t _real_bytes; // sizeof(Real) in the worker's build
+    std::uint32_t _threads;
+};
+
+struct SettingsRecord
+{
+    std::uint64_t _seed;
+    std::int32_t _russian_roulette_depth;
+    std::int32_t _tile_size;
+    std::uint32_t _wavefront;
+    SamplerKind _sampler;
+};
+
+// One pixel of a result; a job's pixels are sent tile by tile, each tile row
+// by row.
+struct PixelRecord
+{
+    double _luminance_square;
+    std::array<Real, 3> _sum;
+    std::uint32_t _samples;
+};
+
+static_assert(std::is_trivially_copyable_v<MessageHeader> &&
+              std::is_trivially_copyable_v<HelloRecord> &&
+              std::is_trivially_copyable_v<SettingsRecord> &&
+              std::is_trivially_copyable_v<PixelRecord>);
+
+// Bytes held in a message payload, decoded with memcpy since the buffer
+// carries no alignment guarantee.
+template <typename T>
+T read_record(std::span<const std::byte> bytes, std::size_t offset = 0)
+{
+    T record{};
+    std::memcpy(&record, bytes.data() + offset, sizeof(T));
+    return record;
+}
+
+// Owns a connected or listening socket.
+class Socket
+{
+public:
+    Socket() = default;
+
+    explicit Socket(int descriptor) : _descriptor(descriptor)
+    {
+    }
+
+    Socket(const Socket &) = delete;
+    Socket &operator=(const Socket &) = delete;
+
+    Socket(Socket &&other) noexcept
+        : _descriptor(std::exchange(other._descriptor, -1))
+    {
+    }
+
+    Socket &operator=(Socket &&other) noexcept
+    {
+        std::swap(_descriptor, other._descriptor);
+        return *this;
+    }
+
+    ~Socket()
+    {
+        if (_descriptor >= 0)
+        {
+            ::close(_descriptor);
+        }
+    }
+
+    [[nodiscard]] int descriptor() const
+    {
+        return _descriptor;
+    }
+
+    [[nodiscard]] bool is_open() const
+    {
+        return _descriptor >= 0;
+    }
+
+    // Small messages go out at once rather than waiting to be coalesced.
+    void disable_delay() const
+    {
+        const int enable{1};
+        ::setsockopt(
+            _descriptor, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    }
+
+    // A send that makes no progress for `timeout` fails instead of waiting
+    // on a peer that has stopped reading.
+    void set_send_timeout(std::chrono::duration<double> timeout) const
+    {
+        const auto microseconds{
+            std::chrono::ceil<std::chrono::microseconds>(timeout).count()};
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        constexpr std::int64_t kPerSecond{1000000};
+        timeval limit{};
+        limit.tv_sec = static_cast<time_t>(microseconds / kPerSecond);
+        limit.tv_usec = static_cast<suseconds_t>(microseconds % kPerSecond);
+        ::setsockopt(
+            _descriptor, SOL_SOCKET, SO_SNDTIMEO, &limit, sizeof(limit));
+    }
+
+    // Sends or receives exactly bytes.size() bytes; false if the peer has
+    // gone away.
+    [[nodiscard]] bool send_all(std::span<const std::byte> bytes) const
+    {
+        while (!bytes.empty())
+        {
+            const ssize_t sent{
+                ::send(_descriptor, bytes.data(), bytes.size(), MSG_NOSIGNAL)};
+            if (sent < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (sent <= 0)
+            {
+                return false;
+            }
+            bytes = bytes.subspan(static_cast<std::size_t>(sent));
+        }
+        return true;
+    }
+
+    [[nodiscard]] bool receive_all(std::span<std::byte> bytes) const
+    {
+        while (!bytes.empty())
+        {
+            const ssize_t received{
+                ::recv(_descriptor, bytes.data(), bytes.size(), 0)};
+            if (received < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (received <= 0)
+            {
+                return false;
+            }
+            bytes = bytes.subspan(static_cast<std::size_t>(received));
+        }
+        return true;
+    }
+
+    [[nodiscard]] bool send_message(MessageType type,
+                                    std::span<const std::byte> payload) const
+    {
+        const MessageHeader header{type, 0, payload.size()};
+        return send_all(std::as_bytes(std::span{&header, 1})) &&
+               send_all(payload);
+    }
+
+    // Receives a message whose payload is at most max_size bytes.
+    [[nodiscard]] bool receive_message(MessageType &type,
+                                       std::vector<std::byte> &payload,
+                                       std::size_t max_size) const
+    {
+        MessageHeader header{};
+        if (!receive_all(std::as_writable_bytes(std::span{&header, 1})) ||
+            header._size > max_size)
+        {
+            return false;
+        }
+        type = header._type;
+        payload.resize(header._size);
+        return receive_all(payload);
+    }
+
+private:
+    int _descriptor{-1};
+};
+
+// Largest payload either side accepts, so a corrupt header cannot ask for an
+// absurd allocation.
+// NOLINTNEXTLINE(readability-magic-numbers)
+constexpr std::size_t kMaxPayload{std::size_t{1} << 32U};
+
+// A message assembled from whatever has arrived each time its socket is
+// readable, so waiting for the rest of one worker's message never holds up
+// the others.
+class MessageReader
+{
+public:
+    // Reads what the socket holds, up to the end of the message, without
+    // waiting for more.  False if the peer has gone away or announced a
+    // payload over max_size bytes.
+    [[nodiscard]] bool read_available(const Socket &socket,
+                                      std::size_t max_size)
+    {
+        while (!complete())
+        {
+            const std::span<std::byte> target{
+                _received < sizeof(MessageHeader)
+                    ? std::as_writable_bytes(std::span{&_header, 1})
+                          .subspan(_received)
+                    : std::span{_payload}.subspan(_received -
+                                                  sizeof(MessageHeader))};
+            const ssize_t received{::recv(socket.descriptor(),
+                                          target.data(),
+                                          target.size(),
+                                          MSG_DONTWAIT)};
+            if (received < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                return true;
+            }
+            if (received <= 0)
+            {
+                return false;
+            }
+            _received += static_cast<std::size_t>(received);
+            if (_received == sizeof(MessageHeader))
+            {
+                if (_header._size > max_size)
+                {
+                    return false;
+                }
+                _payload.resize(_header._size);
+            }
+        }
+        return true;
+    }
+
+    [[nodiscard]] bool complete() const
+    {
+        return _received >= sizeof(MessageHeader) &&
+               _received == sizeof(MessageHeader) + _payload.size();
+    }
+
+    // The finished message's type.
+    [[nodiscard]] MessageType type() const
+    {
+        return _header._type;
+    }
+
+    // The finished message's payload, leaving the reader ready for the next.
+    [[nodiscard]] std::vector<std::byte> take_payload()
+    {
+        _received = 0;
+        return std::exchange(_payload, {});
+    }
+
+private:
+    MessageHeader _header{};
+    std::vector<std::byte> _payload;
+    std::size_t _received{0}; // bytes of header and payload so far
+};
+
+// A connected worker and the tiles it is rendering, if any.
+struct WorkerState
+{
+    Socket _socket;
+    bool _ready{false}; // sent the scene
+    std::size_t _job_tiles{1};
+    std::vector<std::size_t> _job;
+    // when the worker is given up on if its hello, or the result of its job,
+    // has not arrived
+    std::chrono::steady_clock::time_point _deadline;
+    MessageReader _inbox;
+    bool _failed{false};
+
+    // Whether the coordinator is waiting on the worker, and so its deadline
+    // applies.
+    [[nodiscard]] bool owes_message() const
+    {
+        return !_ready || !_job.empty();
+    }
+};
+
+inline std::size_t pixel_count(const Camera &camera,
+                               std::span<const std::size_t> tiles)
+{
+    std::size_t count{0};
+    for (const std::size_t tile : tiles)
+    {
+        const Camera::TileBounds bounds{camera.tile_bounds(tile)};
+        count += static_cast<std::size_t>(bounds._i_end - bounds._i_begin) *
+                 static_cast<std::size_t>(bounds._j_end - bounds._j_begin);
+    }
+    return count;
+}
+
+// Calls visit(i, j, record_index) for every pixel of the tiles in the order
+// results carry them.
+template <typename Visit>
+void for_each_job_pixel(const Camera &camera,
+                        std::span<const std::size_t> tiles,
+                        const Visit &visit)
+{
+    std::size_t record{0};
+    for (const std::size_t tile : tiles)
+    {
+        const Camera::TileBounds bounds{camera.tile_bounds(tile)};
+        for (int j{bounds._j_begin}; j < bounds._j_end; ++j)
+        {
+            for (int i{bounds._i_begin}; i < bounds._i_end; ++i)
+            {
+                visit(i, j, record++);
+            }
+        }
+    }
+}
+
+inline std::vector<std::byte> scene_message(const Scene &scene)
+{
+    const Camera &camera{scene._camera};
+    const SettingsRecord settings{
+        camera._seed,
+        camera._russian_roulette_depth,
+        camera._tile_size,
+        camera._wavefront ? 1U : 0U,
+        camera._sampler};
+
+    std::ostringstream output;
+    output.write(reinterpret_cast<const char *>(&settings), sizeof(settings));
+    write_scene_binary(output, scene);
+    const std::string bytes{output.str()};
+    const auto *begin{reinterpret_cast<const std::byte *>(bytes.data())};
+    return {begin, begin + bytes.size()};
+}
+
+// Reads what a worker has sent and, once its hello or its result for the
+// job in flight is complete, answers the hello or merges the result.  False
+// if the worker broke the protocol or went away.
+inline bool receive_from_worker(WorkerState &worker,
+                                const Camera &camera,
+                                std::span<const std::byte> scene,
+                                Framebuffer &framebuffer)
+{
+    if (!worker._inbox.read_available(worker._socket, kMaxPayload))
+    {
+        return false;
+    }
+    if (!worker._inbox.complete())
+    {
+        return true;
+    }
+    const MessageType type{worker._inbox.type()};
+    const std::vector<std::byte> payload{worker._inbox.take_payload()};
+
+    if (!worker._ready)
+    {
+        if (type != MessageType::kHello || payload.size() != sizeof(HelloRecord))
+        {
+            return false;
+        }
+        const auto hello{read_record<HelloRecord>(payload)};
+        if (hello._magic != kMagic || hello._real_bytes != sizeof(Real))
+        {
+            std::clog << "\rRejected a worker built for another protocol or "
+                         "precision\n";
+            return false;
+        }
+        // two tiles per thread keeps every thread busy to the end of a job
+        worker._job_tiles = 2 * std::max<std::size_t>(hello._threads, 1);
+        worker._ready = worker._socket.send_message(MessageType::kScene, scene);
+        return worker._ready;
+    }
+
+    if (type != MessageType::kResult || worker._job.empty() ||
+        payload.size() !=
+            pixel_count(camera, worker._job) * sizeof(PixelRecord))
+    {
+        return false;
+    }
+    for_each_job_pixel(
+        camera, worker._job, [&](int i, int j, std::size_t record) {
+            const auto pixel{
+                read_record<PixelRecord>(payload, record * sizeof(PixelRecord))};
+            framebuffer.set_pixel(
+                i,
+                j,
+                Colour{pixel._sum[0], pixel._sum[1], pixel._sum[2]},
+                pixel._luminance_square,
+                pixel._samples);
+        });
+    worker._job.clear();
+    return true;
+}
+
+// Opens a connection to the coordinator, retrying for a few seconds in case
+// the worker started first.
+inline Socket connect_to(const std::string &host, std::uint16_t port)
+{
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    constexpr int kAttempts{50};
+    constexpr std::chrono::milliseconds kRetryDelay{100};
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    const std::string service{std::to_string(port)};
+    for (int attempt{0}; attempt < kAttempts; ++attempt)
+    {
+        addrinfo *addresses{nullptr};
+        if (::getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses) ==
+            0)
+        {
+            for (const addrinfo *address{addresses}; address != nullptr;
+                 address = address->ai_next)
+            {
+                Socket socket{::socket(address->ai_family,
+                                       address->ai_socktype | SOCK_CLOEXEC,
+                                       address->ai_protocol)};
+                if (socket.is_open() &&
+                    ::connect(socket.descriptor(),
+                              address->ai_addr,
+                              address->ai_addrlen) == 0)
+                {
+                    ::freeaddrinfo(addresses);
+                    socket.disable_delay();
+                    return socket;
+                }
+            }
+            ::freeaddrinfo(addresses);
+        }
+        std::this_thread::sleep_for(kRetryDelay);
+    }
+    return Socket{};
+}
+} // namespace distributed_detail
+
+// A TCP socket listening for workers on every interface.  Port 0 picks a
+// free port, which port() then reports.
+class Listener
+{
+public:
+    explicit Listener(std::uint16_t port)
+        : _socket(::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0))
+    {
+        if (!_socket.is_open())
+        {
+            return;
+        }
+        const int enable{1};
+        ::setsockopt(_socket.descriptor(),
+                     SOL_SOCKET,
+                     SO_REUSEADDR,
+                     &enable,
+                     sizeof(enable));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(port);
+        socklen_t length{sizeof(address)};
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        constexpr int kBacklog{64};
+        if (::bind(_socket.descriptor(),
+                   reinterpret_cast<const sockaddr *>(&address),
+                   sizeof(address)) != 0 ||
+            ::listen(_socket.descriptor(), kBacklog) != 0 ||
+            ::getsockname(_socket.descriptor(),
+                          reinterpret_cast<sockaddr *>(&address),
+                          &length) != 0)
+        {
+            _socket = distributed_detail::Socket{};
+            return;
+        }
+        _port = ntohs(address.sin_port);
+    }
+
+    // False if the port could not be bound.
+    [[nodiscard]] bool is_open() const
+    {
+        return _socket.is_open();
+    }
+
+    [[nodiscard]] std::uint16_t port() const
+    {
+        return _port;
+    }
+
+    [[nodiscard]] const distributed_detail::Socket &socket() const
+    {
+        return _socket;
+    }
+
+private:
+    distributed_detail::Socket _socket;
+    std::uint16_t _port{0};
+};
+
+struct CoordinatorStats
+{
+    std::size_t _workers{0};       // workers that received the scene
+    std::size_t _jobs{0};          // jobs handed out, including reissues
+    std::size_t _reissued_jobs{0}; // jobs lost with a worker and requeued
+    std::size_t _expired_jobs{0};  // of those, jobs that ran out of time
+    double _seconds{0.0};
+};
+
+// Renders `scene`, whose hierarchy should already be built, on the workers
+// that connect to `listener`, and returns the merged framebuffer.  A worker
+// has `job_timeout` to say hello after connecting, and again to return each
+// job; one that misses its deadline, or stops reading what is sent to it for
+// as long, is dropped and its tiles reissued, so a hung worker cannot stall
+// the frame.  Blocks until every tile is done, waiting as long as it takes
+// for workers to arrive; returns nothing only if polling the sockets fails.
+inline std::optional<Framebuffer>
+coordinate_render(const Scene &scene,
+                  Listener &listener,
+                  std::chrono::duration<double> job_timeout,
+                  CoordinatorStats &stats,
+                  std::string &error)
+{
+    using namespace distributed_detail;
+    using Clock = std::chrono::steady_clock;
+    constexpr std::chrono::milliseconds kPollInterval{1000};
+    const auto timeout{std::chrono::ceil<Clock::duration>(job_timeout)};
+
+    const auto start{Clock::now()};
+    const Camera &camera{scene._camera};
+    const std::vector<std::byte> scene_bytes{scene_message(scene)};
+    Framebuffer framebuffer{camera._image_width, camera.image_height()};
+
+    std::deque<std::size_t> pending;
+    for (std::size_t tile{0}; tile < camera.tile_count(); ++tile)
+    {
+        pending.push_back(tile);
+    }
+    std::size_t tiles_remaining{pending.size()};
+    std::vector<WorkerState> workers;
+    stats = CoordinatorStats{};
+
+    std::clog << "Waiting for workers on port " << listener.port() << '\n';
+    std::vector<pollfd> descriptors;
+    while (tiles_remaining > 0)
+    {
+        descriptors.assign(1, {listener.socket().descriptor(), POLLIN, 0});
+        for (const WorkerState &worker : workers)
+        {
+            descriptors.push_back({worker._socket.descriptor(), POLLIN, 0});
+        }
+        // wake for the nearest deadline, and every so often regardless
+        std::chrono::milliseconds wait{kPollInterval};
+        const auto before_poll{Clock::now()};
+        for (const WorkerState &worker : workers)
+        {
+            if (worker.owes_message())
+            {
+                wait = std::clamp(std::chrono::ceil<std::chrono::milliseconds>(
+                                      worker._deadline - before_poll),
+                                  std::chrono::milliseconds{0},
+                                  wait);
+            }
+        }
+        if (::poll(descriptors.data(),
+                   descriptors.size(),
+                   static_cast<int>(wait.count())) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            error = std::string{"poll failed: "} + std::strerror(errno);
+            return std::nullopt;
+        }
+
+        for (std::size_t index{0}; index < workers.size(); ++index)
+        {
+            WorkerState &worker{workers[index]};
+            if (descriptors[index + 1].revents == 0)
+            {
+                continue;
+            }
+            const std::size_t job_size{worker._job.size()};
+            const bool was_ready{worker._ready};
+            if (!receive_from_worker(
+                    worker, camera, scene_bytes, framebuffer))
+            {
+                worker._failed = true;
+                continue;
+            }
+            if (!was_ready && worker._ready)
+            {
+                ++stats._workers;
+            }
+            if (job_size > worker._job.size())
+            {
+                tiles_remaining -= job_size;
+                std::clog << "\rTiles remaining: " << tiles_remaining << ' '
+                          << std::flush;
+            }
+        }
+
+        if ((descriptors[0].revents & POLLIN) != 0)
+        {
+            Socket socket{::accept4(
+                listener.socket().descriptor(), nullptr, nullptr, SOCK_CLOEXEC)};
+            if (socket.is_open())
+            {
+                socket.disable_delay();
+                socket.set_send_timeout(job_timeout);
+                workers.push_back({std::move(socket),
+                                   false,
+                                   1,
+                                   {},
+                                   Clock::now() + timeout,
+                                   {},
+                                   false});
+            }
+        }
+
+        const auto now{Clock::now()};
+        for (WorkerState &worker : workers)
+        {
+            if (!worker._failed && worker.owes_message() &&
+                now >= worker._deadline)
+            {
+                if (!worker._job.empty())
+                {
+                    ++stats._expired_jobs;
+                }
+                worker._failed = true;
+            }
+        }
+
+        for (WorkerState &worker : workers)
+        {
+            if (worker._failed || !worker._ready || !worker._job.empty() ||
+                pending.empty())
+            {
+                continue;
+            }
+            while (worker._job.size() < worker._job_tiles && !pending.empty())
+            {
+                worker._job.push_back(pending.front());
+                pending.pop_front();
+            }
+            std::vector<std::uint64_t> tiles(worker._job.begin(),
+                                             worker._job.end());
+            ++stats._jobs;
+            worker._deadline = Clock::now() + timeout;
+            if (!worker._socket.send_message(
+                    MessageType::kJob, std::as_bytes(std::span{tiles})))
+            {
+                worker._failed = true;
+            }
+        }
+
+        // requeue the work of lost workers at the front, so it is not left
+        // until last
+        for (WorkerState &worker : workers)
+        {
+            if (worker._failed && !worker._job.empty())
+            {
+                ++stats._reissued_jobs;
+                pending.insert(
+                    pending.begin(), worker._job.begin(), worker._job.end());
+                worker._job.clear();
+            }
+            if (worker._failed && worker._ready)
+            {
+                std::clog << "\rLost a worker; reissuing its tiles\n";
+            }
+        }
+        std::erase_if(workers,
+                      [](const WorkerState &worker) { return worker._failed; });
+    }
+
+    for (const WorkerState &worker : workers)
+    {
+        static_cast<void>(worker._socket.send_message(MessageType::kDone, {}));
+    }
+    stats._seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    std::clog << "\rDone.                  \n";
+    return framebuffer;
+}
+
+// Connects to the coordinator at host:port and renders the jobs it hands
+// out with `threads` threads until it says the frame is done.  Returns false
+// with a description in `error` if the coordinator cannot be reached or the
+// connection fails before then.
+inline bool run_worker(const std::string &host,
+                       std::uint16_t port,
+                       unsigned int threads,
+                       std::string &error)
+{
+    using namespace distributed_detail;
+
+    const Socket socket{connect_to(host, port)};
+    if (!socket.is_open())
+    {
+        error = "cannot connect to " + host + ':' + std::to_string(port);
+        return false;
+    }
+
+    const HelloRecord hello{kMagic, sizeof(Real), threads};
+    MessageType type{};
+    std::vector<std::byte> payload;
+    if (!socket.send_message(MessageType::kHello,
+                             std::as_bytes(std::span{&hello, 1})) ||
+        !socket.receive_message(type, payload, kMaxPayload) ||
+        type != MessageType::kScene || payload.size() < sizeof(SettingsRecord))
+    {
+        error = "the coordinator did not send a scene";
+        return false;
+    }
+
+    const auto settings{read_record<SettingsRecord>(payload)};
+    std::optional<Scene> scene{load_scene_binary(
+        std::span{payload}.subspan(sizeof(SettingsRecord)), error)};
+    if (!scene)
+    {
+        error = "bad scene from the coordinator: " + error;
+        return false;
+    }
+    if (scene->_spheres.hierarchy().nodes().empty())
+    {
+        scene->_spheres.build_hierarchy();
+    }
+    Camera &camera{scene->_camera};
+    camera._threads = threads;
+    camera._seed = settings._seed;
+    camera._russian_roulette_depth = settings._russian_roulette_depth;
+    camera._tile_size = settings._tile_size;
+    camera._wavefront = settings._wavefront != 0;
+    camera._sampler = settings._sampler;
+    if (camera._tile_size <= 0 || settings._sampler > SamplerKind::kBlueNoise)
+    {
+        error = "bad settings from the coordinator";
+        return false;
+    }
+
+    Framebuffer framebuffer{camera._image_width, camera.image_height()};
+    std::vector<std::size_t> tiles;
+    std::vector<PixelRecord> records;
+    while (socket.receive_message(type, payload, kMaxPayload))
+    {
+        if (type == MessageType::kDone)
+        {
+            return true;
+        }
+        if (type != MessageType::kJob ||
+            payload.size() % sizeof(std::uint64_t) != 0)
+        {
+            break;
+        }
+
+        tiles.resize(payload.size() / sizeof(std::uint64_t));
+        for (std::size_t index{0}; index < tiles.size(); ++index)
+        {
+            const auto tile{read_record<std::uint64_t>(
+                payload, index * sizeof(std::uint64_t))};
+            if (tile >= camera.tile_count())
+            {
+                error = "tile out of range from the coordinator";
+                return false;
+            }
+            tiles[index] = tile;
+        }
+
+        // start from empty pixels in case a tile is handed out again
+        for_each_job_pixel(camera, tiles, [&](int i, int j, std::size_t) {
+            framebuffer.set_pixel(i, j, Colour{0, 0, 0}, 0.0, 0);
+        });
+        camera.render_tiles(
+            scene->_spheres, scene->_materials, tiles, framebuffer);
+
+        records.resize(pixel_count(camera, tiles));
+        for_each_job_pixel(
+            camera, tiles, [&](int i, int j, std::size_t record) {
+                const Colour &sum{framebuffer.at(i, j)};
+                records[record] = {framebuffer.luminance_square(i, j),
+                                   {sum.x(), sum.y(), sum.z()},
+                                   framebuffer.samples(i, j)};
+            });
+        if (!socket.send_message(MessageType::kResult,
+                                 std::as_bytes(std::span{records})))
+        {
+            break;
+        }
+    }
+    error = "lost the connection to the coordinator";
+    return false;
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef FEATURE_BUFFER_H
+#define FEATURE_BUFFER_H
+
+#include "colour.h"
+#include "vec3.h"
+
+#include <cstddef>
+#include <vector>
+
+// Per-pixel features of the surfaces the camera sees, which guide the
+// denoiser: the albedo, the unit normal and the distance from the camera,
+// each averaged over a pixel's feature samples and stored row-major.
+class FeatureBuffer
+{
+public:
+    FeatureBuffer(int width, int height)
+        : _width(width), _height(height), _albedo(pixel_count()),
+          _normals(pixel_count()), _depths(pixel_count())
+    {
+    }
+
+    [[nodiscard]] int width() const
+    {
+        return _width;
+    }
+
+    [[nodiscard]] int height() const
+    {
+        return _height;
+    }
+
+    [[nodiscard]] const Colour &albedo(int i, int j) const
+    {
+        return _albedo[index(i, j)];
+    }
+
+    [[nodiscard]] const Vec3 &normal(int i, int j) const
+    {
+        return _normals[index(i, j)];
+    }
+
+    [[nodiscard]] double depth(int i, int j) const
+    {
+        return _depths[index(i, j)];
+    }
+
+    void
+    set(int i, int j, const Colour &albedo, const Vec3 &normal, double depth)
+    {
+        const std::size_t pixel{index(i, j)};
+        _albedo[pixel] = albedo;
+        _normals[pixel] = normal;
+        _depths[pixel] = depth;
+    }
+
+private:
+    int _width;
+    int _height;
+    std::vector<Colour> _albedo;
+    std::vector<Vec3> _normals;
+    std::vector<double> _depths;
+
+    [[nodiscard]] std::size_t pixel_count() const
+    {
+        return static_cast<std::size_t>(_width) *
+               static_cast<std::size_t>(_height);
+    }
+
+    [[nodiscard]] std::size_t index(int i, int j) const
+    {
+        return static_cast<std::size_t>(j) * static_cast<std::size_t>(_width) +
+               static_cast<std::size_t>(i);
+    }
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "colour.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-pixel accumulation of un-normalised sample sums, stored row-major,
+// along with each pixel's sample count and the sum of squared sample
+// luminances from which its variance is estimated.  Tiles write disjoint
+// pixels, so workers can share one buffer without locking.
+class Framebuffer
+{
+public:
+    Framebuffer(int width, int height)
+        : _width(width), _height(height), _pixels(pixel_count()),
+          _luminance_squares(pixel_count()), _samples(pixel_count())
+    {
+    }
+
+    // Discards every sample, keeping the storage for the next image.
+    void clear()
+    {
+        std::fill(_pixels.begin(), _pixels.end(), Colour{0, 0, 0});
+        std::fill(_luminance_squares.begin(), _luminance_squares.end(), 0.0);
+        std::fill(_samples.begin(), _samples.end(), 0U);
+    }
+
+    [[nodiscard]] int width() const
+    {
+        return _width;
+    }
+
+    [[nodiscard]] int height() const
+    {
+        return _height;
+    }
+
+    [[nodiscard]] Colour &at(int i, int j)
+    {
+        return _pixels[index(i, j)];
+    }
+
+    [[nodiscard]] const Colour &at(int i, int j) const
+    {
+        return _pixels[index(i, j)];
+    }
+
+    [[nodiscard]] std::uint32_t samples(int i, int j) const
+    {
+        return _samples[index(i, j)];
+    }
+
+    [[nodiscard]] std::uint64_t total_samples() const
+    {
+        std::uint64_t total{0};
+        for (const std::uint32_t count : _samples)
+        {
+            total += count;
+        }
+        return total;
+    }
+
+    [[nodiscard]] double luminance_square(int i, int j) const
+    {
+        return _luminance_squares[index(i, j)];
+    }
+
+    // Overwrites a pixel's accumulated state, as when merging pixels another
+    // process rendered.
+    void set_pixel(int i,
+                   int j,
+                   const Colour &sum,
+                   double luminance_square,
+                   std::uint32_t samples)
+    {
+        const std::size_t pixel{index(i, j)};
+        _pixels[pixel] = sum;
+        _luminance_squares[pixel] = luminance_square;
+        _samples[pixel] = samples;
+    }
+
+    void add_sample(int i, int j, const Colour &sample)
+    {
+        const std::size_t pixel{index(i, j)};
+        const double sample_luminance{luminance(sample)};
+        _pixels[pixel] += sample;
+        _luminance_squares[pixel] += sample_luminance * sample_luminance;
+        ++_samples[pixel];
+    }
+
+    // Unbiased sample variance of the pixel's luminance, or infinity while
+    // fewer than two samples have been taken.
+    [[nodiscard]] double luminance_variance(int i, int j) const
+    {
+        const std::size_t pixel{index(i, j)};
+        const auto count{static_cast<double>(_samples[pixel])};
+        if (count < 2.0)
+        {
+            return constants::kInfinity;
+        }
+
+        const double mean{luminance(_pixels[pixel]) / count};
+        return fmax(0.0,
+                    (_luminance_squares[pixel] - count * mean * mean) /
+                        (count - 1.0));
+    }
+
+    // Standard error of the pixel's mean luminance relative to that mean.
+    [[nodiscard]] double relative_error(int i, int j) const
+    {
+        const auto count{static_cast<double>(samples(i, j))};
+        const double mean{luminance(at(i, j)) / count};
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        constexpr double kBlackLevel{1.0e-3}; // avoid dividing by ~zero
+        return std::sqrt(luminance_variance(i, j) / count) /
+               fmax(mean, kBlackLevel);
+    }
+
+private:
+    int _width;
+    int _height;
+    std::vector<Colour> _pixels;
+    std::vector<double> _luminance_squares;
+    std::vector<std::uint32_t> _samples;
+
+    [[nodiscard]] std::size_t pixel_count() const
+    {
+        return static_cast<std::size_t>(_width) *
+               static_cast<std::size_t>(_height);
+    }
+
+    [[nodiscard]] std::size_t index(int i, int j) const
+    {
+        return static_cast<std::size_t>(j) * static_cast<std::size_t>(_width) +
+               static_cast<std::size_t>(i);
+    }
+};
+
+#endif
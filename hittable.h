@@ -1,19 +1,36 @@
 #ifndef HITTABLE_H
 #define HITTABLE_H
 
+#include "aabb.h"
 #include "interval.h"
 #include "ray.h"
+#include "utility.h"
 
-class Material;
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <span>
+
+// Index of a material in the scene's MaterialTable.
+using MaterialId = std::uint32_t;
 
 class HitRecord
 {
 public:
     Point3 _point;
     Vec3 _normal;
-    std::shared_ptr<Material> _material;
-    double _t_interval = {};
+    MaterialId _material = {};
+    Real _t_interval = {};
     bool _front_face = {};
+    // Texture coordinates are finished only when a texture reads them
+    // (uv()), as a sphere's angles cost more than the rest of its hit: a
+    // sphere leaves its outward unit normal here, anything else its u and v.
+    Vec3 _uv_source = {};
+    bool _uv_on_sphere = {};
+    // How fast the coordinates change per unit of distance across the
+    // surface, which scales the footprint into them.
+    Real _uv_density = {};
+    Real _footprint = {}; // width of the ray's cone here, set by the camera
 
     void set_face_normal(const Ray &ray, const Vec3 &outward_normal)
     {
@@ -22,6 +39,36 @@ public:
         _front_face = dot(ray.direction(), outward_normal) < 0;
         _normal = _front_face ? outward_normal : -outward_normal;
     }
+
+    void set_uv(Real u, Real v, Real density)
+    {
+        _uv_source = Vec3{u, v, 0};
+        _uv_on_sphere = false;
+        _uv_density = density;
+    }
+
+    // For a sphere of `radius`, from its outward unit normal.
+    void set_sphere_uv(const Vec3 &outward_normal, Real radius)
+    {
+        _uv_source = outward_normal;
+        _uv_on_sphere = true;
+        _uv_density = 1 / (static_cast<Real>(constants::kPi) * radius);
+    }
+
+    // On a sphere, longitude and colatitude: u runs once around the y axis
+    // from -x, v from 0 at the top pole to 1 at the bottom, as image rows
+    // do.
+    [[nodiscard]] std::array<Real, 2> uv() const
+    {
+        if (!_uv_on_sphere)
+        {
+            return {_uv_source.x(), _uv_source.y()};
+        }
+        const auto pi{static_cast<Real>(constants::kPi)};
+        const Real y{std::fmin(std::fmax(_uv_source.y(), Real{-1}), Real{1})};
+        return {(std::atan2(-_uv_source.z(), _uv_source.x()) + pi) / (2 * pi),
+                std::acos(y) / pi};
+    }
 };
 
 class Hittable
@@ -34,6 +81,28 @@ public:
     virtual ~Hittable() = default;
 
     virtual bool hit(const Ray &ray, Interval ray_t, HitRecord &rec) const = 0;
+
+    // Finds, for each index in `slots`, the nearest hit of rays[index] beyond
+    // t_min and nearer than closest[index], exactly as hit() would: a hit
+    // fills records[index] and lowers closest[index] to its distance.
+    // Objects that trace many rays more cheaply together override this; by
+    // default each ray goes through hit() in turn.
+    virtual void hit_batch(std::span<const Ray> rays,
+                           std::span<const std::uint32_t> slots,
+                           Real t_min,
+                           std::span<Real> closest,
+                           std::span<HitRecord> records) const
+    {
+        for (const std::uint32_t slot : slots)
+        {
+            if (hit(rays[slot], Interval(t_min, closest[slot]), records[slot]))
+            {
+                closest[slot] = records[slot]._t_interval;
+            }
+        }
+    }
+
+    [[nodiscard]] virtual Aabb bounding_box() const = 0;
 };
 
 #endif
@@ -2,18 +2,22 @@
 #define HITTABLE_LIST_H
 
 #include "hittable.h"
+#include "render_counters.h"
 
-#include <memory>
+#include <cstdint>
+#include <span>
 #include <vector>
 
+// Linear list of objects owned elsewhere, usually by an Arena, which must
+// outlive the list.
 class HittableList : public Hittable
 {
 public:
-    std::vector<std::shared_ptr<Hittable>> _objects;
+    std::vector<const Hittable *> _objects;
 
     HittableList() = default;
 
-    explicit HittableList(std::shared_ptr<Hittable> object)
+    explicit HittableList(const Hittable &object)
     {
         add(object);
     }
@@ -21,18 +25,21 @@ public:
     void clear()
     {
         _objects.clear();
+        _bbox = Aabb{};
     }
 
-    void add(std::shared_ptr<Hittable> object)
+    void add(const Hittable &object)
     {
-        _objects.emplace_back(object);
+        _bbox = Aabb{_bbox, object.bounding_box()};
+        _objects.push_back(&object);
     }
 
     bool hit(const Ray &ray, Interval ray_t, HitRecord &rec) const override
     {
         HitRecord temp_rec;
         bool hit_anything = false;
-        double closest_so_far = ray_t._max;
+        Real closest_so_far = ray_t._max;
+        RT_COUNT(_primitives_tested, _objects.size());
 
         for (const auto &object : _objects)
         {
@@ -48,6 +55,29 @@ public:
 
         return hit_anything;
     }
+
+    // Each object takes the whole batch in turn, so every ray meets the
+    // objects in the order hit() tries them.
+    void hit_batch(std::span<const Ray> rays,
+                   std::span<const std::uint32_t> slots,
+                   Real t_min,
+                   std::span<Real> closest,
+                   std::span<HitRecord> records) const override
+    {
+        RT_COUNT(_primitives_tested, _objects.size() * slots.size());
+        for (const auto &object : _objects)
+        {
+            object->hit_batch(rays, slots, t_min, closest, records);
+        }
+    }
+
+    [[nodiscard]] Aabb bounding_box() const override
+    {
+        return _bbox;
+    }
+
+private:
+    Aabb _bbox;
 };
 
 #endif
@@ -0,0 +1,122 @@
+// Compares two PFM images written by main --format pfm, for example the
+// output of the double and float builds, and reports how far apart they are.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct Image
+{
+    int _width{0};
+    int _height{0};
+    std::vector<float> _values; // three per pixel
+};
+
+// Reads the little-endian colour PFM that encode_pfm writes.
+std::optional<Image> read_pfm(const std::string &path)
+{
+    std::ifstream input{path, std::ios::binary};
+    std::string magic;
+    Image image;
+    double scale{0.0};
+    input >> magic >> image._width >> image._height >> scale;
+    if (!input || magic != "PF" || image._width <= 0 || image._height <= 0 ||
+        scale >= 0.0)
+    {
+        return std::nullopt;
+    }
+    input.get(); // the single whitespace character ending the header
+
+    const std::vector<char> bytes{std::istreambuf_iterator<char>{input},
+                                  std::istreambuf_iterator<char>{}};
+    const std::size_t value_count{static_cast<std::size_t>(image._width) *
+                                  static_cast<std::size_t>(image._height) * 3};
+    if (bytes.size() != value_count * sizeof(float))
+    {
+        return std::nullopt;
+    }
+    image._values.resize(value_count);
+    for (std::size_t index{0}; index < value_count; ++index)
+    {
+        std::uint32_t bits{0};
+        for (std::size_t byte{0}; byte < sizeof(bits); ++byte)
+        {
+            bits |= static_cast<std::uint32_t>(static_cast<unsigned char>(
+                        bytes[index * sizeof(bits) + byte]))
+                    << (8 * byte);
+        }
+        std::memcpy(&image._values[index], &bits, sizeof(bits));
+    }
+    return image;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const std::span<char *> arguments{argv, static_cast<std::size_t>(argc)};
+    if (arguments.size() != 3)
+    {
+        std::cerr << "Usage: " << arguments[0] << " REFERENCE.pfm TEST.pfm\n";
+        return EXIT_FAILURE;
+    }
+
+    const std::optional<Image> reference{read_pfm(arguments[1])};
+    const std::optional<Image> test{read_pfm(arguments[2])};
+    if (!reference || !test)
+    {
+        std::cerr << "Unable to read "
+                  << (reference ? arguments[2] : arguments[1])
+                  << " as a colour PFM\n";
+        return EXIT_FAILURE;
+    }
+    if (reference->_width != test->_width ||
+        reference->_height != test->_height)
+    {
+        std::cerr << "Images differ in size\n";
+        return EXIT_FAILURE;
+    }
+
+    // errors are measured on values clamped to [0, 1], as written to 8-bit
+    // formats, so a few bright outliers do not dominate
+    double squared_sum{0.0};
+    double max_difference{0.0};
+    std::size_t differing{0};
+    for (std::size_t index{0}; index < reference->_values.size(); ++index)
+    {
+        const double expected{std::clamp(
+            static_cast<double>(reference->_values[index]), 0.0, 1.0)};
+        const double actual{
+            std::clamp(static_cast<double>(test->_values[index]), 0.0, 1.0)};
+        const double difference{std::fabs(actual - expected)};
+        squared_sum += difference * difference;
+        max_difference = std::max(max_difference, difference);
+        if (reference->_values[index] != test->_values[index])
+        {
+            ++differing;
+        }
+    }
+
+    const auto count{static_cast<double>(reference->_values.size())};
+    const double rmse{std::sqrt(squared_sum / count)};
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    const double psnr{rmse > 0.0 ? -20.0 * std::log10(rmse)
+                                 : std::numeric_limits<double>::infinity()};
+    std::cout << std::setprecision(6) << "rmse " << rmse << "\nmax "
+              << max_difference << "\npsnr " << psnr << " dB\ndiffering "
+              << static_cast<double>(differing) / count * 100.0
+              << "% of values\n";
+}
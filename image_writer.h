@@ -0,0 +1,579 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include "colour.h"
+#include "framebuffer.h"
+#include "interval.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Output stage: every writer resolves the whole framebuffer into one byte
+// buffer and hands it to the stream in a single write.
+enum class ImageFormat : std::uint8_t
+{
+    kP3,  // ASCII PPM, 8 bits per channel
+    kP6,  // binary PPM, 8 bits per channel
+    kPng, // PNG, 16 bits per channel
+    kPfm, // portable float map, linear 32-bit float per channel
+};
+
+inline std::optional<ImageFormat> image_format_from_name(std::string_view name)
+{
+    if (name == "p3")
+    {
+        return ImageFormat::kP3;
+    }
+    if (name == "p6")
+    {
+        return ImageFormat::kP6;
+    }
+    if (name == "png")
+    {
+        return ImageFormat::kPng;
+    }
+    if (name == "pfm")
+    {
+        return ImageFormat::kPfm;
+    }
+    return std::nullopt;
+}
+
+namespace image_writer_detail
+{
+inline Colour pixel_mean(const Framebuffer &framebuffer, int i, int j)
+{
+    const std::uint32_t samples{framebuffer.samples(i, j)};
+    if (samples == 0)
+    {
+        return Colour{0.0, 0.0, 0.0};
+    }
+    return framebuffer.at(i, j) / static_cast<Real>(samples);
+}
+
+inline std::uint8_t to_byte(double linear_component)
+{
+    // same quantisation as write_colour
+    static const BasicInterval<double> intensity{0.000, 0.999};
+    constexpr double kMaxIntensity{256.0};
+    return static_cast<std::uint8_t>(
+        kMaxIntensity * intensity.clamp(linear_to_gamma(linear_component)));
+}
+
+inline std::uint16_t to_word(double linear_component)
+{
+    static const BasicInterval<double> intensity{0.0, 1.0};
+    constexpr double kMaxIntensity{65535.0};
+    return static_cast<std::uint16_t>(
+        kMaxIntensity * intensity.clamp(linear_to_gamma(linear_component)) +
+        0.5);
+}
+
+inline void append(std::vector<std::uint8_t> &bytes, std::string_view text)
+{
+    bytes.insert(bytes.end(), text.begin(), text.end());
+}
+
+inline void append_big_endian(std::vector<std::uint8_t> &bytes,
+                              std::uint32_t value)
+{
+    for (int shift{24}; shift >= 0; shift -= 8)
+    {
+        bytes.push_back(static_cast<std::uint8_t>(value >> shift));
+    }
+}
+
+inline std::string header(std::string_view magic,
+                          const Framebuffer &framebuffer,
+                          std::string_view maximum)
+{
+    return std::string{magic} + '\n' + std::to_string(framebuffer.width()) +
+           ' ' + std::to_string(framebuffer.height()) + '\n' +
+           std::string{maximum} + '\n';
+}
+
+inline std::vector<std::uint8_t> encode_p3(const Framebuffer &framebuffer)
+{
+    std::vector<std::uint8_t> bytes;
+    append(bytes, header("P3", framebuffer, "255"));
+
+    std::array<char, 4> digits{};
+    for (int j{0}; j < framebuffer.height(); ++j)
+    {
+        for (int i{0}; i < framebuffer.width(); ++i)
+        {
+            const Colour colour{pixel_mean(framebuffer, i, j)};
+            for (int channel{0}; channel < 3; ++channel)
+            {
+                const auto result{std::to_chars(digits.data(),
+                                                digits.data() + digits.size(),
+                                                to_byte(colour[channel]))};
+                bytes.insert(bytes.end(), digits.data(), result.ptr);
+                bytes.push_back(channel < 2 ? ' ' : '\n');
+            }
+        }
+    }
+    return bytes;
+}
+
+inline std::vector<std::uint8_t> encode_p6(const Framebuffer &framebuffer)
+{
+    std::vector<std::uint8_t> bytes;
+    append(bytes, header("P6", framebuffer, "255"));
+    bytes.reserve(bytes.size() +
+                  3 * static_cast<std::size_t>(framebuffer.width()) *
+                      static_cast<std::size_t>(framebuffer.height()));
+
+    for (int j{0}; j < framebuffer.height(); ++j)
+    {
+        for (int i{0}; i < framebuffer.width(); ++i)
+        {
+            const Colour colour{pixel_mean(framebuffer, i, j)};
+            bytes.push_back(to_byte(colour.x()));
+            bytes.push_back(to_byte(colour.y()));
+            bytes.push_back(to_byte(colour.z()));
+        }
+    }
+    return bytes;
+}
+
+inline std::vector<std::uint8_t> encode_pfm(const Framebuffer &framebuffer)
+{
+    // negative scale marks little-endian data; rows run bottom to top
+    std::vector<std::uint8_t> bytes;
+    append(bytes, header("PF", framebuffer, "-1.0"));
+
+    for (int j{framebuffer.height() - 1}; j >= 0; --j)
+    {
+        for (int i{0}; i < framebuffer.width(); ++i)
+        {
+            const Colour colour{pixel_mean(framebuffer, i, j)};
+            for (int channel{0}; channel < 3; ++channel)
+            {
+                const auto value{static_cast<float>(colour[channel])};
+                std::uint32_t bits{0};
+                std::memcpy(&bits, &value, sizeof(bits));
+                for (int shift{0}; shift < 32; shift += 8)
+                {
+                    bytes.push_back(static_cast<std::uint8_t>(bits >> shift));
+                }
+            }
+        }
+    }
+    return bytes;
+}
+
+// Minimal DEFLATE compressor: greedy LZ77 matching over hash chains, coded
+// with the fixed Huffman tables of RFC 1951, which keeps the encoder small
+// while still compressing filtered image rows well.
+class Deflater
+{
+public:
+    static std::vector<std::uint8_t> zlib(const std::vector<std::uint8_t> &data)
+    {
+        Deflater deflater{data};
+        deflater.compress();
+
+        std::vector<std::uint8_t> stream{0x78, 0x01}; // 32K window, fastest
+        stream.insert(
+            stream.end(), deflater._output.begin(), deflater._output.end());
+        append_big_endian(stream, adler32(data));
+        return stream;
+    }
+
+private:
+    static constexpr std::size_t kWindow{32768};
+    static constexpr std::size_t kHashSize{1U << 15U};
+    static constexpr std::size_t kMinMatch{3};
+    static constexpr std::size_t kMaxMatch{258};
+    static constexpr int kMaxChain{32};
+
+    const std::vector<std::uint8_t> &_data;
+    std::vector<std::uint8_t> _output;
+    std::uint32_t _bit_buffer{0};
+    int _bit_count{0};
+
+    explicit Deflater(const std::vector<std::uint8_t> &data) : _data(data)
+    {
+    }
+
+    static std::uint32_t adler32(const std::vector<std::uint8_t> &data)
+    {
+        constexpr std::uint32_t kModulus{65521};
+        std::uint32_t a_value{1};
+        std::uint32_t b_value{0};
+        for (const std::uint8_t byte : data)
+        {
+            a_value = (a_value + byte) % kModulus;
+            b_value = (b_value + a_value) % kModulus;
+        }
+        return (b_value << 16U) | a_value;
+    }
+
+    void put_bits(std::uint32_t value, int count)
+    {
+        _bit_buffer |= value << static_cast<std::uint32_t>(_bit_count);
+        _bit_count += count;
+        while (_bit_count >= 8)
+        {
+            _output.push_back(static_cast<std::uint8_t>(_bit_buffer));
+            _bit_buffer >>= 8U;
+            _bit_count -= 8;
+        }
+    }
+
+    void put_code(std::uint32_t code, int length)
+    {
+        // Huffman codes are sent most significant bit first
+        std::uint32_t reversed{0};
+        for (int bit{0}; bit < length; ++bit)
+        {
+            reversed = (reversed << 1U) | ((code >> bit) & 1U);
+        }
+        put_bits(reversed, length);
+    }
+
+    void put_literal(std::uint32_t symbol)
+    {
+        // NOLINTBEGIN(readability-magic-numbers)
+        if (symbol < 144)
+        {
+            put_code(0x30 + symbol, 8);
+        }
+        else if (symbol < 256)
+        {
+            put_code(0x190 + symbol - 144, 9);
+        }
+        else if (symbol < 280)
+        {
+            put_code(symbol - 256, 7);
+        }
+        else
+        {
+            put_code(0xc0 + symbol - 280, 8);
+        }
+        // NOLINTEND(readability-magic-numbers)
+    }
+
+    void put_match(std::size_t length, std::size_t distance)
+    {
+        // NOLINTBEGIN(readability-magic-numbers)
+        static constexpr std::array<std::uint16_t, 29> kLengthBase{
+            3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+            31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static constexpr std::array<std::uint8_t, 29> kLengthExtra{
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+            2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static constexpr std::array<std::uint16_t, 30> kDistanceBase{
+            1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+            33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+            1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        static constexpr std::array<std::uint8_t, 30> kDistanceExtra{
+            0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+            6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+        // NOLINTEND(readability-magic-numbers)
+
+        std::size_t code{kLengthBase.size() - 1};
+        while (kLengthBase[code] > length)
+        {
+            --code;
+        }
+        put_literal(static_cast<std::uint32_t>(257 + code));
+        put_bits(static_cast<std::uint32_t>(length - kLengthBase[code]),
+                 kLengthExtra[code]);
+
+        code = kDistanceBase.size() - 1;
+        while (kDistanceBase[code] > distance)
+        {
+            --code;
+        }
+        put_code(static_cast<std::uint32_t>(code), 5);
+        put_bits(static_cast<std::uint32_t>(distance - kDistanceBase[code]),
+                 kDistanceExtra[code]);
+    }
+
+    [[nodiscard]] std::size_t hash(std::size_t position) const
+    {
+        const std::uint32_t key{
+            static_cast<std::uint32_t>(_data[position]) << 16U |
+            static_cast<std::uint32_t>(_data[position + 1]) << 8U |
+            _data[position + 2]};
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        return (key * 2654435761U) >> 17U;
+    }
+
+    void compress()
+    {
+        put_bits(1, 1); // final block
+        put_bits(1, 2); // fixed Huffman codes
+
+        // head holds the most recent position + 1 for each hash, previous
+        // links each position to the last one sharing its hash
+        std::vector<std::uint32_t> head(kHashSize);
+        std::vector<std::uint32_t> previous(_data.size());
+
+        const auto insert{[&](std::size_t position) {
+            if (position + kMinMatch <= _data.size())
+            {
+                const std::size_t key{hash(position)};
+                previous[position] = head[key];
+                head[key] = static_cast<std::uint32_t>(position + 1);
+            }
+        }};
+
+        std::size_t position{0};
+        while (position < _data.size())
+        {
+            std::size_t best_length{0};
+            std::size_t best_distance{0};
+            if (position + kMinMatch <= _data.size())
+            {
+                const std::size_t limit{
+                    std::min(kMaxMatch, _data.size() - position)};
+                std::uint32_t candidate{head[hash(position)]};
+                for (int chain{0}; chain < kMaxChain && candidate != 0;
+                     ++chain)
+                {
+                    const std::size_t start{candidate - 1U};
+                    if (position - start > kWindow)
+                    {
+                        break;
+                    }
+                    std::size_t length{0};
+                    while (length < limit &&
+                           _data[start + length] == _data[position + length])
+                    {
+                        ++length;
+                    }
+                    if (length > best_length)
+                    {
+                        best_length = length;
+                        best_distance = position - start;
+                        if (length == limit)
+                        {
+                            break;
+                        }
+                    }
+                    candidate = previous[start];
+                }
+            }
+
+            if (best_length >= kMinMatch)
+            {
+                put_match(best_length, best_distance);
+                for (std::size_t offset{0}; offset < best_length; ++offset)
+                {
+                    insert(position + offset);
+                }
+                position += best_length;
+            }
+            else
+            {
+                put_literal(_data[position]);
+                insert(position);
+                ++position;
+            }
+        }
+
+        put_literal(256); // end of block
+        if (_bit_count > 0)
+        {
+            put_bits(0, 8 - _bit_count);
+        }
+    }
+};
+
+inline std::uint32_t crc32(const std::uint8_t *data, std::size_t size)
+{
+    static const std::array<std::uint32_t, 256> kTable{[] {
+        std::array<std::uint32_t, 256> table{};
+        for (std::uint32_t entry{0}; entry < table.size(); ++entry)
+        {
+            std::uint32_t value{entry};
+            for (int bit{0}; bit < 8; ++bit)
+            {
+                // NOLINTNEXTLINE(readability-magic-numbers)
+                value = (value & 1U) != 0 ? 0xedb88320U ^ (value >> 1U)
+                                          : value >> 1U;
+            }
+            table[entry] = value;
+        }
+        return table;
+    }()};
+
+    std::uint32_t crc{0xffffffffU};
+    for (std::size_t index{0}; index < size; ++index)
+    {
+        crc = kTable[(crc ^ data[index]) & 0xffU] ^ (crc >> 8U);
+    }
+    return crc ^ 0xffffffffU;
+}
+
+inline void append_png_chunk(std::vector<std::uint8_t> &bytes,
+                             std::string_view type,
+                             const std::vector<std::uint8_t> &data)
+{
+    append_big_endian(bytes, static_cast<std::uint32_t>(data.size()));
+    const std::size_t type_start{bytes.size()};
+    append(bytes, type);
+    bytes.insert(bytes.end(), data.begin(), data.end());
+    append_big_endian(bytes,
+                      crc32(&bytes[type_start], bytes.size() - type_start));
+}
+
+inline std::uint8_t paeth(std::uint8_t left,
+                          std::uint8_t up,
+                          std::uint8_t up_left)
+{
+    const int estimate{left + up - up_left};
+    const int to_left{std::abs(estimate - left)};
+    const int to_up{std::abs(estimate - up)};
+    const int to_up_left{std::abs(estimate - up_left)};
+    if (to_left <= to_up && to_left <= to_up_left)
+    {
+        return left;
+    }
+    return to_up <= to_up_left ? up : up_left;
+}
+
+inline std::vector<std::uint8_t> encode_png(const Framebuffer &framebuffer)
+{
+    constexpr std::size_t kBytesPerPixel{6}; // three 16-bit channels
+    const auto width{static_cast<std::size_t>(framebuffer.width())};
+    const std::size_t row_bytes{width * kBytesPerPixel};
+
+    // Each scanline is prefixed with the filter type that leaves the
+    // smallest sum of absolute byte values, the usual libpng heuristic.
+    std::vector<std::uint8_t> filtered;
+    std::vector<std::uint8_t> previous_row(row_bytes);
+    std::vector<std::uint8_t> row(row_bytes);
+    std::array<std::vector<std::uint8_t>, 5> candidates;
+    for (auto &candidate : candidates)
+    {
+        candidate.resize(row_bytes);
+    }
+
+    for (int j{0}; j < framebuffer.height(); ++j)
+    {
+        for (std::size_t i{0}; i < width; ++i)
+        {
+            const Colour colour{
+                pixel_mean(framebuffer, static_cast<int>(i), j)};
+            for (std::size_t channel{0}; channel < 3; ++channel)
+            {
+                const std::uint16_t word{
+                    to_word(colour[static_cast<int>(channel)])};
+                row[i * kBytesPerPixel + 2 * channel] =
+                    static_cast<std::uint8_t>(word >> 8U);
+                row[i * kBytesPerPixel + 2 * channel + 1] =
+                    static_cast<std::uint8_t>(word);
+            }
+        }
+
+        std::size_t best_filter{0};
+        std::size_t best_score{SIZE_MAX};
+        for (std::size_t filter{0}; filter < candidates.size(); ++filter)
+        {
+            std::size_t score{0};
+            for (std::size_t byte{0}; byte < row_bytes; ++byte)
+            {
+                const std::uint8_t up{previous_row[byte]};
+                std::uint8_t left{0};
+                std::uint8_t up_left{0};
+                if (byte >= kBytesPerPixel)
+                {
+                    left = row[byte - kBytesPerPixel];
+                    up_left = previous_row[byte - kBytesPerPixel];
+                }
+                std::uint8_t predictor{0};
+                switch (filter)
+                {
+                case 1:
+                    predictor = left;
+                    break;
+                case 2:
+                    predictor = up;
+                    break;
+                case 3:
+                    predictor = static_cast<std::uint8_t>((left + up) / 2);
+                    break;
+                case 4:
+                    predictor = paeth(left, up, up_left);
+                    break;
+                default:
+                    break;
+                }
+                const auto value{
+                    static_cast<std::uint8_t>(row[byte] - predictor)};
+                candidates[filter][byte] = value;
+                // NOLINTNEXTLINE(readability-magic-numbers)
+                score += value < 128 ? value : 256U - value;
+            }
+            if (score < best_score)
+            {
+                best_score = score;
+                best_filter = filter;
+            }
+        }
+
+        filtered.push_back(static_cast<std::uint8_t>(best_filter));
+        filtered.insert(filtered.end(),
+                        candidates[best_filter].begin(),
+                        candidates[best_filter].end());
+        std::swap(previous_row, row);
+    }
+
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    std::vector<std::uint8_t> bytes{
+        0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+    std::vector<std::uint8_t> image_header;
+    append_big_endian(image_header,
+                      static_cast<std::uint32_t>(framebuffer.width()));
+    append_big_endian(image_header,
+                      static_cast<std::uint32_t>(framebuffer.height()));
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    image_header.insert(image_header.end(), {16, 2, 0, 0, 0}); // 16-bit RGB
+    append_png_chunk(bytes, "IHDR", image_header);
+    append_png_chunk(bytes, "IDAT", Deflater::zlib(filtered));
+    append_png_chunk(bytes, "IEND", {});
+    return bytes;
+}
+} // namespace image_writer_detail
+
+inline void write_image(std::ostream &out,
+                        const Framebuffer &framebuffer,
+                        ImageFormat format)
+{
+    std::vector<std::uint8_t> bytes;
+    switch (format)
+    {
+    case ImageFormat::kP3:
+        bytes = image_writer_detail::encode_p3(framebuffer);
+        break;
+    case ImageFormat::kP6:
+        bytes = image_writer_detail::encode_p6(framebuffer);
+        break;
+    case ImageFormat::kPng:
+        bytes = image_writer_detail::encode_png(framebuffer);
+        break;
+    case ImageFormat::kPfm:
+        bytes = image_writer_detail::encode_pfm(framebuffer);
+        break;
+    }
+    out.write(reinterpret_cast<const char *>(bytes.data()),
+              static_cast<std::streamsize>(bytes.size()));
+}
+
+#endif
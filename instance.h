@@ -0,0 +1,285 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "aabb.h"
+#include "bvh.h"
+#include "hittable.h"
+#include "render_counters.h"
+#include "transform.h"
+#include "vec3.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// A placement of geometry owned elsewhere, which must outlive the instance,
+// under an object-to-world transform.  hit() takes the ray into object
+// space without normalising its direction, so distances along it are the
+// same in both spaces, and takes the normal back out.  The instance may
+// give the geometry a material of its own.
+//
+// A moving instance blends from one transform at time 0 to another at time
+// 1 (Transform::interpolate) and is placed at the ray's time.  Its bounds
+// enclose both ends and so the whole motion.
+class Instance : public Hittable
+{
+public:
+    Instance(const Hittable &geometry,
+             const Transform &to_world,
+             std::optional<MaterialId> material = std::nullopt)
+        : _geometry(&geometry), _to_world(to_world), _material(material),
+          _bounds(to_world.bounds(geometry.bounding_box())),
+          _uv_scale(uv_scale(to_world))
+    {
+    }
+
+    Instance(const Hittable &geometry,
+             const Transform &to_world,
+             const Transform &to_world_end,
+             std::optional<MaterialId> material = std::nullopt)
+        : Instance(geometry, to_world, material)
+    {
+        set_motion(to_world_end);
+    }
+
+    [[nodiscard]] const Hittable &geometry() const
+    {
+        return *_geometry;
+    }
+
+    [[nodiscard]] const Transform &to_world() const
+    {
+        return _to_world;
+    }
+
+    [[nodiscard]] bool moving() const
+    {
+        return _to_world_end != nullptr;
+    }
+
+    // Places the instance, which stops any motion it had.
+    void set_to_world(const Transform &to_world)
+    {
+        _to_world = to_world;
+        _to_world_end.reset();
+        _bounds = to_world.bounds(_geometry->bounding_box());
+        _uv_scale = uv_scale(to_world);
+    }
+
+    // Moves the instance from its transform at time 0 to `to_world_end` at
+    // time 1.
+    void set_motion(const Transform &to_world_end)
+    {
+        _to_world_end = std::make_shared<const Transform>(to_world_end);
+        _bounds = Aabb{_to_world.bounds(_geometry->bounding_box()),
+                       to_world_end.bounds(_geometry->bounding_box())};
+    }
+
+    bool hit(const Ray &ray, Interval ray_t, HitRecord &record) const override
+    {
+        if (_to_world_end)
+        {
+            return hit_placed(
+                Transform::interpolate(_to_world, *_to_world_end, ray.time()),
+                ray,
+                ray_t,
+                record);
+        }
+        return hit_placed(_to_world, ray, ray_t, record);
+    }
+
+    [[nodiscard]] Aabb bounding_box() const override
+    {
+        return _bounds;
+    }
+
+private:
+    const Hittable *_geometry;
+    Transform _to_world;
+    std::optional<MaterialId> _material;
+    Aabb _bounds;   // world space
+    Real _uv_scale; // world texture density over the geometry's
+    // shared, so instances stay cheap to copy and the static ones small
+    std::shared_ptr<const Transform> _to_world_end;
+
+    // Lengths grow by about the cube root of the volume scale, so texture
+    // coordinates change that much more slowly per unit of world distance.
+    static Real uv_scale(const Transform &to_world)
+    {
+        return 1 / std::cbrt(std::fabs(to_world.determinant()));
+    }
+
+    bool hit_placed(const Transform &to_world,
+                    const Ray &ray,
+                    Interval ray_t,
+                    HitRecord &record) const
+    {
+        const Ray local{to_world.inverse_point(ray.origin()),
+                        to_world.inverse_vector(ray.direction()),
+                        ray.time()};
+        if (!_geometry->hit(local, ray_t, record))
+        {
+            return false;
+        }
+        // the normal already faces the ray, and the inverse transpose keeps
+        // its side
+        record._point = ray.at(record._t_interval);
+        record._normal = unit_vector(to_world.normal(record._normal));
+        record._uv_density *= _uv_scale;
+        if (_material)
+        {
+            record._material = *_material;
+        }
+        return true;
+    }
+};
+
+// Top level of a two-level hierarchy: instances, stored contiguously, under
+// a BVH over their world bounds.  Each geometry keeps its own hierarchy as
+// the bottom level, built once however many instances share it, so memory
+// grows with the unique geometry plus one transform per instance.  Moving
+// instances only needs the top level refitted or rebuilt, over one box per
+// instance.
+class InstanceSet : public Hittable
+{
+public:
+    // Returns the new instance's index.
+    std::size_t add(const Hittable &geometry,
+                    const Transform &to_world,
+                    std::optional<MaterialId> material = std::nullopt)
+    {
+        _instances.emplace_back(geometry, to_world, material);
+        return _instances.size() - 1;
+    }
+
+    // Adds an instance moving from `to_world` at time 0 to `to_world_end`
+    // at time 1.
+    std::size_t add(const Hittable &geometry,
+                    const Transform &to_world,
+                    const Transform &to_world_end,
+                    std::optional<MaterialId> material = std::nullopt)
+    {
+        _instances.emplace_back(geometry, to_world, to_world_end, material);
+        return _instances.size() - 1;
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return _instances.size();
+    }
+
+    [[nodiscard]] const Instance &instance(std::size_t index) const
+    {
+        return _instances[index];
+    }
+
+    // Moves an instance; the hierarchy is stale until refitted or rebuilt.
+    void set_to_world(std::size_t index, const Transform &to_world)
+    {
+        _instances[index].set_to_world(to_world);
+    }
+
+    // Sets where an instance is at time 1, with the same caveat.
+    void set_motion(std::size_t index, const Transform &to_world_end)
+    {
+        _instances[index].set_motion(to_world_end);
+    }
+
+    void build_hierarchy()
+    {
+        std::vector<Aabb> bounds;
+        bounds.reserve(_instances.size());
+        for (const Instance &instance : _instances)
+        {
+            bounds.push_back(instance.bounding_box());
+        }
+        _tree = BvhTree{bounds};
+    }
+
+    // Updates the hierarchy's bounds to the instances' current transforms
+    // without changing its shape.
+    void refit_hierarchy()
+    {
+        _tree.refit([this](std::uint32_t position) {
+            return _instances[_tree.order()[position]].bounding_box();
+        });
+    }
+
+    [[nodiscard]] const BvhTree &hierarchy() const
+    {
+        return _tree;
+    }
+
+    // Bytes held by the instances, their end transforms and the top-level
+    // hierarchy, excluding the geometry they share.
+    [[nodiscard]] std::size_t memory_bytes() const
+    {
+        std::size_t bytes{_instances.capacity() * sizeof(Instance) +
+                          _tree.nodes().capacity() * sizeof(BvhNode) +
+                          _tree.order().capacity() * sizeof(std::uint32_t)};
+        for (const Instance &instance : _instances)
+        {
+            if (instance.moving())
+            {
+                bytes += sizeof(Transform);
+            }
+        }
+        return bytes;
+    }
+
+    bool hit(const Ray &ray, Interval ray_t, HitRecord &record) const override
+    {
+        if (_tree.nodes().empty())
+        {
+            // no hierarchy yet: test every instance
+            bool hit_anything{false};
+            for (const Instance &instance : _instances)
+            {
+                RT_COUNT(_primitives_tested, 1U);
+                if (instance.hit(ray, ray_t, record))
+                {
+                    hit_anything = true;
+                    ray_t._max = record._t_interval;
+                }
+            }
+            return hit_anything;
+        }
+        return _tree.hit(ray,
+                         ray_t,
+                         [this, &ray, &record](std::uint32_t position,
+                                               Interval &closest) {
+                             RT_COUNT(_primitives_tested, 1U);
+                             const Instance &instance{
+                                 _instances[_tree.order()[position]]};
+                             if (!instance.hit(ray, closest, record))
+                             {
+                                 return false;
+                             }
+                             closest._max = record._t_interval;
+                             return true;
+                         });
+    }
+
+    [[nodiscard]] Aabb bounding_box() const override
+    {
+        if (!_tree.nodes().empty())
+        {
+            return _tree.bounding_box();
+        }
+        Aabb bounds;
+        for (const Instance &instance : _instances)
+        {
+            bounds = Aabb{bounds, instance.bounding_box()};
+        }
+        return bounds;
+    }
+
+private:
+    std::vector<Instance> _instances;
+    BvhTree _tree;
+};
+
+#endif
@@ -3,31 +3,48 @@
 
 #include "utility.h"
 
-class Interval
+#include <cmath>
+#include <limits>
+
+template <typename T>
+class BasicInterval
 {
 public:
-    double _min;
-    double _max;
+    T _min;
+    T _max;
 
-    Interval() : _min(+constants::kInfinity), _max(-constants::kInfinity)
+    BasicInterval()
+        : _min(+std::numeric_limits<T>::infinity()),
+          _max(-std::numeric_limits<T>::infinity())
     {
     } // default interval is empty
 
-    Interval(double min, double max) : _min(min), _max(max)
+    BasicInterval(T min, T max) : _min(min), _max(max)
     {
     }
 
-    bool contains(double x) const
+    BasicInterval(const BasicInterval &a_value, const BasicInterval &b_value)
+        : _min(std::fmin(a_value._min, b_value._min)),
+          _max(std::fmax(a_value._max, b_value._max))
+    {
+    } // smallest interval enclosing both
+
+    T size() const
+    {
+        return _max - _min;
+    }
+
+    bool contains(T x) const
     {
         return _min <= x && x <= _max;
     }
 
-    bool surrounds(double x) const
+    bool surrounds(T x) const
     {
         return _min < x && x < _max;
     }
 
-    double clamp(double x) const
+    T clamp(T x) const
     {
         if (x < _min)
         {
@@ -40,9 +57,11 @@ public:
         return x;
     }
 
-    static const Interval empty, universe;
+    static const BasicInterval empty, universe;
 };
 
+using Interval = BasicInterval<Real>;
+
 const static Interval Empty(+constants::kInfinity, -constants::kInfinity);
 const static Interval Universe(-constants::kInfinity, +constants::kInfinity);
 
@@ -1,91 +1,712 @@
+#include "animation.h"
 #include "camera.h"
-#include "colour.h"
-#include "hittable.h"
-#include "hittable_list.h"
-#include "ray.h"
-#include "sphere.h"
-#include "utility.h"
-#include "vec3.h"
+#include "checkpoint.h"
+#include "denoise.h"
+#include "distributed.h"
+#include "image_writer.h"
+#include "instance.h"
+#include "mesh_file.h"
+#include "preview.h"
+#include "scene.h"
+#include "scene_file.h"
+#include "scenes.h"
 
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
 
-int main()
+namespace
 {
-    HittableList world;
+template <typename T>
+bool parse_number(std::string_view text, T &value)
+{
+    const char *end{text.data() + text.size()};
+    const auto [pointer, error]{std::from_chars(text.data(), end, value)};
+    return error == std::errc{} && pointer == end;
+}
+
+// The output path of one frame of a sequence: the frame number follows the
+// stem, so "out.ppm" becomes "out_0007.ppm".
+std::string frame_path(const std::string &output_path, int frame)
+{
+    const std::filesystem::path path{output_path};
+    std::string number{std::to_string(frame)};
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    number.insert(0, number.size() < 4 ? 4 - number.size() : 0, '0');
+    return (path.parent_path() /
+            (path.stem().string() + '_' + number + path.extension().string()))
+        .string();
+}
+
+bool parse_number(std::string_view text, double &value)
+{
+    // strtod rather than from_chars, which not every standard library
+    // implements for floating point yet
+    const std::string copy{text};
+    char *end{nullptr};
+    value = std::strtod(copy.c_str(), &end);
+    return !copy.empty() && end == copy.c_str() + copy.size();
+}
+
+void print_usage(std::string_view program)
+{
+    std::cerr << "Usage: " << program
+              << " [--threads N] [--width N] [--samples N] [--seed N]"
+                 " [--rr-depth N]"
+                 " [--sampler independent|stratified|sobol|blue-noise]"
+                 " [--wavefront]"
+                 " [--progressive] [--error-threshold X]"
+                 " [--time-budget SECONDS] [--denoise]"
+                 " [--frames N [--shutter FRACTION]]"
+                 " [--format p3|p6|png|pfm]"
+                 " [--output FILE] [--scene FILE] [--mesh FILE [--instances N]]"
+                 " [--texture FILE [--texture-cache MB]] [--make-texture FILE]"
+                 " [--checkpoint FILE] [--checkpoint-interval SECONDS]"
+                 " [--save-scene FILE | --save-scene-text FILE]"
+                 " [--preview FILE [--control FIFO]]"
+                 " [--coordinate PORT [--job-timeout SECONDS]"
+                 " | --worker HOST:PORT]\n";
+}
+} // namespace
 
-    // NOLINTBEGIN(readability-magic-numbers)
-    auto ground_material(std::make_shared<Lambertian>(Colour{0.5, 0.5, 0.5}));
-    world.add(
-        std::make_shared<Sphere>(Point3{0, -1000, 0}, 1000, ground_material));
+int main(int argc, char *argv[])
+{
+    const std::span<char *> arguments{argv, static_cast<std::size_t>(argc)};
+    unsigned int threads{std::max(std::thread::hardware_concurrency(), 1U)};
+    int width{0};
+    int samples{0};
+    std::uint64_t seed{0};
+    int russian_roulette_depth{3};
+    SamplerKind sampler{SamplerKind::kIndependent};
+    bool wavefront{false};
+    bool progressive{false};
+    bool denoise_image{false};
+    int frame_count{0};
+    double shutter{0.0};
+    double error_threshold{0.02};
+    double time_budget{0.0};
+    ImageFormat format{ImageFormat::kP6};
+    std::string output_path;
+    std::string scene_path;
+    std::string mesh_path;
+    std::size_t instance_count{0};
+    std::string texture_path;
+    std::string make_texture_path;
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    std::size_t texture_cache_mb{64};
+    std::string save_scene_path;
+    bool save_scene_text{false};
+    std::string checkpoint_path;
+    std::string preview_path;
+    std::string control_path;
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    double checkpoint_interval{300.0};
+    double job_timeout{300.0};
+    std::optional<std::uint16_t> coordinator_port;
+    std::string worker_host;
+    std::uint16_t worker_port{0};
 
-    for (int aa{-11}; aa < 11; ++aa)
+    for (std::size_t index{1}; index < arguments.size(); ++index)
     {
-        for (int bb{-11}; bb < 11; ++bb)
+        const std::string_view argument{arguments[index]};
+        const bool has_value{index + 1 < arguments.size()};
+        if (argument == "--threads" && has_value &&
+            parse_number(arguments[index + 1], threads) && threads > 0)
         {
-            const double choose_mat{random_double()};
-            Point3 centre{aa + 0.9 * random_double(),
-                          0.2,
-                          bb + 0.9 * random_double()};
-
-            if ((centre - Point3{4, 0.2, 0}).length() > 0.9)
+            ++index;
+        }
+        else if (argument == "--width" && has_value &&
+                 parse_number(arguments[index + 1], width) && width > 0)
+        {
+            ++index;
+        }
+        else if (argument == "--samples" && has_value &&
+                 parse_number(arguments[index + 1], samples) && samples > 0)
+        {
+            ++index;
+        }
+        else if (argument == "--seed" && has_value &&
+                 parse_number(arguments[index + 1], seed))
+        {
+            ++index;
+        }
+        else if (argument == "--rr-depth" && has_value &&
+                 parse_number(arguments[index + 1], russian_roulette_depth) &&
+                 russian_roulette_depth >= 0)
+        {
+            ++index;
+        }
+        else if (argument == "--sampler" && has_value &&
+                 sampler_from_name(arguments[index + 1]))
+        {
+            sampler = *sampler_from_name(arguments[++index]);
+        }
+        else if (argument == "--wavefront")
+        {
+            wavefront = true;
+        }
+        else if (argument == "--progressive")
+        {
+            progressive = true;
+        }
+        else if (argument == "--denoise")
+        {
+            denoise_image = true;
+        }
+        else if (argument == "--error-threshold" && has_value &&
+                 parse_number(arguments[index + 1], error_threshold))
+        {
+            ++index;
+        }
+        else if (argument == "--time-budget" && has_value &&
+                 parse_number(arguments[index + 1], time_budget))
+        {
+            ++index;
+        }
+        else if (argument == "--format" && has_value &&
+                 image_format_from_name(arguments[index + 1]))
+        {
+            format = *image_format_from_name(arguments[++index]);
+        }
+        else if (argument == "--output" && has_value)
+        {
+            output_path = arguments[++index];
+        }
+        else if (argument == "--scene" && has_value)
+        {
+            scene_path = arguments[++index];
+        }
+        else if (argument == "--frames" && has_value &&
+                 parse_number(arguments[index + 1], frame_count) &&
+                 frame_count > 0)
+        {
+            ++index;
+        }
+        else if (argument == "--shutter" && has_value &&
+                 parse_number(arguments[index + 1], shutter) &&
+                 shutter > 0.0 && shutter <= 1.0)
+        {
+            ++index;
+        }
+        else if (argument == "--mesh" && has_value)
+        {
+            mesh_path = arguments[++index];
+        }
+        else if (argument == "--instances" && has_value &&
+                 parse_number(arguments[index + 1], instance_count))
+        {
+            ++index;
+        }
+        else if (argument == "--texture" && has_value)
+        {
+            texture_path = arguments[++index];
+        }
+        else if (argument == "--texture-cache" && has_value &&
+                 parse_number(arguments[index + 1], texture_cache_mb) &&
+                 texture_cache_mb > 0)
+        {
+            ++index;
+        }
+        else if (argument == "--make-texture" && has_value)
+        {
+            make_texture_path = arguments[++index];
+        }
+        else if ((argument == "--save-scene" ||
+                  argument == "--save-scene-text") &&
+                 has_value)
+        {
+            save_scene_text = argument == "--save-scene-text";
+            save_scene_path = arguments[++index];
+        }
+        else if (argument == "--checkpoint" && has_value)
+        {
+            checkpoint_path = arguments[++index];
+        }
+        else if (argument == "--checkpoint-interval" && has_value &&
+                 parse_number(arguments[index + 1], checkpoint_interval) &&
+                 checkpoint_interval > 0.0)
+        {
+            ++index;
+        }
+        else if (argument == "--preview" && has_value)
+        {
+            preview_path = arguments[++index];
+        }
+        else if (argument == "--control" && has_value)
+        {
+            control_path = arguments[++index];
+        }
+        else if (argument == "--coordinate" && has_value &&
+                 parse_number(arguments[index + 1], worker_port))
+        {
+            coordinator_port = worker_port;
+            ++index;
+        }
+        else if (argument == "--job-timeout" && has_value &&
+                 parse_number(arguments[index + 1], job_timeout) &&
+                 job_timeout > 0.0)
+        {
+            ++index;
+        }
+        else if (argument == "--worker" && has_value)
+        {
+            const std::string_view address{arguments[++index]};
+            const std::size_t colon{address.rfind(':')};
+            if (colon == std::string_view::npos ||
+                !parse_number(address.substr(colon + 1), worker_port))
             {
-                std::shared_ptr<Material> sphere_material;
+                print_usage(arguments[0]);
+                return EXIT_FAILURE;
+            }
+            worker_host = address.substr(0, colon);
+        }
+        else
+        {
+            print_usage(arguments[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (coordinator_port && (progressive || !checkpoint_path.empty()))
+    {
+        std::cerr << "--coordinate renders every sample in one go; it cannot "
+                     "be combined with --progressive or --checkpoint\n";
+        return EXIT_FAILURE;
+    }
+    if (!control_path.empty() && preview_path.empty())
+    {
+        std::cerr << "--control needs --preview\n";
+        return EXIT_FAILURE;
+    }
+    if (!preview_path.empty() &&
+        (coordinator_port || !worker_host.empty() || !checkpoint_path.empty()))
+    {
+        std::cerr << "--preview cannot be combined with --coordinate, "
+                     "--worker or --checkpoint\n";
+        return EXIT_FAILURE;
+    }
+
+    if (!mesh_path.empty() &&
+        (!preview_path.empty() || coordinator_port || !worker_host.empty() ||
+         !checkpoint_path.empty() || !save_scene_path.empty()))
+    {
+        std::cerr << "--mesh is not part of the scene; it cannot be combined "
+                     "with --preview, --coordinate, --worker, --checkpoint "
+                     "or --save-scene\n";
+        return EXIT_FAILURE;
+    }
+    if (frame_count > 0 &&
+        (output_path.empty() || !preview_path.empty() || coordinator_port ||
+         !worker_host.empty() || !checkpoint_path.empty() ||
+         !save_scene_path.empty()))
+    {
+        std::cerr << "--frames needs --output, and cannot be combined with "
+                     "--preview, --coordinate, --worker, --checkpoint or "
+                     "--save-scene\n";
+        return EXIT_FAILURE;
+    }
+    if (shutter > 0.0 && frame_count == 0)
+    {
+        std::cerr << "--shutter blurs the motion of --frames, which is "
+                     "missing\n";
+        return EXIT_FAILURE;
+    }
+    if (instance_count > 0 && mesh_path.empty())
+    {
+        std::cerr << "--instances places copies of --mesh, which is missing\n";
+        return EXIT_FAILURE;
+    }
+    if (!texture_path.empty() &&
+        (!preview_path.empty() || coordinator_port || !worker_host.empty() ||
+         !checkpoint_path.empty() || !save_scene_path.empty()))
+    {
+        std::cerr << "--texture is not part of the scene; it cannot be "
+                     "combined with --preview, --coordinate, --worker, "
+                     "--checkpoint or --save-scene\n";
+        return EXIT_FAILURE;
+    }
+
+    if (!make_texture_path.empty())
+    {
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        constexpr std::uint32_t kMadeTextureSize{4096};
+        std::string error;
+        if (!write_grid_texture(
+                make_texture_path, kMadeTextureSize, seed, error))
+        {
+            std::cerr << error << '\n';
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // workers take the scene and settings from the coordinator
+    if (!worker_host.empty())
+    {
+        std::string error;
+        if (!run_worker(worker_host, worker_port, threads, error))
+        {
+            std::cerr << error << '\n';
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    std::optional<Scene> scene;
+    if (scene_path.empty())
+    {
+        scene = random_spheres_scene();
+    }
+    else
+    {
+        std::string error;
+        scene = load_scene(scene_path, error);
+        if (!scene)
+        {
+            std::cerr << error << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+    if (scene->_spheres.hierarchy().nodes().empty())
+    {
+        scene->_spheres.build_hierarchy();
+    }
+
+    // a mesh joins the spheres in a light grey of its own
+    std::optional<TriangleMesh> mesh;
+    HittableList world{scene->_spheres};
+    if (!mesh_path.empty())
+    {
+        const auto start{std::chrono::steady_clock::now()};
+        std::string error;
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        const Lambertian grey{Colour{0.7_r, 0.7_r, 0.7_r}};
+        mesh = load_mesh(mesh_path, scene->_materials.add(grey), error);
+        if (!mesh)
+        {
+            std::cerr << error << '\n';
+            return EXIT_FAILURE;
+        }
+        std::clog << "Mesh: " << mesh->size() << " triangles, "
+                  << static_cast<double>(mesh->memory_bytes()) /
+                         static_cast<double>(mesh->size())
+                  << " bytes per triangle, loaded in "
+                  << std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count()
+                  << " s\n";
+        if (instance_count == 0)
+        {
+            world.add(*mesh);
+        }
+    }
 
-                if (choose_mat < 0.8)
+    // --instances scatters the mesh over the ground like the small spheres,
+    // each copy as wide as one and in a random diffuse colour
+    InstanceSet instances;
+    if (instance_count > 0)
+    {
+        // NOLINTBEGIN(readability-magic-numbers)
+        const Aabb bounds{mesh->bounding_box()};
+        const Real size{std::max(
+            {bounds._x.size(), bounds._y.size(), bounds._z.size()})};
+        const Transform to_ground{
+            Transform::scaling(Vec3{0.4_r, 0.4_r, 0.4_r} / size) *
+            Transform::translation(-Point3{bounds.centroid().x(),
+                                           bounds._y._min,
+                                           bounds.centroid().z()})};
+        Rng rng{seed};
+        for (std::size_t index{0}; index < instance_count; ++index)
+        {
+            const Colour albedo{Colour::random(rng) * Colour::random(rng)};
+            const Vec3 position{
+                static_cast<Real>(random_double(rng, -11.0, 11.0)),
+                0,
+                static_cast<Real>(random_double(rng, -11.0, 11.0))};
+            const Transform turn{Transform::rotation(
+                Vec3{0, 1, 0}, random_double(rng, 0.0, 360.0))};
+            instances.add(*mesh,
+                          Transform::translation(position) * turn * to_ground,
+                          scene->_materials.add(Lambertian{albedo}));
+        }
+        // NOLINTEND(readability-magic-numbers)
+        const auto start{std::chrono::steady_clock::now()};
+        instances.build_hierarchy();
+        world.add(instances);
+        std::clog << "Instances: " << instance_count << ", "
+                  << static_cast<double>(instances.memory_bytes()) /
+                         static_cast<double>(instance_count)
+                  << " bytes each, top level built in "
+                  << std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - start)
+                         .count()
+                  << " ms\n";
+    }
+
+    // --texture paints the large spheres with an image, read through a tile
+    // cache of --texture-cache megabytes
+    std::unique_ptr<TextureFile> texture;
+    std::optional<TileCache> tile_cache;
+    if (!texture_path.empty())
+    {
+        std::string error;
+        texture = load_texture(texture_path, error);
+        if (!texture)
+        {
+            std::cerr << texture_path << ": " << error << '\n';
+            return EXIT_FAILURE;
+        }
+        // NOLINTBEGIN(readability-magic-numbers)
+        tile_cache.emplace(texture_cache_mb << 20U);
+        const std::size_t textured{texture_large_spheres(
+            *scene, Texture{ImageTexture{*texture, *tile_cache}})};
+        std::clog << "Texture: " << texture->width() << " x "
+                  << texture->height() << ", "
+                  << static_cast<double>(texture->file_bytes()) / 1048576.0
+                  << " MB on " << textured << " spheres, "
+                  << tile_cache->slot_count() << " cached tiles\n";
+        // NOLINTEND(readability-magic-numbers)
+    }
+
+    if (!save_scene_path.empty())
+    {
+        std::ofstream output{save_scene_path, std::ios::binary};
+        if (save_scene_text)
+        {
+            write_scene_text(output, *scene);
+        }
+        else
+        {
+            write_scene_binary(output, *scene);
+        }
+        if (!output)
+        {
+            std::cerr << "Unable to write " << save_scene_path << '\n';
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    Camera &camera{scene->_camera};
+    camera._threads = threads;
+    camera._seed = seed;
+    camera._russian_roulette_depth = russian_roulette_depth;
+    camera._sampler = sampler;
+    camera._wavefront = wavefront;
+    camera._progressive = progressive;
+    camera._error_threshold = error_threshold;
+    camera._time_budget = time_budget;
+    if (width > 0)
+    {
+        camera._image_width = width;
+    }
+    if (samples > 0)
+    {
+        camera._samples_per_pixel = samples;
+    }
+
+    if (frame_count > 0)
+    {
+        const SceneAnimation animation{*scene};
+        bool written{true};
+        const std::vector<FrameTimes> times{render_sequence(
+            *scene,
+            world,
+            animation,
+            frame_count,
+            shutter,
+            [&](int frame, const Framebuffer &rendered) {
+                const std::string path{frame_path(output_path, frame)};
+                std::ofstream output{path, std::ios::binary};
+                if (denoise_image)
                 {
-                    // diffuse
-                    const Colour albedo{Colour::random() * Colour::random()};
-                    sphere_material = std::make_shared<Lambertian>(albedo);
-                    world.add(
-                        std::make_shared<Sphere>(centre, 0.2, sphere_material));
+                    write_image(
+                        output,
+                        denoise(rendered,
+                                camera.render_features(world,
+                                                       scene->_materials),
+                                threads),
+                        format);
                 }
-                else if (choose_mat < 0.95)
+                else
                 {
-                    // metal
-                    const Colour albedo{Colour::random(0.5, 1)};
-                    auto fuzz(random_double(0, 0.5));
-                    sphere_material = std::make_shared<Metal>(albedo, fuzz);
-                    world.add(
-                        std::make_shared<Sphere>(centre, 0.2, sphere_material));
+                    write_image(output, rendered, format);
                 }
-                else
+                if (!output)
                 {
-                    //glass
-                    sphere_material = std::make_shared<Dielectric>(1.5);
-                    world.add(
-                        std::make_shared<Sphere>(centre, 0.2, sphere_material));
+                    std::cerr << "Unable to write " << path << '\n';
+                    written = false;
                 }
-            }
+            })};
+
+        FrameTimes total;
+        for (std::size_t frame{0}; frame < times.size(); ++frame)
+        {
+            std::clog << "Frame " << frame << ": setup "
+                      << 1000.0 * times[frame]._setup_seconds << " ms, trace "
+                      << times[frame]._trace_seconds << " s, output "
+                      << 1000.0 * times[frame]._output_seconds << " ms\n";
+            total._setup_seconds += times[frame]._setup_seconds;
+            total._trace_seconds += times[frame]._trace_seconds;
+            total._output_seconds += times[frame]._output_seconds;
         }
+        std::clog << "Frames: " << frame_count << " with "
+                  << animation.bouncing_spheres()
+                  << " moving spheres\nPer frame: setup "
+                  << 1000.0 * total._setup_seconds / frame_count
+                  << " ms, trace " << total._trace_seconds / frame_count
+                  << " s, output "
+                  << 1000.0 * total._output_seconds / frame_count << " ms\n";
+        return written ? EXIT_SUCCESS : EXIT_FAILURE;
     }
 
-    auto material1(std::make_shared<Dielectric>(1.5));
-    world.add(std::make_shared<Sphere>(Point3{0, 1, 0}, 1.0, material1));
-
-    auto material2(std::make_shared<Lambertian>(Colour{0.4, 0.2, 0.1}));
-    world.add(std::make_shared<Sphere>(Point3{-4, 1, 0}, 1.0, material2));
-
-    auto material3(std::make_shared<Metal>(Colour{0.7, 0.6, 0.5}, 0.0));
-    world.add(std::make_shared<Sphere>(Point3{4, 1, 0}, 1.0, material3));
-
-    Camera camera;
-    camera._aspect_ratio = 16.0 / 9.0;
-    camera._image_width = 1200;
-    camera._samples_per_pixel = 500;
-    camera._max_depth = 50;
-    //camera._samples_per_pixel = 10;
-    //camera._max_depth = 20;
+    std::optional<Framebuffer> framebuffer;
+    if (!preview_path.empty())
+    {
+        PreviewStats stats;
+        std::string error;
+        framebuffer =
+            run_preview(*scene, preview_path, control_path, stats, error);
+        if (!framebuffer)
+        {
+            std::cerr << error << '\n';
+            return EXIT_FAILURE;
+        }
+        std::clog << "Preview frames: " << stats._frames
+                  << "\nRestarts: " << stats._restarts;
+        if (stats._stops > 0)
+        {
+            std::clog << " (renders stopped in "
+                      << 1000.0 * stats._total_stop_seconds /
+                             static_cast<double>(stats._stops)
+                      << " ms on average, " << 1000.0 * stats._max_stop_seconds
+                      << " ms at most)";
+        }
+        std::clog << '\n';
+    }
+    else if (coordinator_port)
+    {
+        Listener listener{*coordinator_port};
+        if (!listener.is_open())
+        {
+            std::cerr << "Unable to listen on port " << *coordinator_port
+                      << '\n';
+            return EXIT_FAILURE;
+        }
+        CoordinatorStats stats;
+        std::string error;
+        framebuffer = coordinate_render(*scene,
+                                        listener,
+                                        std::chrono::duration<double>{
+                                            job_timeout},
+                                        stats,
+                                        error);
+        if (!framebuffer)
+        {
+            std::cerr << error << '\n';
+            return EXIT_FAILURE;
+        }
+        std::clog << "Workers: " << stats._workers << "\nJobs: " << stats._jobs
+                  << " (reissued " << stats._reissued_jobs << ", "
+                  << stats._expired_jobs << " after timing out)"
+                  << "\nRender time: " << stats._seconds << " s\n";
+    }
+    else if (!checkpoint_path.empty())
+    {
+        // resume from the checkpoint if there is one, and keep it up to date
+        CheckpointInfo info{checkpoint_info(*scene)};
+        std::string error;
+        if (std::filesystem::exists(checkpoint_path))
+        {
+            framebuffer = load_checkpoint(checkpoint_path, info, error);
+            if (!framebuffer)
+            {
+                std::cerr << error << '\n';
+                return EXIT_FAILURE;
+            }
+            camera._stratified_samples = info._stratified_samples;
+            std::clog << "Resuming from " << checkpoint_path << " ("
+                      << framebuffer->total_samples() << " samples)\n";
+        }
+        else
+        {
+            framebuffer.emplace(info._width, info._height);
+        }
+        camera._checkpoint_interval = checkpoint_interval;
+        camera._checkpoint = [&](const Framebuffer &partial) {
+            if (!save_checkpoint(checkpoint_path, partial, info, error))
+            {
+                std::cerr << "\nUnable to checkpoint: " << error << '\n';
+            }
+        };
+        camera.render(scene->_spheres, scene->_materials, *framebuffer);
+    }
+    else
+    {
+        framebuffer = camera.render(world, scene->_materials);
+    }
 
-    camera._vertical_fov = 20;
-    camera._look_from = Point3{13, 2, 3};
-    camera._look_at = Point3{0, 0, 0};
-    camera._vup = Point3{0, 1, 0};
+    // the features are traced afresh from the final view, so denoising works
+    // after any of the renders above
+    if (denoise_image)
+    {
+        using Clock = std::chrono::steady_clock;
+        const auto start{Clock::now()};
+        const FeatureBuffer features{
+            camera.render_features(world, scene->_materials)};
+        const auto filter_start{Clock::now()};
+        framebuffer = denoise(*framebuffer, features, threads);
+        const auto end{Clock::now()};
+        std::clog << "\nFeature time: "
+                  << std::chrono::duration<double>(filter_start - start).count()
+                  << " s\nDenoise time: "
+                  << std::chrono::duration<double>(end - filter_start).count()
+                  << " s\n";
+    }
 
-    camera._defocus_angle = 0.6;
-    camera._focus_dist = 10.0;
+    if (output_path.empty())
+    {
+        write_image(std::cout, *framebuffer, format);
+    }
+    else
+    {
+        std::ofstream output{output_path, std::ios::binary};
+        write_image(output, *framebuffer, format);
+        if (!output)
+        {
+            std::cerr << "Unable to write " << output_path << '\n';
+            return EXIT_FAILURE;
+        }
+    }
 
-    // NOLINTEND(readability-magic-numbers)
+    if (tile_cache)
+    {
+        const TileCache::Stats stats{tile_cache->stats()};
+        std::clog << "Texture lookups: " << stats._lookups << ", hit rate "
+                  << 100.0 * stats.hit_rate() << "%, " << stats._misses
+                  << " tiles decoded, " << stats._evictions << " evicted\n";
+    }
 
-    camera.render(world);
+    if (progressive)
+    {
+        const Camera::RenderStats &stats{camera.stats()};
+        const auto saved{stats._samples_budgeted - stats._samples_taken};
+        std::clog << "Passes: " << stats._passes
+                  << "\nSamples taken: " << stats._samples_taken << " of "
+                  << stats._samples_budgeted << " (saved " << saved << ", "
+                  << 100.0 * static_cast<double>(saved) /
+                         static_cast<double>(stats._samples_budgeted)
+                  << "%)\nConverged pixels: " << stats._converged_pixels
+                  << "\nRender time: " << stats._seconds << " s\n";
+    }
 }
@@ -0,0 +1,155 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only memory mapping of a whole file.  Pages are read in by the kernel
+// as they are first touched, so loaders can copy large arrays straight out of
+// the mapping without an intermediate read buffer.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path)
+    {
+        const int descriptor{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+        if (descriptor < 0)
+        {
+            return;
+        }
+
+        struct stat status
+        {
+        };
+        if (::fstat(descriptor, &status) == 0 && status.st_size > 0)
+        {
+            const auto size{static_cast<std::size_t>(status.st_size)};
+            void *address{
+                ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0)};
+            if (address != MAP_FAILED)
+            {
+                _address = address;
+                _size = size;
+            }
+        }
+        ::close(descriptor);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile()
+    {
+        if (_address != nullptr)
+        {
+            ::munmap(_address, _size);
+        }
+    }
+
+    // False if the file could not be opened or mapped, or is empty.
+    [[nodiscard]] bool is_open() const
+    {
+        return _address != nullptr;
+    }
+
+    [[nodiscard]] std::span<const std::byte> bytes() const
+    {
+        return {static_cast<const std::byte *>(_address), _size};
+    }
+
+    // Drops the whole pages within [offset, offset + length) from the
+    // process's resident memory.  The mapping stays valid and touching the
+    // range again reads it back from the file.
+    void release(std::size_t offset, std::size_t length) const
+    {
+        const auto page{static_cast<std::size_t>(::sysconf(_SC_PAGESIZE))};
+        const std::size_t begin{(offset + page - 1) / page * page};
+        const std::size_t end{std::min(offset + length, _size) / page * page};
+        if (_address != nullptr && begin < end)
+        {
+            ::madvise(static_cast<std::byte *>(_address) + begin,
+                      end - begin,
+                      MADV_DONTNEED);
+        }
+    }
+
+private:
+    void *_address{nullptr};
+    std::size_t _size{0};
+};
+
+// Writable shared mapping of a file created (or truncated) at a fixed size.
+// Bytes written through the mapping reach the file when sync() is called or
+// the mapping is destroyed.
+class MappedOutputFile
+{
+public:
+    MappedOutputFile(const std::string &path, std::size_t size)
+    {
+        const int descriptor{
+            ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)};
+        if (descriptor < 0)
+        {
+            return;
+        }
+
+        if (size > 0 &&
+            ::ftruncate(descriptor, static_cast<off_t>(size)) == 0)
+        {
+            void *address{::mmap(nullptr,
+                                 size,
+                                 PROT_READ | PROT_WRITE,
+                                 MAP_SHARED,
+                                 descriptor,
+                                 0)};
+            if (address != MAP_FAILED)
+            {
+                _address = address;
+                _size = size;
+            }
+        }
+        ::close(descriptor);
+    }
+
+    MappedOutputFile(const MappedOutputFile &) = delete;
+    MappedOutputFile &operator=(const MappedOutputFile &) = delete;
+
+    ~MappedOutputFile()
+    {
+        if (_address != nullptr)
+        {
+            ::munmap(_address, _size);
+        }
+    }
+
+    // False if the file could not be created or mapped, or size was zero.
+    [[nodiscard]] bool is_open() const
+    {
+        return _address != nullptr;
+    }
+
+    [[nodiscard]] std::span<std::byte> bytes() const
+    {
+        return {static_cast<std::byte *>(_address), _size};
+    }
+
+    // Writes the mapped bytes back to the file and waits for them to reach
+    // the disk.
+    [[nodiscard]] bool sync() const
+    {
+        return ::msync(_address, _size, MS_SYNC) == 0;
+    }
+
+private:
+    void *_address{nullptr};
+    std::size_t _size{0};
+};
+
+#endif
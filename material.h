@@ -4,99 +4,121 @@
 #include "colour.h"
 #include "hittable.h"
 #include "ray.h"
+#include "sampler.h"
+#include "sampling.h"
+#include "texture.h"
 #include "utility.h"
 
-class HitRecord;
+#include <cmath>
+#include <cstddef>
+#include <variant>
+#include <vector>
 
-class Material
+class Lambertian
 {
 public:
-    virtual ~Material() = default;
+    explicit Lambertian(const Colour &albedo) : _albedo(albedo)
+    {
+    }
 
-    virtual bool scatter(const Ray &ray_in,
-                         const HitRecord &record,
-                         Colour &attenuation,
-                         Ray &scattered) const = 0;
-};
+    explicit Lambertian(const Texture &albedo) : _albedo(albedo)
+    {
+    }
 
-class Lambertian : public Material
-{
-public:
-    explicit Lambertian(const Colour &albedo) : _albedo(albedo)
+    [[nodiscard]] const Texture &albedo() const
     {
+        return _albedo;
     }
 
-    bool scatter(const Ray & /*ray_in*/,
+    bool scatter(const Ray &ray_in,
                  const HitRecord &record,
                  Colour &attenuation,
-                 Ray &scattered) const override
+                 Ray &scattered,
+                 const Sample2 &sample) const
     {
-        Vec3 scatter_direction{record._normal + random_unit_vector()};
-
-        // catch degenerate scatter direction
-        if (scatter_direction.near_zero())
-        {
-            scatter_direction = record._normal;
-        }
-
-        scattered = Ray{record._point, scatter_direction};
-        attenuation = _albedo;
+        scattered = Ray{record._point,
+                        cosine_hemisphere(record._normal, sample),
+                        ray_in.time()};
+        attenuation = _albedo.value(record);
         return true;
     }
 
 private:
-    Colour _albedo;
+    Texture _albedo;
 };
 
-class Metal : public Material
+class Metal
 {
 public:
-    Metal(const Colour &albedo, double fuzz)
-        : _albedo(albedo), _fuzz(fuzz < 1 ? fuzz : 1)
+    Metal(const Colour &albedo, double fuzz) : Metal(Texture{albedo}, fuzz)
+    {
+    }
+
+    Metal(const Texture &albedo, double fuzz)
+        : _albedo(albedo), _fuzz(static_cast<Real>(fuzz < 1 ? fuzz : 1))
+    {
+    }
+
+    [[nodiscard]] const Texture &albedo() const
     {
+        return _albedo;
+    }
+
+    [[nodiscard]] Real fuzz() const
+    {
+        return _fuzz;
     }
 
     bool scatter(const Ray &ray_in,
                  const HitRecord &record,
                  Colour &attenuation,
-                 Ray &scattered) const override
+                 Ray &scattered,
+                 const Sample2 &sample) const
     {
         Vec3 reflected{
             reflect(unit_vector(ray_in.direction()), record._normal)};
-        scattered =
-            Ray{record._point, reflected + _fuzz * random_unit_vector()};
-        attenuation = _albedo;
+        scattered = Ray{record._point,
+                        reflected + _fuzz * uniform_sphere(sample),
+                        ray_in.time()};
+        attenuation = _albedo.value(record);
         return (dot(scattered.direction(), record._normal) > 0);
     }
 
 private:
-    Colour _albedo;
-    double _fuzz;
+    Texture _albedo;
+    Real _fuzz;
 };
 
 // Dielectric materials, such as glass and water, both reflect and refract incident light.
-class Dielectric : public Material
+class Dielectric
 {
 public:
-    Dielectric(double index_of_refraction)
-        : _refraction_index(index_of_refraction)
+    explicit Dielectric(double index_of_refraction)
+        : _refraction_index(static_cast<Real>(index_of_refraction))
+    {
+    }
+
+    [[nodiscard]] Real refraction_index() const
     {
+        return _refraction_index;
     }
 
     bool scatter(const Ray &ray_in,
                  const HitRecord &record,
                  Colour &attenuation,
-                 Ray &scattered) const override
+                 Ray &scattered,
+                 const Sample2 & /*sample*/) const
     {
         attenuation = {Colour(1.0, 1.0, 1.0)};
-        const double refraction_ratio{
-            record._front_face ? (1.0 / _refraction_index) : _refraction_index};
+        const Real refraction_ratio{
+            record._front_face ? (1 / _refraction_index) : _refraction_index};
 
         Vec3 unit_direction{unit_vector(ray_in.direction())};
-        const double cos_theta{fmin(dot(-unit_direction, record._normal), 1.0)};
-        const double sin_theta{sqrt(1.0 - cos_theta * cos_theta)};
+        const Real cos_theta{
+            std::fmin(dot(-unit_direction, record._normal), Real{1})};
+        const Real sin_theta{std::sqrt(1 - cos_theta * cos_theta)};
 
-        const bool cannot_refract{refraction_ratio * sin_theta > 1.0};
+        const bool cannot_refract{refraction_ratio * sin_theta > 1};
         Vec3 direction;
 
         if (cannot_refract)
@@ -109,13 +131,125 @@ public:
                 refract(unit_direction, record._normal, refraction_ratio);
         }
 
-        scattered = Ray{record._point, direction};
+        scattered = Ray{record._point, direction, ray_in.time()};
 
         return true;
     }
 
 private:
-    double _refraction_index;
+    Real _refraction_index;
+};
+
+// A material is one of a closed set of kinds held by value.  scatter()
+// switches on the kind rather than making a virtual call, and materials sit
+// contiguously in a MaterialTable instead of behind individual pointers.
+class Material
+{
+public:
+    explicit Material(const Lambertian &lambertian) : _kind(lambertian)
+    {
+    }
+
+    explicit Material(const Metal &metal) : _kind(metal)
+    {
+    }
+
+    explicit Material(const Dielectric &dielectric) : _kind(dielectric)
+    {
+    }
+
+    bool scatter(const Ray &ray_in,
+                 const HitRecord &record,
+                 Colour &attenuation,
+                 Ray &scattered,
+                 const Sample2 &sample) const
+    {
+        switch (_kind.index())
+        {
+        case kLambertian:
+            return std::get_if<kLambertian>(&_kind)->scatter(
+                ray_in, record, attenuation, scattered, sample);
+        case kMetal:
+            return std::get_if<kMetal>(&_kind)->scatter(
+                ray_in, record, attenuation, scattered, sample);
+        default:
+            return std::get_if<kDielectric>(&_kind)->scatter(
+                ray_in, record, attenuation, scattered, sample);
+        }
+    }
+
+    // The colour the material tints light with at a hit, as the denoiser's
+    // albedo feature: white for dielectrics.
+    [[nodiscard]] Colour albedo(const HitRecord &record) const
+    {
+        switch (_kind.index())
+        {
+        case kLambertian:
+            return std::get_if<kLambertian>(&_kind)->albedo().value(record);
+        case kMetal:
+            return std::get_if<kMetal>(&_kind)->albedo().value(record);
+        default:
+            return Colour{1.0, 1.0, 1.0};
+        }
+    }
+
+    // True for glass and metal with little fuzz, which show a recognisable
+    // image of what lies beyond them.
+    [[nodiscard]] bool is_specular() const
+    {
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        constexpr Real kPolishedFuzz{0.25_r};
+        const Metal *metal{std::get_if<kMetal>(&_kind)};
+        return _kind.index() == kDielectric ||
+               (metal != nullptr && metal->fuzz() < kPolishedFuzz);
+    }
+
+    // The material as the given kind, or null if it is another kind.
+    template <typename Kind>
+    [[nodiscard]] const Kind *get_if() const
+    {
+        return std::get_if<Kind>(&_kind);
+    }
+
+private:
+    static constexpr std::size_t kLambertian{0};
+    static constexpr std::size_t kMetal{1};
+    static constexpr std::size_t kDielectric{2};
+
+    std::variant<Lambertian, Metal, Dielectric> _kind;
+};
+
+// Scene-owned store of every material, addressed by the MaterialId that
+// primitives record in HitRecord.
+class MaterialTable
+{
+public:
+    template <typename Kind>
+    MaterialId add(const Kind &kind)
+    {
+        _materials.emplace_back(kind);
+        return static_cast<MaterialId>(_materials.size() - 1);
+    }
+
+    // Replaces a material, keeping its id.
+    template <typename Kind>
+    void set(MaterialId material, const Kind &kind)
+    {
+        _materials[material] = Material{kind};
+    }
+
+    [[nodiscard]] const Material &operator[](MaterialId material) const
+    {
+        return _materials[material];
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return _materials.size();
+    }
+
+private:
+    std::vector<Material> _materials;
 };
 
 #endif
@@ -0,0 +1,264 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include "aabb.h"
+#include "bvh.h"
+#include "hittable.h"
+#include "render_counters.h"
+#include "vec3.h"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Three vertex indices, counter-clockwise seen from the front.
+using Triangle = std::array<std::uint32_t, 3>;
+
+// Indexed triangle mesh: a vertex buffer shared by all triangles, optional
+// per-vertex normals, and one index triple per triangle, all with a single
+// material.  Construction builds a hierarchy over the triangles and stores
+// them in its leaf order, so a leaf reads a contiguous run of triples.
+//
+// Rays are tested with the watertight algorithm of Woop, Benthin and Wald
+// ("Watertight Ray/Triangle Intersection", 2013): the ray is sheared onto
+// the z axis and the edge functions are evaluated in that frame, so a ray
+// through a shared edge or vertex hits at least one of the triangles there
+// and cannot slip through a closed mesh.
+class TriangleMesh : public Hittable
+{
+public:
+    // `normals` is either empty or holds one normal per vertex.
+    TriangleMesh(std::vector<Point3> positions,
+                 std::vector<Vec3> normals,
+                 std::vector<Triangle> triangles,
+                 MaterialId material)
+        : _positions(std::move(positions)), _normals(std::move(normals)),
+          _triangles(std::move(triangles)), _material(material)
+    {
+        std::vector<Aabb> bounds;
+        bounds.reserve(_triangles.size());
+        for (const Triangle &triangle : _triangles)
+        {
+            bounds.push_back(triangle_bounds(triangle));
+        }
+        const BvhTree tree{bounds};
+
+        std::vector<Triangle> ordered;
+        ordered.reserve(_triangles.size());
+        for (const std::uint32_t index : tree.order())
+        {
+            ordered.push_back(_triangles[index]);
+        }
+        _triangles = std::move(ordered);
+        _tree = BvhTree{tree.nodes()};
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return _triangles.size();
+    }
+
+    [[nodiscard]] const std::vector<Point3> &positions() const
+    {
+        return _positions;
+    }
+
+    [[nodiscard]] const std::vector<Vec3> &normals() const
+    {
+        return _normals;
+    }
+
+    // The triangles in hierarchy leaf order.
+    [[nodiscard]] const std::vector<Triangle> &triangles() const
+    {
+        return _triangles;
+    }
+
+    [[nodiscard]] MaterialId material() const
+    {
+        return _material;
+    }
+
+    [[nodiscard]] const BvhTree &hierarchy() const
+    {
+        return _tree;
+    }
+
+    // Bytes held by the vertex, normal, index and node arrays.
+    [[nodiscard]] std::size_t memory_bytes() const
+    {
+        return _positions.capacity() * sizeof(Point3) +
+               _normals.capacity() * sizeof(Vec3) +
+               _triangles.capacity() * sizeof(Triangle) +
+               _tree.nodes().capacity() * sizeof(BvhNode);
+    }
+
+    bool hit(const Ray &ray, Interval ray_t, HitRecord &record) const override
+    {
+        const ShearedRay sheared{ray};
+        std::size_t closest_index{size()};
+        Barycentrics closest{};
+        _tree.hit(ray,
+                  ray_t,
+                  [this, &sheared, &closest, &closest_index](
+                      std::uint32_t position, Interval &leaf_t) {
+                      RT_COUNT(_primitives_tested, 1U);
+                      Barycentrics hit{};
+                      if (!intersect(
+                              sheared, _triangles[position], leaf_t, hit))
+                      {
+                          return false;
+                      }
+                      leaf_t._max = hit._t;
+                      closest = hit;
+                      closest_index = position;
+                      return true;
+                  });
+        if (closest_index == size())
+        {
+            return false;
+        }
+
+        const Triangle &triangle{_triangles[closest_index]};
+        const Point3 &p0{_positions[triangle[0]]};
+        const Vec3 area_normal{cross(_positions[triangle[1]] - p0,
+                                     _positions[triangle[2]] - p0)};
+        const Real twice_area{area_normal.length()};
+        record._t_interval = closest._t;
+        record._point = ray.at(record._t_interval);
+        record.set_face_normal(ray, area_normal / twice_area);
+        // without texture coordinates of its own, each triangle maps the
+        // unit right triangle of its barycentrics
+        record.set_uv(closest._v, closest._w, 1 / std::sqrt(twice_area));
+        if (!_normals.empty())
+        {
+            // interpolated normals shade smoothly, on the geometric side
+            const Vec3 shading{
+                unit_vector(closest._u * _normals[triangle[0]] +
+                            closest._v * _normals[triangle[1]] +
+                            closest._w * _normals[triangle[2]])};
+            record._normal = record._front_face ? shading : -shading;
+        }
+        record._material = _material;
+        return true;
+    }
+
+    [[nodiscard]] Aabb bounding_box() const override
+    {
+        return _tree.bounding_box();
+    }
+
+private:
+    std::vector<Point3> _positions;
+    std::vector<Vec3> _normals;
+    std::vector<Triangle> _triangles;
+    MaterialId _material;
+    BvhTree _tree;
+
+    // The ray's per-ray part of the watertight test: the axis along which
+    // its direction is largest becomes z, and the shear that maps the
+    // direction onto z.
+    struct ShearedRay
+    {
+        Point3 _origin;
+        int _kx{0};
+        int _ky{1};
+        int _kz{2};
+        Real _shear_x{0};
+        Real _shear_y{0};
+        Real _shear_z{1};
+
+        explicit ShearedRay(const Ray &ray) : _origin(ray.origin())
+        {
+            const Vec3 &direction{ray.direction()};
+            const Real x{std::fabs(direction.x())};
+            const Real y{std::fabs(direction.y())};
+            const Real z{std::fabs(direction.z())};
+            _kz = x > y ? (x > z ? 0 : 2) : (y > z ? 1 : 2);
+            _kx = (_kz + 1) % 3;
+            _ky = (_kx + 1) % 3;
+            if (direction[_kz] < 0)
+            {
+                std::swap(_kx, _ky); // keep the winding
+            }
+            _shear_x = direction[_kx] / direction[_kz];
+            _shear_y = direction[_ky] / direction[_kz];
+            _shear_z = 1 / direction[_kz];
+        }
+    };
+
+    // Hit distance and the weights of the triangle's three vertices there.
+    struct Barycentrics
+    {
+        Real _t;
+        Real _u;
+        Real _v;
+        Real _w;
+    };
+
+    [[nodiscard]] Aabb triangle_bounds(const Triangle &triangle) const
+    {
+        return Aabb{Aabb{_positions[triangle[0]], _positions[triangle[1]]},
+                    Aabb{_positions[triangle[2]], _positions[triangle[2]]}};
+    }
+
+    [[nodiscard]] bool intersect(const ShearedRay &ray,
+                                 const Triangle &triangle,
+                                 Interval ray_t,
+                                 Barycentrics &hit) const
+    {
+        const Vec3 a{_positions[triangle[0]] - ray._origin};
+        const Vec3 b{_positions[triangle[1]] - ray._origin};
+        const Vec3 c{_positions[triangle[2]] - ray._origin};
+        const Real ax{a[ray._kx] - ray._shear_x * a[ray._kz]};
+        const Real ay{a[ray._ky] - ray._shear_y * a[ray._kz]};
+        const Real bx{b[ray._kx] - ray._shear_x * b[ray._kz]};
+        const Real by{b[ray._ky] - ray._shear_y * b[ray._kz]};
+        const Real cx{c[ray._kx] - ray._shear_x * c[ray._kz]};
+        const Real cy{c[ray._ky] - ray._shear_y * c[ray._kz]};
+
+        // scaled barycentrics: the edge functions in the sheared frame
+        Real u{cx * by - cy * bx};
+        Real v{ax * cy - ay * cx};
+        Real w{bx * ay - by * ax};
+        if constexpr (sizeof(Real) < sizeof(double))
+        {
+            // a zero may be rounding; decide edge hits in double precision
+            if (u == 0 || v == 0 || w == 0)
+            {
+                u = static_cast<Real>(double{cx} * double{by} -
+                                      double{cy} * double{bx});
+                v = static_cast<Real>(double{ax} * double{cy} -
+                                      double{ay} * double{cx});
+                w = static_cast<Real>(double{bx} * double{ay} -
+                                      double{by} * double{ax});
+            }
+        }
+        if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0))
+        {
+            return false;
+        }
+        const Real determinant{u + v + w};
+        if (determinant == 0)
+        {
+            return false;
+        }
+
+        const Real t{(u * ray._shear_z * a[ray._kz] +
+                      v * ray._shear_z * b[ray._kz] +
+                      w * ray._shear_z * c[ray._kz]) /
+                     determinant};
+        if (!ray_t.surrounds(t))
+        {
+            return false;
+        }
+        const Real inverse{1 / determinant};
+        hit = {t, u * inverse, v * inverse, w * inverse};
+        return true;
+    }
+};
+
+#endif
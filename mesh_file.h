@@ -0,0 +1,893 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include "hittable.h"
+#include "mapped_file.h"
+#include "mesh.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Loaders for triangle meshes in Wavefront OBJ and Stanford PLY files.  Both
+// parse straight out of a memory mapping of the file, with no line buffer or
+// stream, and polygons are split into fans of triangles.
+//
+// OBJ: `v X Y Z` and `vn X Y Z` lines, and `f` lines whose corners are
+// `V`, `V/T`, `V//N` or `V/T/N`, counting from 1 or, when negative, back
+// from the latest vertex.  Other lines are skipped.  An OBJ normal belongs
+// to a face corner, so a vertex used with two different normals is split
+// in two.  Normals are kept only if every corner has one.
+//
+// PLY: ASCII and binary of either byte order, with a `vertex` element
+// holding x, y, z and optionally nx, ny, nz, and a `face` element holding a
+// `vertex_indices` (or `vertex_index`) list.  Other properties and elements
+// are skipped.
+namespace mesh_file_detail
+{
+// Reads numbers and words from a span of text with no terminating NUL.
+class TextCursor
+{
+public:
+    explicit TextCursor(std::span<const std::byte> bytes)
+        : _cursor(reinterpret_cast<const char *>(bytes.data())),
+          _end(_cursor + bytes.size())
+    {
+    }
+
+    [[nodiscard]] bool at_end() const
+    {
+        return _cursor == _end;
+    }
+
+    [[nodiscard]] const char *position() const
+    {
+        return _cursor;
+    }
+
+    // Skips spaces and tabs, but not line ends.
+    void skip_spaces()
+    {
+        while (_cursor != _end &&
+               (*_cursor == ' ' || *_cursor == '\t' || *_cursor == '\r'))
+        {
+            ++_cursor;
+        }
+    }
+
+    // Skips all white space, line ends included.
+    void skip_white_space()
+    {
+        while (_cursor != _end &&
+               std::isspace(static_cast<unsigned char>(*_cursor)) != 0)
+        {
+            ++_cursor;
+        }
+    }
+
+    [[nodiscard]] bool at_line_end()
+    {
+        skip_spaces();
+        return _cursor == _end || *_cursor == '\n';
+    }
+
+    void next_line()
+    {
+        const void *newline{std::memchr(
+            _cursor, '\n', static_cast<std::size_t>(_end - _cursor))};
+        _cursor = newline == nullptr ? _end
+                                     : static_cast<const char *>(newline) + 1;
+    }
+
+    // The next run of non-blank characters on the line.
+    std::string_view word()
+    {
+        skip_spaces();
+        const char *start{_cursor};
+        while (_cursor != _end && std::isspace(static_cast<unsigned char>(
+                                      *_cursor)) == 0)
+        {
+            ++_cursor;
+        }
+        return {start, static_cast<std::size_t>(_cursor - start)};
+    }
+
+    [[nodiscard]] bool peek(char character) const
+    {
+        return _cursor != _end && *_cursor == character;
+    }
+
+    void skip()
+    {
+        ++_cursor;
+    }
+
+    bool integer(std::int64_t &value)
+    {
+        skip_spaces();
+        const bool negative{peek('-')};
+        if (negative || peek('+'))
+        {
+            ++_cursor;
+        }
+        const char *start{_cursor};
+        std::uint64_t magnitude{0};
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        constexpr std::uint64_t kLimit{std::uint64_t{1} << 62U};
+        while (_cursor != _end && is_digit(*_cursor) && magnitude < kLimit)
+        {
+            magnitude = 10 * magnitude + static_cast<std::uint64_t>(
+                                             *_cursor++ - '0');
+        }
+        if (_cursor == start)
+        {
+            return false;
+        }
+        value = negative ? -static_cast<std::int64_t>(magnitude)
+                         : static_cast<std::int64_t>(magnitude);
+        return true;
+    }
+
+    // A decimal number.  Numbers of up to 15 significant digits and small
+    // exponents, which covers what exporters write, are converted exactly
+    // by one multiplication or division by a power of ten (Clinger's fast
+    // path); anything else goes through strtod.
+    bool real(double &value)
+    {
+        skip_spaces();
+        const char *start{_cursor};
+        const bool negative{peek('-')};
+        if (negative || peek('+'))
+        {
+            ++_cursor;
+        }
+        std::uint64_t mantissa{0};
+        int digits{0};
+        int exponent{0};
+        bool any_digit{false};
+        const auto take_digits{[&](bool fraction) {
+            while (_cursor != _end && is_digit(*_cursor))
+            {
+                any_digit = true;
+                if (mantissa == 0 && *_cursor == '0')
+                {
+                    exponent -= fraction ? 1 : 0;
+                }
+                else if (digits < kMaxDigits)
+                {
+                    mantissa = 10 * mantissa +
+                               static_cast<std::uint64_t>(*_cursor - '0');
+                    ++digits;
+                    exponent -= fraction ? 1 : 0;
+                }
+                else
+                {
+                    digits = kMaxDigits + 1; // too many to be exact
+                    exponent += fraction ? 0 : 1;
+                }
+                ++_cursor;
+            }
+        }};
+        take_digits(false);
+        if (peek('.'))
+        {
+            ++_cursor;
+            take_digits(true);
+        }
+        if (!any_digit)
+        {
+            _cursor = start;
+            return false;
+        }
+        if (peek('e') || peek('E'))
+        {
+            ++_cursor;
+            std::int64_t written{0};
+            if (!integer(written))
+            {
+                return false;
+            }
+            exponent += static_cast<int>(std::clamp<std::int64_t>(
+                written, -kExponentLimit, kExponentLimit));
+        }
+        if (_cursor != _end && std::isalpha(static_cast<unsigned char>(
+                                   *_cursor)) != 0)
+        {
+            return false; // inf, nan or garbage
+        }
+
+        if (digits <= kMaxDigits && exponent >= -kMaxPower &&
+            exponent <= kMaxPower)
+        {
+            const auto exact{static_cast<double>(mantissa)};
+            value = exponent < 0
+                        ? exact / kPowers[static_cast<std::size_t>(-exponent)]
+                        : exact * kPowers[static_cast<std::size_t>(exponent)];
+        }
+        else
+        {
+            const std::string copy{start, _cursor};
+            value = std::strtod(copy.c_str(), nullptr);
+            return true;
+        }
+        value = negative ? -value : value;
+        return true;
+    }
+
+private:
+    // NOLINTBEGIN(readability-magic-numbers)
+    static constexpr int kMaxDigits{15};
+    static constexpr int kMaxPower{22};
+    static constexpr std::int64_t kExponentLimit{100000};
+    static constexpr std::array<double, kMaxPower + 1> kPowers{
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+        1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+        1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    // NOLINTEND(readability-magic-numbers)
+
+    const char *_cursor;
+    const char *_end;
+
+    static bool is_digit(char character)
+    {
+        return character >= '0' && character <= '9';
+    }
+};
+
+// Vertex attributes as read, before becoming a TriangleMesh.
+struct MeshData
+{
+    std::vector<Point3> _positions;
+    std::vector<Vec3> _normals;
+    std::vector<Triangle> _triangles;
+};
+
+// Appends the fan of triangles over a polygon's corners.
+inline void add_polygon(std::span<const std::uint32_t> corners,
+                        std::vector<Triangle> &triangles)
+{
+    for (std::size_t corner{2}; corner < corners.size(); ++corner)
+    {
+        triangles.push_back(
+            {corners[0], corners[corner - 1], corners[corner]});
+    }
+}
+
+inline Point3 to_point(double x, double y, double z)
+{
+    return {static_cast<Real>(x), static_cast<Real>(y), static_cast<Real>(z)};
+}
+
+inline bool parse_obj(std::span<const std::byte> bytes,
+                      MeshData &mesh,
+                      std::string &error)
+{
+    std::vector<Vec3> file_normals;
+    // each file vertex's position in the mesh, which the copies below make
+    // differ from its position in the file
+    std::vector<std::uint32_t> file_vertices;
+    // the file normal each mesh vertex was first used with, and the copies
+    // made for later uses with other normals
+    std::vector<std::uint32_t> vertex_normal;
+    std::unordered_map<std::uint64_t, std::uint32_t> split_vertices;
+    bool every_corner_has_normal{true};
+    std::vector<std::uint32_t> corners;
+    constexpr auto kNone{std::numeric_limits<std::uint32_t>::max()};
+
+    // OBJ counts from 1, or backwards from the end when negative
+    const auto resolve{[](std::int64_t index, std::size_t count,
+                          std::uint32_t &resolved) {
+        const std::int64_t position{
+            index < 0 ? static_cast<std::int64_t>(count) + index : index - 1};
+        if (index == 0 || position < 0 ||
+            position >= static_cast<std::int64_t>(count))
+        {
+            return false;
+        }
+        resolved = static_cast<std::uint32_t>(position);
+        return true;
+    }};
+
+    std::size_t line{1};
+    for (TextCursor cursor{bytes}; !cursor.at_end(); cursor.next_line(), ++line)
+    {
+        const std::string_view keyword{cursor.word()};
+        std::array<double, 3> values{};
+        if (keyword == "v" || keyword == "vn")
+        {
+            if (!cursor.real(values[0]) || !cursor.real(values[1]) ||
+                !cursor.real(values[2]))
+            {
+                error = "line " + std::to_string(line) + ": bad vertex";
+                return false;
+            }
+            if (keyword == "v")
+            {
+                file_vertices.push_back(
+                    static_cast<std::uint32_t>(mesh._positions.size()));
+                mesh._positions.push_back(
+                    to_point(values[0], values[1], values[2]));
+                vertex_normal.push_back(kNone);
+            }
+            else
+            {
+                file_normals.push_back(
+                    to_point(values[0], values[1], values[2]));
+            }
+        }
+        else if (keyword == "f")
+        {
+            corners.clear();
+            while (!cursor.at_line_end())
+            {
+                std::int64_t index{0};
+                std::uint32_t vertex{0};
+                std::uint32_t normal{kNone};
+                if (!cursor.integer(index) ||
+                    !resolve(index, file_vertices.size(), vertex))
+                {
+                    error = "line " + std::to_string(line) +
+                            ": bad face vertex";
+                    return false;
+                }
+                vertex = file_vertices[vertex];
+                if (cursor.peek('/'))
+                {
+                    cursor.skip();
+                    std::int64_t ignored{0};
+                    if (!cursor.peek('/'))
+                    {
+                        static_cast<void>(cursor.integer(ignored));
+                    }
+                    if (cursor.peek('/'))
+                    {
+                        cursor.skip();
+                        if (!cursor.integer(index) ||
+                            !resolve(index, file_normals.size(), normal))
+                        {
+                            error = "line " + std::to_string(line) +
+                                    ": bad face normal";
+                            return false;
+                        }
+                    }
+                }
+                if (normal == kNone)
+                {
+                    every_corner_has_normal = false;
+                }
+                else if (vertex_normal[vertex] == kNone)
+                {
+                    vertex_normal[vertex] = normal;
+                }
+                else if (vertex_normal[vertex] != normal)
+                {
+                    const std::uint64_t key{
+                        (std::uint64_t{vertex} << 32U) | normal};
+                    const auto [entry, inserted]{split_vertices.try_emplace(
+                        key,
+                        static_cast<std::uint32_t>(mesh._positions.size()))};
+                    if (inserted)
+                    {
+                        mesh._positions.push_back(mesh._positions[vertex]);
+                        vertex_normal.push_back(normal);
+                    }
+                    vertex = entry->second;
+                }
+                corners.push_back(vertex);
+            }
+            add_polygon(corners, mesh._triangles);
+        }
+    }
+
+    if (every_corner_has_normal && !file_normals.empty())
+    {
+        mesh._normals.reserve(mesh._positions.size());
+        for (const std::uint32_t normal : vertex_normal)
+        {
+            // vertices no face uses get any normal
+            mesh._normals.push_back(
+                unit_vector(file_normals[normal == kNone ? 0 : normal]));
+        }
+    }
+    return true;
+}
+
+enum class PlyFormat
+{
+    kAscii,
+    kLittleEndian,
+    kBigEndian,
+};
+
+enum class PlyType
+{
+    kInt8,
+    kUint8,
+    kInt16,
+    kUint16,
+    kInt32,
+    kUint32,
+    kFloat32,
+    kFloat64,
+};
+
+inline std::optional<PlyType> ply_type(std::string_view name)
+{
+    if (name == "char" || name == "int8")
+    {
+        return PlyType::kInt8;
+    }
+    if (name == "uchar" || name == "uint8")
+    {
+        return PlyType::kUint8;
+    }
+    if (name == "short" || name == "int16")
+    {
+        return PlyType::kInt16;
+    }
+    if (name == "ushort" || name == "uint16")
+    {
+        return PlyType::kUint16;
+    }
+    if (name == "int" || name == "int32")
+    {
+        return PlyType::kInt32;
+    }
+    if (name == "uint" || name == "uint32")
+    {
+        return PlyType::kUint32;
+    }
+    if (name == "float" || name == "float32")
+    {
+        return PlyType::kFloat32;
+    }
+    if (name == "double" || name == "float64")
+    {
+        return PlyType::kFloat64;
+    }
+    return std::nullopt;
+}
+
+struct PlyProperty
+{
+    std::string _name;
+    PlyType _type;
+    std::optional<PlyType> _count_type; // set for list properties
+};
+
+struct PlyElement
+{
+    std::string _name;
+    std::size_t _count{0};
+    std::vector<PlyProperty> _properties;
+};
+
+// Reads PLY values in the body's format, as doubles.
+class PlyReader
+{
+public:
+    PlyReader(std::span<const std::byte> body, PlyFormat format)
+        : _text(body), _bytes(body), _format(format)
+    {
+    }
+
+    bool read(PlyType type, double &value)
+    {
+        if (_format == PlyFormat::kAscii)
+        {
+            _text.skip_white_space(); // ASCII items may span lines
+            return _text.real(value);
+        }
+        switch (type)
+        {
+        case PlyType::kInt8:
+            return read_binary<std::int8_t>(value);
+        case PlyType::kUint8:
+            return read_binary<std::uint8_t>(value);
+        case PlyType::kInt16:
+            return read_binary<std::int16_t>(value);
+        case PlyType::kUint16:
+            return read_binary<std::uint16_t>(value);
+        case PlyType::kInt32:
+            return read_binary<std::int32_t>(value);
+        case PlyType::kUint32:
+            return read_binary<std::uint32_t>(value);
+        case PlyType::kFloat32:
+            return read_binary<float>(value);
+        case PlyType::kFloat64:
+            return read_binary<double>(value);
+        }
+        return false;
+    }
+
+private:
+    TextCursor _text;
+    std::span<const std::byte> _bytes;
+    std::size_t _offset{0};
+    PlyFormat _format;
+
+    template <typename T>
+    bool read_binary(double &value)
+    {
+        if (_bytes.size() - _offset < sizeof(T))
+        {
+            return false;
+        }
+        std::array<std::byte, sizeof(T)> raw{};
+        std::memcpy(raw.data(), _bytes.data() + _offset, sizeof(T));
+        _offset += sizeof(T);
+        if ((_format == PlyFormat::kBigEndian) !=
+            (std::endian::native == std::endian::big))
+        {
+            std::reverse(raw.begin(), raw.end());
+        }
+        value = static_cast<double>(std::bit_cast<T>(raw));
+        return true;
+    }
+};
+
+// Parses the header up to end_header, leaving `body` at the data.
+inline bool parse_ply_header(std::span<const std::byte> bytes,
+                             PlyFormat &format,
+                             std::vector<PlyElement> &elements,
+                             std::span<const std::byte> &body,
+                             std::string &error)
+{
+    TextCursor cursor{bytes};
+    if (cursor.word() != "ply")
+    {
+        error = "not a PLY file";
+        return false;
+    }
+    bool have_format{false};
+    for (cursor.next_line(); !cursor.at_end(); cursor.next_line())
+    {
+        const std::string_view keyword{cursor.word()};
+        if (keyword == "format")
+        {
+            const std::string_view name{cursor.word()};
+            have_format = true;
+            if (name == "ascii")
+            {
+                format = PlyFormat::kAscii;
+            }
+            else if (name == "binary_little_endian")
+            {
+                format = PlyFormat::kLittleEndian;
+            }
+            else if (name == "binary_big_endian")
+            {
+                format = PlyFormat::kBigEndian;
+            }
+            else
+            {
+                error = "unknown PLY format " + std::string{name};
+                return false;
+            }
+        }
+        else if (keyword == "element")
+        {
+            PlyElement element{std::string{cursor.word()}, 0, {}};
+            std::int64_t count{0};
+            if (!cursor.integer(count) || count < 0)
+            {
+                error = "bad element count";
+                return false;
+            }
+            element._count = static_cast<std::size_t>(count);
+            elements.push_back(std::move(element));
+        }
+        else if (keyword == "property")
+        {
+            std::string_view type_name{cursor.word()};
+            std::optional<PlyType> count_type;
+            if (type_name == "list")
+            {
+                count_type = ply_type(cursor.word());
+                type_name = cursor.word();
+                if (!count_type)
+                {
+                    error = "bad list count type";
+                    return false;
+                }
+            }
+            const std::optional<PlyType> type{ply_type(type_name)};
+            if (!type || elements.empty())
+            {
+                error = "bad property " + std::string{type_name};
+                return false;
+            }
+            elements.back()._properties.push_back(
+                {std::string{cursor.word()}, *type, count_type});
+        }
+        else if (keyword == "end_header")
+        {
+            cursor.next_line();
+            const auto offset{static_cast<std::size_t>(
+                cursor.position() -
+                reinterpret_cast<const char *>(bytes.data()))};
+            body = bytes.subspan(offset);
+            if (!have_format)
+            {
+                error = "no PLY format line";
+            }
+            return have_format;
+        }
+    }
+    error = "no end_header";
+    return false;
+}
+
+inline bool parse_ply(std::span<const std::byte> bytes,
+                      MeshData &mesh,
+                      std::string &error)
+{
+    PlyFormat format{PlyFormat::kAscii};
+    std::vector<PlyElement> elements;
+    std::span<const std::byte> body;
+    if (!parse_ply_header(bytes, format, elements, body, error))
+    {
+        return false;
+    }
+
+    PlyReader reader{body, format};
+    std::vector<double> values;
+    std::vector<std::uint32_t> corners;
+    for (const PlyElement &element : elements)
+    {
+        const bool is_vertex{element._name == "vertex"};
+        const bool is_face{element._name == "face"};
+        // slots 0-2 position, 3-5 normal; -1 for properties not kept
+        std::vector<int> slot(element._properties.size(), -1);
+        std::size_t normal_slots{0};
+        for (std::size_t index{0}; index < element._properties.size(); ++index)
+        {
+            const PlyProperty &property{element._properties[index]};
+            constexpr std::array<std::string_view, 6> kNames{
+                "x", "y", "z", "nx", "ny", "nz"};
+            const auto *found{
+                std::find(kNames.begin(), kNames.end(), property._name)};
+            if (is_vertex && found != kNames.end() && !property._count_type)
+            {
+                slot[index] = static_cast<int>(found - kNames.begin());
+                normal_slots += slot[index] >= 3 ? 1U : 0U;
+            }
+            if (is_face && property._count_type &&
+                (property._name == "vertex_indices" ||
+                 property._name == "vertex_index"))
+            {
+                slot[index] = 0;
+            }
+        }
+        // reserve no more than the body could hold, whatever the header says
+        const std::size_t reserve{std::min(element._count, body.size())};
+        if (is_vertex)
+        {
+            mesh._positions.reserve(reserve);
+            if (normal_slots == 3)
+            {
+                mesh._normals.reserve(reserve);
+            }
+        }
+        if (is_face)
+        {
+            mesh._triangles.reserve(reserve);
+        }
+
+        for (std::size_t item{0}; item < element._count; ++item)
+        {
+            std::array<double, 6> attributes{};
+            for (std::size_t index{0}; index < element._properties.size();
+                 ++index)
+            {
+                const PlyProperty &property{element._properties[index]};
+                double value{0.0};
+                if (!property._count_type)
+                {
+                    if (!reader.read(property._type, value))
+                    {
+                        error = "truncated " + element._name + " data";
+                        return false;
+                    }
+                    if (slot[index] >= 0)
+                    {
+                        attributes[static_cast<std::size_t>(slot[index])] =
+                            value;
+                    }
+                    continue;
+                }
+                double count{0.0};
+                if (!reader.read(*property._count_type, count) || count < 0)
+                {
+                    error = "truncated " + element._name + " data";
+                    return false;
+                }
+                corners.clear();
+                for (std::size_t entry{0};
+                     entry < static_cast<std::size_t>(count);
+                     ++entry)
+                {
+                    if (!reader.read(property._type, value))
+                    {
+                        error = "truncated " + element._name + " data";
+                        return false;
+                    }
+                    if (slot[index] >= 0)
+                    {
+                        if (value < 0 ||
+                            value >= static_cast<double>(
+                                         mesh._positions.size()))
+                        {
+                            error = "face index out of range";
+                            return false;
+                        }
+                        corners.push_back(static_cast<std::uint32_t>(value));
+                    }
+                }
+                if (slot[index] >= 0)
+                {
+                    add_polygon(corners, mesh._triangles);
+                }
+            }
+            if (is_vertex)
+            {
+                mesh._positions.push_back(
+                    to_point(attributes[0], attributes[1], attributes[2]));
+                if (normal_slots == 3)
+                {
+                    mesh._normals.push_back(unit_vector(to_point(
+                        attributes[3], attributes[4], attributes[5])));
+                }
+            }
+        }
+    }
+    return true;
+}
+
+inline bool has_extension(std::string_view path, std::string_view extension)
+{
+    if (path.size() < extension.size())
+    {
+        return false;
+    }
+    return std::equal(extension.begin(),
+                      extension.end(),
+                      path.end() - static_cast<std::ptrdiff_t>(
+                                       extension.size()),
+                      [](char expected, char actual) {
+                          return expected ==
+                                 std::tolower(static_cast<unsigned char>(
+                                     actual));
+                      });
+}
+} // namespace mesh_file_detail
+
+// Loads the .obj or .ply file at `path` as a mesh of one material.  On
+// failure returns nothing and describes the problem in `error`.
+inline std::optional<TriangleMesh> load_mesh(const std::string &path,
+                                             MaterialId material,
+                                             std::string &error)
+{
+    using namespace mesh_file_detail;
+
+    const bool obj{has_extension(path, ".obj")};
+    if (!obj && !has_extension(path, ".ply"))
+    {
+        error = path + ": not a .obj or .ply file";
+        return std::nullopt;
+    }
+    const MappedFile file{path};
+    if (!file.is_open())
+    {
+        error = "cannot open " + path;
+        return std::nullopt;
+    }
+    MeshData mesh;
+    std::string problem;
+    if (!(obj ? parse_obj(file.bytes(), mesh, problem)
+              : parse_ply(file.bytes(), mesh, problem)))
+    {
+        error = path + ": " + problem;
+        return std::nullopt;
+    }
+    if (mesh._triangles.empty())
+    {
+        error = path + ": no faces";
+        return std::nullopt;
+    }
+    return TriangleMesh{std::move(mesh._positions),
+                        std::move(mesh._normals),
+                        std::move(mesh._triangles),
+                        material};
+}
+
+// Writes the mesh as binary PLY in the machine's byte order, with float
+// coordinates and normals if it has them.
+inline void write_ply(std::ostream &output, const TriangleMesh &mesh)
+{
+    const bool normals{!mesh.normals().empty()};
+    output << "ply\nformat "
+           << (std::endian::native == std::endian::big
+                   ? "binary_big_endian"
+                   : "binary_little_endian")
+           << " 1.0\nelement vertex " << mesh.positions().size()
+           << "\nproperty float x\nproperty float y\nproperty float z\n";
+    if (normals)
+    {
+        output << "property float nx\nproperty float ny\nproperty float nz\n";
+    }
+    output << "element face " << mesh.size()
+           << "\nproperty list uchar uint vertex_indices\nend_header\n";
+
+    std::vector<char> buffer;
+    const auto append{[&buffer](const auto &value) {
+        const auto *bytes{reinterpret_cast<const char *>(&value)};
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(value));
+    }};
+    for (std::size_t index{0}; index < mesh.positions().size(); ++index)
+    {
+        const Point3 &position{mesh.positions()[index]};
+        for (int axis{0}; axis < 3; ++axis)
+        {
+            append(static_cast<float>(position[axis]));
+        }
+        for (int axis{0}; normals && axis < 3; ++axis)
+        {
+            append(static_cast<float>(mesh.normals()[index][axis]));
+        }
+    }
+    for (const Triangle &triangle : mesh.triangles())
+    {
+        append(std::uint8_t{3});
+        append(triangle);
+    }
+    output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
+
+// Writes the mesh as OBJ text, with `vn` lines and `V//N` corners if it has
+// normals.
+inline void write_obj(std::ostream &output, const TriangleMesh &mesh)
+{
+    const bool normals{!mesh.normals().empty()};
+    output << std::setprecision(std::numeric_limits<float>::max_digits10);
+    for (const Point3 &position : mesh.positions())
+    {
+        output << "v " << position.x() << ' ' << position.y() << ' '
+               << position.z() << '\n';
+    }
+    for (const Vec3 &normal : mesh.normals())
+    {
+        output << "vn " << normal.x() << ' ' << normal.y() << ' '
+               << normal.z() << '\n';
+    }
+    for (const Triangle &triangle : mesh.triangles())
+    {
+        output << 'f';
+        for (const std::uint32_t vertex : triangle)
+        {
+            output << ' ' << vertex + 1;
+            if (normals)
+            {
+                output << "//" << vertex + 1;
+            }
+        }
+        output << '\n';
+    }
+}
+
+#endif
@@ -0,0 +1,394 @@
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include "camera.h"
+#include "framebuffer.h"
+#include "image_writer.h"
+#include "mapped_file.h"
+#include "scene.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Interactive preview.  run_preview renders in passes of one sample per
+// pixel and after every pass copies the image into a shared mapping of a
+// file.  The file is a binary PPM whose comment line counts frames, so any
+// viewer that reloads a changed file shows the render as it refines; on
+// Linux, put it under /dev/shm to keep it in memory.  Each line written to
+// the control FIFO is a command that moves the camera:
+//
+//   look_from X Y Z        look_at X Y Z        vertical_fov DEGREES
+//   defocus_angle DEGREES  focus_dist DISTANCE  quit
+//
+// A command stops the render after the tiles in flight, which at one sample
+// per pixel take about a millisecond each, and starts accumulating afresh.
+namespace preview_detail
+{
+// NOLINTNEXTLINE(readability-magic-numbers)
+constexpr int kPollMilliseconds{50}; // how often the reader checks for quit
+constexpr int kFrameDigits{20};
+
+// The camera settings the control FIFO can change.
+struct View
+{
+    Point3 _look_from;
+    Point3 _look_at;
+    double _vertical_fov;
+    double _defocus_angle;
+    double _focus_dist;
+};
+
+inline View view_of(const Camera &camera)
+{
+    return {camera._look_from,
+            camera._look_at,
+            camera._vertical_fov,
+            camera._defocus_angle,
+            camera._focus_dist};
+}
+
+inline void apply(const View &view, Camera &camera)
+{
+    camera._look_from = view._look_from;
+    camera._look_at = view._look_at;
+    camera._vertical_fov = view._vertical_fov;
+    camera._defocus_angle = view._defocus_angle;
+    camera._focus_dist = view._focus_dist;
+}
+
+// Applies one command line to `view`, or sets `quit`.  Returns false, with
+// `view` unchanged, for a malformed command.
+inline bool parse_command(std::string_view line, View &view, bool &quit)
+{
+    std::istringstream input{std::string{line}};
+    std::string name;
+    input >> name;
+    View changed{view};
+    if (name == "quit")
+    {
+        quit = true;
+        return true;
+    }
+    if (name == "look_from" || name == "look_at")
+    {
+        double x{0.0};
+        double y{0.0};
+        double z{0.0};
+        input >> x >> y >> z;
+        (name == "look_from" ? changed._look_from : changed._look_at) =
+            Point3{static_cast<Real>(x),
+                   static_cast<Real>(y),
+                   static_cast<Real>(z)};
+    }
+    else if (name == "vertical_fov")
+    {
+        input >> changed._vertical_fov;
+    }
+    else if (name == "defocus_angle")
+    {
+        input >> changed._defocus_angle;
+    }
+    else if (name == "focus_dist")
+    {
+        input >> changed._focus_dist;
+    }
+    else
+    {
+        return false;
+    }
+    std::string rest;
+    if (input.fail() || (input >> rest))
+    {
+        return false;
+    }
+    view = changed;
+    return true;
+}
+
+// The shared preview image: a binary PPM of fixed size, rewritten in place.
+// The frame number in its comment line is written after the pixels, so a
+// viewer that sees a new number has the whole frame, though a frame may
+// still be overwritten while it is read.
+class PreviewImage
+{
+public:
+    PreviewImage(const std::string &path, int width, int height)
+        : _header_prefix("P6\n# frame "),
+          _header_suffix('\n' + std::to_string(width) + ' ' +
+                         std::to_string(height) + "\n255\n"),
+          _file(path,
+                header_size() + 3 * static_cast<std::size_t>(width) *
+                                    static_cast<std::size_t>(height))
+    {
+        if (_file.is_open())
+        {
+            write_header(0);
+        }
+    }
+
+    [[nodiscard]] bool is_open() const
+    {
+        return _file.is_open();
+    }
+
+    void publish(const Framebuffer &framebuffer, std::uint64_t frame)
+    {
+        using image_writer_detail::pixel_mean;
+        using image_writer_detail::to_byte;
+
+        std::byte *pixel{_file.bytes().data() + header_size()};
+        for (int j{0}; j < framebuffer.height(); ++j)
+        {
+            for (int i{0}; i < framebuffer.width(); ++i)
+            {
+                const Colour colour{pixel_mean(framebuffer, i, j)};
+                *pixel++ = static_cast<std::byte>(to_byte(colour.x()));
+                *pixel++ = static_cast<std::byte>(to_byte(colour.y()));
+                *pixel++ = static_cast<std::byte>(to_byte(colour.z()));
+            }
+        }
+        write_header(frame);
+    }
+
+private:
+    std::string _header_prefix;
+    std::string _header_suffix;
+    MappedOutputFile _file;
+
+    [[nodiscard]] std::size_t header_size() const
+    {
+        return _header_prefix.size() + kFrameDigits + _header_suffix.size();
+    }
+
+    void write_header(std::uint64_t frame)
+    {
+        std::ostringstream header;
+        header << _header_prefix << std::setw(kFrameDigits)
+               << std::setfill('0') << frame << _header_suffix;
+        const std::string text{header.str()};
+        std::memcpy(_file.bytes().data(), text.data(), text.size());
+    }
+};
+
+// Read end of the control FIFO, created if missing.  It is opened for
+// writing too, so it never reports end of file when a writer closes it.
+class ControlPipe
+{
+public:
+    explicit ControlPipe(const std::string &path)
+    {
+        if (::mkfifo(path.c_str(), 0600) != 0 && errno != EEXIST)
+        {
+            return;
+        }
+        _descriptor = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        struct stat status
+        {
+        };
+        if (_descriptor >= 0 &&
+            (::fstat(_descriptor, &status) != 0 || !S_ISFIFO(status.st_mode)))
+        {
+            ::close(_descriptor);
+            _descriptor = -1;
+        }
+    }
+
+    ControlPipe(const ControlPipe &) = delete;
+    ControlPipe &operator=(const ControlPipe &) = delete;
+
+    ~ControlPipe()
+    {
+        if (_descriptor >= 0)
+        {
+            ::close(_descriptor);
+        }
+    }
+
+    [[nodiscard]] bool is_open() const
+    {
+        return _descriptor >= 0;
+    }
+
+    // Waits up to `timeout_milliseconds` for input and calls handle_line
+    // with each complete line read.
+    template <typename HandleLine>
+    void read_lines(int timeout_milliseconds, const HandleLine &handle_line)
+    {
+        pollfd request{_descriptor, POLLIN, 0};
+        if (::poll(&request, 1, timeout_milliseconds) <= 0)
+        {
+            return;
+        }
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        std::array<char, 4096> buffer{};
+        const ssize_t count{::read(_descriptor, buffer.data(), buffer.size())};
+        if (count <= 0)
+        {
+            return;
+        }
+        _partial.append(buffer.data(), static_cast<std::size_t>(count));
+        for (std::size_t end{_partial.find('\n')}; end != std::string::npos;
+             end = _partial.find('\n'))
+        {
+            handle_line(std::string_view{_partial}.substr(0, end));
+            _partial.erase(0, end + 1);
+        }
+    }
+
+private:
+    int _descriptor{-1};
+    std::string _partial; // input after the last complete line
+};
+} // namespace preview_detail
+
+struct PreviewStats
+{
+    std::uint64_t _frames{0};
+    int _restarts{0};
+    // renders interrupted by a command, and the time from reading the
+    // command to the render returning
+    int _stops{0};
+    double _total_stop_seconds{0.0};
+    double _max_stop_seconds{0.0};
+};
+
+// Renders `scene` into the preview image at `image_path`, restarting when
+// commands arrive on the FIFO at `control_path`, until a quit command; with
+// no control path it renders once.  Returns the framebuffer of the last
+// view, or nothing, with the problem in `error`, if the image or FIFO could
+// not be opened.
+inline std::optional<Framebuffer> run_preview(Scene &scene,
+                                              const std::string &image_path,
+                                              const std::string &control_path,
+                                              PreviewStats &stats,
+                                              std::string &error)
+{
+    using namespace preview_detail;
+    using Clock = std::chrono::steady_clock;
+
+    Camera &camera{scene._camera};
+    const int width{camera._image_width};
+    const int height{camera.image_height()};
+    PreviewImage image{image_path, width, height};
+    if (!image.is_open())
+    {
+        error = "cannot create " + image_path;
+        return std::nullopt;
+    }
+    std::optional<ControlPipe> control;
+    if (!control_path.empty())
+    {
+        control.emplace(control_path);
+        if (!control->is_open())
+        {
+            error = "cannot open " + control_path + " as a FIFO";
+            return std::nullopt;
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    View pending{view_of(camera)};
+    bool restart{false};
+    bool quit{false};
+    Clock::time_point command_time;
+    std::atomic<bool> stop{false};
+    std::atomic<bool> reader_done{false};
+
+    std::thread reader;
+    if (control)
+    {
+        reader = std::thread{[&] {
+            while (!reader_done)
+            {
+                control->read_lines(kPollMilliseconds,
+                                    [&](std::string_view line) {
+                    const std::lock_guard<std::mutex> lock{mutex};
+                    if (!parse_command(line, pending, quit))
+                    {
+                        std::clog << "\nUnknown preview command: " << line
+                                  << '\n';
+                        return;
+                    }
+                    if (!restart)
+                    {
+                        command_time = Clock::now();
+                    }
+                    restart = true;
+                    stop = true;
+                    changed.notify_all();
+                });
+            }
+        }};
+    }
+
+    camera._pass_samples = 1;
+    camera._stop = [&stop] { return stop.load(std::memory_order_relaxed); };
+    camera._on_pass = [&](const Framebuffer &partial) {
+        image.publish(partial, ++stats._frames);
+    };
+
+    Framebuffer framebuffer{width, height};
+    for (;;)
+    {
+        camera.render(scene._spheres, scene._materials, framebuffer);
+
+        std::unique_lock<std::mutex> lock{mutex};
+        if (!control)
+        {
+            break;
+        }
+        if (restart)
+        {
+            const double seconds{
+                std::chrono::duration<double>(Clock::now() - command_time)
+                    .count()};
+            ++stats._stops;
+            stats._total_stop_seconds += seconds;
+            stats._max_stop_seconds =
+                std::max(stats._max_stop_seconds, seconds);
+        }
+        changed.wait(lock, [&] { return restart || quit; });
+        if (quit)
+        {
+            break;
+        }
+        apply(pending, camera);
+        restart = false;
+        stop = false;
+        ++stats._restarts;
+        framebuffer = Framebuffer{width, height};
+    }
+
+    reader_done = true;
+    if (reader.joinable())
+    {
+        reader.join();
+    }
+    camera._stop = nullptr;
+    camera._on_pass = nullptr;
+    return framebuffer;
+}
+
+#endif
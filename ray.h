@@ -3,34 +3,49 @@
 
 #include "vec3.h"
 
-class Ray
+// A ray also carries the time at which it samples the scene, in the units
+// of the primitives' motion: a moving primitive is where it would be at
+// that time, and rays scattered from a hit keep the time of the ray that
+// made it.  Static scenes ignore it.
+template <typename T>
+class BasicRay
 {
 public:
-    Ray() = default;
+    BasicRay() = default;
 
-    Ray(const Point3 &origin, const Vec3 &direction)
-        : _origin(origin), _direction(direction)
+    BasicRay(const BasicVec3<T> &origin,
+             const BasicVec3<T> &direction,
+             T time = 0)
+        : _origin(origin), _direction(direction), _time(time)
     {
     }
 
-    [[nodiscard]] Point3 origin() const
+    [[nodiscard]] BasicVec3<T> origin() const
     {
         return _origin;
     }
 
-    [[nodiscard]] Vec3 direction() const
+    [[nodiscard]] BasicVec3<T> direction() const
     {
         return _direction;
     }
 
-    [[nodiscard]] Point3 at(double t_value) const
+    [[nodiscard]] T time() const
+    {
+        return _time;
+    }
+
+    [[nodiscard]] BasicVec3<T> at(T t_value) const
     {
         return _origin + t_value * _direction;
     }
 
 private:
-    Point3 _origin;
-    Vec3 _direction;
+    BasicVec3<T> _origin;
+    BasicVec3<T> _direction;
+    T _time{0};
 };
 
+using Ray = BasicRay<Real>;
+
 #endif
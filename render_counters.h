@@ -0,0 +1,82 @@
+#ifndef RENDER_COUNTERS_H
+#define RENDER_COUNTERS_H
+
+#include <chrono>
+#include <cstdint>
+
+// Work done while rendering, for profiling.  Counting only happens in builds
+// that define RT_STATS; elsewhere RT_COUNT and RT_TIME_STAGE expand to
+// nothing, so the hot loops carry no extra work.
+struct RenderCounters
+{
+    std::uint64_t _primary_rays{0};
+    std::uint64_t _secondary_rays{0};
+    std::uint64_t _nodes_visited{0};     // BVH nodes whose bounds were tested
+    std::uint64_t _primitives_tested{0}; // objects whose hit() was called
+    double _intersect_seconds{0.0};      // wavefront intersection stages
+    double _scatter_seconds{0.0};        // wavefront scatter stages
+
+    RenderCounters &operator+=(const RenderCounters &other)
+    {
+        _primary_rays += other._primary_rays;
+        _secondary_rays += other._secondary_rays;
+        _nodes_visited += other._nodes_visited;
+        _primitives_tested += other._primitives_tested;
+        _intersect_seconds += other._intersect_seconds;
+        _scatter_seconds += other._scatter_seconds;
+        return *this;
+    }
+};
+
+// Counters of the calling thread.  Threads count privately and the camera
+// folds each thread's counts into its RenderStats after every tile.
+inline RenderCounters &thread_render_counters()
+{
+    thread_local RenderCounters counters;
+    return counters;
+}
+
+// Returns the calling thread's counts and resets them.
+inline RenderCounters take_render_counters()
+{
+    RenderCounters &counters{thread_render_counters()};
+    const RenderCounters taken{counters};
+    counters = RenderCounters{};
+    return taken;
+}
+
+// Adds its elapsed time to one of the thread's seconds counters when it goes
+// out of scope.
+class StageTimer
+{
+public:
+    explicit StageTimer(double &seconds)
+        : _seconds(seconds), _start(std::chrono::steady_clock::now())
+    {
+    }
+
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+    ~StageTimer()
+    {
+        _seconds += std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - _start)
+                        .count();
+    }
+
+private:
+    double &_seconds;
+    std::chrono::steady_clock::time_point _start;
+};
+
+#if defined(RT_STATS)
+#define RT_COUNT(counter, amount) (thread_render_counters().counter += (amount))
+#define RT_TIME_STAGE(counter)                                                 \
+    const StageTimer stage_timer{thread_render_counters().counter}
+#else
+#define RT_COUNT(counter, amount) static_cast<void>(0)
+#define RT_TIME_STAGE(counter) static_cast<void>(0)
+#endif
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+// PCG32 (XSH-RR) generator: 16 bytes of state and a handful of integer
+// operations per draw.  Every generator is passed around explicitly, so
+// render threads never share state, and the stream parameter gives each
+// pixel its own independent sequence.
+class Rng
+{
+public:
+    explicit Rng(std::uint64_t seed = 0, std::uint64_t stream = 0)
+        : _increment((stream << 1U) | 1U)
+    {
+        next();
+        _state += seed;
+        next();
+    }
+
+    std::uint32_t next()
+    {
+        constexpr std::uint64_t kMultiplier{6364136223846793005ULL};
+        const std::uint64_t old_state{_state};
+        _state = old_state * kMultiplier + _increment;
+
+        const auto xorshifted{static_cast<std::uint32_t>(
+            ((old_state >> 18U) ^ old_state) >> 27U)};
+        const auto rotation{static_cast<std::uint32_t>(old_state >> 59U)};
+        return (xorshifted >> rotation) |
+               (xorshifted << ((0U - rotation) & 31U));
+    }
+
+private:
+    std::uint64_t _state{0};
+    std::uint64_t _increment;
+};
+
+inline std::uint64_t mix_seed(std::uint64_t seed, std::uint64_t value)
+{
+    // SplitMix64 finaliser, used to derive well-separated seeds from small,
+    // consecutive integers such as sample indices
+    std::uint64_t mixed{seed ^ (value + 0x9e3779b97f4a7c15ULL)};
+    mixed = (mixed ^ (mixed >> 30U)) * 0xbf58476d1ce4e5b9ULL;
+    mixed = (mixed ^ (mixed >> 27U)) * 0x94d049bb133111ebULL;
+    return mixed ^ (mixed >> 31U);
+}
+
+#endif
@@ -0,0 +1,462 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "rng.h"
+#include "utility.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Sample points for pixel samples.  A path asks its Sampler for one 2D point
+// per decision in a fixed order: the position within the pixel, the point on
+// the lens, the shutter time if the shutter stays open, then at each bounce
+// the scattering direction and the Russian roulette draw.  Each of those is
+// one dimension of the sample's point, and the kinds differ in how points of
+// different samples are spread out:
+//
+//   independent  uniform random numbers from the path's own Rng
+//   stratified   correlated multi-jittered points: each dimension's samples
+//                fall one per cell of a grid and one per row and column
+//                (Kensler, "Correlated Multi-Jittered Sampling", 2013)
+//   sobol        the first two dimensions of the Sobol sequence, Owen
+//                scrambled and shuffled per pixel and dimension with hashes
+//                (Burley, "Practical Hash-based Owen Scrambling", 2020)
+//   blue-noise   one Owen-scrambled Sobol sequence shared by every pixel,
+//                offset per pixel by a tileable blue-noise mask, so the
+//                error left in the image is spread at high frequencies
+//
+// Every kind is a pure function of the seed, pixel, sample index and
+// dimension, so renders stay independent of thread count and tile order.
+// Stratified points also depend on the samples per pixel.
+enum class SamplerKind : std::uint32_t
+{
+    kIndependent,
+    kStratified,
+    kSobol,
+    kBlueNoise
+};
+
+inline std::optional<SamplerKind> sampler_from_name(std::string_view name)
+{
+    if (name == "independent")
+    {
+        return SamplerKind::kIndependent;
+    }
+    if (name == "stratified")
+    {
+        return SamplerKind::kStratified;
+    }
+    if (name == "sobol")
+    {
+        return SamplerKind::kSobol;
+    }
+    if (name == "blue-noise")
+    {
+        return SamplerKind::kBlueNoise;
+    }
+    return std::nullopt;
+}
+
+inline std::string_view sampler_name(SamplerKind kind)
+{
+    switch (kind)
+    {
+    case SamplerKind::kIndependent:
+        return "independent";
+    case SamplerKind::kStratified:
+        return "stratified";
+    case SamplerKind::kSobol:
+        return "sobol";
+    default:
+        return "blue-noise";
+    }
+}
+
+// A point in [0, 1)^2.
+using Sample2 = std::array<double, 2>;
+
+namespace sampler_detail
+{
+// NOLINTBEGIN(readability-magic-numbers)
+constexpr double kInverse32{1.0 / 4294967296.0};
+
+inline std::uint32_t hash(std::uint64_t seed, std::uint64_t value)
+{
+    return static_cast<std::uint32_t>(mix_seed(seed, value));
+}
+
+inline std::uint32_t reverse_bits(std::uint32_t value)
+{
+    value = ((value >> 1U) & 0x55555555U) | ((value & 0x55555555U) << 1U);
+    value = ((value >> 2U) & 0x33333333U) | ((value & 0x33333333U) << 2U);
+    value = ((value >> 4U) & 0x0f0f0f0fU) | ((value & 0x0f0f0f0fU) << 4U);
+    value = ((value >> 8U) & 0x00ff00ffU) | ((value & 0x00ff00ffU) << 8U);
+    return (value >> 16U) | (value << 16U);
+}
+
+// A random permutation of 32-bit values in which each bit depends only on
+// itself and the bits below it, so applied to bit-reversed values it acts
+// as a nested uniform (Owen) scramble.
+inline std::uint32_t laine_karras_permutation(std::uint32_t value,
+                                              std::uint32_t seed)
+{
+    value += seed;
+    value ^= value * 0x6c50b47cU;
+    value ^= value * 0xb82f1e52U;
+    value ^= value * 0xc7afe638U;
+    value ^= value * 0x8d22f6e6U;
+    return value;
+}
+
+inline std::uint32_t owen_scramble(std::uint32_t value, std::uint32_t seed)
+{
+    return reverse_bits(laine_karras_permutation(reverse_bits(value), seed));
+}
+
+// The generator matrix of the Sobol sequence's second dimension, applied a
+// byte of the index at a time: entry [b][v] is the xor of the columns for
+// the set bits of v shifted up by 8b.  Each column is the previous one xored
+// with itself shifted down a bit, starting from the top bit.
+constexpr auto kSobolTables{[] {
+    std::array<std::uint32_t, 32> columns{};
+    std::uint32_t column{0x80000000U};
+    for (std::uint32_t &entry : columns)
+    {
+        entry = column;
+        column ^= column >> 1U;
+    }
+    std::array<std::array<std::uint32_t, 256>, 4> tables{};
+    for (std::size_t byte{0}; byte < tables.size(); ++byte)
+    {
+        for (std::size_t value{0}; value < 256; ++value)
+        {
+            for (std::size_t bit{0}; bit < 8; ++bit)
+            {
+                if ((value >> bit & 1U) != 0)
+                {
+                    tables[byte][value] ^= columns[byte * 8 + bit];
+                }
+            }
+        }
+    }
+    return tables;
+}()};
+
+// Dimension 0 or 1 of the Sobol sequence as a 32-bit fraction.  The first
+// is the van der Corput sequence.
+inline std::uint32_t sobol(std::uint32_t index, int dimension)
+{
+    if (dimension == 0)
+    {
+        return reverse_bits(index);
+    }
+    return kSobolTables[0][index & 0xffU] ^
+           kSobolTables[1][index >> 8U & 0xffU] ^
+           kSobolTables[2][index >> 16U & 0xffU] ^
+           kSobolTables[3][index >> 24U];
+}
+
+// Kensler's hashed permutation of [0, length) selected by pattern.
+inline std::uint32_t permute(std::uint32_t index,
+                             std::uint32_t length,
+                             std::uint32_t pattern)
+{
+    std::uint32_t mask{length - 1};
+    mask |= mask >> 1U;
+    mask |= mask >> 2U;
+    mask |= mask >> 4U;
+    mask |= mask >> 8U;
+    mask |= mask >> 16U;
+    do
+    {
+        index ^= pattern;
+        index *= 0xe170893dU;
+        index ^= pattern >> 16U;
+        index ^= (index & mask) >> 4U;
+        index ^= pattern >> 8U;
+        index *= 0x0929eb3fU;
+        index ^= pattern >> 23U;
+        index ^= (index & mask) >> 1U;
+        index *= 1U | pattern >> 27U;
+        index *= 0x6935fa69U;
+        index ^= (index & mask) >> 11U;
+        index *= 0x74dcb303U;
+        index ^= (index & mask) >> 2U;
+        index *= 0x9e501cc3U;
+        index ^= (index & mask) >> 2U;
+        index *= 0xc860a3dfU;
+        index &= mask;
+        index ^= index >> 5U;
+    } while (index >= length);
+    return (index + pattern) % length;
+}
+
+inline double hashed_fraction(std::uint32_t index, std::uint32_t pattern)
+{
+    index ^= pattern;
+    index ^= index >> 17U;
+    index ^= index >> 10U;
+    index *= 0xb36534e5U;
+    index ^= index >> 12U;
+    index ^= index >> 21U;
+    index *= 0x93fc4795U;
+    index ^= 0xdf6e307fU;
+    index ^= index >> 17U;
+    index *= 1U | pattern >> 18U;
+    return index * kInverse32;
+}
+
+// Sample `index` of `count` correlated multi-jittered points.
+inline Sample2 correlated_multi_jitter(std::uint32_t index,
+                                       std::uint32_t count,
+                                       std::uint32_t pattern)
+{
+    const auto columns{std::max(
+        static_cast<std::uint32_t>(std::sqrt(static_cast<double>(count))),
+        1U)};
+    const std::uint32_t rows{(count + columns - 1) / columns};
+    index = permute(index, count, pattern * 0x51633e2dU);
+    const std::uint32_t column{
+        permute(index % columns, columns, pattern * 0x68bc21ebU)};
+    const std::uint32_t row{
+        permute(index / columns, rows, pattern * 0x02e5be93U)};
+    const double jitter_x{hashed_fraction(index, pattern * 0x967a889bU)};
+    const double jitter_y{hashed_fraction(index, pattern * 0x368cc8b7U)};
+    return {(column + (row + jitter_x) / rows) / columns,
+            (index + jitter_y) / count};
+}
+
+constexpr int kBlueNoiseSize{64}; // mask edge length, a power of two
+
+// Ranks of a tileable blue-noise dither mask built by Ulichney's
+// void-and-cluster method, scaled into (0, 1).
+inline std::vector<double> make_blue_noise_mask()
+{
+    constexpr int kSize{kBlueNoiseSize};
+    constexpr std::size_t kCells{kSize * kSize};
+    constexpr double kSigma{1.5};
+
+    // Gaussian energy each set cell adds to others, by toroidal offset
+    std::vector<double> kernel(kCells);
+    for (int dy{0}; dy < kSize; ++dy)
+    {
+        for (int dx{0}; dx < kSize; ++dx)
+        {
+            const int x{std::min(dx, kSize - dx)};
+            const int y{std::min(dy, kSize - dy)};
+            kernel[static_cast<std::size_t>(dy * kSize + dx)] =
+                std::exp(-(x * x + y * y) / (2.0 * kSigma * kSigma));
+        }
+    }
+
+    std::vector<std::uint8_t> pattern(kCells);
+    std::vector<double> energy(kCells);
+    const auto toggle{[&](std::size_t cell, double sign) {
+        pattern[cell] = static_cast<std::uint8_t>(sign > 0.0);
+        const std::size_t cx{cell % kSize};
+        const std::size_t cy{cell / kSize};
+        for (std::size_t other{0}; other < kCells; ++other)
+        {
+            const std::size_t dx{(other % kSize + kSize - cx) % kSize};
+            const std::size_t dy{(other / kSize + kSize - cy) % kSize};
+            energy[other] += sign * kernel[dy * kSize + dx];
+        }
+    }};
+    // the set cell with the most energy, or the empty one with the least
+    const auto extreme{[&](std::uint8_t value) {
+        std::size_t best{kCells};
+        for (std::size_t cell{0}; cell < kCells; ++cell)
+        {
+            if (pattern[cell] == value &&
+                (best == kCells ||
+                 (value != 0 ? energy[cell] > energy[best]
+                             : energy[cell] < energy[best])))
+            {
+                best = cell;
+            }
+        }
+        return best;
+    }};
+
+    // a random initial pattern, relaxed until moving its tightest cluster
+    // into its largest void changes nothing
+    Rng rng{kCells};
+    const std::size_t initial_count{kCells / 10};
+    for (std::size_t placed{0}; placed < initial_count;)
+    {
+        const std::size_t cell{rng.next() % kCells};
+        if (pattern[cell] == 0)
+        {
+            toggle(cell, 1.0);
+            ++placed;
+        }
+    }
+    for (;;)
+    {
+        const std::size_t cluster{extreme(1)};
+        toggle(cluster, -1.0);
+        const std::size_t void_cell{extreme(0)};
+        toggle(void_cell, 1.0);
+        if (void_cell == cluster)
+        {
+            break;
+        }
+    }
+
+    std::vector<double> mask(kCells);
+    const std::vector<std::uint8_t> initial_pattern{pattern};
+    const std::vector<double> initial_energy{energy};
+    for (std::size_t rank{initial_count}; rank-- > 0;)
+    {
+        const std::size_t cluster{extreme(1)};
+        toggle(cluster, -1.0);
+        mask[cluster] = static_cast<double>(rank);
+    }
+    pattern = initial_pattern;
+    energy = initial_energy;
+    for (std::size_t rank{initial_count}; rank < kCells; ++rank)
+    {
+        const std::size_t void_cell{extreme(0)};
+        toggle(void_cell, 1.0);
+        mask[void_cell] = static_cast<double>(rank);
+    }
+    for (double &value : mask)
+    {
+        value = (value + 0.5) / static_cast<double>(kCells);
+    }
+    return mask;
+}
+
+inline const std::vector<double> &blue_noise_mask()
+{
+    static const std::vector<double> mask{make_blue_noise_mask()};
+    return mask;
+}
+// NOLINTEND(readability-magic-numbers)
+} // namespace sampler_detail
+
+// The points of one pixel sample, handed out a dimension at a time.
+class Sampler
+{
+public:
+    Sampler() = default;
+
+    Sampler(SamplerKind kind,
+            std::uint64_t seed,
+            int i,
+            int j,
+            std::size_t pixel,
+            int sample,
+            int sample_count)
+        : _rng(mix_seed(seed, static_cast<std::uint64_t>(sample)), pixel),
+          _pixel_seed(mix_seed(seed ^ kPixelSalt, pixel)),
+          _sequence_seed(mix_seed(seed, kPixelSalt)),
+          _i(static_cast<std::uint32_t>(i)), _j(static_cast<std::uint32_t>(j)),
+          _sample(static_cast<std::uint32_t>(sample)),
+          _sample_count(static_cast<std::uint32_t>(sample_count)), _kind(kind)
+    {
+        if (_kind == SamplerKind::kBlueNoise)
+        {
+            static_cast<void>(sampler_detail::blue_noise_mask());
+        }
+    }
+
+    // The next dimension's point.
+    Sample2 next_2d()
+    {
+        using namespace sampler_detail;
+
+        const std::uint32_t dimension{_dimension++};
+        switch (_kind)
+        {
+        case SamplerKind::kIndependent:
+        {
+            const double x{random_double(_rng)};
+            return {x, random_double(_rng)};
+        }
+        case SamplerKind::kStratified:
+            // samples beyond the count the pattern was laid out for, as
+            // when a checkpoint is resumed with more (see
+            // Camera::_stratified_samples), are drawn independently
+            if (_sample >= _sample_count)
+            {
+                const double x{random_double(_rng)};
+                return {x, random_double(_rng)};
+            }
+            return correlated_multi_jitter(
+                _sample, _sample_count, hash(_pixel_seed, dimension));
+        case SamplerKind::kSobol:
+        {
+            const std::uint32_t seed{hash(_pixel_seed, dimension)};
+            const std::uint32_t index{owen_scramble(_sample, seed)};
+            return {owen_scramble(sobol(index, 0), hash(seed, 0)) * kInverse32,
+                    owen_scramble(sobol(index, 1), hash(seed, 1)) *
+                        kInverse32};
+        }
+        default:
+            return blue_noise_point(dimension);
+        }
+    }
+
+    // The next dimension's point, of which only one coordinate is needed.
+    double next_1d()
+    {
+        if (_kind == SamplerKind::kIndependent)
+        {
+            ++_dimension;
+            return random_double(_rng);
+        }
+        return next_2d()[0];
+    }
+
+private:
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    static constexpr std::uint64_t kPixelSalt{0x5a3c9e17b2d40f61ULL};
+
+    Rng _rng;
+    std::uint64_t _pixel_seed{0};
+    std::uint64_t _sequence_seed{0}; // shared by every pixel
+    std::uint32_t _i{0};
+    std::uint32_t _j{0};
+    std::uint32_t _sample{0};
+    std::uint32_t _sample_count{1};
+    std::uint32_t _dimension{0};
+    SamplerKind _kind{SamplerKind::kIndependent};
+
+    [[nodiscard]] Sample2 blue_noise_point(std::uint32_t dimension) const
+    {
+        using namespace sampler_detail;
+
+        // the same scrambled sequence in every pixel, so only the offsets
+        // differ between neighbours; the seed picks the scramble and the
+        // mask shifts
+        const std::uint32_t seed{hash(_sequence_seed, dimension)};
+        const std::uint32_t x_bits{owen_scramble(sobol(_sample, 0), seed)};
+        const std::uint32_t y_bits{
+            owen_scramble(sobol(_sample, 1), hash(seed, 1))};
+
+        // each dimension reads the mask at its own toroidal shift
+        constexpr std::uint32_t kMask{kBlueNoiseSize - 1};
+        const std::uint32_t shift{hash(seed, 2)};
+        const std::vector<double> &mask{blue_noise_mask()};
+        const auto offset{[&](std::uint32_t dx, std::uint32_t dy) {
+            return mask[((_j + dy) & kMask) * kBlueNoiseSize +
+                        ((_i + dx) & kMask)];
+        }};
+        // NOLINTBEGIN(readability-magic-numbers)
+        const double x{x_bits * kInverse32 +
+                       offset(shift & kMask, (shift >> 8U) & kMask)};
+        const double y{y_bits * kInverse32 +
+                       offset((shift >> 16U) & kMask, (shift >> 24U) & kMask)};
+        // NOLINTEND(readability-magic-numbers)
+        return {x - std::floor(x), y - std::floor(y)};
+    }
+};
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include "sampler.h"
+#include "utility.h"
+#include "vec3.h"
+
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Closed-form mappings from a Sampler's points in [0, 1)^2 to the shapes
+// materials and the lens sample.  Each takes exactly one point and has no
+// loop, unlike the rejection samplers in vec3.h, and neighbouring points map
+// to neighbouring results, so stratified and low-discrepancy points keep
+// their spread.  All of them go through the concentric disc mapping, whose
+// angles stay within an eighth of a turn, so short polynomials replace the
+// library's sine and cosine.
+namespace sampling_detail
+{
+// Sine and cosine of an angle within pi/4 of zero, by the minimax
+// polynomials of fdlibm's __kernel_sin and __kernel_cos, which are accurate
+// to double precision there.  The library functions reduce the argument
+// first, which the disc mapping never needs.
+inline void eighth_turn_sin_cos(double angle, double &sine, double &cosine)
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    const double z{angle * angle};
+    const double sine_tail{
+        -1.66666666666666324348e-01 +
+        z * (8.33333333332248946124e-03 +
+             z * (-1.98412698298579493134e-04 +
+                  z * (2.75573137070700676789e-06 +
+                       z * (-2.50507602534068634195e-08 +
+                            z * 1.58969099521155010221e-10))))};
+    const double cosine_tail{
+        4.16666666666666019037e-02 +
+        z * (-1.38888888888741095749e-03 +
+             z * (2.48015872894767294178e-05 +
+                  z * (-2.75573143513906633035e-07 +
+                       z * (2.08757232129817482790e-09 +
+                            z * -1.13596475577881948265e-11))))};
+    sine = angle + angle * z * sine_tail;
+    cosine = 1.0 - 0.5 * z + z * z * cosine_tail;
+    // NOLINTEND(readability-magic-numbers)
+}
+
+// `chosen` if `condition`, otherwise `other`, without a branch: the
+// mappings' conditions depend on the sample, so a branch would be
+// mispredicted half the time.
+inline double select(bool condition, double chosen, double other)
+{
+    const std::uint64_t mask{std::uint64_t{0} -
+                             static_cast<std::uint64_t>(condition)};
+    return std::bit_cast<double>((std::bit_cast<std::uint64_t>(chosen) & mask) |
+                                 (std::bit_cast<std::uint64_t>(other) & ~mask));
+}
+} // namespace sampling_detail
+
+// Point uniformly distributed in the unit disc in the xy plane, by Shirley
+// and Chiu's concentric mapping of squares about the centre to circles,
+// which distorts areas less than the polar mapping.
+inline Vec3 concentric_disc(const Sample2 &sample)
+{
+    using sampling_detail::select;
+
+    constexpr double kEighthTurn{constants::kPi / 4.0};
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    constexpr double kTiny{1e-300};
+
+    const double a{2.0 * sample[0] - 1.0};
+    const double b{2.0 * sample[1] - 1.0};
+    const bool horizontal{a * a > b * b};
+    const double radius{select(horizontal, a, b)};
+    // the centre, where a and b are both zero, gets a ratio of zero
+    const double ratio{
+        select(horizontal, b, a) /
+        std::copysign(std::fmax(std::fabs(radius), kTiny), radius)};
+
+    // the angle is kEighthTurn * ratio from the x axis in the left and right
+    // quarters, and that far the other way from the y axis in the others
+    double sine{0.0};
+    double cosine{0.0};
+    sampling_detail::eighth_turn_sin_cos(kEighthTurn * ratio, sine, cosine);
+    return {static_cast<Real>(radius * select(horizontal, cosine, sine)),
+            static_cast<Real>(radius * select(horizontal, sine, cosine)),
+            0};
+}
+
+// Point uniformly distributed on the unit sphere: a concentric disc point's
+// squared radius is uniform, giving the height, and its direction gives the
+// azimuth.
+inline Vec3 uniform_sphere(const Sample2 &sample)
+{
+    const Vec3 disc{concentric_disc(sample)};
+    const double x{disc.x()};
+    const double y{disc.y()};
+    const double radius_squared{x * x + y * y};
+    const double scale{2.0 * std::sqrt(std::fmax(0.0, 1.0 - radius_squared))};
+    return {static_cast<Real>(x * scale),
+            static_cast<Real>(y * scale),
+            static_cast<Real>(1.0 - 2.0 * radius_squared)};
+}
+
+// Unit vectors completing the unit `normal` to a right-handed basis, without
+// a branch on the normal's direction (Duff et al., "Building an Orthonormal
+// Basis, Revisited", 2017).
+inline void
+orthonormal_basis(const Vec3 &normal, Vec3 &tangent, Vec3 &bitangent)
+{
+    const Real sign{std::copysign(Real{1}, normal.z())};
+    const Real a{-1 / (sign + normal.z())};
+    const Real b{normal.x() * normal.y() * a};
+    tangent = {1 + sign * normal.x() * normal.x() * a,
+               sign * b,
+               -sign * normal.x()};
+    bitangent = {b, sign + normal.y() * normal.y() * a, -normal.y()};
+}
+
+// Unit vector in the hemisphere about the unit `normal` with density
+// proportional to the cosine of its angle to the normal: a concentric disc
+// point lifted onto the hemisphere (Malley's method).  This is the
+// distribution of normal + uniform_sphere() once normalised.
+inline Vec3 cosine_hemisphere(const Vec3 &normal, const Sample2 &sample)
+{
+    const Vec3 disc{concentric_disc(sample)};
+    const Real height{std::sqrt(
+        std::fmax(Real{0}, 1 - disc.x() * disc.x() - disc.y() * disc.y()))};
+    Vec3 tangent;
+    Vec3 bitangent;
+    orthonormal_basis(normal, tangent, bitangent);
+    return disc.x() * tangent + disc.y() * bitangent + height * normal;
+}
+
+#endif
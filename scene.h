@@ -0,0 +1,17 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "camera.h"
+#include "material.h"
+#include "sphere_set.h"
+
+// Everything needed to render an image: the camera, the material table, and
+// the spheres whose material ids index that table.
+struct Scene
+{
+    Camera _camera;
+    MaterialTable _materials;
+    SphereSet _spheres;
+};
+
+#endif
@@ -0,0 +1,682 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include "bvh.h"
+#include "camera.h"
+#include "mapped_file.h"
+#include "material.h"
+#include "scene.h"
+#include "sphere_set.h"
+#include "texture.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Scene files come in two forms holding the same description: the camera,
+// the materials and the spheres.
+//
+// The text form has one item per line; blank lines and lines starting with
+// '#' are ignored.  Camera lines name a Camera setting and give its value:
+//
+//     aspect_ratio 1.7778      image_width 1200      samples_per_pixel 500
+//     max_depth 50             vertical_fov 20       defocus_angle 0.6
+//     focus_dist 10            look_from 13 2 3      look_at 0 0 0
+//     vup 0 1 0
+//
+// Materials are numbered from 0 in the order they appear:
+//
+//     lambertian R G B         metal R G B FUZZ      dielectric INDEX
+//
+// and each sphere names its material by number:
+//
+//     sphere X Y Z RADIUS MATERIAL
+//
+// The binary form is a fixed header, the material records, then each sphere
+// column as one contiguous array, then the nodes of the sphere hierarchy if
+// one was built.  Arrays start on 8-byte boundaries, so the loader maps the
+// file and copies each column in bulk, and adopts the stored hierarchy rather
+// than rebuilding it.  Binary files use the writing machine's byte order and
+// are meant to be read on the same kind of machine.  Values are stored as
+// double whatever the build's Real; a hierarchy written by a build with a
+// different node layout is skipped, and the caller rebuilds it.
+namespace scene_file_detail
+{
+constexpr std::array<char, 8> kMagic{'R', 'T', 'S', 'C', 'E', 'N', 'E', '2'};
+
+enum class MaterialKind : std::uint64_t
+{
+    kLambertian,
+    kMetal,
+    kDielectric,
+};
+
+struct Header
+{
+    std::array<char, 8> _magic;
+    double _aspect_ratio;
+    std::int64_t _image_width;
+    std::int64_t _samples_per_pixel;
+    std::int64_t _max_depth;
+    double _vertical_fov;
+    std::array<double, 3> _look_from;
+    std::array<double, 3> _look_at;
+    std::array<double, 3> _vup;
+    double _defocus_angle;
+    double _focus_dist;
+    std::uint64_t _material_count;
+    std::uint64_t _sphere_count;
+    std::uint64_t _node_count;
+    std::uint64_t _node_bytes; // sizeof(BvhNode) in the writing build
+};
+
+struct MaterialRecord
+{
+    MaterialKind _kind;
+    std::array<double, 4> _parameters; // albedo and fuzz, or index first
+};
+
+static_assert(std::is_trivially_copyable_v<Header> &&
+              std::is_trivially_copyable_v<MaterialRecord> &&
+              std::is_trivially_copyable_v<BvhNode>);
+static_assert(sizeof(Header) % 8 == 0 && sizeof(MaterialRecord) % 8 == 0 &&
+              sizeof(BvhNode) % 8 == 0);
+
+inline std::size_t padded(std::size_t bytes)
+{
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    return (bytes + 7) & ~std::size_t{7};
+}
+
+inline std::array<double, 3> to_array(const Vec3 &vector)
+{
+    return {vector[0], vector[1], vector[2]};
+}
+
+inline Vec3 to_vec3(double x, double y, double z)
+{
+    return Vec3{
+        static_cast<Real>(x), static_cast<Real>(y), static_cast<Real>(z)};
+}
+
+inline Vec3 to_vec3(const std::array<double, 3> &values)
+{
+    return to_vec3(values[0], values[1], values[2]);
+}
+
+// Scene files hold constant colours only, so image textures save as white.
+inline Colour constant_colour(const Texture &texture)
+{
+    const Colour *colour{texture.colour()};
+    return colour != nullptr ? *colour : Colour{1.0, 1.0, 1.0};
+}
+
+inline MaterialRecord to_record(const Material &material)
+{
+    MaterialRecord record{};
+    if (const auto *lambertian{material.get_if<Lambertian>()})
+    {
+        record._kind = MaterialKind::kLambertian;
+        const Colour albedo{constant_colour(lambertian->albedo())};
+        record._parameters = {albedo[0], albedo[1], albedo[2], 0.0};
+    }
+    else if (const auto *metal{material.get_if<Metal>()})
+    {
+        record._kind = MaterialKind::kMetal;
+        const Colour albedo{constant_colour(metal->albedo())};
+        record._parameters = {albedo[0], albedo[1], albedo[2], metal->fuzz()};
+    }
+    else
+    {
+        record._kind = MaterialKind::kDielectric;
+        record._parameters = {
+            material.get_if<Dielectric>()->refraction_index(), 0.0, 0.0, 0.0};
+    }
+    return record;
+}
+
+// Adds the material a record describes, or returns false for an unknown kind.
+inline bool add_material(MaterialTable &materials, const MaterialRecord &record)
+{
+    const std::array<double, 4> &values{record._parameters};
+    switch (record._kind)
+    {
+    case MaterialKind::kLambertian:
+        materials.add(Lambertian{to_vec3(values[0], values[1], values[2])});
+        return true;
+    case MaterialKind::kMetal:
+        materials.add(
+            Metal{to_vec3(values[0], values[1], values[2]), values[3]});
+        return true;
+    case MaterialKind::kDielectric:
+        materials.add(Dielectric{values[0]});
+        return true;
+    }
+    return false;
+}
+
+inline bool materials_in_range(const SphereSet &spheres,
+                               const MaterialTable &materials)
+{
+    for (const MaterialId material : spheres.materials())
+    {
+        if (material >= materials.size())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+void write_array(std::ostream &output, const T *values, std::size_t count)
+{
+    output.write(reinterpret_cast<const char *>(values),
+                 static_cast<std::streamsize>(count * sizeof(T)));
+}
+
+// Writes a column of Real as double, widening it first in float builds.
+inline void write_column(std::ostream &output, const std::vector<Real> &column)
+{
+    if constexpr (std::is_same_v<Real, double>)
+    {
+        write_array(output, column.data(), column.size());
+    }
+    else
+    {
+        const std::vector<double> widened(column.begin(), column.end());
+        write_array(output, widened.data(), widened.size());
+    }
+}
+
+template <typename Number>
+bool fits_int(Number value)
+{
+    return value >= std::numeric_limits<int>::min() &&
+           value <= std::numeric_limits<int>::max();
+}
+
+// Rejects camera settings a render cannot start from; null if they are fine.
+inline const char *camera_problem(const Camera &camera)
+{
+    if (!std::isfinite(camera._aspect_ratio) || camera._aspect_ratio <= 0.0)
+    {
+        return "aspect_ratio must be positive";
+    }
+    if (camera._image_width <= 0)
+    {
+        return "image_width must be positive";
+    }
+    if (camera._samples_per_pixel <= 0)
+    {
+        return "samples_per_pixel must be positive";
+    }
+    if (camera._max_depth < 0)
+    {
+        return "max_depth must not be negative";
+    }
+    return nullptr;
+}
+
+inline std::optional<Scene> load_binary(std::span<const std::byte> bytes,
+                                        std::string &error)
+{
+    Header header{};
+    if (bytes.size() < sizeof(Header))
+    {
+        error = "truncated header";
+        return std::nullopt;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(Header));
+
+    // bound every count by the file size before multiplying
+    const std::size_t size{bytes.size()};
+    if (header._material_count > size / sizeof(MaterialRecord) ||
+        header._sphere_count > size / sizeof(double) ||
+        (header._node_count > 0 &&
+         (header._node_bytes == 0 || header._node_bytes % 8 != 0 ||
+          header._node_count > size / header._node_bytes)))
+    {
+        error = "counts exceed the file size";
+        return std::nullopt;
+    }
+    const auto material_count{static_cast<std::size_t>(header._material_count)};
+    const auto sphere_count{static_cast<std::size_t>(header._sphere_count)};
+    const auto node_count{static_cast<std::size_t>(header._node_count)};
+    const auto node_bytes{static_cast<std::size_t>(header._node_bytes)};
+
+    const std::size_t materials_offset{sizeof(Header)};
+    const std::size_t columns_offset{materials_offset +
+                                     material_count * sizeof(MaterialRecord)};
+    const std::size_t column_bytes{sphere_count * sizeof(double)};
+    const std::size_t ids_offset{columns_offset + 4 * column_bytes};
+    const std::size_t nodes_offset{
+        ids_offset + padded(sphere_count * sizeof(MaterialId))};
+    if (nodes_offset + node_count * node_bytes != size)
+    {
+        error = "file size does not match its header";
+        return std::nullopt;
+    }
+
+    if (!fits_int(header._image_width) ||
+        !fits_int(header._samples_per_pixel) || !fits_int(header._max_depth))
+    {
+        error = "camera setting out of range";
+        return std::nullopt;
+    }
+    Scene scene;
+    Camera &camera{scene._camera};
+    camera._aspect_ratio = header._aspect_ratio;
+    camera._image_width = static_cast<int>(header._image_width);
+    camera._samples_per_pixel = static_cast<int>(header._samples_per_pixel);
+    camera._max_depth = static_cast<int>(header._max_depth);
+    camera._vertical_fov = header._vertical_fov;
+    camera._look_from = to_vec3(header._look_from);
+    camera._look_at = to_vec3(header._look_at);
+    camera._vup = to_vec3(header._vup);
+    camera._defocus_angle = header._defocus_angle;
+    camera._focus_dist = header._focus_dist;
+    if (const char *problem{camera_problem(camera)})
+    {
+        error = problem;
+        return std::nullopt;
+    }
+
+    for (std::size_t index{0}; index < material_count; ++index)
+    {
+        MaterialRecord record{};
+        std::memcpy(&record,
+                    bytes.data() + materials_offset +
+                        index * sizeof(MaterialRecord),
+                    sizeof(MaterialRecord));
+        if (!add_material(scene._materials, record))
+        {
+            error = "unknown material kind";
+            return std::nullopt;
+        }
+    }
+
+    // the mapping is page aligned and every array offset a multiple of 8
+    const auto column{[&](std::size_t index) {
+        return std::span<const double>{
+            reinterpret_cast<const double *>(bytes.data() + columns_offset +
+                                             index * column_bytes),
+            sphere_count};
+    }};
+    scene._spheres.assign(
+        column(0),
+        column(1),
+        column(2),
+        column(3),
+        std::span<const MaterialId>{
+            reinterpret_cast<const MaterialId *>(bytes.data() + ids_offset),
+            sphere_count});
+    if (!materials_in_range(scene._spheres, scene._materials))
+    {
+        error = "sphere material out of range";
+        return std::nullopt;
+    }
+
+    if (node_count > 0 && node_bytes == sizeof(BvhNode))
+    {
+        std::vector<BvhNode> nodes(node_count);
+        std::memcpy(nodes.data(),
+                    bytes.data() + nodes_offset,
+                    node_count * sizeof(BvhNode));
+        if (!scene._spheres.adopt_hierarchy(std::move(nodes)))
+        {
+            error = "malformed sphere hierarchy";
+            return std::nullopt;
+        }
+    }
+    return scene;
+}
+
+// Parses the numbers following a keyword into `values`, requiring exactly
+// values.size() of them.
+inline bool parse_values(const std::string &line,
+                         std::size_t start,
+                         std::span<double> values)
+{
+    const char *cursor{line.c_str() + start};
+    for (double &value : values)
+    {
+        char *end{nullptr};
+        value = std::strtod(cursor, &end);
+        if (end == cursor)
+        {
+            return false;
+        }
+        cursor = end;
+    }
+    while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r')
+    {
+        ++cursor;
+    }
+    return *cursor == '\0';
+}
+
+inline bool parse_line(const std::string &line, Scene &scene)
+{
+    const std::size_t keyword_end{line.find_first_of(" \t")};
+    const std::string_view keyword{
+        std::string_view{line}.substr(0, keyword_end)};
+    const std::size_t start{keyword_end == std::string::npos ? line.size()
+                                                             : keyword_end};
+    Camera &camera{scene._camera};
+
+    std::array<double, 5> values{};
+    const auto parse{[&](std::size_t count) {
+        return parse_values(line, start, std::span{values}.first(count));
+    }};
+    const auto parse_int{[&](int &setting) {
+        // range first: casting a value int cannot hold is undefined
+        if (!parse(1) || !fits_int(values[0]) ||
+            values[0] != std::trunc(values[0]))
+        {
+            return false;
+        }
+        setting = static_cast<int>(values[0]);
+        return true;
+    }};
+    const auto parse_double{[&](double &setting) {
+        if (!parse(1))
+        {
+            return false;
+        }
+        setting = values[0];
+        return true;
+    }};
+    const auto parse_vec3{[&](Vec3 &setting) {
+        if (!parse(3))
+        {
+            return false;
+        }
+        setting = to_vec3(values[0], values[1], values[2]);
+        return true;
+    }};
+
+    if (keyword == "sphere")
+    {
+        if (!parse(5) || values[4] < 0 ||
+            values[4] != static_cast<MaterialId>(values[4]))
+        {
+            return false;
+        }
+        scene._spheres.add(to_vec3(values[0], values[1], values[2]),
+                           static_cast<Real>(values[3]),
+                           static_cast<MaterialId>(values[4]));
+        return true;
+    }
+    const auto parse_material{[&](MaterialKind kind, std::size_t count) {
+        if (!parse(count))
+        {
+            return false;
+        }
+        MaterialRecord record{kind, {}};
+        std::copy_n(values.begin(), count, record._parameters.begin());
+        return add_material(scene._materials, record);
+    }};
+    if (keyword == "lambertian")
+    {
+        return parse_material(MaterialKind::kLambertian, 3);
+    }
+    if (keyword == "metal")
+    {
+        return parse_material(MaterialKind::kMetal, 4);
+    }
+    if (keyword == "dielectric")
+    {
+        return parse_material(MaterialKind::kDielectric, 1);
+    }
+    if (keyword == "aspect_ratio")
+    {
+        return parse_double(camera._aspect_ratio);
+    }
+    if (keyword == "image_width")
+    {
+        return parse_int(camera._image_width);
+    }
+    if (keyword == "samples_per_pixel")
+    {
+        return parse_int(camera._samples_per_pixel);
+    }
+    if (keyword == "max_depth")
+    {
+        return parse_int(camera._max_depth);
+    }
+    if (keyword == "vertical_fov")
+    {
+        return parse_double(camera._vertical_fov);
+    }
+    if (keyword == "look_from")
+    {
+        return parse_vec3(camera._look_from);
+    }
+    if (keyword == "look_at")
+    {
+        return parse_vec3(camera._look_at);
+    }
+    if (keyword == "vup")
+    {
+        return parse_vec3(camera._vup);
+    }
+    if (keyword == "defocus_angle")
+    {
+        return parse_double(camera._defocus_angle);
+    }
+    if (keyword == "focus_dist")
+    {
+        return parse_double(camera._focus_dist);
+    }
+    return false;
+}
+
+inline std::optional<Scene> load_text(std::span<const std::byte> bytes,
+                                      std::string &error)
+{
+    const std::string_view text{reinterpret_cast<const char *>(bytes.data()),
+                                bytes.size()};
+    Scene scene;
+    std::string line;
+    std::size_t line_number{0};
+    for (std::size_t begin{0}; begin < text.size();)
+    {
+        std::size_t end{text.find('\n', begin)};
+        if (end == std::string_view::npos)
+        {
+            end = text.size();
+        }
+        line.assign(text.substr(begin, end - begin));
+        begin = end + 1;
+        ++line_number;
+
+        const std::size_t first{line.find_first_not_of(" \t\r")};
+        if (first == std::string::npos || line[first] == '#')
+        {
+            continue;
+        }
+        line.erase(0, first);
+        if (!parse_line(line, scene))
+        {
+            error = "line " + std::to_string(line_number) + ": cannot parse \"" +
+                    line + '"';
+            return std::nullopt;
+        }
+    }
+
+    if (!materials_in_range(scene._spheres, scene._materials))
+    {
+        error = "sphere material out of range";
+        return std::nullopt;
+    }
+    if (const char *problem{camera_problem(scene._camera)})
+    {
+        error = problem;
+        return std::nullopt;
+    }
+    return scene;
+}
+} // namespace scene_file_detail
+
+// Loads a scene in either form, telling them apart by the binary form's
+// leading magic bytes.  On failure returns nothing and describes the problem
+// in `error`.
+inline std::optional<Scene> load_scene(const std::string &path,
+                                       std::string &error)
+{
+    using namespace scene_file_detail;
+
+    const MappedFile file{path};
+    if (!file.is_open())
+    {
+        error = "cannot open " + path;
+        return std::nullopt;
+    }
+
+    const std::span<const std::byte> bytes{file.bytes()};
+    std::optional<Scene> scene;
+    if (bytes.size() >= kMagic.size() &&
+        std::memcmp(bytes.data(), kMagic.data(), kMagic.size()) == 0)
+    {
+        scene = load_binary(bytes, error);
+    }
+    else
+    {
+        scene = load_text(bytes, error);
+    }
+    if (!scene)
+    {
+        error = path + ": " + error;
+    }
+    return scene;
+}
+
+// Loads the binary form from memory, such as a scene received over the
+// network.
+inline std::optional<Scene> load_scene_binary(std::span<const std::byte> bytes,
+                                              std::string &error)
+{
+    using namespace scene_file_detail;
+
+    if (bytes.size() < kMagic.size() ||
+        std::memcmp(bytes.data(), kMagic.data(), kMagic.size()) != 0)
+    {
+        error = "not a binary scene";
+        return std::nullopt;
+    }
+    return load_binary(bytes, error);
+}
+
+// Writes the binary form, including the sphere hierarchy if one was built.
+inline void write_scene_binary(std::ostream &output, const Scene &scene)
+{
+    using namespace scene_file_detail;
+
+    const Camera &camera{scene._camera};
+    const SphereSet &spheres{scene._spheres};
+    const std::vector<BvhNode> &nodes{spheres.hierarchy().nodes()};
+
+    Header header{};
+    header._magic = kMagic;
+    header._aspect_ratio = camera._aspect_ratio;
+    header._image_width = camera._image_width;
+    header._samples_per_pixel = camera._samples_per_pixel;
+    header._max_depth = camera._max_depth;
+    header._vertical_fov = camera._vertical_fov;
+    header._look_from = to_array(camera._look_from);
+    header._look_at = to_array(camera._look_at);
+    header._vup = to_array(camera._vup);
+    header._defocus_angle = camera._defocus_angle;
+    header._focus_dist = camera._focus_dist;
+    header._material_count = scene._materials.size();
+    header._sphere_count = spheres.size();
+    header._node_count = nodes.size();
+    header._node_bytes = sizeof(BvhNode);
+    write_array(output, &header, 1);
+
+    for (MaterialId material{0}; material < scene._materials.size(); ++material)
+    {
+        const MaterialRecord record{to_record(scene._materials[material])};
+        write_array(output, &record, 1);
+    }
+
+    write_column(output, spheres.centre_x());
+    write_column(output, spheres.centre_y());
+    write_column(output, spheres.centre_z());
+    write_column(output, spheres.radii());
+    write_array(output, spheres.materials().data(), spheres.size());
+    const std::array<char, 8> padding{};
+    const std::size_t id_bytes{spheres.size() * sizeof(MaterialId)};
+    output.write(padding.data(),
+                 static_cast<std::streamsize>(padded(id_bytes) - id_bytes));
+
+    write_array(output, nodes.data(), nodes.size());
+}
+
+// Writes the text form, with enough digits to read back every value exactly.
+inline void write_scene_text(std::ostream &output, const Scene &scene)
+{
+    using namespace scene_file_detail;
+
+    const Camera &camera{scene._camera};
+
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    output << std::setprecision(17) << "# camera\n"
+           << "aspect_ratio " << camera._aspect_ratio << '\n'
+           << "image_width " << camera._image_width << '\n'
+           << "samples_per_pixel " << camera._samples_per_pixel << '\n'
+           << "max_depth " << camera._max_depth << '\n'
+           << "vertical_fov " << camera._vertical_fov << '\n'
+           << "look_from " << camera._look_from << '\n'
+           << "look_at " << camera._look_at << '\n'
+           << "vup " << camera._vup << '\n'
+           << "defocus_angle " << camera._defocus_angle << '\n'
+           << "focus_dist " << camera._focus_dist << '\n';
+
+    output << "# materials, numbered from 0\n";
+    for (MaterialId material{0}; material < scene._materials.size(); ++material)
+    {
+        const MaterialRecord record{to_record(scene._materials[material])};
+        const std::array<double, 4> &values{record._parameters};
+        switch (record._kind)
+        {
+        case MaterialKind::kLambertian:
+            output << "lambertian " << values[0] << ' ' << values[1] << ' '
+                   << values[2] << '\n';
+            break;
+        case MaterialKind::kMetal:
+            output << "metal " << values[0] << ' ' << values[1] << ' '
+                   << values[2] << ' ' << values[3] << '\n';
+            break;
+        case MaterialKind::kDielectric:
+            output << "dielectric " << values[0] << '\n';
+            break;
+        }
+    }
+
+    output << "# spheres: centre, radius, material\n";
+    const SphereSet &spheres{scene._spheres};
+    for (std::size_t index{0}; index < spheres.size(); ++index)
+    {
+        output << "sphere " << spheres.centre(index) << ' '
+               << spheres.radius(index) << ' ' << spheres.material(index)
+               << '\n';
+    }
+}
+
+#endif
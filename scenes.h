@@ -0,0 +1,232 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include "colour.h"
+#include "material.h"
+#include "rng.h"
+#include "scene.h"
+#include "texture.h"
+#include "texture_file.h"
+#include "utility.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// The book's camera: a 1200 pixel wide, 16:9 view from above the ground
+// plane with slight defocus blur, at 500 samples per pixel.
+inline void set_book_view(Camera &camera)
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    camera._aspect_ratio = 16.0 / 9.0;
+    camera._image_width = 1200;
+    camera._samples_per_pixel = 500;
+    camera._max_depth = 50;
+
+    camera._vertical_fov = 20;
+    camera._look_from = Point3{13, 2, 3};
+    camera._look_at = Point3{0, 0, 0};
+    camera._vup = Point3{0, 1, 0};
+
+    camera._defocus_angle = 0.6;
+    camera._focus_dist = 10.0;
+    // NOLINTEND(readability-magic-numbers)
+}
+
+// Materials given to the small spheres of random_spheres_scene.
+enum class SphereMix
+{
+    kBook,  // mostly diffuse with some metal and glass, as in the book cover
+    kGlass, // every sphere glass
+    kMetal  // every sphere metal
+};
+
+// The book's final scene: small spheres jittered about a grid on a ground
+// plane, around three large spheres.  The grid spans [-half_width,
+// half_width) in x and z, so the sphere count grows with its square; the
+// default reproduces the book's image, and the layout is the same for every
+// mix.  The camera is set up as in the book.
+inline Scene random_spheres_scene(int half_width = 11,
+                                  SphereMix mix = SphereMix::kBook,
+                                  std::uint64_t seed = 0)
+{
+    Scene scene;
+    MaterialTable &materials{scene._materials};
+    SphereSet &world{scene._spheres};
+    Rng scene_rng{seed};
+
+    // NOLINTBEGIN(readability-magic-numbers)
+    world.add(Point3{0, -1000, 0},
+              1000,
+              materials.add(Lambertian{Colour{0.5, 0.5, 0.5}}));
+
+    for (int aa{-half_width}; aa < half_width; ++aa)
+    {
+        for (int bb{-half_width}; bb < half_width; ++bb)
+        {
+            double choose_mat{random_double(scene_rng)};
+            if (mix == SphereMix::kGlass)
+            {
+                choose_mat = 1.0;
+            }
+            else if (mix == SphereMix::kMetal)
+            {
+                choose_mat = 0.9;
+            }
+            Point3 centre{
+                static_cast<Real>(aa + 0.9 * random_double(scene_rng)),
+                0.2_r,
+                static_cast<Real>(bb + 0.9 * random_double(scene_rng))};
+
+            if ((centre - Point3{4, 0.2_r, 0}).length() > 0.9_r)
+            {
+                MaterialId sphere_material{};
+
+                if (choose_mat < 0.8)
+                {
+                    // diffuse
+                    const Colour albedo{Colour::random(scene_rng) *
+                                        Colour::random(scene_rng)};
+                    sphere_material = materials.add(Lambertian{albedo});
+                    world.add(centre, 0.2_r, sphere_material);
+                }
+                else if (choose_mat < 0.95)
+                {
+                    // metal
+                    const Colour albedo{Colour::random(scene_rng, 0.5, 1)};
+                    auto fuzz(random_double(scene_rng, 0, 0.5));
+                    sphere_material = materials.add(Metal{albedo, fuzz});
+                    world.add(centre, 0.2_r, sphere_material);
+                }
+                else
+                {
+                    //glass
+                    sphere_material = materials.add(Dielectric{1.5});
+                    world.add(centre, 0.2_r, sphere_material);
+                }
+            }
+        }
+    }
+
+    world.add(Point3{0, 1, 0}, 1.0, materials.add(Dielectric{1.5}));
+
+    const Colour large_albedo{0.4_r, 0.2_r, 0.1_r};
+    const MaterialId material2{
+        mix == SphereMix::kBook    ? materials.add(Lambertian{large_albedo})
+        : mix == SphereMix::kGlass ? materials.add(Dielectric{1.5})
+                                   : materials.add(Metal{large_albedo, 0.3})};
+    world.add(Point3{-4, 1, 0}, 1.0, material2);
+
+    world.add(Point3{4, 1, 0},
+              1.0,
+              mix == SphereMix::kGlass
+                  ? materials.add(Dielectric{1.5})
+                  : materials.add(Metal{Colour{0.7_r, 0.6_r, 0.5_r}, 0.0}));
+    // NOLINTEND(readability-magic-numbers)
+
+    set_book_view(scene._camera);
+    return scene;
+}
+
+// Gives the large diffuse and metal spheres, those of radius from 1 up to
+// but not including the ground's, `texture` as albedo; returns how many.
+inline std::size_t texture_large_spheres(Scene &scene, const Texture &texture)
+{
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    constexpr Real kGroundRadius{1000};
+    std::size_t textured{0};
+    for (std::size_t index{0}; index < scene._spheres.size(); ++index)
+    {
+        const Real radius{scene._spheres.radius(index)};
+        if (radius < 1 || radius >= kGroundRadius)
+        {
+            continue;
+        }
+        const MaterialId id{scene._spheres.material(index)};
+        const Material &material{scene._materials[id]};
+        if (const auto *metal{material.get_if<Metal>()})
+        {
+            scene._materials.set(id, Metal{texture, metal->fuzz()});
+            ++textured;
+        }
+        else if (material.get_if<Lambertian>() != nullptr)
+        {
+            scene._materials.set(id, Lambertian{texture});
+            ++textured;
+        }
+    }
+    return textured;
+}
+
+// Writes a `size` x `size` test texture: a checkerboard of two colours
+// drawn from `seed`, 16 squares a side, ruled with dark lines every 16th of
+// a square, which blur to a tint where too coarse a mip level is read and
+// alias where too fine a one is.
+inline bool write_grid_texture(const std::string &path,
+                               std::uint32_t size,
+                               std::uint64_t seed,
+                               std::string &error)
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    Rng rng{seed};
+    const Colour light{Colour::random(rng, 0.5, 0.9)};
+    const Colour dark{Colour::random(rng, 0.1, 0.4)};
+    const std::uint32_t square{std::max(size / 16, 1U)};
+    const std::uint32_t rule{std::max(square / 16, 1U)};
+    return write_texture(
+        path,
+        size,
+        size,
+        [&](std::uint32_t x, std::uint32_t y) {
+            if (x % rule == 0 || y % rule == 0)
+            {
+                return Colour{0.02_r, 0.02_r, 0.02_r};
+            }
+            return (x / square + y / square) % 2 == 0 ? light : dark;
+        },
+        error);
+    // NOLINTEND(readability-magic-numbers)
+}
+
+// A cube of spheres_per_side^3 small diffuse spheres packed almost touching
+// above a ground plane, where nearly every ray meets many close primitives.
+inline Scene dense_grid_scene(int spheres_per_side, std::uint64_t seed = 0)
+{
+    Scene scene;
+    MaterialTable &materials{scene._materials};
+    SphereSet &world{scene._spheres};
+    Rng scene_rng{seed};
+
+    // NOLINTBEGIN(readability-magic-numbers)
+    world.add(Point3{0, -1000, 0},
+              1000,
+              materials.add(Lambertian{Colour{0.5, 0.5, 0.5}}));
+
+    const Real spacing{3 / static_cast<Real>(spheres_per_side)};
+    const Real radius{0.45_r * spacing};
+    const Point3 corner{
+        -1.5_r + 0.5_r * spacing, 0.5_r * spacing, -1.5_r + 0.5_r * spacing};
+    for (int x_index{0}; x_index < spheres_per_side; ++x_index)
+    {
+        for (int y_index{0}; y_index < spheres_per_side; ++y_index)
+        {
+            for (int z_index{0}; z_index < spheres_per_side; ++z_index)
+            {
+                const Point3 centre{
+                    corner + spacing * Vec3{static_cast<Real>(x_index),
+                                            static_cast<Real>(y_index),
+                                            static_cast<Real>(z_index)}};
+                const Colour albedo{Colour::random(scene_rng, 0.2, 0.9)};
+                world.add(centre, radius, materials.add(Lambertian{albedo}));
+            }
+        }
+    }
+    // NOLINTEND(readability-magic-numbers)
+
+    set_book_view(scene._camera);
+    return scene;
+}
+
+#endif
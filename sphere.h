@@ -4,34 +4,43 @@
 #include "hittable.h"
 #include "vec3.h"
 
+#include <cmath>
+
+// A sphere centred at `centre` at time 0 that moves by `motion` per unit of
+// time, static by default.
 class Sphere : public Hittable
 {
 public:
-    Sphere(Point3 centre, double radius, std::shared_ptr<Material> material)
-        : _centre(centre), _radius(radius), _material(material)
+    Sphere(Point3 centre,
+           Real radius,
+           MaterialId material,
+           Vec3 motion = Vec3{0, 0, 0})
+        : _centre(centre), _radius(radius), _material(material),
+          _motion(motion)
     {
     }
 
     bool hit(const Ray &ray, Interval ray_t, HitRecord &record) const override
     {
-        const Vec3 sphere_origin_displacement{ray.origin() - _centre};
-        const double quadratic_coefficient_a{ray.direction().length_squared()};
-        const double half_quadratic_coefficient_b{
+        const Point3 centre{_centre + ray.time() * _motion};
+        const Vec3 sphere_origin_displacement{ray.origin() - centre};
+        const Real quadratic_coefficient_a{ray.direction().length_squared()};
+        const Real half_quadratic_coefficient_b{
             dot(sphere_origin_displacement, ray.direction())};
-        const double quadratic_coefficient_c{
+        const Real quadratic_coefficient_c{
             sphere_origin_displacement.length_squared() - _radius * _radius};
 
-        const double discriminant{
+        const Real discriminant{
             half_quadratic_coefficient_b * half_quadratic_coefficient_b -
             quadratic_coefficient_a * quadratic_coefficient_c};
         if (discriminant < 0)
         {
             return false;
         }
-        const double discriminant_sqrt{sqrt(discriminant)};
+        const Real discriminant_sqrt{std::sqrt(discriminant)};
 
         // Find the nearest root that lines on the acceptable range
-        double root = (-half_quadratic_coefficient_b - discriminant_sqrt) /
+        Real root = (-half_quadratic_coefficient_b - discriminant_sqrt) /
                       quadratic_coefficient_a;
         if (!ray_t.surrounds(root))
         {
@@ -45,17 +54,28 @@ public:
 
         record._t_interval = root;
         record._point = ray.at(record._t_interval);
-        const Vec3 outward_normal{(record._point - _centre) / _radius};
+        const Vec3 outward_normal{(record._point - centre) / _radius};
         record.set_face_normal(ray, outward_normal);
+        record.set_sphere_uv(outward_normal, _radius);
         record._material = _material;
 
         return true;
     }
 
+    // Encloses the sphere over times 0 to 1.
+    [[nodiscard]] Aabb bounding_box() const override
+    {
+        const Vec3 extent{_radius, _radius, _radius};
+        const Point3 end{_centre + _motion};
+        return Aabb{Aabb{_centre - extent, _centre + extent},
+                    Aabb{end - extent, end + extent}};
+    }
+
 private:
     Point3 _centre;
-    double _radius;
-    std::shared_ptr<Material> _material;
+    Real _radius;
+    MaterialId _material;
+    Vec3 _motion;
 };
 
 #endif
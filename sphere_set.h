@@ -0,0 +1,740 @@
+#ifndef SPHERE_SET_H
+#define SPHERE_SET_H
+
+#include "bvh.h"
+#include "hittable.h"
+#include "render_counters.h"
+#include "vec3.h"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX512F__) || defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+// Spheres stored as structure-of-arrays: centre components, radii and
+// material indices each live in their own contiguous array.  hit() tests a
+// whole batch of spheres per step with AVX-512 (8 lanes, 16 in float builds)
+// or AVX (4 lanes, 8 in float builds) when the build enables them, falling
+// back to one sphere at a time.  Every lane repeats the arithmetic of
+// Sphere::hit operation for operation, so the records produced are identical
+// to those of an equivalent list of Sphere.  Large sets can build a bounding
+// volume hierarchy over the spheres, after which hit() walks it and tests
+// only the spheres of the leaves it reaches.
+//
+// Spheres may move, each by its own displacement per unit of time, and are
+// then tested where they are at the ray's time.  Their bounds enclose the
+// motion over times 0 to 1, so a motion-blurred render walks the same kind
+// of hierarchy as a static one.  The motion columns stay empty while every
+// sphere is static, and moving sets skip the batched kernel.
+class SphereSet : public Hittable
+{
+public:
+#if defined(__AVX512F__)
+    static constexpr std::size_t kLanes{64 / sizeof(Real)};
+    static constexpr const char *kKernel{"avx512"};
+#elif defined(__AVX__)
+    static constexpr std::size_t kLanes{32 / sizeof(Real)};
+    static constexpr const char *kKernel{"avx"};
+#else
+    static constexpr std::size_t kLanes{1};
+    static constexpr const char *kKernel{"scalar"};
+#endif
+
+    SphereSet() = default;
+
+    // Adds a sphere centred at `centre` at time 0.
+    void add(const Point3 &centre,
+             Real radius,
+             MaterialId material,
+             const Vec3 &motion = Vec3{0, 0, 0})
+    {
+        _centre_x.push_back(centre.x());
+        _centre_y.push_back(centre.y());
+        _centre_z.push_back(centre.z());
+        _radius.push_back(radius);
+        _material.push_back(material);
+        _tree = BvhTree{};
+        if (moving() || motion.length_squared() > 0)
+        {
+            reserve_motion();
+            _motion_x.back() = motion.x();
+            _motion_y.back() = motion.y();
+            _motion_z.back() = motion.z();
+        }
+
+        _bbox = Aabb{_bbox, sphere_bounds(size() - 1)};
+    }
+
+    // Replaces the contents with the given columns, which must all be the
+    // same length, in one bulk copy per column.  The spheres are static.
+    void assign(std::span<const double> centre_x,
+                std::span<const double> centre_y,
+                std::span<const double> centre_z,
+                std::span<const double> radius,
+                std::span<const MaterialId> material)
+    {
+        _centre_x.assign(centre_x.begin(), centre_x.end());
+        _centre_y.assign(centre_y.begin(), centre_y.end());
+        _centre_z.assign(centre_z.begin(), centre_z.end());
+        _radius.assign(radius.begin(), radius.end());
+        _material.assign(material.begin(), material.end());
+        _motion_x.clear();
+        _motion_y.clear();
+        _motion_z.clear();
+        _tree = BvhTree{};
+
+        _bbox = Aabb{};
+        for (std::size_t index{0}; index < size(); ++index)
+        {
+            _bbox = Aabb{_bbox, sphere_bounds(index)};
+        }
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return _radius.size();
+    }
+
+    // The centre at time 0.
+    [[nodiscard]] Point3 centre(std::size_t index) const
+    {
+        return Point3{_centre_x[index], _centre_y[index], _centre_z[index]};
+    }
+
+    [[nodiscard]] Vec3 motion(std::size_t index) const
+    {
+        if (!moving())
+        {
+            return Vec3{0, 0, 0};
+        }
+        return Vec3{_motion_x[index], _motion_y[index], _motion_z[index]};
+    }
+
+    [[nodiscard]] bool moving() const
+    {
+        return !_motion_x.empty();
+    }
+
+    [[nodiscard]] Real radius(std::size_t index) const
+    {
+        return _radius[index];
+    }
+
+    [[nodiscard]] MaterialId material(std::size_t index) const
+    {
+        return _material[index];
+    }
+
+    // The columns in storage order, for writing the set out in bulk.
+    [[nodiscard]] const std::vector<Real> &centre_x() const
+    {
+        return _centre_x;
+    }
+
+    [[nodiscard]] const std::vector<Real> &centre_y() const
+    {
+        return _centre_y;
+    }
+
+    [[nodiscard]] const std::vector<Real> &centre_z() const
+    {
+        return _centre_z;
+    }
+
+    [[nodiscard]] const std::vector<Real> &radii() const
+    {
+        return _radius;
+    }
+
+    [[nodiscard]] const std::vector<MaterialId> &materials() const
+    {
+        return _material;
+    }
+
+    // Builds a hierarchy over the spheres and reorders them into its leaf
+    // order.  Adding spheres afterwards discards the hierarchy.
+    void build_hierarchy()
+    {
+        std::vector<Aabb> bounds;
+        bounds.reserve(size());
+        for (std::size_t index{0}; index < size(); ++index)
+        {
+            bounds.push_back(sphere_bounds(index));
+        }
+        BvhTree tree{bounds};
+
+        const std::vector<std::uint32_t> &order{tree.order()};
+        permute(_centre_x, order);
+        permute(_centre_y, order);
+        permute(_centre_z, order);
+        permute(_radius, order);
+        permute(_material, order);
+        if (moving())
+        {
+            permute(_motion_x, order);
+            permute(_motion_y, order);
+            permute(_motion_z, order);
+        }
+        _tree = BvhTree{tree.nodes()};
+    }
+
+    // Moves a sphere.  The hierarchy, if any, is stale until refitted or
+    // rebuilt.
+    void set_centre(std::size_t index, const Point3 &centre)
+    {
+        _centre_x[index] = centre.x();
+        _centre_y[index] = centre.y();
+        _centre_z[index] = centre.z();
+    }
+
+    // Sets a sphere's displacement per unit of time, with the same caveat.
+    void set_motion(std::size_t index, const Vec3 &motion)
+    {
+        if (!moving() && motion.length_squared() == 0)
+        {
+            return;
+        }
+        reserve_motion();
+        _motion_x[index] = motion.x();
+        _motion_y[index] = motion.y();
+        _motion_z[index] = motion.z();
+    }
+
+    // Updates the hierarchy's bounds, and the set's, to the spheres' current
+    // positions without reordering them.
+    void refit_hierarchy()
+    {
+        _tree.refit([this](std::uint32_t index) {
+            return sphere_bounds(index);
+        });
+        _bbox = Aabb{};
+        for (std::size_t index{0}; index < size(); ++index)
+        {
+            _bbox = Aabb{_bbox, sphere_bounds(index)};
+        }
+    }
+
+    // Adopts a hierarchy built earlier over the spheres in their current
+    // order.  Returns false, leaving the set unchanged, if the nodes do not
+    // describe a valid hierarchy over this many spheres.
+    bool adopt_hierarchy(std::vector<BvhNode> nodes)
+    {
+        BvhTree tree{std::move(nodes)};
+        if (!tree.well_formed(size()))
+        {
+            return false;
+        }
+        _tree = std::move(tree);
+        return true;
+    }
+
+    [[nodiscard]] const BvhTree &hierarchy() const
+    {
+        return _tree;
+    }
+
+    bool hit(const Ray &ray, Interval ray_t, HitRecord &record) const override
+    {
+        std::size_t closest_index{size()};
+        Real closest{ray_t._max};
+        if (_tree.nodes().empty())
+        {
+            closest_index = closest_in_range(ray, ray_t, 0, size(), closest);
+        }
+        else
+        {
+            _tree.hit(ray,
+                      ray_t,
+                      [this, &ray, &closest, &closest_index](
+                          std::uint32_t position, Interval &leaf_t) {
+                          RT_COUNT(_primitives_tested, 1U);
+                          const Real root{sphere_root(ray, leaf_t, position)};
+                          if (root >= leaf_t._max)
+                          {
+                              return false;
+                          }
+                          leaf_t._max = root;
+                          closest = root;
+                          closest_index = position;
+                          return true;
+                      });
+        }
+
+        if (closest_index == size())
+        {
+            return false;
+        }
+        fill_record(ray, closest_index, closest, record);
+        return true;
+    }
+
+    // With a hierarchy, rays in consecutive slots share walks of it in
+    // packets; without one, each ray goes through hit().
+    void hit_batch(std::span<const Ray> rays,
+                   std::span<const std::uint32_t> slots,
+                   Real t_min,
+                   std::span<Real> closest,
+                   std::span<HitRecord> records) const override
+    {
+        if (_tree.nodes().empty())
+        {
+            Hittable::hit_batch(rays, slots, t_min, closest, records);
+            return;
+        }
+        for_each_packet(
+            rays, slots, t_min, closest, [&](RayPacket &packet, auto slot) {
+                std::array<std::size_t, RayPacket::kSize> nearest{};
+                nearest.fill(size());
+                _tree.hit_packet(
+                    packet,
+                    [&](std::size_t lane,
+                        std::uint32_t position,
+                        Interval &lane_t) {
+                        RT_COUNT(_primitives_tested, 1U);
+                        const Real root{sphere_root(
+                            *packet._rays[lane], lane_t, position)};
+                        if (root >= lane_t._max)
+                        {
+                            return false;
+                        }
+                        lane_t._max = root;
+                        nearest[lane] = position;
+                        return true;
+                    });
+                for (std::size_t lane{0}; lane < packet._count; ++lane)
+                {
+                    if (nearest[lane] != size())
+                    {
+                        fill_record(*packet._rays[lane],
+                                    nearest[lane],
+                                    packet._closest[lane],
+                                    records[slot(lane)]);
+                    }
+                }
+            });
+    }
+
+    [[nodiscard]] Aabb bounding_box() const override
+    {
+        return _bbox;
+    }
+
+private:
+    std::vector<Real> _centre_x;
+    std::vector<Real> _centre_y;
+    std::vector<Real> _centre_z;
+    std::vector<Real> _radius;
+    std::vector<MaterialId> _material;
+    std::vector<Real> _motion_x; // all empty unless a sphere moves
+    std::vector<Real> _motion_y;
+    std::vector<Real> _motion_z;
+    Aabb _bbox;
+    BvhTree _tree; // empty unless build_hierarchy or adopt_hierarchy ran
+
+    void fill_record(const Ray &ray,
+                     std::size_t index,
+                     Real distance,
+                     HitRecord &record) const
+    {
+        const Point3 centre{centre_at(index, ray.time())};
+        record._t_interval = distance;
+        record._point = ray.at(record._t_interval);
+        const Vec3 outward_normal{(record._point - centre) / _radius[index]};
+        record.set_face_normal(ray, outward_normal);
+        record.set_sphere_uv(outward_normal, _radius[index]);
+        record._material = _material[index];
+    }
+
+    // Encloses the sphere over times 0 to 1.
+    [[nodiscard]] Aabb sphere_bounds(std::size_t index) const
+    {
+        const Vec3 extent{_radius[index], _radius[index], _radius[index]};
+        const Aabb start{centre(index) - extent, centre(index) + extent};
+        if (!moving())
+        {
+            return start;
+        }
+        const Point3 end{centre(index) + motion(index)};
+        return Aabb{start, Aabb{end - extent, end + extent}};
+    }
+
+    [[nodiscard]] Point3 centre_at(std::size_t index, Real time) const
+    {
+        if (!moving())
+        {
+            return centre(index);
+        }
+        return centre(index) + time * motion(index);
+    }
+
+    // Gives every sphere a motion entry, zero for those without one.
+    void reserve_motion()
+    {
+        _motion_x.resize(size());
+        _motion_y.resize(size());
+        _motion_z.resize(size());
+    }
+
+    template <typename T>
+    static void permute(std::vector<T> &column,
+                        const std::vector<std::uint32_t> &order)
+    {
+        std::vector<T> permuted;
+        permuted.reserve(column.size());
+        for (const std::uint32_t index : order)
+        {
+            permuted.push_back(column[index]);
+        }
+        column = std::move(permuted);
+    }
+
+    // Index of the nearest sphere in [begin, end) hit within ray_t, or size()
+    // if none is; `closest` is narrowed to its root.
+    [[nodiscard]] std::size_t closest_in_range(const Ray &ray,
+                                               Interval ray_t,
+                                               std::size_t begin,
+                                               std::size_t end,
+                                               Real &closest) const
+    {
+        RT_COUNT(_primitives_tested, end - begin);
+        std::size_t closest_index{size()};
+
+        std::size_t base{begin};
+#if defined(__AVX512F__) || defined(__AVX__)
+        std::array<Real, kLanes> roots{};
+        for (; !moving() && base + kLanes <= end; base += kLanes)
+        {
+            batch_roots(ray, Interval{ray_t._min, closest}, base, roots);
+            for (std::size_t lane{0}; lane < kLanes; ++lane)
+            {
+                if (roots[lane] < closest)
+                {
+                    closest = roots[lane];
+                    closest_index = base + lane;
+                }
+            }
+        }
+#endif
+        for (; base < end; ++base)
+        {
+            const Real root{
+                sphere_root(ray, Interval{ray_t._min, closest}, base)};
+            if (root < closest)
+            {
+                closest = root;
+                closest_index = base;
+            }
+        }
+        return closest_index;
+    }
+
+    // Nearest root of sphere `index` in the open interval, or infinity.
+    [[nodiscard]] Real sphere_root(const Ray &ray,
+                                   Interval ray_t,
+                                   std::size_t index) const
+    {
+        const Vec3 sphere_origin_displacement{ray.origin() -
+                                              centre_at(index, ray.time())};
+        const Real quadratic_coefficient_a{ray.direction().length_squared()};
+        const Real half_quadratic_coefficient_b{
+            dot(sphere_origin_displacement, ray.direction())};
+        const Real quadratic_coefficient_c{
+            sphere_origin_displacement.length_squared() -
+            _radius[index] * _radius[index]};
+
+        const Real discriminant{
+            half_quadratic_coefficient_b * half_quadratic_coefficient_b -
+            quadratic_coefficient_a * quadratic_coefficient_c};
+        if (discriminant < 0)
+        {
+            return constants::kInfinity;
+        }
+        const Real discriminant_sqrt{std::sqrt(discriminant)};
+
+        Real root = (-half_quadratic_coefficient_b - discriminant_sqrt) /
+                    quadratic_coefficient_a;
+        if (!ray_t.surrounds(root))
+        {
+            root = (-half_quadratic_coefficient_b + discriminant_sqrt) /
+                   quadratic_coefficient_a;
+            if (!ray_t.surrounds(root))
+            {
+                return constants::kInfinity;
+            }
+        }
+        return root;
+    }
+
+#if defined(__AVX512F__) || defined(__AVX__)
+    // Writes the nearest root in the open interval (or infinity) for each of
+    // the kLanes spheres starting at `base`.
+    void batch_roots(const Ray &ray,
+                     Interval ray_t,
+                     std::size_t base,
+                     std::array<Real, kLanes> &roots) const
+    {
+        const Point3 origin{ray.origin()};
+        const Vec3 direction{ray.direction()};
+        const Real quadratic_coefficient_a{direction.length_squared()};
+
+#if defined(__AVX512F__) && defined(RT_USE_FLOAT)
+        const __m512 dx{_mm512_set1_ps(direction[0])};
+        const __m512 dy{_mm512_set1_ps(direction[1])};
+        const __m512 dz{_mm512_set1_ps(direction[2])};
+        const __m512 ox{
+            _mm512_sub_ps(_mm512_set1_ps(origin[0]),
+                          _mm512_loadu_ps(&_centre_x[base]))};
+        const __m512 oy{
+            _mm512_sub_ps(_mm512_set1_ps(origin[1]),
+                          _mm512_loadu_ps(&_centre_y[base]))};
+        const __m512 oz{
+            _mm512_sub_ps(_mm512_set1_ps(origin[2]),
+                          _mm512_loadu_ps(&_centre_z[base]))};
+        const __m512 radius{_mm512_loadu_ps(&_radius[base])};
+        const __m512 a_value{_mm512_set1_ps(quadratic_coefficient_a)};
+
+        const __m512 half_b{_mm512_add_ps(
+            _mm512_add_ps(_mm512_mul_ps(ox, dx), _mm512_mul_ps(oy, dy)),
+            _mm512_mul_ps(oz, dz))};
+        const __m512 c_value{_mm512_sub_ps(
+            _mm512_add_ps(
+                _mm512_add_ps(_mm512_mul_ps(ox, ox), _mm512_mul_ps(oy, oy)),
+                _mm512_mul_ps(oz, oz)),
+            _mm512_mul_ps(radius, radius))};
+        const __m512 discriminant{
+            _mm512_sub_ps(_mm512_mul_ps(half_b, half_b),
+                          _mm512_mul_ps(a_value, c_value))};
+        const __mmask16 real_roots{_mm512_cmp_ps_mask(
+            discriminant, _mm512_setzero_ps(), _CMP_GE_OQ)};
+
+        if (real_roots == 0)
+        {
+            roots.fill(constants::kInfinity);
+            return;
+        }
+
+        const __m512 discriminant_sqrt{
+            _mm512_maskz_sqrt_ps(real_roots, discriminant)};
+        const __m512 minus_half_b{_mm512_castsi512_ps(_mm512_xor_si512(
+            _mm512_castps_si512(half_b),
+            _mm512_castps_si512(_mm512_set1_ps(-0.0F))))};
+        const __m512 near_root{_mm512_div_ps(
+            _mm512_sub_ps(minus_half_b, discriminant_sqrt), a_value)};
+        const __m512 far_root{_mm512_div_ps(
+            _mm512_add_ps(minus_half_b, discriminant_sqrt), a_value)};
+
+        const __m512 t_min{_mm512_set1_ps(ray_t._min)};
+        const __m512 t_max{_mm512_set1_ps(ray_t._max)};
+        const __mmask16 near_inside{_mm512_mask_cmp_ps_mask(
+            _mm512_cmp_ps_mask(near_root, t_min, _CMP_GT_OQ),
+            near_root,
+            t_max,
+            _CMP_LT_OQ)};
+        const __mmask16 far_inside{_mm512_mask_cmp_ps_mask(
+            _mm512_cmp_ps_mask(far_root, t_min, _CMP_GT_OQ),
+            far_root,
+            t_max,
+            _CMP_LT_OQ)};
+
+        __m512 root{_mm512_set1_ps(constants::kInfinity)};
+        root = _mm512_mask_mov_ps(
+            root, static_cast<__mmask16>(far_inside & real_roots), far_root);
+        root = _mm512_mask_mov_ps(
+            root, static_cast<__mmask16>(near_inside & real_roots), near_root);
+        _mm512_storeu_ps(roots.data(), root);
+#elif defined(__AVX512F__)
+        const __m512d dx{_mm512_set1_pd(direction[0])};
+        const __m512d dy{_mm512_set1_pd(direction[1])};
+        const __m512d dz{_mm512_set1_pd(direction[2])};
+        const __m512d ox{
+            _mm512_sub_pd(_mm512_set1_pd(origin[0]),
+                          _mm512_loadu_pd(&_centre_x[base]))};
+        const __m512d oy{
+            _mm512_sub_pd(_mm512_set1_pd(origin[1]),
+                          _mm512_loadu_pd(&_centre_y[base]))};
+        const __m512d oz{
+            _mm512_sub_pd(_mm512_set1_pd(origin[2]),
+                          _mm512_loadu_pd(&_centre_z[base]))};
+        const __m512d radius{_mm512_loadu_pd(&_radius[base])};
+        const __m512d a_value{_mm512_set1_pd(quadratic_coefficient_a)};
+
+        const __m512d half_b{_mm512_add_pd(
+            _mm512_add_pd(_mm512_mul_pd(ox, dx), _mm512_mul_pd(oy, dy)),
+            _mm512_mul_pd(oz, dz))};
+        const __m512d c_value{_mm512_sub_pd(
+            _mm512_add_pd(
+                _mm512_add_pd(_mm512_mul_pd(ox, ox), _mm512_mul_pd(oy, oy)),
+                _mm512_mul_pd(oz, oz)),
+            _mm512_mul_pd(radius, radius))};
+        const __m512d discriminant{
+            _mm512_sub_pd(_mm512_mul_pd(half_b, half_b),
+                          _mm512_mul_pd(a_value, c_value))};
+        const __mmask8 real_roots{_mm512_cmp_pd_mask(
+            discriminant, _mm512_setzero_pd(), _CMP_GE_OQ)};
+
+        if (real_roots == 0)
+        {
+            roots.fill(constants::kInfinity);
+            return;
+        }
+
+        const __m512d discriminant_sqrt{
+            _mm512_maskz_sqrt_pd(real_roots, discriminant)};
+        const __m512d minus_half_b{_mm512_castsi512_pd(_mm512_xor_si512(
+            _mm512_castpd_si512(half_b),
+            _mm512_castpd_si512(_mm512_set1_pd(-0.0))))};
+        const __m512d near_root{_mm512_div_pd(
+            _mm512_sub_pd(minus_half_b, discriminant_sqrt), a_value)};
+        const __m512d far_root{_mm512_div_pd(
+            _mm512_add_pd(minus_half_b, discriminant_sqrt), a_value)};
+
+        const __m512d t_min{_mm512_set1_pd(ray_t._min)};
+        const __m512d t_max{_mm512_set1_pd(ray_t._max)};
+        const __mmask8 near_inside{_mm512_mask_cmp_pd_mask(
+            _mm512_cmp_pd_mask(near_root, t_min, _CMP_GT_OQ),
+            near_root,
+            t_max,
+            _CMP_LT_OQ)};
+        const __mmask8 far_inside{_mm512_mask_cmp_pd_mask(
+            _mm512_cmp_pd_mask(far_root, t_min, _CMP_GT_OQ),
+            far_root,
+            t_max,
+            _CMP_LT_OQ)};
+
+        __m512d root{_mm512_set1_pd(constants::kInfinity)};
+        root = _mm512_mask_mov_pd(
+            root, static_cast<__mmask8>(far_inside & real_roots), far_root);
+        root = _mm512_mask_mov_pd(
+            root, static_cast<__mmask8>(near_inside & real_roots), near_root);
+        _mm512_storeu_pd(roots.data(), root);
+#elif defined(__AVX__) && defined(RT_USE_FLOAT)
+        const __m256 dx{_mm256_set1_ps(direction[0])};
+        const __m256 dy{_mm256_set1_ps(direction[1])};
+        const __m256 dz{_mm256_set1_ps(direction[2])};
+        const __m256 ox{
+            _mm256_sub_ps(_mm256_set1_ps(origin[0]),
+                          _mm256_loadu_ps(&_centre_x[base]))};
+        const __m256 oy{
+            _mm256_sub_ps(_mm256_set1_ps(origin[1]),
+                          _mm256_loadu_ps(&_centre_y[base]))};
+        const __m256 oz{
+            _mm256_sub_ps(_mm256_set1_ps(origin[2]),
+                          _mm256_loadu_ps(&_centre_z[base]))};
+        const __m256 radius{_mm256_loadu_ps(&_radius[base])};
+        const __m256 a_value{_mm256_set1_ps(quadratic_coefficient_a)};
+
+        const __m256 half_b{_mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(ox, dx), _mm256_mul_ps(oy, dy)),
+            _mm256_mul_ps(oz, dz))};
+        const __m256 c_value{_mm256_sub_ps(
+            _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(ox, ox), _mm256_mul_ps(oy, oy)),
+                _mm256_mul_ps(oz, oz)),
+            _mm256_mul_ps(radius, radius))};
+        const __m256 discriminant{
+            _mm256_sub_ps(_mm256_mul_ps(half_b, half_b),
+                          _mm256_mul_ps(a_value, c_value))};
+        const __m256 real_roots{
+            _mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_GE_OQ)};
+
+        if (_mm256_movemask_ps(real_roots) == 0)
+        {
+            roots.fill(constants::kInfinity);
+            return;
+        }
+
+        const __m256 discriminant_sqrt{_mm256_sqrt_ps(discriminant)};
+        const __m256 minus_half_b{
+            _mm256_xor_ps(half_b, _mm256_set1_ps(-0.0F))};
+        const __m256 near_root{_mm256_div_ps(
+            _mm256_sub_ps(minus_half_b, discriminant_sqrt), a_value)};
+        const __m256 far_root{_mm256_div_ps(
+            _mm256_add_ps(minus_half_b, discriminant_sqrt), a_value)};
+
+        const __m256 t_min{_mm256_set1_ps(ray_t._min)};
+        const __m256 t_max{_mm256_set1_ps(ray_t._max)};
+        const __m256 near_inside{
+            _mm256_and_ps(_mm256_cmp_ps(near_root, t_min, _CMP_GT_OQ),
+                          _mm256_cmp_ps(near_root, t_max, _CMP_LT_OQ))};
+        const __m256 far_inside{
+            _mm256_and_ps(_mm256_cmp_ps(far_root, t_min, _CMP_GT_OQ),
+                          _mm256_cmp_ps(far_root, t_max, _CMP_LT_OQ))};
+
+        __m256 root{_mm256_set1_ps(constants::kInfinity)};
+        root = _mm256_blendv_ps(
+            root, far_root, _mm256_and_ps(far_inside, real_roots));
+        root = _mm256_blendv_ps(
+            root, near_root, _mm256_and_ps(near_inside, real_roots));
+        _mm256_storeu_ps(roots.data(), root);
+#elif defined(__AVX__)
+        const __m256d dx{_mm256_set1_pd(direction[0])};
+        const __m256d dy{_mm256_set1_pd(direction[1])};
+        const __m256d dz{_mm256_set1_pd(direction[2])};
+        const __m256d ox{
+            _mm256_sub_pd(_mm256_set1_pd(origin[0]),
+                          _mm256_loadu_pd(&_centre_x[base]))};
+        const __m256d oy{
+            _mm256_sub_pd(_mm256_set1_pd(origin[1]),
+                          _mm256_loadu_pd(&_centre_y[base]))};
+        const __m256d oz{
+            _mm256_sub_pd(_mm256_set1_pd(origin[2]),
+                          _mm256_loadu_pd(&_centre_z[base]))};
+        const __m256d radius{_mm256_loadu_pd(&_radius[base])};
+        const __m256d a_value{_mm256_set1_pd(quadratic_coefficient_a)};
+
+        const __m256d half_b{_mm256_add_pd(
+            _mm256_add_pd(_mm256_mul_pd(ox, dx), _mm256_mul_pd(oy, dy)),
+            _mm256_mul_pd(oz, dz))};
+        const __m256d c_value{_mm256_sub_pd(
+            _mm256_add_pd(
+                _mm256_add_pd(_mm256_mul_pd(ox, ox), _mm256_mul_pd(oy, oy)),
+                _mm256_mul_pd(oz, oz)),
+            _mm256_mul_pd(radius, radius))};
+        const __m256d discriminant{
+            _mm256_sub_pd(_mm256_mul_pd(half_b, half_b),
+                          _mm256_mul_pd(a_value, c_value))};
+        const __m256d real_roots{
+            _mm256_cmp_pd(discriminant, _mm256_setzero_pd(), _CMP_GE_OQ)};
+
+        if (_mm256_movemask_pd(real_roots) == 0)
+        {
+            roots.fill(constants::kInfinity);
+            return;
+        }
+
+        const __m256d discriminant_sqrt{_mm256_sqrt_pd(discriminant)};
+        const __m256d minus_half_b{
+            _mm256_xor_pd(half_b, _mm256_set1_pd(-0.0))};
+        const __m256d near_root{_mm256_div_pd(
+            _mm256_sub_pd(minus_half_b, discriminant_sqrt), a_value)};
+        const __m256d far_root{_mm256_div_pd(
+            _mm256_add_pd(minus_half_b, discriminant_sqrt), a_value)};
+
+        const __m256d t_min{_mm256_set1_pd(ray_t._min)};
+        const __m256d t_max{_mm256_set1_pd(ray_t._max)};
+        const __m256d near_inside{
+            _mm256_and_pd(_mm256_cmp_pd(near_root, t_min, _CMP_GT_OQ),
+                          _mm256_cmp_pd(near_root, t_max, _CMP_LT_OQ))};
+        const __m256d far_inside{
+            _mm256_and_pd(_mm256_cmp_pd(far_root, t_min, _CMP_GT_OQ),
+                          _mm256_cmp_pd(far_root, t_max, _CMP_LT_OQ))};
+
+        __m256d root{_mm256_set1_pd(constants::kInfinity)};
+        root = _mm256_blendv_pd(
+            root, far_root, _mm256_and_pd(far_inside, real_roots));
+        root = _mm256_blendv_pd(
+            root, near_root, _mm256_and_pd(near_inside, real_roots));
+        _mm256_storeu_pd(roots.data(), root);
+#endif
+    }
+#endif
+};
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include "colour.h"
+#include "hittable.h"
+#include "texture_cache.h"
+#include "texture_file.h"
+#include "utility.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <variant>
+
+// An image mapped onto surfaces by their texture coordinates, read through
+// a TileCache.  u wraps around and v is clamped, which suits spheres.  Each
+// lookup picks the mip levels whose texels match the footprint's size, so
+// distant and indirectly seen surfaces touch the small levels' few tiles,
+// and blends bilinear samples of the two nearest (trilinear filtering).
+// The file and the cache must outlive the texture.
+class ImageTexture
+{
+public:
+    ImageTexture(const TextureFile &file, TileCache &cache)
+        : _file(&file), _cache(&cache), _id(cache.add(file))
+    {
+    }
+
+    // The colour at (u, v), filtered over `footprint` units of texture
+    // space, in which the whole image spans 1.
+    [[nodiscard]] Colour value(Real u, Real v, Real footprint) const
+    {
+        const Real texels{
+            footprint *
+            static_cast<Real>(std::max(_file->width(), _file->height()))};
+        const Real last{static_cast<Real>(_file->level_count() - 1)};
+        const Real level{
+            std::clamp(std::log2(std::fmax(texels, Real{1})), Real{0}, last)};
+        const auto coarse{static_cast<std::uint32_t>(level)};
+        const Real blend{level - static_cast<Real>(coarse)};
+        const Real wrapped{u - std::floor(u)};
+        const Real clamped{std::clamp(v, Real{0}, Real{1})};
+        const Colour fine_colour{bilinear(coarse, wrapped, clamped)};
+        if (blend == 0)
+        {
+            return fine_colour;
+        }
+        return (1 - blend) * fine_colour +
+               blend * bilinear(coarse + 1, wrapped, clamped);
+    }
+
+private:
+    const TextureFile *_file;
+    TileCache *_cache;
+    std::uint32_t _id;
+
+    // Texel centres sit at half-integer coordinates, as in image space.
+    [[nodiscard]] Colour bilinear(std::uint32_t level, Real u, Real v) const
+    {
+        const std::uint32_t width{_file->width(level)};
+        const std::uint32_t height{_file->height(level)};
+        // NOLINTBEGIN(readability-magic-numbers)
+        const Real x{u * static_cast<Real>(width) - 0.5_r};
+        const Real y{v * static_cast<Real>(height) - 0.5_r};
+        // NOLINTEND(readability-magic-numbers)
+        const Real left{std::floor(x)};
+        const Real top{std::floor(y)};
+        const Real across{x - left};
+        const Real down{y - top};
+
+        const auto wrap_column{[width](Real column) {
+            const auto wide{static_cast<std::int64_t>(width)};
+            return static_cast<std::uint32_t>(
+                ((static_cast<std::int64_t>(column) % wide) + wide) % wide);
+        }};
+        const auto clamp_row{[height](Real row) {
+            return static_cast<std::uint32_t>(std::clamp(
+                row, Real{0}, static_cast<Real>(height - 1)));
+        }};
+        const std::array<std::uint32_t, 2> columns{wrap_column(left),
+                                                   wrap_column(left + 1)};
+        const std::array<std::uint32_t, 2> rows{clamp_row(top),
+                                                clamp_row(top + 1)};
+
+        std::array<Colour, 4> corners{};
+        const std::uint32_t tile{_file->tile(level, columns[0], rows[0])};
+        if (tile == _file->tile(level, columns[1], rows[1]))
+        {
+            // usually all four lie in one tile: a single lookup
+            _cache->read_tile(_id, tile, [&](std::span<const float> texels) {
+                for (std::size_t corner{0}; corner < 4; ++corner)
+                {
+                    corners[corner] = texel(
+                        texels, columns[corner % 2], rows[corner / 2]);
+                }
+            });
+        }
+        else
+        {
+            for (std::size_t corner{0}; corner < 4; ++corner)
+            {
+                const std::uint32_t column{columns[corner % 2]};
+                const std::uint32_t row{rows[corner / 2]};
+                _cache->read_tile(_id,
+                                  _file->tile(level, column, row),
+                                  [&](std::span<const float> texels) {
+                                      corners[corner] =
+                                          texel(texels, column, row);
+                                  });
+            }
+        }
+        return (1 - down) * ((1 - across) * corners[0] + across * corners[1]) +
+               down * ((1 - across) * corners[2] + across * corners[3]);
+    }
+
+    static Colour texel(std::span<const float> texels,
+                        std::uint32_t column,
+                        std::uint32_t row)
+    {
+        const std::size_t first{
+            3 * (std::size_t{row % kTextureTileSize} * kTextureTileSize +
+                 column % kTextureTileSize)};
+        return {static_cast<Real>(texels[first]),
+                static_cast<Real>(texels[first + 1]),
+                static_cast<Real>(texels[first + 2])};
+    }
+};
+
+// A surface colour, either constant or read from an image.  Like Material,
+// a closed set of kinds held by value.
+class Texture
+{
+public:
+    explicit Texture(const Colour &colour) : _kind(colour)
+    {
+    }
+
+    explicit Texture(const ImageTexture &image) : _kind(image)
+    {
+    }
+
+    // The colour at a hit, filtered over the width of the ray's footprint.
+    [[nodiscard]] Colour value(const HitRecord &record) const
+    {
+        if (const Colour *colour{std::get_if<Colour>(&_kind)})
+        {
+            return *colour;
+        }
+        const auto [u, v]{record.uv()};
+        return std::get_if<ImageTexture>(&_kind)->value(
+            u, v, record._footprint * record._uv_density);
+    }
+
+    // The constant colour, or null for an image.
+    [[nodiscard]] const Colour *colour() const
+    {
+        return std::get_if<Colour>(&_kind);
+    }
+
+private:
+    std::variant<Colour, ImageTexture> _kind;
+};
+
+#endif
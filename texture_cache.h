@@ -0,0 +1,259 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "texture_file.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+// Decoded texture tiles for every texture of a scene, held in a fixed
+// number of slots whatever the textures' total size, and shared by all
+// render threads.
+//
+// Each texture keeps one atomic slot number per tile, so a lookup is a load
+// of that entry and a pin of the slot it names: no lock and no hashing.  A
+// reader pins the slot, then checks that the slot still holds its tile, and
+// reads the texels while pinned.  A miss takes the cache's mutex, picks a
+// victim with the CLOCK approximation of least recently used (each lookup
+// sets its slot's reference bit; the hand clears set bits and evicts the
+// first slot found clear and unpinned), waits out any reader still pinning
+// the victim, then decodes the new tile into it.  Misses serialise on the
+// mutex, which is cheap once the working set is resident.  A tile's file
+// pages are dropped as soon as it is decoded, so resident memory stays near
+// the slots' size however much texture data the scene maps.
+//
+// Every texture must be added before rendering starts.
+class TileCache
+{
+public:
+    struct Stats
+    {
+        std::uint64_t _lookups{0};
+        std::uint64_t _misses{0};    // tiles decoded
+        std::uint64_t _evictions{0}; // tiles decoded into an occupied slot
+
+        [[nodiscard]] double hit_rate() const
+        {
+            return _lookups == 0 ? 1.0
+                                 : 1.0 - static_cast<double>(_misses) /
+                                             static_cast<double>(_lookups);
+        }
+    };
+
+    // Linear red, green and blue floats per texel, row by row.
+    static constexpr std::size_t kTileFloats{
+        std::size_t{3} * kTextureTileSize * kTextureTileSize};
+
+    // A cache of as many tiles as fit in `budget_bytes`, and at least
+    // kMinSlots.
+    explicit TileCache(std::size_t budget_bytes)
+        : _slots(std::max(budget_bytes / (kTileFloats * sizeof(float)),
+                          kMinSlots)),
+          _texels(_slots.size() * kTileFloats)
+    {
+    }
+
+    TileCache(const TileCache &) = delete;
+    TileCache &operator=(const TileCache &) = delete;
+    TileCache(TileCache &&) = delete;
+    TileCache &operator=(TileCache &&) = delete;
+    ~TileCache() = default;
+
+    // Registers a texture, which must outlive the cache, and returns the
+    // number lookups name it by.
+    std::uint32_t add(const TextureFile &file)
+    {
+        _textures.push_back(std::make_unique<TextureSlots>(file));
+        return static_cast<std::uint32_t>(_textures.size() - 1);
+    }
+
+    [[nodiscard]] std::size_t slot_count() const
+    {
+        return _slots.size();
+    }
+
+    [[nodiscard]] std::size_t memory_bytes() const
+    {
+        return _texels.size() * sizeof(float);
+    }
+
+    // Calls read(texels) with the decoded texels of one tile of a texture,
+    // loading the tile first if it is not resident.  The texels are only
+    // valid during the call.
+    template <typename Read>
+    void read_tile(std::uint32_t texture, std::uint32_t tile, Read &&read)
+    {
+        count_lookup();
+        std::atomic<std::int32_t> &entry{_textures[texture]->_slots[tile]};
+        const std::uint64_t key{tile_key(texture, tile)};
+        for (;;)
+        {
+            const std::int32_t slot{entry.load(std::memory_order_acquire)};
+            if (slot >= 0)
+            {
+                Slot &cached{_slots[static_cast<std::size_t>(slot)]};
+                // sequentially consistent against eviction: either the
+                // evictor sees the pin or this sees the new key
+                cached._pins.fetch_add(1);
+                if (cached._key.load() == key)
+                {
+                    cached._referenced.store(true, std::memory_order_relaxed);
+                    read(texels(static_cast<std::size_t>(slot)));
+                    cached._pins.fetch_sub(1, std::memory_order_release);
+                    return;
+                }
+                cached._pins.fetch_sub(1, std::memory_order_release);
+            }
+            load(texture, tile);
+        }
+    }
+
+    [[nodiscard]] Stats stats() const
+    {
+        Stats stats;
+        for (const Counter &counter : _lookups)
+        {
+            stats._lookups += counter._value.load(std::memory_order_relaxed);
+        }
+        const std::lock_guard<std::mutex> lock{_mutex};
+        stats._misses = _misses;
+        stats._evictions = _evictions;
+        return stats;
+    }
+
+private:
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    static constexpr std::size_t kMinSlots{64};
+    static constexpr std::size_t kCounterShards{64};
+    static constexpr std::uint64_t kEmpty{
+        std::numeric_limits<std::uint64_t>::max()};
+
+    struct TextureSlots
+    {
+        const TextureFile *_file;
+        std::vector<std::atomic<std::int32_t>> _slots; // -1 if not resident
+
+        explicit TextureSlots(const TextureFile &file)
+            : _file(&file), _slots(file.tile_count())
+        {
+            for (std::atomic<std::int32_t> &slot : _slots)
+            {
+                slot.store(-1, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    // Own cache lines, so readers of different slots do not contend.
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    struct alignas(64) Slot
+    {
+        std::atomic<std::uint64_t> _key{kEmpty};
+        std::atomic<std::uint32_t> _pins{0};
+        std::atomic<bool> _referenced{false};
+    };
+
+    // Lookups are counted in per-thread shards rather than one shared
+    // counter, which every thread would write on every lookup.
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    struct alignas(64) Counter
+    {
+        std::atomic<std::uint64_t> _value{0};
+    };
+
+    std::vector<std::unique_ptr<TextureSlots>> _textures{};
+    std::vector<Slot> _slots;
+    std::vector<float> _texels;
+    std::array<Counter, kCounterShards> _lookups{};
+
+    mutable std::mutex _mutex; // guards the members below and every load
+    std::size_t _hand{0};
+    std::uint64_t _misses{0};
+    std::uint64_t _evictions{0};
+
+    static std::uint64_t tile_key(std::uint32_t texture, std::uint32_t tile)
+    {
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        return (std::uint64_t{texture} << 32U) | tile;
+    }
+
+    [[nodiscard]] std::span<float> texels(std::size_t slot)
+    {
+        return {_texels.data() + slot * kTileFloats, kTileFloats};
+    }
+
+    void count_lookup()
+    {
+        thread_local const std::size_t shard{
+            std::hash<std::thread::id>{}(std::this_thread::get_id()) %
+            kCounterShards};
+        _lookups[shard]._value.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Makes the tile resident unless another thread already has.
+    void load(std::uint32_t texture, std::uint32_t tile)
+    {
+        const std::lock_guard<std::mutex> lock{_mutex};
+        std::atomic<std::int32_t> &entry{_textures[texture]->_slots[tile]};
+        if (entry.load(std::memory_order_relaxed) >= 0)
+        {
+            return;
+        }
+        ++_misses;
+
+        const std::size_t slot{victim()};
+        Slot &cached{_slots[slot]};
+        const std::uint64_t old_key{
+            cached._key.load(std::memory_order_relaxed)};
+        if (old_key != kEmpty)
+        {
+            ++_evictions;
+            cached._key.store(kEmpty);
+            // NOLINTNEXTLINE(readability-magic-numbers)
+            _textures[old_key >> 32U]
+                ->_slots[old_key & 0xffffffffU]
+                .store(-1, std::memory_order_relaxed);
+            while (cached._pins.load() != 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        _textures[texture]->_file->decode_tile(tile, texels(slot));
+        cached._referenced.store(true, std::memory_order_relaxed);
+        cached._key.store(tile_key(texture, tile), std::memory_order_release);
+        entry.store(static_cast<std::int32_t>(slot), std::memory_order_release);
+    }
+
+    // Advances the clock hand to the next slot free to reuse.
+    std::size_t victim()
+    {
+        for (;;)
+        {
+            const std::size_t slot{_hand};
+            _hand = (_hand + 1) % _slots.size();
+            Slot &cached{_slots[slot]};
+            if (cached._key.load(std::memory_order_relaxed) == kEmpty)
+            {
+                return slot;
+            }
+            if (cached._referenced.exchange(false, std::memory_order_relaxed) ||
+                cached._pins.load(std::memory_order_relaxed) != 0)
+            {
+                continue;
+            }
+            return slot;
+        }
+    }
+};
+
+#endif
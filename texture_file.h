@@ -0,0 +1,343 @@
+#ifndef TEXTURE_FILE_H
+#define TEXTURE_FILE_H
+
+#include "colour.h"
+#include "mapped_file.h"
+#include "utility.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <type_traits>
+
+// Tiled, mip-mapped texture files.  A file holds an image and its chain of
+// mip levels, each half the size of the one before (rounding down, to 1 x
+// 1), cut into square tiles of kTextureTileSize texels a side.  Every tile
+// takes a full tile's bytes, padded past the level's right and bottom
+// edges, and starts on a page boundary, so a renderer maps the file and
+// reads a tile as one run of whole pages, which it can drop again once the
+// tile is decoded.  After a fixed header come the tiles of every level, the
+// finest first, each level's row by row from the top left.  Texels are red,
+// green and blue as 8-bit sRGB, then an unused byte.
+inline constexpr std::uint32_t kTextureTileSize{64};
+
+namespace texture_file_detail
+{
+constexpr std::array<char, 8> kMagic{'R', 'T', 'T', 'E', 'X', 'T', 'R', '1'};
+constexpr std::size_t kTexelBytes{4};
+constexpr std::size_t kTileBytes{
+    std::size_t{kTextureTileSize} * kTextureTileSize * kTexelBytes};
+constexpr std::size_t kPageBytes{4096}; // tiles start on these boundaries
+constexpr std::size_t kMaxLevels{33};   // of a 2^32 texel wide texture
+
+struct Header
+{
+    std::array<char, 8> _magic;
+    std::uint32_t _width;
+    std::uint32_t _height;
+    std::uint32_t _tile_size;
+    std::uint32_t _level_count;
+};
+
+static_assert(std::is_trivially_copyable_v<Header> &&
+              sizeof(Header) <= kPageBytes && kTileBytes % kPageBytes == 0);
+
+// The sRGB transfer function and its inverse, on [0, 1].
+inline std::uint8_t encode_srgb(double linear)
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    const double clamped{std::clamp(linear, 0.0, 1.0)};
+    const double encoded{clamped <= 0.0031308
+                             ? 12.92 * clamped
+                             : 1.055 * std::pow(clamped, 1.0 / 2.4) - 0.055};
+    return static_cast<std::uint8_t>(std::lround(255.0 * encoded));
+    // NOLINTEND(readability-magic-numbers)
+}
+
+inline float decode_srgb(std::uint8_t encoded)
+{
+    static const std::array<float, 256> kTable{[] {
+        std::array<float, 256> table{};
+        for (std::size_t value{0}; value < table.size(); ++value)
+        {
+            // NOLINTBEGIN(readability-magic-numbers)
+            const double code{static_cast<double>(value) / 255.0};
+            table[value] = static_cast<float>(
+                code <= 0.04045 ? code / 12.92
+                                : std::pow((code + 0.055) / 1.055, 2.4));
+            // NOLINTEND(readability-magic-numbers)
+        }
+        return table;
+    }()};
+    return kTable[encoded];
+}
+
+inline std::uint32_t count_levels(std::uint32_t width, std::uint32_t height)
+{
+    std::uint32_t count{1};
+    for (std::uint32_t size{std::max(width, height)}; size > 1; size /= 2)
+    {
+        ++count;
+    }
+    return count;
+}
+} // namespace texture_file_detail
+
+// Read access to a mapped texture file.  The mapping stays read-only, so
+// any number of threads may decode tiles at once.
+class TextureFile
+{
+public:
+    explicit TextureFile(const std::string &path) : _file(path)
+    {
+    }
+
+    // Checks the header and the file's length; false, with `error` set, if
+    // the file is missing or is not a valid texture file.
+    bool validate(std::string &error)
+    {
+        using namespace texture_file_detail;
+
+        const std::span<const std::byte> bytes{_file.bytes()};
+        if (!_file.is_open() || bytes.size() < kPageBytes)
+        {
+            error = "cannot map the texture or it is too short";
+            return false;
+        }
+        Header header{};
+        std::memcpy(&header, bytes.data(), sizeof(Header));
+        if (header._magic != kMagic || header._width == 0 ||
+            header._height == 0 || header._tile_size != kTextureTileSize ||
+            header._level_count != count_levels(header._width, header._height))
+        {
+            error = "not a texture file";
+            return false;
+        }
+        _width = header._width;
+        _height = header._height;
+        _level_count = header._level_count;
+        _tile_count = 0;
+        for (std::uint32_t level{0}; level < _level_count; ++level)
+        {
+            _first_tile[level] = _tile_count;
+            _tile_count += tiles_across(level) * tiles_down(level);
+        }
+        if ((bytes.size() - kPageBytes) / kTileBytes < _tile_count)
+        {
+            error = "texture file is truncated";
+            return false;
+        }
+        return true;
+    }
+
+    [[nodiscard]] std::uint32_t level_count() const
+    {
+        return _level_count;
+    }
+
+    [[nodiscard]] std::uint32_t width(std::uint32_t level = 0) const
+    {
+        return std::max(_width >> level, 1U);
+    }
+
+    [[nodiscard]] std::uint32_t height(std::uint32_t level = 0) const
+    {
+        return std::max(_height >> level, 1U);
+    }
+
+    [[nodiscard]] std::uint32_t tiles_across(std::uint32_t level) const
+    {
+        return (width(level) + kTextureTileSize - 1) / kTextureTileSize;
+    }
+
+    [[nodiscard]] std::uint32_t tiles_down(std::uint32_t level) const
+    {
+        return (height(level) + kTextureTileSize - 1) / kTextureTileSize;
+    }
+
+    // Tiles are numbered across all levels, in file order.
+    [[nodiscard]] std::uint32_t tile_count() const
+    {
+        return _tile_count;
+    }
+
+    [[nodiscard]] std::uint32_t tile(std::uint32_t level,
+                                     std::uint32_t x,
+                                     std::uint32_t y) const
+    {
+        return _first_tile[level] +
+               (y / kTextureTileSize) * tiles_across(level) +
+               x / kTextureTileSize;
+    }
+
+    [[nodiscard]] std::size_t file_bytes() const
+    {
+        return _file.bytes().size();
+    }
+
+    // Decodes a tile into linear red, green and blue floats, row by row,
+    // then drops its pages from memory: the caller keeps the decoded copy.
+    void decode_tile(std::uint32_t tile, std::span<float> texels) const
+    {
+        using namespace texture_file_detail;
+
+        const std::size_t offset{kPageBytes + tile * kTileBytes};
+        const std::byte *source{_file.bytes().data() + offset};
+        for (std::size_t texel{0}; texel < kTileBytes / kTexelBytes; ++texel)
+        {
+            for (std::size_t channel{0}; channel < 3; ++channel)
+            {
+                texels[3 * texel + channel] = decode_srgb(
+                    std::to_integer<std::uint8_t>(
+                        source[kTexelBytes * texel + channel]));
+            }
+        }
+        _file.release(offset, kTileBytes);
+    }
+
+private:
+    MappedFile _file;
+    std::uint32_t _width{0};
+    std::uint32_t _height{0};
+    std::uint32_t _level_count{0};
+    std::uint32_t _tile_count{0};
+    std::array<std::uint32_t, texture_file_detail::kMaxLevels> _first_tile{};
+};
+
+inline std::unique_ptr<TextureFile> load_texture(const std::string &path,
+                                                 std::string &error)
+{
+    auto texture{std::make_unique<TextureFile>(path)};
+    if (!texture->validate(error))
+    {
+        return nullptr;
+    }
+    return texture;
+}
+
+// Writes a `width` x `height` texture with all its mip levels to `path`;
+// texel(x, y) gives the linear colour at column x, row y from the top left.
+// The file is written through a mapping a tile at a time, and each level is
+// box filtered from the one before as stored, so textures larger than
+// memory can be made.  Returns false, with `error` set, on failure.
+template <typename Texel>
+bool write_texture(const std::string &path,
+                   std::uint32_t width,
+                   std::uint32_t height,
+                   Texel &&texel,
+                   std::string &error)
+{
+    using namespace texture_file_detail;
+
+    if (width == 0 || height == 0)
+    {
+        error = "empty texture";
+        return false;
+    }
+    const std::uint32_t levels{count_levels(width, height)};
+    const auto level_width{[&](std::uint32_t level) {
+        return std::max(width >> level, 1U);
+    }};
+    const auto level_height{[&](std::uint32_t level) {
+        return std::max(height >> level, 1U);
+    }};
+    const auto tiles{[](std::uint32_t size) {
+        return (size + kTextureTileSize - 1) / kTextureTileSize;
+    }};
+    std::array<std::size_t, kMaxLevels> first_tile{};
+    std::size_t tile_count{0};
+    for (std::uint32_t level{0}; level < levels; ++level)
+    {
+        first_tile[level] = tile_count;
+        tile_count += std::size_t{tiles(level_width(level))} *
+                      tiles(level_height(level));
+    }
+
+    const MappedOutputFile file{path, kPageBytes + tile_count * kTileBytes};
+    if (!file.is_open())
+    {
+        error = "cannot create " + path;
+        return false;
+    }
+    std::byte *const bytes{file.bytes().data()};
+    const Header header{kMagic, width, height, kTextureTileSize, levels};
+    std::memcpy(bytes, &header, sizeof(Header));
+
+    const auto address{[&](std::uint32_t level,
+                           std::uint32_t x,
+                           std::uint32_t y) {
+        const std::size_t tile{
+            first_tile[level] +
+            std::size_t{y / kTextureTileSize} * tiles(level_width(level)) +
+            x / kTextureTileSize};
+        const std::size_t within{
+            std::size_t{y % kTextureTileSize} * kTextureTileSize +
+            x % kTextureTileSize};
+        return bytes + kPageBytes + tile * kTileBytes + within * kTexelBytes;
+    }};
+    const auto store{[](std::byte *target, double red, double green,
+                        double blue) {
+        target[0] = std::byte{encode_srgb(red)};
+        target[1] = std::byte{encode_srgb(green)};
+        target[2] = std::byte{encode_srgb(blue)};
+    }};
+
+    // tile by tile, so the pages written are touched once
+    for (std::uint32_t tile_y{0}; tile_y < height; tile_y += kTextureTileSize)
+    {
+        for (std::uint32_t tile_x{0}; tile_x < width;
+             tile_x += kTextureTileSize)
+        {
+            for (std::uint32_t y{tile_y};
+                 y < std::min(tile_y + kTextureTileSize, height);
+                 ++y)
+            {
+                for (std::uint32_t x{tile_x};
+                     x < std::min(tile_x + kTextureTileSize, width);
+                     ++x)
+                {
+                    const Colour colour{texel(x, y)};
+                    store(address(0, x, y), colour.x(), colour.y(),
+                          colour.z());
+                }
+            }
+        }
+    }
+
+    for (std::uint32_t level{1}; level < levels; ++level)
+    {
+        const std::uint32_t source_width{level_width(level - 1)};
+        const std::uint32_t source_height{level_height(level - 1)};
+        for (std::uint32_t y{0}; y < level_height(level); ++y)
+        {
+            for (std::uint32_t x{0}; x < level_width(level); ++x)
+            {
+                std::array<double, 3> sum{};
+                for (std::uint32_t corner{0}; corner < 4; ++corner)
+                {
+                    const std::byte *source{address(
+                        level - 1,
+                        std::min(2 * x + corner % 2, source_width - 1),
+                        std::min(2 * y + corner / 2, source_height - 1))};
+                    for (std::size_t channel{0}; channel < 3; ++channel)
+                    {
+                        sum[channel] += decode_srgb(
+                            std::to_integer<std::uint8_t>(source[channel]));
+                    }
+                }
+                // NOLINTNEXTLINE(readability-magic-numbers)
+                store(address(level, x, y), sum[0] / 4, sum[1] / 4,
+                      sum[2] / 4);
+            }
+        }
+    }
+    return true;
+}
+
+#endif
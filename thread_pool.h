@@ -0,0 +1,176 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads.  Each worker owns a task queue seeded
+// with a contiguous block of task indices; when its own queue runs dry, a
+// worker steals from the back of another worker's queue, so uneven tiles
+// (glass, caustics) do not leave cores idle at the end of a frame.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned int thread_count)
+        : _queues(std::max(thread_count, 1U))
+    {
+        _workers.reserve(_queues.size());
+        for (std::size_t index{0}; index < _queues.size(); ++index)
+        {
+            _workers.emplace_back([this, index] { worker_loop(index); });
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ThreadPool(ThreadPool &&) = delete;
+    ThreadPool &operator=(ThreadPool &&) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            const std::lock_guard<std::mutex> lock{_mutex};
+            _stopping = true;
+        }
+        _wake.notify_all();
+        for (auto &worker : _workers)
+        {
+            worker.join();
+        }
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return _workers.size();
+    }
+
+    // Runs task(index) for every index in [0, task_count) and blocks until
+    // all have completed.  Tasks must be independent of one another.
+    void parallel_for(std::size_t task_count,
+                      const std::function<void(std::size_t)> &task)
+    {
+        if (task_count == 0)
+        {
+            return;
+        }
+
+        const std::size_t worker_count{_queues.size()};
+        const std::size_t block{(task_count + worker_count - 1) /
+                                worker_count};
+        for (std::size_t worker{0}; worker < worker_count; ++worker)
+        {
+            const std::lock_guard<std::mutex> lock{_queues[worker]._mutex};
+            const std::size_t first{std::min(worker * block, task_count)};
+            const std::size_t last{std::min(first + block, task_count)};
+            for (std::size_t index{first}; index < last; ++index)
+            {
+                _queues[worker]._tasks.push_back(index);
+            }
+        }
+
+        std::unique_lock<std::mutex> lock{_mutex};
+        _task = &task;
+        _busy_workers = worker_count;
+        ++_generation;
+        _wake.notify_all();
+        _done.wait(lock, [this] { return _busy_workers == 0; });
+        _task = nullptr;
+    }
+
+private:
+    struct alignas(64) WorkQueue
+    {
+        std::mutex _mutex;
+        std::deque<std::size_t> _tasks;
+    };
+
+    std::vector<WorkQueue> _queues;
+    std::vector<std::thread> _workers;
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    const std::function<void(std::size_t)> *_task{nullptr};
+    std::size_t _busy_workers{0};
+    std::size_t _generation{0};
+    bool _stopping{false};
+
+    std::optional<std::size_t> pop_local(std::size_t worker)
+    {
+        WorkQueue &queue{_queues[worker]};
+        const std::lock_guard<std::mutex> lock{queue._mutex};
+        if (queue._tasks.empty())
+        {
+            return std::nullopt;
+        }
+        const std::size_t index{queue._tasks.front()};
+        queue._tasks.pop_front();
+        return index;
+    }
+
+    std::optional<std::size_t> steal(std::size_t thief)
+    {
+        for (std::size_t offset{1}; offset < _queues.size(); ++offset)
+        {
+            WorkQueue &victim{_queues[(thief + offset) % _queues.size()]};
+            const std::lock_guard<std::mutex> lock{victim._mutex};
+            if (!victim._tasks.empty())
+            {
+                const std::size_t index{victim._tasks.back()};
+                victim._tasks.pop_back();
+                return index;
+            }
+        }
+        return std::nullopt;
+    }
+
+    void worker_loop(std::size_t worker)
+    {
+        std::size_t seen_generation{0};
+        while (true)
+        {
+            const std::function<void(std::size_t)> *task{nullptr};
+            {
+                std::unique_lock<std::mutex> lock{_mutex};
+                _wake.wait(lock, [this, seen_generation] {
+                    return _stopping || _generation != seen_generation;
+                });
+                if (_stopping)
+                {
+                    return;
+                }
+                seen_generation = _generation;
+                task = _task;
+            }
+
+            while (true)
+            {
+                std::optional<std::size_t> index{pop_local(worker)};
+                if (!index)
+                {
+                    index = steal(worker);
+                }
+                if (!index)
+                {
+                    break;
+                }
+                (*task)(*index);
+            }
+
+            {
+                const std::lock_guard<std::mutex> lock{_mutex};
+                --_busy_workers;
+            }
+            _done.notify_one();
+        }
+    }
+};
+
+#endif
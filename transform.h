@@ -0,0 +1,197 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "aabb.h"
+#include "utility.h"
+#include "vec3.h"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+
+// Affine map p -> linear * p + offset, kept together with its inverse so
+// either direction costs one matrix product.  The linear part must be
+// invertible.
+class Transform
+{
+public:
+    Transform() = default; // identity
+
+    Transform(const std::array<Vec3, 3> &rows, const Vec3 &offset)
+        : _rows(rows), _offset(offset)
+    {
+        // the inverse's columns are the rows' pairwise cross products over
+        // the determinant
+        const Vec3 column0{cross(rows[1], rows[2])};
+        const Vec3 column1{cross(rows[2], rows[0])};
+        const Vec3 column2{cross(rows[0], rows[1])};
+        const Real inverse_determinant{1 / dot(rows[0], column0)};
+        for (int row{0}; row < 3; ++row)
+        {
+            _inverse_rows[static_cast<std::size_t>(row)] =
+                inverse_determinant *
+                Vec3{column0[row], column1[row], column2[row]};
+        }
+        _inverse_offset = -multiply(_inverse_rows, offset);
+    }
+
+    static Transform translation(const Vec3 &offset)
+    {
+        return {{Vec3{1, 0, 0}, Vec3{0, 1, 0}, Vec3{0, 0, 1}}, offset};
+    }
+
+    static Transform scaling(const Vec3 &factors)
+    {
+        return {{Vec3{factors.x(), 0, 0},
+                 Vec3{0, factors.y(), 0},
+                 Vec3{0, 0, factors.z()}},
+                Vec3{0, 0, 0}};
+    }
+
+    // Rotation by `degrees` counter-clockwise about the unit `axis`, seen
+    // with the axis pointing at the viewer (Rodrigues' formula).
+    static Transform rotation(const Vec3 &axis, double degrees)
+    {
+        const double radians{degrees_to_radians(degrees)};
+        const auto sine{static_cast<Real>(std::sin(radians))};
+        const auto cosine{static_cast<Real>(std::cos(radians))};
+        const Real versine{1 - cosine};
+        const Real x{axis.x()};
+        const Real y{axis.y()};
+        const Real z{axis.z()};
+        return {{Vec3{cosine + x * x * versine,
+                      x * y * versine - z * sine,
+                      x * z * versine + y * sine},
+                 Vec3{y * x * versine + z * sine,
+                      cosine + y * y * versine,
+                      y * z * versine - x * sine},
+                 Vec3{z * x * versine - y * sine,
+                      z * y * versine + x * sine,
+                      cosine + z * z * versine}},
+                Vec3{0, 0, 0}};
+    }
+
+    // The transform `fraction` of the way from `start` to `end`, blending
+    // the matrices entry by entry.  Every point then moves in a straight
+    // line, so the boxes of the two ends bound the whole motion.  Turns are
+    // only approximated, closely for the small ones made while a shutter is
+    // open, and the blend must stay invertible.
+    static Transform interpolate(const Transform &start,
+                                 const Transform &end,
+                                 Real fraction)
+    {
+        std::array<Vec3, 3> rows{};
+        for (std::size_t row{0}; row < 3; ++row)
+        {
+            rows[row] = start._rows[row] +
+                        fraction * (end._rows[row] - start._rows[row]);
+        }
+        return {rows,
+                start._offset + fraction * (end._offset - start._offset)};
+    }
+
+    [[nodiscard]] Transform inverse() const
+    {
+        Transform inverted{*this};
+        std::swap(inverted._rows, inverted._inverse_rows);
+        std::swap(inverted._offset, inverted._inverse_offset);
+        return inverted;
+    }
+
+    // The factor by which the transform scales volumes, signed.
+    [[nodiscard]] Real determinant() const
+    {
+        return dot(_rows[0], cross(_rows[1], _rows[2]));
+    }
+
+    [[nodiscard]] Point3 point(const Point3 &point) const
+    {
+        return multiply(_rows, point) + _offset;
+    }
+
+    [[nodiscard]] Vec3 vector(const Vec3 &vector) const
+    {
+        return multiply(_rows, vector);
+    }
+
+    // The image of a surface normal: the inverse transpose keeps it
+    // perpendicular to the transformed surface.  The result is not unit.
+    [[nodiscard]] Vec3 normal(const Vec3 &normal) const
+    {
+        return normal.x() * _inverse_rows[0] + normal.y() * _inverse_rows[1] +
+               normal.z() * _inverse_rows[2];
+    }
+
+    [[nodiscard]] Point3 inverse_point(const Point3 &point) const
+    {
+        return multiply(_inverse_rows, point) + _inverse_offset;
+    }
+
+    [[nodiscard]] Vec3 inverse_vector(const Vec3 &vector) const
+    {
+        return multiply(_inverse_rows, vector);
+    }
+
+    // Smallest box holding the image of `box`: per axis, each matrix entry
+    // takes the nearer or further end of the source interval (Arvo,
+    // "Transforming Axis-Aligned Bounding Boxes", 1990).
+    [[nodiscard]] Aabb bounds(const Aabb &box) const
+    {
+        std::array<Interval, 3> axes{};
+        for (int row{0}; row < 3; ++row)
+        {
+            Interval image{_offset[row], _offset[row]};
+            for (int column{0}; column < 3; ++column)
+            {
+                const Real entry{_rows[static_cast<std::size_t>(row)][column]};
+                const Real low{entry * box.axis(column)._min};
+                const Real high{entry * box.axis(column)._max};
+                image._min += std::fmin(low, high);
+                image._max += std::fmax(low, high);
+            }
+            axes[static_cast<std::size_t>(row)] = image;
+        }
+        return {axes[0], axes[1], axes[2]};
+    }
+
+    // `outer` after `inner`.
+    friend Transform operator*(const Transform &outer, const Transform &inner)
+    {
+        Transform product;
+        product._rows = matrix_product(outer._rows, inner._rows);
+        product._offset = outer.point(inner._offset);
+        product._inverse_rows =
+            matrix_product(inner._inverse_rows, outer._inverse_rows);
+        product._inverse_offset = inner.inverse_point(outer._inverse_offset);
+        return product;
+    }
+
+private:
+    std::array<Vec3, 3> _rows{Vec3{1, 0, 0}, Vec3{0, 1, 0}, Vec3{0, 0, 1}};
+    Vec3 _offset{0, 0, 0};
+    std::array<Vec3, 3> _inverse_rows{
+        Vec3{1, 0, 0}, Vec3{0, 1, 0}, Vec3{0, 0, 1}};
+    Vec3 _inverse_offset{0, 0, 0};
+
+    static Vec3 multiply(const std::array<Vec3, 3> &rows, const Vec3 &vector)
+    {
+        return {
+            dot(rows[0], vector), dot(rows[1], vector), dot(rows[2], vector)};
+    }
+
+    // The matrix product left * right, all given by rows.
+    static std::array<Vec3, 3> matrix_product(
+        const std::array<Vec3, 3> &left, const std::array<Vec3, 3> &right)
+    {
+        std::array<Vec3, 3> product{};
+        for (std::size_t row{0}; row < 3; ++row)
+        {
+            product[row] = left[row].x() * right[0] +
+                           left[row].y() * right[1] + left[row].z() * right[2];
+        }
+        return product;
+    }
+};
+
+#endif
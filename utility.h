@@ -1,14 +1,38 @@
 #ifndef UTILTIY_H
 #define UTILTIY_H
 
+#include "rng.h"
+
 #include <cmath>
 #include <limits>
 #include <memory>
-#include <random>
+
+// Scalar type of geometry and colour.  Builds that define RT_USE_FLOAT use
+// single precision, which doubles the lanes in each SIMD register and halves
+// the memory traffic of vectors and rays; all other builds use double.
+#if defined(RT_USE_FLOAT)
+using Real = float;
+inline constexpr const char *kRealName{"float"};
+#else
+using Real = double;
+inline constexpr const char *kRealName{"double"};
+#endif
+
+// Literal of type Real, so constants such as 0.001_r do not drag float
+// arithmetic up to double.
+constexpr Real operator""_r(long double value)
+{
+    return static_cast<Real>(value);
+}
+
+constexpr Real operator""_r(unsigned long long value)
+{
+    return static_cast<Real>(value);
+}
 
 namespace constants
 {
-inline constexpr double kInfinity{std::numeric_limits<double>::infinity()};
+inline constexpr Real kInfinity{std::numeric_limits<Real>::infinity()};
 inline constexpr double kPi{3.1415926535897932385};
 } // namespace constants
 
@@ -18,17 +42,18 @@ inline double degrees_to_radians(double degrees)
     return degrees * constants::kPi / 180.0;
 }
 
-inline double random_double()
+inline double random_double(Rng &rng)
 {
     // returns a random, real in [0,1)
-    static std::uniform_real_distribution<double> distribution(0.0, 1.0);
-    static std::mt19937 generator;
-    return distribution(generator);
+    constexpr double kInverseRange{1.0 / 4294967296.0};
+    return rng.next() * kInverseRange;
 }
 
-inline double random_double(double min_included, double max_excluded)
+inline double random_double(Rng &rng,
+                            double min_included,
+                            double max_excluded)
 {
-    return min_included + (max_excluded - min_included) * random_double();
+    return min_included + (max_excluded - min_included) * random_double(rng);
 }
 
 #endif
@@ -4,191 +4,514 @@
 #include "utility.h"
 
 #include <array>
+#include <bit>
 #include <cmath>
+#include <cstddef>
 #include <iostream>
+#include <type_traits>
 
-class Vec3
+#if defined(RT_SIMD_VEC3)
+#include <immintrin.h>
+#endif
+
+namespace vec3_detail
+{
+// Builds defining RT_SIMD_VEC3 pad vectors to four lanes aligned to their
+// size, 32 bytes for double and 16 for float, so a vector loads into one
+// register.  The fourth lane carries no meaning and is never read back.
+#if defined(RT_SIMD_VEC3)
+inline constexpr std::size_t kStoredLanes{4};
+#else
+inline constexpr std::size_t kStoredLanes{3};
+#endif
+
+template <typename T>
+inline constexpr std::size_t kAlignment{
+    kStoredLanes == 4 ? kStoredLanes * sizeof(T) : alignof(T)};
+
+// Register operations on a padded vector of T, when the build has them.  The
+// arithmetic is done lane by lane in the same order as the scalar code, so
+// results are bit-identical with and without RT_SIMD_VEC3.
+template <typename T>
+struct Register
+{
+    static constexpr bool kAvailable{false};
+};
+
+#if defined(RT_SIMD_VEC3) && defined(__AVX2__)
+template <>
+struct Register<double>
+{
+    using Type = __m256d;
+    static constexpr bool kAvailable{true};
+
+    static Type load(const double *lanes)
+    {
+        return _mm256_load_pd(lanes);
+    }
+
+    static void store(double *lanes, Type value)
+    {
+        _mm256_store_pd(lanes, value);
+    }
+
+    static Type set(double x_value, double y_value, double z_value)
+    {
+        return _mm256_setr_pd(x_value, y_value, z_value, 0.0);
+    }
+
+    static Type splat(double value)
+    {
+        return _mm256_set1_pd(value);
+    }
+
+    static Type add(Type a_value, Type b_value)
+    {
+        return _mm256_add_pd(a_value, b_value);
+    }
+
+    static Type sub(Type a_value, Type b_value)
+    {
+        return _mm256_sub_pd(a_value, b_value);
+    }
+
+    static Type mul(Type a_value, Type b_value)
+    {
+        return _mm256_mul_pd(a_value, b_value);
+    }
+
+    static Type negate(Type value)
+    {
+        return _mm256_xor_pd(value, _mm256_set1_pd(-0.0));
+    }
+
+    // (y, z, x) and (z, x, y)
+    static Type rotate_left(Type value)
+    {
+        return _mm256_permute4x64_pd(value, _MM_SHUFFLE(3, 0, 2, 1));
+    }
+
+    static Type rotate_right(Type value)
+    {
+        return _mm256_permute4x64_pd(value, _MM_SHUFFLE(3, 1, 0, 2));
+    }
+
+    // (x + y) + z
+    static double sum(Type value)
+    {
+        const __m128d low{_mm256_castpd256_pd128(value)};
+        const __m128d high{_mm256_extractf128_pd(value, 1)};
+        return _mm_cvtsd_f64(
+            _mm_add_sd(_mm_add_sd(low, _mm_unpackhi_pd(low, low)), high));
+    }
+};
+#endif
+
+#if defined(RT_SIMD_VEC3) && defined(__SSE2__)
+template <>
+struct Register<float>
+{
+    using Type = __m128;
+    static constexpr bool kAvailable{true};
+
+    static Type load(const float *lanes)
+    {
+        return _mm_load_ps(lanes);
+    }
+
+    static void store(float *lanes, Type value)
+    {
+        _mm_store_ps(lanes, value);
+    }
+
+    static Type set(float x_value, float y_value, float z_value)
+    {
+        return _mm_setr_ps(x_value, y_value, z_value, 0.0F);
+    }
+
+    static Type splat(float value)
+    {
+        return _mm_set1_ps(value);
+    }
+
+    static Type add(Type a_value, Type b_value)
+    {
+        return _mm_add_ps(a_value, b_value);
+    }
+
+    static Type sub(Type a_value, Type b_value)
+    {
+        return _mm_sub_ps(a_value, b_value);
+    }
+
+    static Type mul(Type a_value, Type b_value)
+    {
+        return _mm_mul_ps(a_value, b_value);
+    }
+
+    static Type negate(Type value)
+    {
+        return _mm_xor_ps(value, _mm_set1_ps(-0.0F));
+    }
+
+    static Type rotate_left(Type value)
+    {
+        return _mm_shuffle_ps(value, value, _MM_SHUFFLE(3, 0, 2, 1));
+    }
+
+    static Type rotate_right(Type value)
+    {
+        return _mm_shuffle_ps(value, value, _MM_SHUFFLE(3, 1, 0, 2));
+    }
+
+    static float sum(Type value)
+    {
+        const __m128 y_value{
+            _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 1, 1, 1))};
+        const __m128 z_value{
+            _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 2, 2, 2))};
+        return _mm_cvtss_f32(
+            _mm_add_ss(_mm_add_ss(value, y_value), z_value));
+    }
+};
+#endif
+} // namespace vec3_detail
+
+// Three-component vector over the scalar type T.  The renderer uses Vec3,
+// which is BasicVec3<Real>; scalar arguments never take part in template
+// deduction, so expressions like 0.5_r * vector work for either precision.
+template <typename T>
+class alignas(vec3_detail::kAlignment<T>) BasicVec3
 {
+    using Register = vec3_detail::Register<T>;
+
 public:
-    std::array<double, 3> e;
+    using Scalar = T;
+
+    std::array<T, vec3_detail::kStoredLanes> e;
 
-    Vec3() : e{0, 0, 0}
+    BasicVec3() : e{0, 0, 0}
     {
     }
 
-    Vec3(double e0_value, double e1_value, double e2_value)
-        : e{e0_value, e1_value, e2_value}
+    BasicVec3(T e0_value, T e1_value, T e2_value)
+        : e{lanes(e0_value, e1_value, e2_value)}
     {
     }
 
-    [[nodiscard]] double x() const
+    [[nodiscard]] T x() const
     {
         return e[0];
     }
 
-    [[nodiscard]] double y() const
+    [[nodiscard]] T y() const
     {
         return e[1];
     }
 
-    [[nodiscard]] double z() const
+    [[nodiscard]] T z() const
     {
         return e[2];
     }
 
-    Vec3 operator-() const
+    BasicVec3 operator-() const
     {
-        return {-e[0], -e[1], -e[2]};
+        if constexpr (Register::kAvailable)
+        {
+            return from_register(Register::negate(to_register()));
+        }
+        else
+        {
+            return {-e[0], -e[1], -e[2]};
+        }
     }
 
-    double operator[](int i_value) const
+    T operator[](int i_value) const
     {
         return e[static_cast<size_t>(i_value)];
     }
 
-    double &operator[](int i_value)
+    T &operator[](int i_value)
     {
         return e[static_cast<size_t>(i_value)];
     }
 
-    Vec3 &operator+=(const Vec3 &v_value)
+    BasicVec3 &operator+=(const BasicVec3 &v_value)
     {
-        e[0] += v_value.e[0];
-        e[1] += v_value.e[1];
-        e[2] += v_value.e[2];
+        if constexpr (Register::kAvailable)
+        {
+            Register::store(
+                e.data(),
+                Register::add(to_register(), v_value.to_register()));
+        }
+        else
+        {
+            e[0] += v_value.e[0];
+            e[1] += v_value.e[1];
+            e[2] += v_value.e[2];
+        }
 
         return *this;
     }
 
-    Vec3 &operator*=(double t_value)
+    BasicVec3 &operator*=(T t_value)
     {
-        e[0] *= t_value;
-        e[1] *= t_value;
-        e[2] *= t_value;
+        if constexpr (Register::kAvailable)
+        {
+            Register::store(
+                e.data(),
+                Register::mul(to_register(), Register::splat(t_value)));
+        }
+        else
+        {
+            e[0] *= t_value;
+            e[1] *= t_value;
+            e[2] *= t_value;
+        }
 
         return *this;
     }
 
-    Vec3 &operator/=(double t_value)
+    BasicVec3 &operator/=(T t_value)
     {
         return *this *= 1 / t_value;
     }
 
-    [[nodiscard]] double length() const
+    [[nodiscard]] T length() const
     {
         return std::sqrt(length_squared());
     }
 
-    [[nodiscard]] double length_squared() const
+    [[nodiscard]] T length_squared() const
     {
-        return e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
+        if constexpr (Register::kAvailable)
+        {
+            const auto lanes{to_register()};
+            return Register::sum(Register::mul(lanes, lanes));
+        }
+        else
+        {
+            return e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
+        }
     }
 
     [[nodiscard]] bool near_zero() const
     {
         // return true is the vector is close to zero in all dimensions
-        constexpr double kSmall{1e-8};
-        return (fabs(e[0]) < kSmall) && (fabs(e[1])) < kSmall &&
-               (fabs(e[2])) < kSmall;
+        constexpr T kSmall{static_cast<T>(1e-8)};
+        return (std::fabs(e[0]) < kSmall) && (std::fabs(e[1])) < kSmall &&
+               (std::fabs(e[2])) < kSmall;
     }
 
-    static Vec3 random()
+    // Random components are drawn in double precision and then rounded, so
+    // every precision sees the same sequence of values.
+    static BasicVec3 random(Rng &rng)
     {
-        return Vec3{random_double(), random_double(), random_double()};
+        return BasicVec3{static_cast<T>(random_double(rng)),
+                         static_cast<T>(random_double(rng)),
+                         static_cast<T>(random_double(rng))};
     }
 
-    static Vec3 random(double min_included, double max_excluded)
+    static BasicVec3 random(Rng &rng, double min_included, double max_excluded)
     {
-        return Vec3{random_double(min_included, max_excluded),
-                    random_double(min_included, max_excluded),
-                    random_double(min_included, max_excluded)};
+        return BasicVec3{
+            static_cast<T>(random_double(rng, min_included, max_excluded)),
+            static_cast<T>(random_double(rng, min_included, max_excluded)),
+            static_cast<T>(random_double(rng, min_included, max_excluded))};
+    }
+
+    // Builds the components in a register where there is one, so a vector
+    // made from scalars is not written piecewise and then reloaded whole.
+    static std::array<T, vec3_detail::kStoredLanes>
+    lanes(T e0_value, T e1_value, T e2_value)
+    {
+        if constexpr (Register::kAvailable)
+        {
+            return std::bit_cast<std::array<T, vec3_detail::kStoredLanes>>(
+                Register::set(e0_value, e1_value, e2_value));
+        }
+        else
+        {
+            return {e0_value, e1_value, e2_value};
+        }
+    }
+
+    // Only called when Register::kAvailable.
+    [[nodiscard]] auto to_register() const
+    {
+        return Register::load(e.data());
+    }
+
+    template <typename Lanes>
+    static BasicVec3 from_register(Lanes lanes)
+    {
+        BasicVec3 result;
+        Register::store(result.e.data(), lanes);
+        return result;
     }
 };
 
+using Vec3 = BasicVec3<Real>;
 
 // point3 is just an alias for vec3, but useful for geometric clarity in the code.
 using Point3 = Vec3;
 
 // Vector utility functions
-inline std::ostream &operator<<(std::ostream &out, const Vec3 &v_value)
+template <typename T>
+std::ostream &operator<<(std::ostream &out, const BasicVec3<T> &v_value)
 {
     return out << v_value.e[0] << ' ' << v_value.e[1] << ' ' << v_value.e[2];
 }
 
-inline Vec3 operator+(const Vec3 &u_value, const Vec3 &v_value)
+template <typename T>
+BasicVec3<T> operator+(const BasicVec3<T> &u_value, const BasicVec3<T> &v_value)
 {
-    return {u_value.e[0] + v_value.e[0],
-            u_value.e[1] + v_value.e[1],
-            u_value.e[2] + v_value.e[2]};
+    using Register = vec3_detail::Register<T>;
+    if constexpr (Register::kAvailable)
+    {
+        return BasicVec3<T>::from_register(
+            Register::add(u_value.to_register(), v_value.to_register()));
+    }
+    else
+    {
+        return {u_value.e[0] + v_value.e[0],
+                u_value.e[1] + v_value.e[1],
+                u_value.e[2] + v_value.e[2]};
+    }
 }
 
-inline Vec3 operator-(const Vec3 &u_value, const Vec3 &v_value)
+template <typename T>
+BasicVec3<T> operator-(const BasicVec3<T> &u_value, const BasicVec3<T> &v_value)
 {
-    return {u_value.e[0] - v_value.e[0],
-            u_value.e[1] - v_value.e[1],
-            u_value.e[2] - v_value.e[2]};
+    using Register = vec3_detail::Register<T>;
+    if constexpr (Register::kAvailable)
+    {
+        return BasicVec3<T>::from_register(
+            Register::sub(u_value.to_register(), v_value.to_register()));
+    }
+    else
+    {
+        return {u_value.e[0] - v_value.e[0],
+                u_value.e[1] - v_value.e[1],
+                u_value.e[2] - v_value.e[2]};
+    }
 }
 
-inline Vec3 operator*(const Vec3 &u_value, const Vec3 &v_value)
+template <typename T>
+BasicVec3<T> operator*(const BasicVec3<T> &u_value, const BasicVec3<T> &v_value)
 {
-    return {u_value.e[0] * v_value.e[0],
-            u_value.e[1] * v_value.e[1],
-            u_value.e[2] * v_value.e[2]};
+    using Register = vec3_detail::Register<T>;
+    if constexpr (Register::kAvailable)
+    {
+        return BasicVec3<T>::from_register(
+            Register::mul(u_value.to_register(), v_value.to_register()));
+    }
+    else
+    {
+        return {u_value.e[0] * v_value.e[0],
+                u_value.e[1] * v_value.e[1],
+                u_value.e[2] * v_value.e[2]};
+    }
 }
 
-inline Vec3 operator*(double t_value, const Vec3 &v_value)
+template <typename T>
+BasicVec3<T> operator*(std::type_identity_t<T> t_value,
+                       const BasicVec3<T> &v_value)
 {
-    return {t_value * v_value.e[0],
-            t_value * v_value.e[1],
-            t_value * v_value.e[2]};
+    using Register = vec3_detail::Register<T>;
+    if constexpr (Register::kAvailable)
+    {
+        return BasicVec3<T>::from_register(
+            Register::mul(Register::splat(t_value), v_value.to_register()));
+    }
+    else
+    {
+        return {t_value * v_value.e[0],
+                t_value * v_value.e[1],
+                t_value * v_value.e[2]};
+    }
 }
 
-inline Vec3 operator*(const Vec3 &v_value, double t_value)
+template <typename T>
+BasicVec3<T> operator*(const BasicVec3<T> &v_value,
+                       std::type_identity_t<T> t_value)
 {
     return t_value * v_value;
 }
 
-inline Vec3 operator/(const Vec3 &v_value, double t_value)
+template <typename T>
+BasicVec3<T> operator/(const BasicVec3<T> &v_value,
+                       std::type_identity_t<T> t_value)
 {
     return (1 / t_value) * v_value;
 }
 
-inline double dot(const Vec3 &u_value, const Vec3 &v_value)
+template <typename T>
+T dot(const BasicVec3<T> &u_value, const BasicVec3<T> &v_value)
 {
-    return u_value.e[0] * v_value.e[0] + u_value.e[1] * v_value.e[1] +
-           u_value.e[2] * v_value.e[2];
+    using Register = vec3_detail::Register<T>;
+    if constexpr (Register::kAvailable)
+    {
+        return Register::sum(
+            Register::mul(u_value.to_register(), v_value.to_register()));
+    }
+    else
+    {
+        return u_value.e[0] * v_value.e[0] + u_value.e[1] * v_value.e[1] +
+               u_value.e[2] * v_value.e[2];
+    }
 }
 
-inline Vec3 cross(const Vec3 &u_value, const Vec3 &v_value)
+template <typename T>
+BasicVec3<T> cross(const BasicVec3<T> &u_value, const BasicVec3<T> &v_value)
 {
-    return {u_value.e[1] * v_value.e[2] - u_value.e[2] * v_value.e[1],
-            u_value.e[2] * v_value.e[0] - u_value.e[0] * v_value.e[2],
-            u_value.e[0] * v_value.e[1] - u_value.e[1] * v_value.e[0]};
+    using Register = vec3_detail::Register<T>;
+    if constexpr (Register::kAvailable)
+    {
+        // u.yzx * v.zxy - u.zxy * v.yzx
+        const auto u_lanes{u_value.to_register()};
+        const auto v_lanes{v_value.to_register()};
+        return BasicVec3<T>::from_register(Register::sub(
+            Register::mul(Register::rotate_left(u_lanes),
+                          Register::rotate_right(v_lanes)),
+            Register::mul(Register::rotate_right(u_lanes),
+                          Register::rotate_left(v_lanes))));
+    }
+    else
+    {
+        return {u_value.e[1] * v_value.e[2] - u_value.e[2] * v_value.e[1],
+                u_value.e[2] * v_value.e[0] - u_value.e[0] * v_value.e[2],
+                u_value.e[0] * v_value.e[1] - u_value.e[1] * v_value.e[0]};
+    }
 }
 
-inline Vec3 unit_vector(Vec3 v_value)
+template <typename T>
+BasicVec3<T> unit_vector(BasicVec3<T> v_value)
 {
     return v_value / v_value.length();
 }
 
-inline Vec3 random_in_unit_disc()
+// Rejection samplers.  The renderer uses the closed-form mappings in
+// sampling.h; bench checks those against these.
+inline Vec3 random_in_unit_disc(Rng &rng)
 {
     while (true)
     {
-        Vec3 result{
-            Vec3{random_double(-1.0, 1.0), random_double(-1.0, 1.0), 0.0}};
-        if (result.length_squared() < 1.0)
+        Vec3 result{static_cast<Real>(random_double(rng, -1.0, 1.0)),
+                    static_cast<Real>(random_double(rng, -1.0, 1.0)),
+                    0.0_r};
+        if (result.length_squared() < 1)
         {
             return result;
         }
     }
 }
 
-inline Vec3 random_in_unit_sphere()
+inline Vec3 random_in_unit_sphere(Rng &rng)
 {
     while (true)
     {
-        Vec3 vector{Vec3::random(-1, 1)};
+        Vec3 vector{Vec3::random(rng, -1, 1)};
         if (vector.length_squared() < 1)
         {
             return vector;
@@ -196,36 +519,39 @@ inline Vec3 random_in_unit_sphere()
     }
 }
 
-inline Vec3 random_unit_vector()
+inline Vec3 random_unit_vector(Rng &rng)
 {
-    return unit_vector(random_in_unit_sphere());
+    return unit_vector(random_in_unit_sphere(rng));
 }
 
-inline Vec3 random_on_hemisphere(const Vec3 &normal)
+inline Vec3 random_on_hemisphere(Rng &rng, const Vec3 &normal)
 {
-    Vec3 on_unit_sphere{random_unit_vector()};
+    Vec3 on_unit_sphere{random_unit_vector(rng)};
     // check if in the same hemisphere as the normal
-    if (dot(on_unit_sphere, normal) > 0.0)
+    if (dot(on_unit_sphere, normal) > 0)
     {
         return on_unit_sphere;
     }
     return -on_unit_sphere;
 }
 
-inline Vec3 reflect(const Vec3 &vector, const Vec3 &normal)
+template <typename T>
+BasicVec3<T> reflect(const BasicVec3<T> &vector, const BasicVec3<T> &normal)
 {
     return {vector - 2 * dot(vector, normal) * normal};
 }
 
-inline Vec3 refract(const Vec3 &incident_ray_uv,
-                    const Vec3 &normal,
-                    double eta_i_over_eta_j)
+template <typename T>
+BasicVec3<T> refract(const BasicVec3<T> &incident_ray_uv,
+                     const BasicVec3<T> &normal,
+                     std::type_identity_t<T> eta_i_over_eta_j)
 {
-    const double cos_theta{fmin(dot(-incident_ray_uv, normal), 1.0)};
-    const Vec3 ray_out_perpendicular{eta_i_over_eta_j *
-                                     (incident_ray_uv + cos_theta * normal)};
-    const Vec3 ray_out_parallel{
-        -sqrt(fabs(1.0 - ray_out_perpendicular.length_squared())) * normal};
+    const T cos_theta{std::fmin(dot(-incident_ray_uv, normal), T{1})};
+    const BasicVec3<T> ray_out_perpendicular{
+        eta_i_over_eta_j * (incident_ray_uv + cos_theta * normal)};
+    const BasicVec3<T> ray_out_parallel{
+        -std::sqrt(std::fabs(1 - ray_out_perpendicular.length_squared())) *
+        normal};
 
     return ray_out_perpendicular + ray_out_parallel;
 }